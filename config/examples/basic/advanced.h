@@ -38,6 +38,11 @@
 // Include the .status field in sensor_status_t to allow the helper functions
 // to store and log status information
 #define USE_SENSOR_STATUS   (!USE_SMALL_SENSORS)
+//
+// Include the .adc_value field in sensor_status_t so that the pins of sensors
+// with SENSOR_CFG_FLAG_ADC set can be sampled together before they're read
+// Requires USE_SENSOR_CFG_PIN
+#define USE_SENSOR_ADC_BATCH (USE_SENSOR_CFG_PIN && uHAL_USE_ADC)
 
 //
 // These are sub-features of USE_SMALL_CONTROLLERS
@@ -138,6 +143,20 @@
 #define RTC_FINE_CORRECTION_PERIOD_MINUTES (60*24)
 #define RTC_FINE_CORRECTION_SECONDS 0
 
+//
+// If > 0, set aside this many bytes of RAM which aren't cleared at startup so
+// that the unwritten part of the log buffer, the pending alarms, and the end
+// of the SD card's log file survive a watchdog, brownout, or software reset
+// The log buffer needs room for LOG_LINE_BUFFER_COUNT lines (or for
+// LOG_COMPRESSED_BUFFER_SIZE bytes and two lines) plus a few dozen bytes and
+// 2 bytes for every 64 for the checksums; if it doesn't fit it's allocated
+// normally and isn't kept. Extra log columns
+// added by the log/logfile.h hooks aren't kept.
+// The linker script must keep the .noinit section out of .bss and below the
+// heap; on STM32 the build fails if it doesn't. On the host the memory is kept
+// in the file HOST_RETAINED_MEMORY_PATH between runs.
+#define RETAINED_MEMORY_BYTES 0
+
 //
 // Maximum length of sensor, controller, and actuator names
 // Increasing this will increase the ROM space used, but depending on struct
@@ -204,6 +223,35 @@
 // calls that need to be made to the FatFS library.
 #define LOG_PRINT_BUFFER_SIZE 2048
 //
+// If set, line the log write buffer up with blocks of this many bytes in the
+// output file so that writes after the first one in a session cover only whole
+// blocks
+// With FatFS, 512 (the sector size) lets whole sectors be written straight from
+// the log buffer instead of being copied through the file's sector buffer first.
+// LOG_PRINT_BUFFER_SIZE must be a multiple of this.
+#define LOG_PRINT_BUFFER_ALIGNMENT 512
+//
+// If > 0, reserve space for LOG_LINES_PER_FILE lines of about this many bytes
+// each when a new log file is started so that it's written to one contiguous
+// area of the storage without updating the FAT at each cluster boundary
+// Once a full file has been written the measured line size is used instead.
+// Any space left over is released when the file is rotated out.
+#define LOG_PREALLOCATE_LINE_SIZE 128
+//
+// If set, pick the most recent log file back up after a reboot instead of
+// starting a new one, as long as it isn't full and was written with the same
+// header
+// This only works for text logs; binary logs always start a new file.
+#define LOG_RESUME_LAST_FILE 1
+//
+// If > 0, store buffered log lines in a ring of this many bytes as the
+// difference from the line before instead of whole, which lets far more lines
+// fit in the same RAM since most fields don't change between readings
+// LOG_LINE_BUFFER_COUNT then only caps the number of lines kept and can be
+// raised accordingly; the buffer is written out when either one fills up.
+// Set to 0 to store each line in full.
+#define LOG_COMPRESSED_BUFFER_SIZE 0
+//
 // The string printed to the log for invalid values
 #define LOG_INVALID_VALUE "(invalid)"
 //
@@ -216,3 +264,27 @@
 // The format of the system time printed in the log
 // Possible values are TIME_FORMAT_{AUTO,SECONDS,DURATION,DATE}
 #define LOG_TIME_FORMAT TIME_FORMAT_AUTO
+//
+// If set, the log is written to storage as packed binary records instead of
+// tab-separated text, which is much faster to produce
+// The files aren't noticeably smaller: with 'int' statuses and readings a record
+// is about the same size as the text line it replaces.
+// Use tools/decode_binary_log.py to convert the files back to text. Logs
+// printed over the terminal are always text.
+#define LOG_FORMAT_BINARY 0
+
+//
+// If set, host builds replay the ADC trace named by the GHMON_SIM_TRACE
+// environment variable and print a summary of actuator switching, controller
+// run times, and wakeups when they exit
+// See src/simulation.c for the trace format. Has no effect on other platforms.
+// Only raw ADC readings can be replayed: a log file can be used as a trace
+// once a '<sensor name>_adc' column has been added for each sensor, but the
+// converted readings it already has are ignored.
+#define USE_SIMULATION 1
+//
+// If set, keep track of time spent awake in each phase of the main loop and of
+// the reasons for waking up
+// The totals can be printed with the 'profile' terminal command. This uses the
+// microsecond counter, which is enabled automatically.
+#define USE_PROFILING 0
@@ -130,7 +130,7 @@
 // If set, keep track of the current log file name
 // Without this LOGFILE_NAME_PATTERN does nothing and LOG_LINES_PER_FILE just
 // reprints the header when the file would otherwise be rotated.
-#define USE_LOG_FILE_NAME (WRITE_LOG_TO_SD)
+#define USE_LOG_FILE_NAME (WRITE_LOG_TO_SD && !WRITE_LOG_TO_FLASH)
 
 //
 // The user-defined code handling sensor/controller/actuator/logging definitions
@@ -75,6 +75,26 @@
 // log outputs either to avoid flushing the buffer
 #define LOG_WITH_MISSING_SD 0
 //
+// If set, write the log to a journal in the MCU's internal flash instead of
+// directly to the SD card
+// Programming flash takes a small fraction of the power needed to bring up an
+// SD card. If WRITE_LOG_TO_SD is also set, the journal is copied to the end of
+// LOG_FLASH_DRAIN_FILE_NAME on the card once LOG_FLASH_DRAIN_BYTES have built
+// up and the battery isn't low; the oldest entries are overwritten if the
+// journal fills up before then.
+// The size of the journal is set by uHAL_FLASH_DATA_PAGES, which must be
+// kept clear of the program. This is only supported on STM32F1 devices and
+// the HOST platform.
+#define WRITE_LOG_TO_FLASH 0
+//
+// The number of bytes the flash journal collects before it's drained to the
+// SD card
+// This should be well under the size of the journal less one page.
+#define LOG_FLASH_DRAIN_BYTES 4096UL
+//
+// The file on the SD card the flash journal is drained to
+#define LOG_FLASH_DRAIN_FILE_NAME "JOURNAL.LOG"
+//
 // If set, write log output to a UART port
 // All log buffering is still applied.
 #define WRITE_LOG_TO_UART 1
@@ -83,6 +103,10 @@
 // log outputs either to avoid flushing the buffer
 #define LOG_WITH_MISSING_UART 1
 //
+// If set and USE_PROFILING is enabled, the extra log columns hold the wake time
+// profile totals instead of the log buffer index
+#define LOG_PROFILE_COLUMNS 1
+//
 // The TX and RX pins the log is written to
 // If 0, use the standard communication port.
 #define UART_LOG_TX_PIN 0
@@ -0,0 +1,6 @@
+//
+// uHAL settings that should be overridden for the native HOST platform go in here
+
+//
+// Find the pin definitions
+#include GHMON_INCLUDE_CONFIG_HEADER(pindefs/host.h)
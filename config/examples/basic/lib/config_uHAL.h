@@ -10,3 +10,7 @@
 # define uHAL_USE_SPI 1
 # define uHAL_USE_FATFS 1
 #endif
+#if USE_LOGGING && WRITE_LOG_TO_FLASH
+# define uHAL_USE_FLASH 1
+# define uHAL_FLASH_DATA_PAGES 8U
+#endif
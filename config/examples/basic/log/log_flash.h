@@ -0,0 +1,529 @@
+#if WRITE_LOG_TO_FLASH
+
+//
+// The log journal is a ring of flash pages at the end of the MCU's internal
+// flash, each starting with a header holding a sequence number which goes up
+// by one every time a page is started. New records are appended to the page
+// with the highest sequence number; when it fills up the next page in the ring
+// is erased and started, so every page is erased the same number of times.
+//
+// Page header:
+//    magic:u16 check:u16 seq:u32
+// where 'check' is a CRC-16/CCITT-FALSE of 'seq'.
+//
+// Record:
+//    size:u16 ~size:u16 crc:u16 drained:u16 data:u8[size]
+// where 'crc' is a CRC-16/CCITT-FALSE of 'data' and 'drained' is left erased
+// until the record has been copied to the SD card, when it's cleared to 0. The
+// data is padded out to a whole number of flash write units.
+//
+// The header is written before the data so that a record cut short by a reset
+// can still be skipped over; its CRC won't match so it's thrown away instead of
+// being drained. A record header that isn't valid ends the page.
+//
+// All values are in the byte order of the MCU.
+//
+#if FLASH_PAGE_BYTES > 0xFFFFU
+# error "The log journal needs flash pages smaller than 64KB"
+#endif
+#if uHAL_FLASH_DATA_PAGES < 2
+# error "The log journal needs uHAL_FLASH_DATA_PAGES >= 2"
+#endif
+
+#define JOURNAL_MAGIC 0x4A47U // 'GJ'
+#define JOURNAL_PAGES ((uint_fast16_t )uHAL_FLASH_DATA_PAGES)
+#define JOURNAL_ROUND_UP(_n_) ((((_n_) + (FLASH_WRITE_BYTES - 1U)) / FLASH_WRITE_BYTES) * FLASH_WRITE_BYTES)
+#define JOURNAL_PAGE_HEADER_BYTES JOURNAL_ROUND_UP(8U)
+// The drained marker gets a write unit to itself so it can be cleared later
+#define JOURNAL_RECORD_INFO_BYTES JOURNAL_ROUND_UP(6U)
+#define JOURNAL_RECORD_HEADER_BYTES (JOURNAL_RECORD_INFO_BYTES + JOURNAL_ROUND_UP(2U))
+#define JOURNAL_PAGE_START(_p_) ((uint32_t )(_p_) * FLASH_PAGE_BYTES)
+#define JOURNAL_PAGE_END(_p_) (JOURNAL_PAGE_START(_p_) + FLASH_PAGE_BYTES)
+// Records are copied in blocks of this size when drained or printed
+#define JOURNAL_COPY_BYTES 64U
+
+#if defined(LOG_FORMAT_BINARY) && LOG_FORMAT_BINARY
+# define JOURNAL_IS_BINARY 1
+#else
+# define JOURNAL_IS_BINARY 0
+#endif
+
+typedef struct {
+	uint16_t size;
+	uint16_t crc;
+	bool drained;
+} journal_record_t;
+//
+// Called for each record when walking the journal
+// Walking stops if anything other than ERR_OK is returned
+typedef err_t (*journal_record_cb_t)(uint32_t offset, const journal_record_t *rec, void *ctx);
+
+static struct {
+	bool mounted;
+	// The page currently being appended to and its sequence number
+	uint_fast16_t page;
+	uint32_t seq;
+	// The offset of the next record in the data area
+	uint32_t end;
+	// Data bytes which haven't been drained to the SD card yet
+	uint32_t undrained;
+	// Undrained data bytes which were erased to make room for newer records
+	uint32_t lost;
+} journal;
+
+static bool read_journal_page_seq(uint_fast16_t page, uint32_t *seq) {
+	uint8_t hdr[8];
+	uint16_t magic, check;
+
+	if (flash_read(JOURNAL_PAGE_START(page), hdr, sizeof(hdr)) != ERR_OK) {
+		return false;
+	}
+	memcpy(&magic, &hdr[0], 2);
+	memcpy(&check, &hdr[2], 2);
+	memcpy(seq, &hdr[4], 4);
+
+	return (magic == JOURNAL_MAGIC && check == crc16_ccitt(0xFFFFU, &hdr[4], 4));
+}
+//
+// Read the header of the record at 'offset'
+// Return values:
+//    ERR_OK     : The record is valid
+//    ERR_NOENT  : There's no record there, this is the end of the page
+//    ERR_BADFILE: The header is damaged and the rest of the page can't be used
+static err_t read_journal_record(uint32_t offset, journal_record_t *rec) {
+	uint8_t hdr[JOURNAL_RECORD_HEADER_BYTES];
+	uint16_t check, drained;
+	bool erased = true;
+
+	if (flash_read(offset, hdr, sizeof(hdr)) != ERR_OK) {
+		return ERR_BADFILE;
+	}
+	for (uiter_t i = 0; i < JOURNAL_RECORD_INFO_BYTES; ++i) {
+		erased = erased && (hdr[i] == FLASH_ERASED_BYTE);
+	}
+	if (erased) {
+		return ERR_NOENT;
+	}
+
+	memcpy(&rec->size, &hdr[0], 2);
+	memcpy(&check, &hdr[2], 2);
+	memcpy(&rec->crc, &hdr[4], 2);
+	memcpy(&drained, &hdr[JOURNAL_RECORD_INFO_BYTES], 2);
+	rec->drained = (drained != 0xFFFFU);
+
+	if (rec->size == 0 || (uint16_t )(rec->size ^ check) != 0xFFFFU) {
+		return ERR_BADFILE;
+	}
+	if ((offset % FLASH_PAGE_BYTES) + JOURNAL_RECORD_HEADER_BYTES + JOURNAL_ROUND_UP((uint32_t )rec->size) > FLASH_PAGE_BYTES) {
+		return ERR_BADFILE;
+	}
+
+	return ERR_OK;
+}
+//
+// Call cb() for every record on a page, and set '*end' to where the next one
+// would go if 'end' isn't NULL
+// A page which hasn't been started has no records and is full.
+static err_t walk_journal_page(uint_fast16_t page, journal_record_cb_t cb, void *ctx, uint32_t *end) {
+	uint32_t seq, offset = JOURNAL_PAGE_END(page);
+	journal_record_t rec;
+	err_t res = ERR_OK;
+
+	if (read_journal_page_seq(page, &seq) && seq <= journal.seq) {
+		offset = JOURNAL_PAGE_START(page) + JOURNAL_PAGE_HEADER_BYTES;
+
+		while (offset + JOURNAL_RECORD_HEADER_BYTES <= JOURNAL_PAGE_END(page)) {
+			switch (read_journal_record(offset, &rec)) {
+			case ERR_OK:
+				break;
+			case ERR_NOENT:
+				goto END;
+			default:
+				offset = JOURNAL_PAGE_END(page);
+				goto END;
+			}
+			if (cb != NULL && (res = cb(offset, &rec, ctx)) != ERR_OK) {
+				goto END;
+			}
+			offset += JOURNAL_RECORD_HEADER_BYTES + JOURNAL_ROUND_UP((uint32_t )rec.size);
+		}
+	}
+
+END:
+	if (end != NULL) {
+		*end = offset;
+	}
+	return res;
+}
+//
+// Call cb() for every record in the journal from oldest to newest
+static err_t walk_journal(journal_record_cb_t cb, void *ctx) {
+	err_t res = ERR_OK;
+
+	for (uint_fast16_t i = 1; i <= JOURNAL_PAGES && res == ERR_OK; ++i) {
+		res = walk_journal_page((journal.page + i) % JOURNAL_PAGES, cb, ctx, NULL);
+	}
+
+	return res;
+}
+static err_t count_undrained_record(uint32_t offset, const journal_record_t *rec, void *ctx) {
+	UNUSED(offset);
+
+	if (!rec->drained) {
+		*(uint32_t *)ctx += rec->size;
+	}
+
+	return ERR_OK;
+}
+
+static err_t mount_flash_journal(void) {
+	uint32_t seq;
+	bool found = false;
+
+	if (journal.mounted) {
+		return ERR_OK;
+	}
+
+	//
+	// With nothing in the journal yet, pretend the last page is full so that
+	// the first one is started by the first write
+	journal.page = JOURNAL_PAGES - 1U;
+	journal.seq = 0;
+	for (uint_fast16_t p = 0; p < JOURNAL_PAGES; ++p) {
+		if (read_journal_page_seq(p, &seq) && (!found || seq > journal.seq)) {
+			found = true;
+			journal.page = p;
+			journal.seq = seq;
+		}
+	}
+	journal.undrained = 0;
+	walk_journal(count_undrained_record, &journal.undrained);
+	walk_journal_page(journal.page, NULL, NULL, &journal.end);
+	journal.mounted = true;
+
+	LOGGER("Log journal: page %u, sequence %lu, %lu bytes not yet drained",
+		(uint )journal.page, (long unsigned )journal.seq, (long unsigned )journal.undrained);
+
+	return ERR_OK;
+}
+//
+// Erase the next page in the ring and start appending to it
+static err_t start_journal_page(void) {
+	uint_fast16_t page = (journal.page + 1U) % JOURNAL_PAGES;
+	uint8_t hdr[JOURNAL_PAGE_HEADER_BYTES];
+	uint32_t lost = 0, seq = journal.seq + 1U;
+	uint16_t v;
+	err_t res;
+
+	//
+	// Whatever on the page hasn't been drained is about to be lost
+	walk_journal_page(page, count_undrained_record, &lost, NULL);
+	if (lost > 0) {
+		journal.lost += lost;
+		journal.undrained = (journal.undrained > lost) ? journal.undrained - lost : 0;
+	}
+
+	if ((res = flash_erase_page(page)) != ERR_OK) {
+		PRINTF("Failed to erase log journal page %u: error %d", (uint )page, (int )res);
+		return res;
+	}
+
+	mem_init(hdr, FLASH_ERASED_BYTE, sizeof(hdr));
+	v = JOURNAL_MAGIC;
+	memcpy(&hdr[0], &v, 2);
+	memcpy(&hdr[4], &seq, 4);
+	v = crc16_ccitt(0xFFFFU, &hdr[4], 4);
+	memcpy(&hdr[2], &v, 2);
+	if ((res = flash_write(JOURNAL_PAGE_START(page), hdr, sizeof(hdr))) != ERR_OK) {
+		PRINTF("Failed to start log journal page %u: error %d", (uint )page, (int )res);
+		return res;
+	}
+
+	journal.page = page;
+	journal.seq = seq;
+	journal.end = JOURNAL_PAGE_START(page) + JOURNAL_PAGE_HEADER_BYTES;
+
+	return ERR_OK;
+}
+static err_t write_journal_record(const uint8_t *buf, uint_fast16_t size) {
+	uint8_t hdr[JOURNAL_RECORD_INFO_BYTES];
+	uint32_t offset = journal.end + JOURNAL_RECORD_HEADER_BYTES;
+	uint_fast16_t whole = size - (size % FLASH_WRITE_BYTES);
+	uint16_t v;
+	err_t res;
+
+	mem_init(hdr, FLASH_ERASED_BYTE, sizeof(hdr));
+	v = (uint16_t )size;
+	memcpy(&hdr[0], &v, 2);
+	v = (uint16_t )~v;
+	memcpy(&hdr[2], &v, 2);
+	v = crc16_ccitt(0xFFFFU, buf, size);
+	memcpy(&hdr[4], &v, 2);
+	if ((res = flash_write(journal.end, hdr, sizeof(hdr))) != ERR_OK) {
+		return res;
+	}
+
+	if (whole > 0 && (res = flash_write(offset, buf, whole)) != ERR_OK) {
+		return res;
+	}
+	if (whole < size) {
+		uint8_t pad[FLASH_WRITE_BYTES];
+
+		mem_init(pad, FLASH_ERASED_BYTE, sizeof(pad));
+		memcpy(pad, &buf[whole], size - whole);
+		if ((res = flash_write(offset + whole, pad, sizeof(pad))) != ERR_OK) {
+			return res;
+		}
+	}
+
+	journal.end = offset + JOURNAL_ROUND_UP((uint32_t )size);
+	journal.undrained += size;
+
+	return ERR_OK;
+}
+static err_t write_buffer_to_flash(const uint8_t *buf, print_buffer_size_t bytes) {
+	err_t res;
+
+	if (!journal.mounted) {
+		return ERR_INIT;
+	}
+
+	while (bytes > 0) {
+		uint32_t page_end = JOURNAL_PAGE_END(journal.page);
+		uint_fast16_t size;
+
+		if (journal.end + JOURNAL_RECORD_HEADER_BYTES >= page_end) {
+			if ((res = start_journal_page()) != ERR_OK) {
+				return res;
+			}
+			continue;
+		}
+
+		size = (uint_fast16_t )(page_end - (journal.end + JOURNAL_RECORD_HEADER_BYTES));
+		if (size > bytes) {
+			size = (uint_fast16_t )bytes;
+		}
+		if ((res = write_journal_record(buf, size)) != ERR_OK) {
+			PRINTF("Failed to write log journal record: error %d", (int )res);
+			// Whatever was written is garbage now, move on to a fresh page
+			// next time
+			journal.end = page_end;
+			return res;
+		}
+		buf += size;
+		bytes -= size;
+	}
+
+	return ERR_OK;
+}
+
+//
+// Check the CRC of a record's data
+static bool journal_record_is_intact(uint32_t offset, const journal_record_t *rec) {
+	uint8_t buf[JOURNAL_COPY_BYTES];
+	uint16_t crc = 0xFFFFU;
+
+	offset += JOURNAL_RECORD_HEADER_BYTES;
+	for (uint_fast16_t left = rec->size, n; left > 0; left -= n, offset += n) {
+		n = (left > sizeof(buf)) ? sizeof(buf) : left;
+		if (flash_read(offset, buf, n) != ERR_OK) {
+			return false;
+		}
+		crc = crc16_ccitt(crc, buf, n);
+	}
+
+	return (crc == rec->crc);
+}
+//
+// Pass a record's data to 'copy' in blocks of up to JOURNAL_COPY_BYTES
+static err_t copy_journal_record(uint32_t offset, const journal_record_t *rec, err_t (*copy)(uint8_t *buf, uint_fast16_t size)) {
+	uint8_t buf[JOURNAL_COPY_BYTES + 1U];
+	err_t res;
+
+	offset += JOURNAL_RECORD_HEADER_BYTES;
+	for (uint_fast16_t left = rec->size, n; left > 0; left -= n, offset += n) {
+		n = (left > JOURNAL_COPY_BYTES) ? JOURNAL_COPY_BYTES : left;
+		if ((res = flash_read(offset, buf, n)) != ERR_OK) {
+			return res;
+		}
+		if ((res = copy(buf, n)) != ERR_OK) {
+			return res;
+		}
+	}
+
+	return ERR_OK;
+}
+
+#if WRITE_LOG_TO_SD
+typedef struct {
+	uint32_t bytes;
+	uint_fast16_t bad;
+} journal_drain_t;
+
+static err_t copy_journal_to_SD(uint8_t *buf, uint_fast16_t size) {
+	return write_buffer_to_SD(buf, (print_buffer_size_t )size);
+}
+static err_t drain_journal_record(uint32_t offset, const journal_record_t *rec, void *ctx) {
+	journal_drain_t *drain = ctx;
+	err_t res;
+
+	if (rec->drained) {
+		return ERR_OK;
+	}
+	if (!journal_record_is_intact(offset, rec)) {
+		++drain->bad;
+		return ERR_OK;
+	}
+	if ((res = copy_journal_record(offset, rec, copy_journal_to_SD)) == ERR_OK) {
+		drain->bytes += rec->size;
+	}
+
+	return res;
+}
+static err_t mark_journal_record_drained(uint32_t offset, const journal_record_t *rec, void *ctx) {
+	uint8_t zero[JOURNAL_RECORD_HEADER_BYTES - JOURNAL_RECORD_INFO_BYTES] = { 0 };
+
+	UNUSED(ctx);
+
+	if (rec->drained) {
+		return ERR_OK;
+	}
+
+	return flash_write(offset + JOURNAL_RECORD_INFO_BYTES, zero, sizeof(zero));
+}
+//
+// Copy everything which hasn't been drained yet to the end of
+// LOG_FLASH_DRAIN_FILE_NAME on the SD card
+// Records are only marked as drained once the file has been closed, so a
+// failure part way through may cause some of them to be copied twice but
+// never loses any.
+static err_t drain_flash_journal(void) {
+	journal_drain_t drain = { 0 };
+	err_t res, cres;
+
+	if ((res = open_SD()) != ERR_OK) {
+		PRINTF("Failed to open log SD: error %d", (int )res);
+		return res;
+	}
+	if ((res = open_SD_file(LOG_FLASH_DRAIN_FILE_NAME)) == ERR_OK) {
+		res = walk_journal(drain_journal_record, &drain);
+		cres = close_SD_file();
+		res = (res == ERR_OK) ? cres : res;
+	}
+	close_SD();
+
+	if (res != ERR_OK) {
+		PRINTF("Failed to drain log journal: error %d", (int )res);
+		return res;
+	}
+
+	if ((res = walk_journal(mark_journal_record_drained, NULL)) != ERR_OK) {
+		PRINTF("Failed to mark log journal records drained: error %d", (int )res);
+	}
+	journal.undrained = 0;
+	LOGGER("Drained %lu log journal bytes to %s (%u damaged records dropped)",
+		(long unsigned )drain.bytes, LOG_FLASH_DRAIN_FILE_NAME, (uint )drain.bad);
+
+	return res;
+}
+//
+// Drain the journal once enough has built up, as long as there's power to
+// spare for the SD card
+static bool flash_journal_needs_draining(void) {
+	const uint8_t warnings = (WARN_BATTERY_LOW | WARN_VCC_LOW);
+
+	return (journal.undrained >= LOG_FLASH_DRAIN_BYTES && !BIT_IS_SET(ghmon_warnings, warnings));
+}
+#else // WRITE_LOG_TO_SD
+static err_t drain_flash_journal(void) {
+	return ERR_OK;
+}
+static bool flash_journal_needs_draining(void) {
+	return false;
+}
+#endif // WRITE_LOG_TO_SD
+
+static err_t close_flash_journal(void) {
+#if defined(HAVE_HOST) && HAVE_HOST
+	// Report what this write cycle cost the flash
+	host_flash_stats_t st;
+
+	if (!journal.mounted) {
+		return ERR_OK;
+	}
+	host_flash_get_stats(&st);
+	LOGGER("Log flash: %u pages erased (%u-%u per page), %u bytes programmed in %u calls, %u bytes read, %u us busy, %lu bytes waiting, %lu lost",
+		(uint )st.page_erases, (uint )st.min_page_erases, (uint )st.max_page_erases,
+		(uint )st.bytes_written, (uint )st.write_calls, (uint )st.bytes_read,
+		(uint )st.busy_us, (long unsigned )journal.undrained, (long unsigned )journal.lost);
+	host_flash_reset_stats();
+#endif
+
+	return ERR_OK;
+}
+
+static void (*journal_pf)(const char *format, ...);
+static err_t print_journal_block(uint8_t *buf, uint_fast16_t size) {
+	if (JOURNAL_IS_BINARY) {
+		for (uint_fast16_t i = 0; i < size; ++i) {
+			journal_pf("%02X", (uint )buf[i]);
+		}
+	} else {
+		// There's room for the terminator past the end of the block
+		buf[size] = 0;
+		journal_pf("%s", (char *)buf);
+	}
+
+	return ERR_OK;
+}
+static err_t print_journal_record(uint32_t offset, const journal_record_t *rec, void *ctx) {
+	UNUSED(ctx);
+
+	if (!journal_record_is_intact(offset, rec)) {
+		journal_pf("\r\n# Damaged log journal record at offset %lu\r\n", (long unsigned )offset);
+		return ERR_OK;
+	}
+
+	return copy_journal_record(offset, rec, print_journal_block);
+}
+//
+// Print every record in the journal, drained or not, from oldest to newest
+// Binary logs are printed in hex.
+static err_t print_flash_journal(void (*pf)(const char *format, ...)) {
+	err_t res;
+
+	if ((res = mount_flash_journal()) != ERR_OK) {
+		return res;
+	}
+	journal_pf = pf;
+	res = walk_journal(print_journal_record, NULL);
+	if (JOURNAL_IS_BINARY) {
+		pf("\r\n");
+	}
+
+	return res;
+}
+
+#else // WRITE_LOG_TO_FLASH
+static err_t mount_flash_journal(void) {
+	return ERR_OK;
+}
+static err_t write_buffer_to_flash(const uint8_t *buf, print_buffer_size_t bytes) {
+	UNUSED(buf);
+	UNUSED(bytes);
+	return ERR_OK;
+}
+static err_t close_flash_journal(void) {
+	return ERR_OK;
+}
+static err_t drain_flash_journal(void) {
+	return ERR_OK;
+}
+static bool flash_journal_needs_draining(void) {
+	return false;
+}
+static err_t print_flash_journal(void (*pf)(const char *format, ...)) {
+	UNUSED(pf);
+	return ERR_NOTSUP;
+}
+#endif // WRITE_LOG_TO_FLASH
@@ -1,6 +1,18 @@
 #if WRITE_LOG_TO_SD
 
 #include "FatFS/ff.h"
+#if uHAL_USE_FATFS_IMAGE
+# include "uHAL/include/drivers/storage/FatFS_diskio/diskio_image.h"
+#endif
+#if uHAL_USE_FATFS_SD
+# include "uHAL/include/drivers/storage/FatFS_diskio/diskio_SD.h"
+#endif
+
+//
+// The FatFS options are set to match in config/general/config_FatFS.h
+#if defined(USE_LOG_FILE_NAME) && USE_LOG_FILE_NAME && LOG_LINES_PER_FILE > 0 && ! FF_USE_FIND
+# error "Rotating log files on the SD card needs FF_USE_FIND"
+#endif
 
 static bool print_to_SD = false;
 static uint8_t write_errors;
@@ -10,6 +22,38 @@ static FIL fh;
 
 #define SD_IS_MOUNTED() (fs.fs_type != 0)
 #define SD_FILE_IS_OPEN() (fh.obj.fs != NULL)
+#if FF_MAX_SS == FF_MIN_SS
+# define SD_SECTOR_SIZE() ((FSIZE_t )FF_MAX_SS)
+#else
+# define SD_SECTOR_SIZE() ((FSIZE_t )fs.ssize)
+#endif
+
+//
+// Where the log file ended the last time it was closed
+// f_open(..., FA_OPEN_APPEND) finds the end of the file by following the
+// cluster chain from the start, so the cost of each flush grows with the size
+// of the file; keeping the last cluster around lets us jump straight there
+// instead. The cursor is only trusted if the directory entry and the volume's
+// free cluster count haven't changed since it was saved, otherwise we fall
+// back to walking the chain.
+// 'end' is where the contents of the file end, which falls short of its size
+// while it still holds space set aside by reserve_SD_file(). It's kept up to
+// date while the file is open and trusted afterwards as long as the directory
+// entry hasn't changed; 'clust' is 0 when only 'end' can be trusted.
+typedef struct {
+	DWORD sclust;
+	DWORD clust;
+	DWORD free_clst;
+	FSIZE_t size;
+	FSIZE_t end;
+} SD_cursor_t;
+static SD_cursor_t SD_cursor;
+#if USE_RETAINED_MEMORY
+//
+// The cursor as of the last time the file was closed, kept in retained memory
+// so that it's still good for a log file resumed after a reset
+static SD_cursor_t *retained_SD_cursor = NULL;
+#endif
 
 static err_t FRESULT_to_err_t(FRESULT fres) {
 	if (!USE_SMALL_CODE) {
@@ -53,9 +97,148 @@ static err_t FRESULT_to_err_t(FRESULT fres) {
 static void init_log_SD(void) {
 	//output_pin_on(SPI_CS_SD_PIN);
 	gpio_set_mode(SPI_CS_SD_PIN, GPIO_MODE_PP, GPIO_HIGH);
+
+#if USE_RETAINED_MEMORY
+	bool restored;
+
+	retained_SD_cursor = retain_region(RETAIN_LOG_CURSOR, sizeof(*retained_SD_cursor), &restored);
+	if ((retained_SD_cursor != NULL) && restored) {
+		SD_cursor = *retained_SD_cursor;
+		LOGGER("Restored log SD cursor at %lu", (long unsigned )SD_cursor.end);
+	}
+#endif
+
+	return;
+}
+
+static FRESULT seek_SD_file_end(void) {
+	FRESULT fres;
+	FSIZE_t size = f_size(&fh);
+
+	if (
+		(size == 0) ||
+		(SD_cursor.size != size) ||
+		(SD_cursor.sclust != fh.obj.sclust)
+		) {
+		SD_cursor.sclust = fh.obj.sclust;
+		SD_cursor.size = size;
+		SD_cursor.clust = 0;
+		SD_cursor.end = size;
+	}
+	if (
+		!FF_USE_FASTSEEK ||
+		(SD_cursor.end == 0) ||
+		(SD_cursor.clust == 0) ||
+		(SD_cursor.free_clst != fs.free_clst)
+		) {
+		return f_lseek(&fh, SD_cursor.end);
+	}
+
+#if FF_USE_FASTSEEK
+	//
+	// Describe the file to fast-seek as the run of clusters leading up to the
+	// last one followed by the last one itself; only the last is ever looked up
+	// so it doesn't matter that the first run may not be contiguous on disk
+	DWORD clmt[6], *tbl = clmt;
+	DWORD last = (DWORD )((SD_cursor.end - 1) / (fs.csize * SD_SECTOR_SIZE()));
+
+	*tbl++ = SIZEOF_ARRAY(clmt);
+	if (last > 0) {
+		*tbl++ = last;
+		*tbl++ = SD_cursor.sclust;
+	}
+	*tbl++ = 1;
+	*tbl++ = SD_cursor.clust;
+	*tbl = 0;
+
+	fh.cltbl = clmt;
+	fres = f_lseek(&fh, SD_cursor.end);
+	//
+	// The file can't grow while in fast-seek mode and the table is about to go
+	// out of scope anyway
+	fh.cltbl = NULL;
+#else
+	fres = FR_OK;
+#endif
+
+	return fres;
+}
+//
+// Called with the file pointer at SD_cursor.end
+static void save_SD_cursor(void) {
+	SD_cursor.sclust = fh.obj.sclust;
+	SD_cursor.clust = fh.clust;
+	SD_cursor.size = f_size(&fh);
+	SD_cursor.free_clst = fs.free_clst;
+
+	return;
+}
+static void clear_SD_cursor(void) {
+	SD_cursor.size = 0;
+	SD_cursor.clust = 0;
+	return;
+}
+static void retain_SD_cursor(void) {
+#if USE_RETAINED_MEMORY
+	if (retained_SD_cursor != NULL) {
+		*retained_SD_cursor = SD_cursor;
+		retain_sync(retained_SD_cursor);
+	}
+#endif
 	return;
 }
 
+//
+// Allocate a contiguous run of clusters for a new, empty file so that it can
+// be written sequentially without touching the FAT
+// The file's size covers the whole reservation from here on; SD_cursor.end
+// keeps track of how much of it has actually been written, and trim_SD_file()
+// cuts the file back down to that.
+static err_t reserve_SD_file(uint32_t bytes) {
+	FRESULT fres;
+
+	if (!print_to_SD || bytes == 0) {
+		return ERR_OK;
+	}
+	if (!SKIP_SAFETY_CHECKS && (!SD_IS_MOUNTED() || !SD_FILE_IS_OPEN())) {
+		return ERR_INIT;
+	}
+	if (f_size(&fh) != 0) {
+		return ERR_OK;
+	}
+
+#if FF_USE_EXPAND
+	if ((fres = f_expand(&fh, bytes, 1)) != FR_OK) {
+		PRINTF("f_expand(): FatFS error %u", (uint )fres);
+		return FRESULT_to_err_t(fres);
+	}
+	SD_cursor.end = 0;
+
+	return ERR_OK;
+#else
+	UNUSED(fres);
+	return ERR_NOTSUP;
+#endif
+}
+//
+// Cut the open file back to the end of what's been written to it, releasing
+// whatever's left of its reservation
+static err_t trim_SD_file(void) {
+	FRESULT fres;
+
+	if (!print_to_SD || !SD_IS_MOUNTED() || !SD_FILE_IS_OPEN() || f_size(&fh) <= SD_cursor.end) {
+		return ERR_OK;
+	}
+
+	if ((fres = f_lseek(&fh, SD_cursor.end)) != FR_OK) {
+		PRINTF("f_lseek(): FatFS error %u", (uint )fres);
+	} else if ((fres = f_truncate(&fh)) != FR_OK) {
+		PRINTF("f_truncate(): FatFS error %u", (uint )fres);
+	}
+
+	return FRESULT_to_err_t(fres);
+}
+
 static err_t open_SD_file(const char *path) {
 	FRESULT fres;
 
@@ -68,9 +251,55 @@ static err_t open_SD_file(const char *path) {
 	}
 
 	print_to_SD = true;
-	if ((fres = f_open(&fh, path, FA_WRITE|FA_OPEN_APPEND)) != FR_OK) {
+	if ((fres = f_open(&fh, path, FA_READ|FA_WRITE|FA_OPEN_ALWAYS)) != FR_OK) {
 		PRINTF("f_open(): FatFS error %u", (uint )fres);
 		print_to_SD = false;
+		return FRESULT_to_err_t(fres);
+	}
+	if ((fres = seek_SD_file_end()) != FR_OK) {
+		PRINTF("f_lseek(): FatFS error %u", (uint )fres);
+		f_close(&fh);
+		print_to_SD = false;
+	}
+
+	return FRESULT_to_err_t(fres);
+}
+//
+// Open a file only to read it
+// Nothing is written to a file opened this way, including when it's closed.
+static err_t open_SD_file_readonly(const char *path) {
+	FRESULT fres;
+
+	if (!SD_IS_MOUNTED()) {
+		return ERR_INIT;
+	}
+
+	if ((fres = f_open(&fh, path, FA_READ|FA_OPEN_EXISTING)) != FR_OK) {
+		PRINTF("f_open(): FatFS error %u", (uint )fres);
+	}
+
+	return FRESULT_to_err_t(fres);
+}
+//
+// Move the end of the open file's contents back to 'end'
+// Whatever follows it is released by trim_SD_file().
+static err_t seek_SD_file(uint32_t end) {
+	FRESULT fres;
+
+	if (!print_to_SD) {
+		return ERR_OK;
+	}
+	if (!SKIP_SAFETY_CHECKS && (!SD_IS_MOUNTED() || !SD_FILE_IS_OPEN())) {
+		return ERR_INIT;
+	}
+	if (end > f_size(&fh)) {
+		return ERR_BADARG;
+	}
+
+	if ((fres = f_lseek(&fh, end)) != FR_OK) {
+		PRINTF("f_lseek(): FatFS error %u", (uint )fres);
+	} else {
+		SD_cursor.end = end;
 	}
 
 	return FRESULT_to_err_t(fres);
@@ -78,11 +307,11 @@ static err_t open_SD_file(const char *path) {
 static err_t open_SD(void) {
 	FRESULT fres;
 
-	spi_on();
+	power_acquire(POWER_DOMAIN_SPI);
 
 	if ((fres = f_mount(&fs, "", 1)) != FR_OK) {
 		PRINTF("f_mount(): FatFS error %u", (uint )fres);
-		spi_off();
+		power_release(POWER_DOMAIN_SPI);
 	}
 
 	return FRESULT_to_err_t(fres);
@@ -90,16 +319,40 @@ static err_t open_SD(void) {
 
 static err_t close_SD_file(void) {
 	FRESULT fres;
+	bool at_end;
+	const bool writing = print_to_SD;
 
 	print_to_SD = false;
 
 	if (!SD_FILE_IS_OPEN()) {
 		return ERR_OK;
 	}
+	if (!writing) {
+		if ((fres = f_close(&fh)) != FR_OK) {
+			PRINTF("f_close(): FatFS error %u", (uint )fres);
+		}
+		return FRESULT_to_err_t(fres);
+	}
 
+	//
+	// f_close() flushes the FSInfo sector so the free cluster count saved here
+	// matches what's on the card
+	at_end = (f_tell(&fh) == SD_cursor.end);
 	if ((fres = f_close(&fh)) != FR_OK) {
 		PRINTF("f_close(): FatFS error %u", (uint )fres);
 	}
+	if (fres != FR_OK) {
+		clear_SD_cursor();
+	} else {
+		save_SD_cursor();
+		//
+		// The end of the contents is still good after a failed write, but
+		// the cluster may not be
+		if (write_errors != 0 || !at_end) {
+			SD_cursor.clust = 0;
+		}
+	}
+	retain_SD_cursor();
 
 	return FRESULT_to_err_t(fres);
 }
@@ -119,12 +372,41 @@ static err_t close_SD(void) {
 	if ((fres = f_unmount("")) != FR_OK) {
 		PRINTF("f_unmount(): FatFS error %u", (uint )fres);
 	}
-	spi_off();
+#if uHAL_USE_FATFS_SD
+	// The power may go off as soon as it's released
+	diskio_SD_power_off();
+#endif
+	power_release(POWER_DOMAIN_SPI);
+
+#if uHAL_USE_FATFS_IMAGE
+	// Report what this write cycle cost in sector accesses
+	diskio_image_stats_t st;
+
+	diskio_image_get_stats(&st);
+	LOGGER("Log SD: %u sector writes (%u FAT, %u dir, %u reserved) in %u calls, %u reads, %u syncs",
+		(uint )(st.data_writes + st.fat_writes + st.dir_writes + st.reserved_writes),
+		(uint )st.fat_writes, (uint )st.dir_writes, (uint )st.reserved_writes,
+		(uint )st.write_calls,
+		(uint )(st.data_reads + st.fat_reads + st.dir_reads + st.reserved_reads),
+		(uint )st.sync_calls);
+	diskio_image_reset_stats();
+#endif
+#if defined(HOST_SD_CARD_EMULATION) && HOST_SD_CARD_EMULATION
+	// Report what this write cycle cost in card time
+	host_sd_stats_t st;
+
+	host_sd_get_stats(&st);
+	LOGGER("Log SD: %u blocks written with %u CMD24 and %u CMD25 (%u pre-erased), %u blocks read, %u commands, %u bytes clocked (%u busy)",
+		(uint )st.blocks_written, (uint )st.single_block_writes, (uint )st.multi_block_writes,
+		(uint )st.pre_erase_hints, (uint )st.blocks_read, (uint )st.commands,
+		(uint )st.bytes_clocked, (uint )st.busy_bytes);
+	host_sd_reset_stats();
+#endif
 
 	return FRESULT_to_err_t(fres);
 }
 
-static err_t write_buffer_to_SD(uint8_t *buf, print_buffer_size_t bytes) {
+static err_t write_buffer_to_SD(const uint8_t *buf, print_buffer_size_t bytes) {
 	FRESULT fres;
 	UINT bw = 0;
 
@@ -135,14 +417,58 @@ static err_t write_buffer_to_SD(uint8_t *buf, print_buffer_size_t bytes) {
 		return ERR_INIT;
 	}
 
-	if ((fres = f_write(&fh, buf, bytes, &bw)) != FR_OK) {
+#if uHAL_USE_FATFS_SD
+	// Let the card know how much is coming so the sectors can be written in
+	// one go
+	diskio_SD_set_write_hint((uint_fast16_t )(((SD_cursor.end % 512U) + bytes + 511U) / 512U));
+#endif
+	//
+	// Reading the file moves the file pointer
+	if (f_tell(&fh) != SD_cursor.end && (fres = f_lseek(&fh, SD_cursor.end)) != FR_OK) {
+		++write_errors;
+		PRINTF("f_lseek(): FatFS error %u", (uint )fres);
+	} else if ((fres = f_write(&fh, buf, bytes, &bw)) != FR_OK) {
 		// Not much else we can do about problems here
 		++write_errors;
 		PRINTF("f_write(): FatFS error %u (%u of %u bytes written)", (uint )fres, (uint )bw, (uint )bytes);
 	}
+	SD_cursor.end += bw;
+
+	return FRESULT_to_err_t(fres);
+}
+
+static uint32_t SD_file_position(void) {
+	if (!print_to_SD || !SD_FILE_IS_OPEN()) {
+		return 0;
+	}
+
+	return (uint32_t )SD_cursor.end;
+}
+
+#if USE_LOG_FILE_NAME && LOG_LINES_PER_FILE > 0
+//
+// These are only used by the log file lookup hooks, which are left out unless
+// the log is split into named files
+#if LOG_RESUME_LAST_FILE && ! LOG_FORMAT_BINARY
+static err_t read_SD_file(uint32_t offset, uint8_t *buf, uint_fast16_t *bytes) {
+	FRESULT fres;
+	UINT br = 0;
+
+	if (!SKIP_SAFETY_CHECKS && (!SD_IS_MOUNTED() || !SD_FILE_IS_OPEN())) {
+		*bytes = 0;
+		return ERR_INIT;
+	}
+
+	if (f_tell(&fh) != offset && (fres = f_lseek(&fh, offset)) != FR_OK) {
+		PRINTF("f_lseek(): FatFS error %u", (uint )fres);
+	} else if ((fres = f_read(&fh, buf, *bytes, &br)) != FR_OK) {
+		PRINTF("f_read(): FatFS error %u", (uint )fres);
+	}
+	*bytes = br;
 
 	return FRESULT_to_err_t(fres);
 }
+#endif // LOG_RESUME_LAST_FILE && ! LOG_FORMAT_BINARY
 
 static err_t SD_file_is_available(const char *path) {
 	FILINFO st;
@@ -161,6 +487,64 @@ static err_t SD_file_is_available(const char *path) {
 	}
 }
 
+#if FF_USE_FIND
+static err_t SD_find_last_file(char *path, uint_fast8_t index_pos, int_fast8_t *index) {
+	FRESULT fres;
+	DIR dir;
+	FILINFO st;
+	char *name = path, *sep = NULL;
+
+	*index = -1;
+
+	for (char *c = path; *c != 0; ++c) {
+		if (*c == '/') {
+			sep = c;
+		}
+	}
+	//
+	// f_findfirst() wants the directory and the file name pattern separately;
+	// the directory is only needed until it's been opened
+	if (sep != NULL) {
+		*sep = 0;
+		name = sep + 1;
+		index_pos -= (uint_fast8_t )(name - path);
+	}
+	fres = f_findfirst(&dir, &st, (sep != NULL) ? path : "", name);
+	if (sep != NULL) {
+		*sep = '/';
+	}
+
+	while (fres == FR_OK && st.fname[0] != 0) {
+		char hi = st.fname[index_pos], lo = st.fname[index_pos+1];
+
+		if (hi >= '0' && hi <= '9' && lo >= '0' && lo <= '9') {
+			int_fast8_t i = (int_fast8_t )(((hi - '0') * 10) + (lo - '0'));
+
+			if (i > *index) {
+				*index = i;
+			}
+		}
+		fres = f_findnext(&dir, &st);
+	}
+	f_closedir(&dir);
+
+	if (fres != FR_OK) {
+		PRINTF("f_findnext(): FatFS error %u", (uint )fres);
+		return ERR_RETRY;
+	}
+
+	return ERR_OK;
+}
+#else // FF_USE_FIND
+static err_t SD_find_last_file(char *path, uint_fast8_t index_pos, int_fast8_t *index) {
+	UNUSED(path);
+	UNUSED(index_pos);
+	*index = -1;
+	return ERR_NOTSUP;
+}
+#endif // FF_USE_FIND
+#endif // USE_LOG_FILE_NAME && LOG_LINES_PER_FILE > 0
+
 #else // WRITE_LOG_TO_SD
 static void init_log_SD(void) {
 	return;
@@ -169,22 +553,56 @@ static err_t open_SD_file(const char *path) {
 	UNUSED(path);
 	return ERR_OK;
 }
+static err_t open_SD_file_readonly(const char *path) {
+	UNUSED(path);
+	return ERR_OK;
+}
+static err_t seek_SD_file(uint32_t end) {
+	UNUSED(end);
+	return ERR_OK;
+}
 static err_t open_SD(void) {
 	return ERR_OK;
 }
 static err_t close_SD_file(void) {
 	return ERR_OK;
 }
+static err_t reserve_SD_file(uint32_t bytes) {
+	UNUSED(bytes);
+	return ERR_OK;
+}
+static err_t trim_SD_file(void) {
+	return ERR_OK;
+}
 static err_t close_SD(void) {
 	return ERR_OK;
 }
-static err_t write_buffer_to_SD(uint8_t *buf, print_buffer_size_t bytes) {
+static err_t write_buffer_to_SD(const uint8_t *buf, print_buffer_size_t bytes) {
 	UNUSED(buf);
 	UNUSED(bytes);
 	return ERR_OK;
 }
+static uint32_t SD_file_position(void) {
+	return 0;
+}
+#if USE_LOG_FILE_NAME && LOG_LINES_PER_FILE > 0
+#if LOG_RESUME_LAST_FILE && ! LOG_FORMAT_BINARY
+static err_t read_SD_file(uint32_t offset, uint8_t *buf, uint_fast16_t *bytes) {
+	UNUSED(offset);
+	UNUSED(buf);
+	*bytes = 0;
+	return ERR_OK;
+}
+#endif
 static err_t SD_file_is_available(const char *path) {
 	UNUSED(path);
 	return ERR_OK;
 }
+static err_t SD_find_last_file(char *path, uint_fast8_t index_pos, int_fast8_t *index) {
+	UNUSED(path);
+	UNUSED(index_pos);
+	*index = -1;
+	return ERR_OK;
+}
+#endif // USE_LOG_FILE_NAME && LOG_LINES_PER_FILE > 0
 #endif // WRITE_LOG_TO_SD
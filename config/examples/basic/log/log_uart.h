@@ -42,7 +42,7 @@ static void init_log_UART(void) {
 	return;
 }
 
-static err_t write_buffer_to_UART(uint8_t *buf, print_buffer_size_t bytes) {
+static err_t write_buffer_to_UART(const uint8_t *buf, print_buffer_size_t bytes) {
 	if (!print_to_UART) {
 		return ERR_OK;
 	}
@@ -20,6 +20,25 @@ static const char* sensor_type_to_name(uint8_t type) {
 // Print extra at the end of each log line
 // To disable this functionality, return NULL.
 //
+#if USE_PROFILING && LOG_PROFILE_COLUMNS
+//
+// These print the cumulative profile totals at the time each line was logged
+static const char* print_header_extra(void) {
+	return profile_log_columns();
+}
+// Because of the way printing is implemented, we need to treat the final (nominally
+// unbuffered) line as though it were buffered.
+static profile_summary_t log_line_profiles[LOG_LINE_BUFFER_COUNT+1];
+static void buffer_line_extra(log_line_buffer_size_t index) {
+	profile_get_summary(&log_line_profiles[index]);
+	return;
+}
+static const char* print_line_extra(log_line_buffer_size_t index) {
+	return profile_summary_to_cstring(&log_line_profiles[index]);
+}
+
+#else // !(USE_PROFILING && LOG_PROFILE_COLUMNS)
+//
 // These just print the buffer index; doing so serves no practical purpose,
 // it's for demonstation only.
 static const char* print_header_extra(void) {
@@ -43,12 +62,39 @@ static const char* print_line_extra(log_line_buffer_size_t index) {
 
 	return buf;
 }
+#endif // USE_PROFILING && LOG_PROFILE_COLUMNS
 
 //
-// We have two supported (optional) outputs, UART and an SPI-controlled SD card,
-// each defined in their own header for convenience.
+// We have three supported (optional) outputs, UART, an SPI-controlled SD card,
+// and a journal in the MCU's internal flash which can be drained to the SD
+// card, each defined in their own header for convenience.
 #include "log_uart.h"
 #include "log_sd.h"
+#include "log_flash.h"
+
+static void log_power_on(void) {
+	if (LOG_POWER_PIN != 0) {
+		output_pin_on(LOG_POWER_PIN);
+		if (LOG_POWER_UP_DELAY_MS > 0) {
+			delay_ms(LOG_POWER_UP_DELAY_MS);
+		}
+	}
+	return;
+}
+static void log_power_off(void) {
+	if (LOG_POWER_PIN != 0) {
+#if WRITE_LOG_TO_SD
+		// The SPI pins need to stop driving the card before its power is cut
+		// or it may be powered through them
+		power_down(POWER_DOMAIN_SPI);
+#endif
+		if (LOG_POWER_DOWN_DELAY_MS > 0) {
+			delay_ms(LOG_POWER_DOWN_DELAY_MS);
+		}
+		output_pin_off(LOG_POWER_PIN);
+	}
+	return;
+}
 
 //
 // Initialize the output device
@@ -66,11 +112,11 @@ static err_t open_output_device(void) {
 	err_t res = ERR_OK;
 	bool abort_logging = false;
 
-	if (LOG_POWER_PIN != 0) {
-		output_pin_on(LOG_POWER_PIN);
-		if (LOG_POWER_UP_DELAY_MS > 0) {
-			delay_ms(LOG_POWER_UP_DELAY_MS);
-		}
+	//
+	// When logging to flash the SD card is only powered up to drain the
+	// journal, and the UART doesn't need switched power
+	if (!WRITE_LOG_TO_FLASH) {
+		log_power_on();
 	}
 
 	if (WRITE_LOG_TO_UART && !abort_logging) {
@@ -82,7 +128,13 @@ static err_t open_output_device(void) {
 		}
 	}
 
-	if (WRITE_LOG_TO_SD && !abort_logging) {
+	if (WRITE_LOG_TO_FLASH && !abort_logging) {
+		if ((res = mount_flash_journal()) != ERR_OK) {
+			PRINTF("Failed to open log journal: error %d", (int )res);
+			abort_logging = true;
+			close_UART();
+		}
+	} else if (WRITE_LOG_TO_SD && !abort_logging) {
 		if ((res = open_SD()) != ERR_OK) {
 			PRINTF("Failed to open log SD: error %d", (int )res);
 			if (!LOG_WITH_MISSING_SD) {
@@ -99,13 +151,17 @@ static err_t open_output_device(void) {
 // The return value is currently ignored
 static err_t close_output_device(void) {
 	close_UART();
-	close_SD();
 
-	if (LOG_POWER_PIN != 0) {
-		if (LOG_POWER_DOWN_DELAY_MS > 0) {
-			delay_ms(LOG_POWER_DOWN_DELAY_MS);
+	if (WRITE_LOG_TO_FLASH) {
+		if (flash_journal_needs_draining()) {
+			log_power_on();
+			drain_flash_journal();
+			log_power_off();
 		}
-		output_pin_off(LOG_POWER_PIN);
+		close_flash_journal();
+	} else {
+		close_SD();
+		log_power_off();
 	}
 
 	return ERR_OK;
@@ -114,13 +170,56 @@ static err_t close_output_device(void) {
 // Open a file on the output device for writing
 // 'path' is NULL if USE_LOG_FILE_NAME isn't set
 static err_t open_output_file(const char *path) {
+	if (WRITE_LOG_TO_FLASH) {
+		return ERR_OK;
+	}
 	return open_SD_file(path);
 }
 //
+// Open an existing file on the output device for reading only
+// The file is closed again with close_output_file(), and must not be changed
+// by anything in between.
+static err_t open_output_file_readonly(const char *path) {
+	if (WRITE_LOG_TO_FLASH) {
+		return ERR_NOTSUP;
+	}
+	return open_SD_file_readonly(path);
+}
+//
+// Move the end of the contents of the file open for writing back to 'end'
+// The next write goes there, and anything left after it is released by
+// close_output_file() the same as unused reserved space is.
+static err_t seek_output_file(uint32_t end) {
+	if (WRITE_LOG_TO_FLASH) {
+		return ERR_OK;
+	}
+	return seek_SD_file(end);
+}
+//
+// Reserve space for a newly-created file on the output device
+// 'bytes' is only an estimate of how large the file will grow to; any space
+// left over is released when the file is closed by close_output_file().
+static err_t reserve_output_file(uint32_t bytes) {
+	if (WRITE_LOG_TO_FLASH) {
+		return ERR_OK;
+	}
+	return reserve_SD_file(bytes);
+}
+//
 // Close the open file on the output device
+// If it was open for writing, any space after the end of its contents is
+// released first.
 static err_t close_output_file(void) {
+	if (WRITE_LOG_TO_FLASH) {
+		return ERR_OK;
+	}
+	trim_SD_file();
 	return close_SD_file();
 }
+#if USE_LOG_FILE_NAME && LOG_LINES_PER_FILE > 0
+//
+// These are only used when the log is split into named files, which is never
+// done when logging to flash
 //
 // Check if a file name on the output device can be used for a new log file
 // 'path' is NULL if USE_LOG_FILE_NAME isn't set
@@ -132,21 +231,61 @@ static err_t output_file_is_available(const char *path) {
 	return SD_file_is_available(path);
 }
 //
+// Find the most recent log file on the output device in a single pass
+// 'path' is the log file name with the file number at 'index_pos' and
+// 'index_pos'+1 set to '?', which matches any character. It may be modified
+// while this runs but is restored before returning.
+// On success 'index' is set to the highest file number in use, or -1 if there
+// are none.
+// Return values:
+//    ERR_OK   : The search completed
+//    ERR_RETRY: The device is unavailable and the search is tried again later
+static err_t find_last_output_file(char *path, uint_fast8_t index_pos, int_fast8_t *index) {
+	return SD_find_last_file(path, index_pos, index);
+}
+#if LOG_RESUME_LAST_FILE && ! LOG_FORMAT_BINARY
+//
+// This is only used to check over a text log file before resuming it; binary
+// log files are never resumed
+//
+// Read up to '*bytes' bytes starting at 'offset' from the open file on the
+// output device and set '*bytes' to the number actually read
+// This doesn't change where the next write goes.
+static err_t read_output_file(uint32_t offset, uint8_t *buf, uint_fast16_t *bytes) {
+	return read_SD_file(offset, buf, bytes);
+}
+#endif // LOG_RESUME_LAST_FILE && ! LOG_FORMAT_BINARY
+#endif // USE_LOG_FILE_NAME && LOG_LINES_PER_FILE > 0
+//
+// Get the current write position in the open file on the output device
+// This is used to align writes to LOG_PRINT_BUFFER_ALIGNMENT-sized blocks and
+// to estimate the size of new files for reserve_output_file(); return 0 if
+// there's no open file.
+static uint32_t output_file_position(void) {
+	return SD_file_position();
+}
+//
 // Write a block of bytes to the output device
-static err_t write_buffer_to_storage(uint8_t *buf, print_buffer_size_t bytes) {
+static err_t write_buffer_to_storage(const uint8_t *buf, print_buffer_size_t bytes) {
 	write_buffer_to_UART(buf, bytes);
+	if (WRITE_LOG_TO_FLASH) {
+		return write_buffer_to_flash(buf, bytes);
+	}
 	return write_buffer_to_SD(buf, bytes);
 }
 //
-// Write a single byte to the output device
-static err_t write_byte_to_storage(uint8_t c) {
-	return write_buffer_to_storage(&c, 1);
+// Print whatever the output device keeps in internal storage using pf()
+// Return ERR_NOTSUP if there isn't any.
+static err_t print_output_storage(void (*pf)(const char *format, ...)) {
+	return print_flash_journal(pf);
 }
 //
 // If this returns true, skip scheduled writes to the log file
 // Forced writes and buffered lines are unaffected
+// Writing to flash costs little enough that it's only put off when the supply
+// is too low to program it reliably.
 static bool skip_log_writes(void) {
-	const uint8_t warnings = (WARN_BATTERY_LOW | WARN_VCC_LOW);
+	const uint8_t warnings = (WRITE_LOG_TO_FLASH) ? WARN_VCC_LOW : (WARN_BATTERY_LOW | WARN_VCC_LOW);
 
 	return (BIT_IS_SET(ghmon_warnings, warnings));
 }
@@ -0,0 +1,38 @@
+//
+// The HOST platform has four virtual ports with 16 pins each which can be
+// used for anything. These mirror the STM32F401 pin definitions so that
+// traces recorded from one can be replayed on the other.
+
+//
+// UART serial console pins
+// The port itself is attached to stdin/stdout
+#define UART_COMM_TX_PIN PINID_B6
+#define UART_COMM_RX_PIN PINID_B7
+
+//
+// SPI pins
+#define SPI_SS_PIN    PINID_A15
+#define SPI_SCK_PIN   PINID_B3
+#define SPI_MISO_PIN  PINID_B4
+#define SPI_MOSI_PIN  PINID_B5
+#define SPI_CS_SD_PIN SPI_SS_PIN
+
+//
+// I2C pins
+#define I2C_SDA_PIN PINID_B9
+#define I2C_SCL_PIN PINID_B8
+
+//
+// Control pins
+#define STATUS_LED_PIN  (PINID_A11 | GPIO_CTRL_OPENDRAIN | GPIO_CTRL_INVERT)
+#define CTRL_BUTTON_PIN (PINID_A3  | GPIO_CTRL_PULLUP | GPIO_CTRL_INVERT)
+#define FAN1_CTRL_PIN (PINID_A12 | GPIO_CTRL_PUSHPULL)
+#define IRR1_CTRL_PIN (PINID_A8 | GPIO_CTRL_PUSHPULL)
+
+//
+// Sensor pins
+// Every pin can be used as an analog input
+#define BATTERY_CHECK_PIN PINID_A1
+#define INSIDE_THERM1_PIN PINID_B0
+#define OUTSIDE_THERM1_PIN 0
+#define GND_MOIST1_PIN PINID_B1
@@ -42,16 +42,11 @@ err_t thermistor_init(thermistor_helper_t *helper, SENSOR_CFG_STORAGE struct sen
 sensor_reading_t* vcc_read(SENSOR_CFG_STORAGE struct sensor_cfg_t *cfg, sensor_status_t *status) {
 	static sensor_reading_t reading = { 0 };
 
-	bool enable_adc = (!adc_is_on());
-	if (enable_adc) {
-		adc_on();
-	}
+	power_acquire(POWER_DOMAIN_ADC);
 
 	ADC_Vref_mV = reading.value = adc_read_vref_mV();
 
-	if (enable_adc) {
-		adc_off();
-	}
+	power_release(POWER_DOMAIN_ADC);
 
 	UNUSED(cfg);
 	UNUSED(status);
@@ -75,21 +70,11 @@ sensor_reading_t* battery_read(SENSOR_CFG_STORAGE struct sensor_cfg_t *cfg, sens
 		return NULL;
 	}
 
-	bool enable_adc = (!adc_is_on());
-	if (enable_adc) {
-		adc_on();
-	}
-
-	adc_t adc_value = adc_read_pin(cfg->pin);
-
-	if (enable_adc) {
-		adc_off();
-	}
+	adc_t adc_value = read_sensor_adc(cfg, status);
 
 	uint32_t corrected_value = (adc_value * (series_r1 + series_r2)) / series_r2;
 	reading.value = adc_to_voltage(corrected_value, ADC_Vref_mV);
 
-	UNUSED(status);
 	return &reading;
 }
 //
@@ -165,6 +150,7 @@ SENSOR_CFG_STORAGE sensor_cfg_t SENSORS[] = {
 	.init = battery_init,
 	.read = battery_read,
 	.pin = BATTERY_CHECK_PIN,
+	.cfg_flags = SENSOR_CFG_FLAG_ADC,
 },
 //
 // Sensor ??, System voltage
@@ -186,6 +172,7 @@ SENSOR_CFG_STORAGE sensor_cfg_t SENSORS[] = {
 	.init = inside_therm1_init,
 	.read = thermistor_read,
 	.pin = INSIDE_THERM1_PIN,
+	.cfg_flags = SENSOR_CFG_FLAG_ADC,
 },
 //
 // Sensor 3, Outdoor thermistor
@@ -197,6 +184,7 @@ SENSOR_CFG_STORAGE sensor_cfg_t SENSORS[] = {
 	.init = outside_therm1_init,
 	.read = thermistor_read,
 	.pin = OUTSIDE_THERM1_PIN,
+	.cfg_flags = SENSOR_CFG_FLAG_ADC,
 },
 */
 //
@@ -210,5 +198,6 @@ SENSOR_CFG_STORAGE sensor_cfg_t SENSORS[] = {
 	.pin = GND_MOIST1_PIN,
 	.cooldown_seconds = 120,
 	.data = MOISTURE_SERIES_OHMS,
+	.cfg_flags = SENSOR_CFG_FLAG_ADC,
 },
 };
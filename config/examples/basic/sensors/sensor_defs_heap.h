@@ -56,16 +56,11 @@ sensor_reading_t* vcc_read(SENSOR_CFG_STORAGE struct sensor_cfg_t *cfg, sensor_s
 	UNUSED(cfg);
 	UNUSED(status);
 
-	bool enable_adc = (!adc_is_on());
-	if (enable_adc) {
-		adc_on();
-	}
+	power_acquire(POWER_DOMAIN_ADC);
 
 	ADC_Vref_mV = reading.value = adc_read_vref_mV();
 
-	if (enable_adc) {
-		adc_off();
-	}
+	power_release(POWER_DOMAIN_ADC);
 
 	return &reading;
 }
@@ -83,22 +78,11 @@ sensor_reading_t* battery_read(SENSOR_CFG_STORAGE struct sensor_cfg_t *cfg, sens
 	const uint32_t series_r1 = BATTERY_VDIV_HIGH_SIDE_OHMS;
 	const uint32_t series_r2 = BATTERY_VDIV_LOW_SIDE_OHMS;
 
-	UNUSED(status);
-
 	if (series_r2 == 0) {
 		return NULL;
 	}
 
-	bool enable_adc = (!adc_is_on());
-	if (enable_adc) {
-		adc_on();
-	}
-
-	adc_t adc_value = adc_read_pin(cfg->pin);
-
-	if (enable_adc) {
-		adc_off();
-	}
+	adc_t adc_value = read_sensor_adc(cfg, status);
 
 	uint32_t corrected_value = (adc_value * (series_r1 + series_r2)) / series_r2;
 	reading.value = adc_to_voltage(corrected_value, ADC_Vref_mV);
@@ -130,6 +114,7 @@ SENSOR_CFG_STORAGE sensor_cfg_t SENSORS[] = {
 	.init = battery_init,
 	.read = battery_read,
 	.pin = BATTERY_CHECK_PIN,
+	.cfg_flags = SENSOR_CFG_FLAG_ADC,
 },
 //
 // Sensor 2, Indoor thermistor
@@ -140,6 +125,7 @@ SENSOR_CFG_STORAGE sensor_cfg_t SENSORS[] = {
 	.init = thermistor_init,
 	.read = thermistor_read,
 	.pin = INSIDE_THERM1_PIN,
+	.cfg_flags = SENSOR_CFG_FLAG_ADC,
 },
 //
 // Sensor 3, Outdoor thermistor
@@ -151,6 +137,7 @@ SENSOR_CFG_STORAGE sensor_cfg_t SENSORS[] = {
 	.init = thermistor_init,
 	.read = thermistor_read,
 	.pin = OUTSIDE_THERM1_PIN,
+	.cfg_flags = SENSOR_CFG_FLAG_ADC,
 },
 */
 //
@@ -164,5 +151,6 @@ SENSOR_CFG_STORAGE sensor_cfg_t SENSORS[] = {
 	.pin = GND_MOIST1_PIN,
 	.cooldown_seconds = 120,
 	.data = MOISTURE_SERIES_OHMS,
+	.cfg_flags = SENSOR_CFG_FLAG_ADC,
 },
 };
@@ -32,16 +32,7 @@ sensor_reading_t* vdiv_ohms_read(SENSOR_CFG_STORAGE struct sensor_cfg_t *cfg, se
 	uint32_t series_r = cfg->data;
 	vdiv_helper_t *helper = status->data;
 
-	bool enable_adc = (!adc_is_on());
-	if (enable_adc) {
-		adc_on();
-	}
-
-	adc_t adc_value = adc_read_pin(cfg->pin);
-
-	if (enable_adc) {
-		adc_off();
-	}
+	adc_t adc_value = read_sensor_adc(cfg, status);
 
 	if (!SERIES_R_IS_HIGH_SIDE) {
 		adc_value = ADC_MAX - adc_value;
@@ -76,16 +67,7 @@ sensor_reading_t* thermistor_read(SENSOR_CFG_STORAGE struct sensor_cfg_t *cfg, s
 		log_R0 = log_fixed_point(fixed_point_from_int(THERMISTOR_REFERENCE_OHMS));
 	}
 
-	bool enable_adc = (!adc_is_on());
-	if (enable_adc) {
-		adc_on();
-	}
-
-	adc_t adc_value = adc_read_pin(cfg->pin);
-
-	if (enable_adc) {
-		adc_off();
-	}
+	adc_t adc_value = read_sensor_adc(cfg, status);
 
 	if (!SERIES_R_IS_HIGH_SIDE) {
 		adc_value = ADC_MAX - adc_value;
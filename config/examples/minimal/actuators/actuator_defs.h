@@ -45,17 +45,12 @@ extern uint_fast16_t ADC_Vref_mV;
 //
 // Read a voltage on an analog pin to decide how hard to run the motor
 static uint_fast8_t get_pump_on_level(void) {
-	bool enable_adc = (!adc_is_on());
-	if (enable_adc) {
-		adc_on();
-	}
+	power_acquire(POWER_DOMAIN_ADC);
 
 	adc_t ctrl_volts = adc_read_pin(PUMP_LEVEL_CTRL_PIN);
 	ctrl_volts = (ctrl_volts * ADC_Vref_mV) / ADC_MAX;
 
-	if (enable_adc) {
-		adc_off();
-	}
+	power_release(POWER_DOMAIN_ADC);
 
 	if (ctrl_volts < PUMP_LEVEL_CTRL_1) {
 		return 1;
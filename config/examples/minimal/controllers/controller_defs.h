@@ -139,12 +139,9 @@ static err_t pump_run(CONTROLLER_CFG_STORAGE controller_cfg_t *cfg, controller_s
 	}
 
 	bool set_analog_mode = (GPIO_MODE_RESET_ALIAS != GPIO_MODE_AIN);
-	bool enable_adc = false;
-	if (WATER_TEMP_SENSE_PIN != 0 || VIN_SENSE_PIN != 0) {
-		enable_adc = (!adc_is_on());
-	}
-	if (enable_adc) {
-		adc_on();
+	bool use_adc = (WATER_TEMP_SENSE_PIN != 0 || VIN_SENSE_PIN != 0);
+	if (use_adc) {
+		power_acquire(POWER_DOMAIN_ADC);
 	}
 
 	if (WATER_TEMP_SENSE_PIN != 0) {
@@ -203,8 +200,8 @@ static err_t pump_run(CONTROLLER_CFG_STORAGE controller_cfg_t *cfg, controller_s
 		voltage_ok = true;
 	}
 
-	if (enable_adc) {
-		adc_off();
+	if (use_adc) {
+		power_release(POWER_DOMAIN_ADC);
 	}
 
 	bool want_on = (voltage_ok && water_temp_ok && water_level_ok);
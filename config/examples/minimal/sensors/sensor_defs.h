@@ -50,17 +50,12 @@ static void thermistor_read(sensor_reading_t *ret, gpio_pin_t pin) {
 		log_R0 = log_fixed_point(fixed_point_from_int(THERMISTOR_REFERENCE_OHMS));
 	}
 
-	bool enable_adc = (!adc_is_on());
-	if (enable_adc) {
-		adc_on();
-	}
+	power_acquire(POWER_DOMAIN_ADC);
 
 	//adc_t adc_value = adc_read_pin(cfg->pin);
 	adc_t adc_value = adc_read_pin(pin);
 
-	if (enable_adc) {
-		adc_off();
-	}
+	power_release(POWER_DOMAIN_ADC);
 
 	if (!SERIES_R_IS_HIGH_SIDE) {
 		adc_value = ADC_MAX - adc_value;
@@ -122,16 +117,11 @@ static void thermistor_read(sensor_reading_t *ret, gpio_pin_t pin) {
 static sensor_reading_t* VCC_read(SENSOR_CFG_STORAGE struct sensor_cfg_t *cfg, sensor_status_t *status) {
 	static sensor_reading_t reading = { 0 };
 
-	bool enable_adc = (!adc_is_on());
-	if (enable_adc) {
-		adc_on();
-	}
+	power_acquire(POWER_DOMAIN_ADC);
 
 	ADC_Vref_mV = reading.value = adc_read_vref_mV();
 
-	if (enable_adc) {
-		adc_off();
-	}
+	power_release(POWER_DOMAIN_ADC);
 
 	UNUSED(cfg);
 	UNUSED(status);
@@ -150,16 +140,11 @@ static sensor_reading_t* VIN_read(SENSOR_CFG_STORAGE struct sensor_cfg_t *cfg, s
 	}
 
 	gpio_set_mode(VIN_SENSE_PIN, GPIO_MODE_AIN, GPIO_FLOAT);
-	bool enable_adc = (!adc_is_on());
-	if (enable_adc) {
-		adc_on();
-	}
+	power_acquire(POWER_DOMAIN_ADC);
 
 	adc_t adc_value = adc_read_pin(VIN_SENSE_PIN);
 
-	if (enable_adc) {
-		adc_off();
-	}
+	power_release(POWER_DOMAIN_ADC);
 	gpio_set_mode(VIN_SENSE_PIN, GPIO_MODE_HiZ, GPIO_FLOAT);
 
 	uint_fast16_t corrected_value = (adc_value * (series_r1 + series_r2)) / series_r2;
@@ -0,0 +1,28 @@
+//
+// FatFS configuration file
+// Only the options GHMon turns on and off itself are set here; everything else
+// is left to lib/FatFS/ffconf.h, where they all default to off.
+//
+
+//
+// Include the GHMon configuration before anything else, it controls which
+// features are needed.
+#include "config/general/config.h"
+
+#if defined(WRITE_LOG_TO_SD) && WRITE_LOG_TO_SD
+//
+// Used to find the most recent log file when rotating
+# if !defined(FF_USE_FIND) && defined(USE_LOG_FILE_NAME) && USE_LOG_FILE_NAME && LOG_LINES_PER_FILE > 0
+#  define FF_USE_FIND 1
+# endif
+//
+// Used to jump to the end of the log file when it's reopened
+# if !defined(FF_USE_FASTSEEK)
+#  define FF_USE_FASTSEEK 1
+# endif
+//
+// Used to preallocate log files
+# if !defined(FF_USE_EXPAND) && defined(LOG_PREALLOCATE_LINE_SIZE) && LOG_PREALLOCATE_LINE_SIZE > 0 && LOG_LINES_PER_FILE > 0
+#  define FF_USE_EXPAND 1
+# endif
+#endif // WRITE_LOG_TO_SD
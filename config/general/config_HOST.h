@@ -0,0 +1,16 @@
+//
+// uHAL configuration file for the native HOST platform
+//
+
+//
+// These are the standard settings
+//
+// There are none at this time
+
+//
+// These are the instance overrides
+#include GHMON_INCLUDE_CONFIG_HEADER(lib/config_HOST.h)
+
+//
+// These are the default settings
+#include "../../lib/uHAL/config/config_HOST.h"
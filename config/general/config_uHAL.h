@@ -16,6 +16,7 @@
 
 #define uHAL_USE_HIBERNATE 1
 #define uHAL_ANNOUNCE_HIBERNATE (DEBUG)
+#define uHAL_RETAINED_MEMORY_BYTES RETAINED_MEMORY_BYTES
 
 #define TERMINAL_HAVE_EXTRA_CMDS (USE_UART_TERMINAL)
 #define uHAL_USE_UART_COMM (USE_UART_OUTPUT || USE_UART_TERMINAL)
@@ -27,6 +28,10 @@
 
 #define uHAL_USE_RTC 1
 
+#if USE_PROFILING
+# define uHAL_USE_USCOUNTER 1
+#endif
+
 //
 // These are the instance overrides
 #include GHMON_INCLUDE_CONFIG_HEADER(lib/config_uHAL.h)
@@ -48,7 +48,12 @@
 #endif
 
 #define ULIB_ENABLE_PRINTF 1
-#define PRINTF_MAX_INT_BYTES 4
+// 'long' is 64 bits on most hosts and '%l' arguments have to be read whole
+#if defined(__SIZEOF_LONG__) && __SIZEOF_LONG__ > 4
+# define PRINTF_MAX_INT_BYTES 8
+#else
+# define PRINTF_MAX_INT_BYTES 4
+#endif
 #define PRINTF_USE_o_FOR_OCTAL 0
 #define PRINTF_USE_MINIMAL_FEATURE_SET 1
 #define PRINTF_ALLOW_BINARY 1
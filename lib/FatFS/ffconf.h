@@ -4,6 +4,12 @@
 
 #define FFCONF_DEF	80286	/* Revision ID */
 
+/* A project can set some of the options below from its own header, named by
+/  FATFS_CONFIG_HEADER; the ones wrapped in #ifndef are the ones it can set. */
+#ifdef FATFS_CONFIG_HEADER
+#include FATFS_CONFIG_HEADER
+#endif
+
 /*---------------------------------------------------------------------------/
 / Function Configurations
 /---------------------------------------------------------------------------*/
@@ -25,7 +31,9 @@
 /   3: f_lseek() function is removed in addition to 2. */
 
 
+#ifndef FF_USE_FIND
 #define FF_USE_FIND		0
+#endif
 /* This option switches filtered directory read functions, f_findfirst() and
 /  f_findnext(). (0:Disable, 1:Enable 2:Enable with matching altname[] too) */
 
@@ -34,11 +42,15 @@
 /* This option switches f_mkfs() function. (0:Disable or 1:Enable) */
 
 
+#ifndef FF_USE_FASTSEEK
 #define FF_USE_FASTSEEK	0
+#endif
 /* This option switches fast seek function. (0:Disable or 1:Enable) */
 
 
+#ifndef FF_USE_EXPAND
 #define FF_USE_EXPAND	0
+#endif
 /* This option switches f_expand function. (0:Disable or 1:Enable) */
 
 
@@ -145,6 +145,25 @@
 # define SLEEP_ALARM_TIMER 0
 #endif
 
+// If non-zero, SPI block transfers are handed to the DMA controller and the
+// core sleeps until they finish instead of polling the bus for every byte
+// This also makes spi_transfer_async() actually asynchronous
+#ifndef uHAL_SPI_USE_DMA
+# define uHAL_SPI_USE_DMA 1
+#endif
+//
+// Transfers shorter than this many bytes are always polled; setting up the
+// DMA channels isn't worth it for a handful of bytes
+#ifndef SPI_DMA_MIN_BYTES
+# define SPI_DMA_MIN_BYTES 16U
+#endif
+
+// If non-zero, adc_read_pins() converts all the pins in one scan and has the
+// DMA controller collect the results instead of reading them one at a time
+#ifndef uHAL_ADC_USE_DMA
+# define uHAL_ADC_USE_DMA 1
+#endif
+
 
 /*
 //
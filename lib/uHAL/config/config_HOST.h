@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// config_HOST.h
+// uHAL configuration file
+// NOTES:
+//
+
+// If non-zero, delay_ms() and friends actually wait
+// Otherwise they just advance the system tick, which keeps the run time of a
+// simulation down to the time spent doing real work
+#ifndef HOST_REALTIME_DELAYS
+# define HOST_REALTIME_DELAYS 0
+#endif
+
+// If non-zero, exit after this many seconds of virtual time have passed
+// This can be overridden at run time with the HOST_RUN_LIMIT_S environment
+// variable
+#ifndef HOST_RUN_LIMIT_S
+# define HOST_RUN_LIMIT_S 0
+#endif
+
+// The size of the array used as heap by halloc()
+// There's no real limit on this, but keeping it close to the size of the
+// target device's RAM will catch programs that won't fit there
+#ifndef HOST_HEAP_BYTES
+# define HOST_HEAP_BYTES (64UL * 1024UL)
+#endif
+
+// The file the retained memory block is loaded from at startup and saved to
+// on exit, to simulate a reset which leaves RAM alone
+// This can be overridden at run time with the HOST_RETAINED_MEMORY_FILE
+// environment variable
+#ifndef HOST_RETAINED_MEMORY_PATH
+# define HOST_RETAINED_MEMORY_PATH "retained.bin"
+#endif
+
+// If non-zero, emulate an SD card on the SPI bus
+// The card is backed by the image file at FATFS_IMAGE_PATH, so the same image
+// can be used with either the SD card driver or the image driver
+#ifndef HOST_SD_CARD_EMULATION
+# define HOST_SD_CARD_EMULATION uHAL_USE_FATFS_SD
+#endif
+// The number of bytes the emulated SD card reports busy for after a write which
+// needed the block to be erased first
+#ifndef HOST_SD_PROGRAM_BUSY_BYTES
+# define HOST_SD_PROGRAM_BUSY_BYTES 256U
+#endif
+// The number of bytes the emulated SD card reports busy for after writing a
+// block pre-erased with ACMD23
+#ifndef HOST_SD_STREAM_BUSY_BYTES
+# define HOST_SD_STREAM_BUSY_BYTES 32U
+#endif
+
+// The file used to hold the emulated internal flash data area
+// It's created if missing and any part of the data area it doesn't cover
+// reads as erased.
+// This can be overridden at run time with the HOST_FLASH_FILE environment
+// variable
+#ifndef HOST_FLASH_PATH
+# define HOST_FLASH_PATH "flash.bin"
+#endif
+// The size of an emulated flash page in bytes
+#ifndef HOST_FLASH_PAGE_BYTES
+# define HOST_FLASH_PAGE_BYTES 1024U
+#endif
+// The number of microseconds it takes to erase an emulated flash page
+// The default is the typical time for an STM32F1
+#ifndef HOST_FLASH_ERASE_US
+# define HOST_FLASH_ERASE_US 20000U
+#endif
+// The number of microseconds it takes to program an emulated flash write unit
+// The default is the typical time for an STM32F1
+#ifndef HOST_FLASH_WRITE_US
+# define HOST_FLASH_WRITE_US 52U
+#endif
+
+// This is the voltage reported for the internal voltage-reference
+#ifndef INTERNAL_VREF_mV
+# define INTERNAL_VREF_mV 1200U
+#endif
+
+// This is the regulated voltage applied to the MCUs power pin
+#ifndef REGULATED_VOLTAGE_mV
+# define REGULATED_VOLTAGE_mV 3300U
+#endif
+
+//
+// The maximum value returned by the ADC
+#ifndef ADC_MAX
+# define ADC_MAX 0x0FFF
+#endif
+
+// If non-zero, use RTC emulation code
+// There's no other RTC option for this platform
+#ifndef uHAL_USE_RTC_EMULATION
+# define uHAL_USE_RTC_EMULATION uHAL_USE_RTC
+#endif
+
+
+/*
+//
+// Pin configuration
+//
+// The full list of defined pins is in each platform's platform.h file or
+// (usually) a file included by platform.h.
+//
+// There are four virtual ports, PORTA-PORTD, with 16 pins each. Any pin can
+// be used for any purpose.
+//
+// Both internal pullups and internal pulldowns are available.
+//
+// UART serial console pins
+// These are only used for their GPIO mode, the port itself is attached to
+// stdin and stdout
+#define UART_COMM_TX_PIN PINID_A9
+#define UART_COMM_RX_PIN PINID_A10
+//
+// SPI pins
+#define SPI_SS_PIN    PINID_A4
+#define SPI_SCK_PIN   PINID_A5
+#define SPI_MISO_PIN  PINID_A6
+#define SPI_MOSI_PIN  PINID_A7
+#define SPI_CS_SD_PIN SPI_SS_PIN
+//
+// I2C pins
+#define I2C_SDA_PIN PINID_B7
+#define I2C_SCL_PIN PINID_B6
+*/
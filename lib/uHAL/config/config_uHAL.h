@@ -102,6 +102,21 @@
 #ifndef uHAL_ANNOUNCE_HIBERNATE
 # define uHAL_ANNOUNCE_HIBERNATE 1
 #endif
+//
+// If > 0, set aside this many bytes of RAM which aren't cleared at startup so
+// that their contents survive a reset; see get_retained_memory()
+#ifndef uHAL_RETAINED_MEMORY_BYTES
+# define uHAL_RETAINED_MEMORY_BYTES 0
+#endif
+//
+// If non-zero, peripherals taken with power_acquire() stay on after the last
+// power_release() until power_down_idle() is called, which is done before
+// hibernating, so that everything using them in one wake shares a single
+// power-up
+// If 0, they're turned off as soon as the last user releases them
+#ifndef uHAL_POWER_DEFER_OFF
+# define uHAL_POWER_DEFER_OFF 1
+#endif
 
 //
 // ADC configuration options
@@ -152,6 +167,15 @@
 # define UART_INPUT_BUFFER_BYTES 1U
 #endif
 //
+// The number of buffered output bytes per interface
+// If non-zero, uart_transmit_block() returns as soon as the data has been
+// queued and it's sent in the background by the transmit interrupt; only one
+// byte less than this can be queued at a time
+// If 0, uart_transmit_block() waits until the data has been sent
+#ifndef UART_OUTPUT_BUFFER_BYTES
+# define UART_OUTPUT_BUFFER_BYTES 0U
+#endif
+//
 // Enable output to a UART serial console
 #ifndef uHAL_USE_UART_COMM
 # define uHAL_USE_UART_COMM uHAL_USE_SUBSYSTEM_DEFAULT
@@ -175,6 +199,17 @@
 # define LOGGER_HISTORY_BUFFER_BYTES 0U
 #endif
 //
+// If set, LOGGER() doesn't format messages on the device; instead each call
+// site is reduced to a 32-bit hash of its format string and only that and
+// the raw arguments are sent, base64-encoded on a line starting with '$'
+// The output (and the contents of the logger() history buffer) is turned back
+// into text on the host by tools/decode_logger.py in the top-level project
+// Requires a compiler supporting _Generic()
+// LOGGER_NOF() and logger() are unaffected
+#ifndef LOGGER_TOKENIZED
+# define LOGGER_TOKENIZED 0
+#endif
+//
 // The serial console baud rate
 #ifndef UART_COMM_BAUDRATE
 # define UART_COMM_BAUDRATE 9600UL
@@ -243,6 +278,13 @@
 #ifndef I2C_FREQUENCY_HZ
 # define I2C_FREQUENCY_HZ 50000UL
 #endif
+//
+// If non-zero, I2C transactions can be queued with i2c_queue_transaction()
+// and are run from the peripheral's interrupts instead of being polled; the
+// block transfer functions then sleep until they finish
+#ifndef uHAL_I2C_USE_QUEUE
+# define uHAL_I2C_USE_QUEUE 0
+#endif
 
 //
 // PWM configuration options
@@ -285,11 +327,44 @@
 # define FATFS_DISKIO_H_PATH "FatFS/diskio.h"
 #endif
 //
+// Enable FAT on a raw disk image file instead of an SD card
+// This is only available on the HOST platform, where it's the default
+#ifndef uHAL_USE_FATFS_IMAGE
+# if defined(HAVE_HOST) && HAVE_HOST
+#  define uHAL_USE_FATFS_IMAGE uHAL_USE_FATFS
+# else
+#  define uHAL_USE_FATFS_IMAGE 0
+# endif
+#endif
+//
+// The path of the disk image
+// This can be overridden at run time with the FATFS_IMAGE environment variable
+#ifndef FATFS_IMAGE_PATH
+# define FATFS_IMAGE_PATH "fatfs.img"
+#endif
+//
 // Enable FAT on SD cards
 // Only a generic SPI access is implemented
 // SPI_CS_SD_PIN must be defined, it's used as the CS pin for the SD card
 #ifndef uHAL_USE_FATFS_SD
-# define uHAL_USE_FATFS_SD uHAL_USE_FATFS
+# define uHAL_USE_FATFS_SD (uHAL_USE_FATFS && !uHAL_USE_FATFS_IMAGE)
+#endif
+
+//
+// Internal flash configuration
+//
+// Enable erasing and programming the MCU's internal flash
+// Only the data area reserved at the end of flash can be written to.
+// This isn't available on all platforms.
+#ifndef uHAL_USE_FLASH
+# define uHAL_USE_FLASH 0
+#endif
+//
+// The number of flash pages at the end of flash reserved for data
+// These must not overlap the program; erasing or writing them fails with
+// ERR_NOMEM if they do.
+#ifndef uHAL_FLASH_DATA_PAGES
+# define uHAL_FLASH_DATA_PAGES 4U
 #endif
 
 //
@@ -377,3 +452,12 @@
 #ifndef SSD1306_AUTOSCALE_COEXIST
 # define SSD1306_AUTOSCALE_COEXIST (!uHAL_USE_SMALL_CODE)
 #endif
+//
+// Size of the per-device framebuffer
+// If > 0, drawing is done in RAM and only the changed parts of the screen are
+// sent to the device when ssd1306_flush() is called
+// Must be at least width*height/8 bytes (1024 for a 128x64 display)
+// Set to 0 to disable
+#ifndef SSD1306_FRAMEBUFFER_BYTES
+# define SSD1306_FRAMEBUFFER_BYTES 0U
+#endif
@@ -84,6 +84,10 @@ typedef struct {
 #define SSD1306_CFG_FLAG_HFLIP 0x08U ///< Flip screen horizontally
 /// @}
 
+///
+/// The maximum number of 8-pixel-tall pages on a device
+#define SSD1306_MAX_PAGES 8U
+
 ///
 /// @name Device Management
 /// @{
@@ -95,6 +99,18 @@ typedef struct {
 	uint8_t flags;    ///< Status flags, see the @c SSD1306_STATUS_FLAG_* macros
 	uint8_t contrast; ///< Screen contrast
 	const ssd1306_cfg_t *cfg; ///< Device configuration, saved from @c ssd1306_init()
+#if SSD1306_FRAMEBUFFER_BYTES > 0 || __HAVE_DOXYGEN__
+	/// The screen contents, one byte per column of each 8-pixel-tall page
+	/// @note This member is only present when @c SSD1306_FRAMEBUFFER_BYTES is > 0.
+	uint8_t framebuffer[SSD1306_FRAMEBUFFER_BYTES];
+	/// The first column of each page changed since the last flush
+	/// @note This member is only present when @c SSD1306_FRAMEBUFFER_BYTES is > 0.
+	uint8_t dirty_first[SSD1306_MAX_PAGES];
+	/// The last column of each page changed since the last flush
+	/// A page is unchanged if this is less than the first column
+	/// @note This member is only present when @c SSD1306_FRAMEBUFFER_BYTES is > 0.
+	uint8_t dirty_last[SSD1306_MAX_PAGES];
+#endif
 } ssd1306_handle_t;
 //
 // Status flags
@@ -112,6 +128,10 @@ typedef struct {
 /// modified but must remain a valid configuration as long as the handle is in
 /// use
 ///
+/// @note
+/// If @c SSD1306_FRAMEBUFFER_BYTES is > 0 it must be large enough to hold the
+/// whole display
+///
 /// @param cfg The structure describing the device configuration
 /// @param handle The handle used to manage the device after initialization
 ///
@@ -199,6 +219,21 @@ err_t ssd1306_set_contrast(ssd1306_handle_t *handle, uint8_t level);
 ///  the nature of the problem encountered.
 err_t ssd1306_adj_contrast(ssd1306_handle_t *handle, int_t incr);
 
+///
+/// Send the changed parts of the framebuffer to the device
+///
+/// When @c SSD1306_FRAMEBUFFER_BYTES is > 0, the drawing functions only
+/// update the framebuffer and nothing is shown until this is called. Each
+/// run of changed pages is sent in a single I2C transaction.
+///
+/// When @c SSD1306_FRAMEBUFFER_BYTES is 0, this does nothing.
+///
+/// @param handle The handle used to manage the device
+///
+/// @returns ERR_OK if successful, otherwise an error code indicating
+///  the nature of the problem encountered.
+err_t ssd1306_flush(ssd1306_handle_t *handle);
+
 ///
 /// Fill a section the screen with a bit pattern
 ///
@@ -215,7 +250,7 @@ err_t ssd1306_adj_contrast(ssd1306_handle_t *handle, int_t incr);
 ///
 /// @returns ERR_OK if successful, otherwise an error code indicating
 ///  the nature of the problem encountered.
-err_t ssd1306_fill_section(const ssd1306_handle_t *handle, uint8_t byte, uint8_t xp, uint8_t wp, uint8_t yp, uint8_t hp);
+err_t ssd1306_fill_section(ssd1306_handle_t *handle, uint8_t byte, uint8_t xp, uint8_t wp, uint8_t yp, uint8_t hp);
 
 ///
 /// Blank the display
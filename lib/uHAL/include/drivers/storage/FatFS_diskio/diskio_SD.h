@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+/// @file
+/// @brief Extra controls for the FatFS SD card SPI driver
+///
+/// The driver itself is used through FatFS; this only covers the parts which
+/// FatFS doesn't know about.
+///
+/// Writes of more than one sector are sent as a CMD25 multiple block write,
+/// which is left open afterwards so that a write to the following sector can
+/// continue it. The stream is closed by anything else which needs the card,
+/// including the CTRL_SYNC request FatFS makes when a file is synced or closed.
+///
+#ifndef _uHAL_DRIVERS_STORAGE_DISKIO_DISKIO_SD_PUBLIC_H
+#define _uHAL_DRIVERS_STORAGE_DISKIO_DISKIO_SD_PUBLIC_H
+
+#include "interface.h"
+
+#if uHAL_USE_FATFS_SD || __HAVE_DOXYGEN__
+
+///
+/// Set the number of sectors expected to be written in the next multiple
+/// block write.
+///
+/// The card is told to pre-erase this many sectors (ACMD23) when the next
+/// stream is started, which lets it prepare for a long write that FatFS
+/// hands over in several pieces. The hint is used once and then cleared.
+///
+/// @note
+/// This is only a hint; writing more or fewer sectors is not an error.
+///
+/// @param sectors The number of 512-byte sectors expected.
+void diskio_SD_set_write_hint(uint_fast16_t sectors);
+
+///
+/// Prepare the driver for the card losing power.
+///
+/// Any open multiple block write is finished and the card is marked as
+/// needing to be initialized again before the next access.
+///
+/// @note
+/// This should be called after the file system is unmounted and before the
+/// card's power is cut.
+void diskio_SD_power_off(void);
+
+#endif // uHAL_USE_FATFS_SD
+#endif // _uHAL_DRIVERS_STORAGE_DISKIO_DISKIO_SD_PUBLIC_H
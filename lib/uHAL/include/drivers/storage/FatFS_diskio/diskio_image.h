@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+/// @file
+/// @brief FatFS driver backed by a raw disk image file
+///
+/// @attention
+/// This driver is only available on the HOST platform.
+///
+/// The image can be either a bare FAT volume or a disk with an MBR partition
+/// table, in which case the first partition is used. Every access is counted
+/// so that the storage cost of an operation can be measured.
+///
+#ifndef _uHAL_DRIVERS_STORAGE_DISKIO_DISKIO_IMAGE_H
+#define _uHAL_DRIVERS_STORAGE_DISKIO_DISKIO_IMAGE_H
+
+#include "interface.h"
+
+#if uHAL_USE_FATFS_IMAGE || __HAVE_DOXYGEN__
+
+///
+/// Counters of disk accesses.
+///
+/// Sector counters are split by the region of the volume the sector is in.
+/// Sectors which can't be placed in a region (e.g. the partition table) are
+/// counted as data.
+///
+/// @attention
+/// Only the first cluster of the root directory of a FAT32 volume is counted
+/// as a directory sector. Sub-directories are always counted as data.
+typedef struct {
+	uint32_t read_calls;     ///< Number of calls to disk_read()
+	uint32_t write_calls;    ///< Number of calls to disk_write()
+	uint32_t sync_calls;     ///< Number of CTRL_SYNC requests
+
+	uint32_t reserved_reads; ///< Boot and FSInfo sectors read
+	uint32_t reserved_writes;///< Boot and FSInfo sectors written
+	uint32_t fat_reads;      ///< Allocation table sectors read
+	uint32_t fat_writes;     ///< Allocation table sectors written
+	uint32_t dir_reads;      ///< Root directory sectors read
+	uint32_t dir_writes;     ///< Root directory sectors written
+	uint32_t data_reads;     ///< Data sectors read
+	uint32_t data_writes;    ///< Data sectors written
+} diskio_image_stats_t;
+
+///
+/// Get the access counters.
+///
+/// @param stats The structure to fill. Must not be NULL.
+void diskio_image_get_stats(diskio_image_stats_t *stats);
+///
+/// Reset the access counters to 0.
+void diskio_image_reset_stats(void);
+
+#endif // uHAL_USE_FATFS_IMAGE
+#endif // _uHAL_DRIVERS_STORAGE_DISKIO_DISKIO_IMAGE_H
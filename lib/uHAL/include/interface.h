@@ -81,6 +81,9 @@ typedef uint_fast16_t txsize_t;
 #if uHAL_USE_ADC || __HAVE_DOXYGEN__
 # include "interface/adc.h"
 #endif
+#if uHAL_USE_FLASH || __HAVE_DOXYGEN__
+# include "interface/flash.h"
+#endif
 #if uHAL_USE_I2C || __HAVE_DOXYGEN__
 # include "interface/i2c.h"
 #endif
@@ -93,6 +96,9 @@ typedef uint_fast16_t txsize_t;
 #if uHAL_USE_UART || __HAVE_DOXYGEN__
 # include "interface/uart.h"
 #endif
+#if uHAL_USE_POWER_MANAGER || __HAVE_DOXYGEN__
+# include "interface/power.h"
+#endif
 
 #include PLATFORM_INTERFACE_H
 
@@ -105,6 +105,24 @@ uint_fast16_t adc_read_vref_mV(void);
 ///  @c ERR_ADC on failure.
 adc_t adc_read_pin(gpio_pin_t pin);
 
+///
+/// Read the values on several analog pins at once.
+///
+/// Where the hardware supports it, all the pins are converted in a single
+/// scan of the ADC rather than one at a time, which is considerably faster
+/// than calling adc_read_pin() in a loop. Each value is averaged over
+/// @c ADC_SAMPLE_COUNT samples the same as adc_read_pin().
+///
+/// @param pins The pins to examine. Must not be NULL.
+/// @param values The array to store the readings in, in the same order as
+///  @c pins. Any reading which couldn't be taken is set to @c ERR_ADC. Must
+///  not be NULL.
+/// @param count The number of entries in @c pins and @c values.
+///
+/// @returns ERR_OK if every pin was read, otherwise an error code indicating
+///  the nature of the problem encountered.
+err_t adc_read_pins(const gpio_pin_t *pins, adc_t *values, uint_fast8_t count);
+
 ///
 /// Try to find the amplitude of an AC voltage.
 ///
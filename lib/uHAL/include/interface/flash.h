@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+/// @file
+/// @brief Internal Flash Interface
+/// @note
+///    This file should only be included by interface.h.
+///
+/// The data area is the last @c uHAL_FLASH_DATA_PAGES pages of the MCU's
+/// flash. Offsets passed to these functions are relative to the start of that
+/// area rather than to the start of flash.
+///
+/// Erased flash reads back as @c FLASH_ERASED_BYTE. Once programmed, a write
+/// unit of @c FLASH_WRITE_BYTES bytes can't be changed again until its page is
+/// erased except to clear it to all zeroes.
+///
+
+//
+// These are defined in the device platform.h, they're included here for
+// documentation purposes.
+#if __HAVE_DOXYGEN__
+///
+/// The size of an erasable flash page in bytes.
+#define FLASH_PAGE_BYTES
+///
+/// The smallest unit of flash that can be programmed in bytes.
+///
+/// Write offsets and sizes must be multiples of this.
+#define FLASH_WRITE_BYTES
+#endif // __HAVE_DOXYGEN__
+#if ! defined(FLASH_PAGE_BYTES) && ! __HAVE_DOXYGEN__
+# error "uHAL_USE_FLASH isn't supported on this platform"
+#endif
+
+///
+/// The value of every byte of an erased page.
+#define FLASH_ERASED_BYTE 0xFFU
+
+///
+/// The size of the flash data area in bytes.
+#define FLASH_DATA_BYTES ((uint32_t )uHAL_FLASH_DATA_PAGES * (uint32_t )FLASH_PAGE_BYTES)
+
+///
+/// Erase a page of the flash data area.
+///
+/// This takes a long time (tens of milliseconds on some devices) and the
+/// CPU may be stalled for all of it.
+///
+/// @param page The page to erase, counting from the start of the data area.
+///  Must be less than @c uHAL_FLASH_DATA_PAGES.
+///
+/// @returns ERR_OK if successful, otherwise an error code indicating
+///  the nature of the problem encountered.
+err_t flash_erase_page(uint_fast16_t page);
+
+///
+/// Program part of the flash data area.
+///
+/// @param offset The offset into the data area to start writing at. Must be a
+///  multiple of @c FLASH_WRITE_BYTES.
+/// @param data The data to write. Must not be NULL.
+/// @param size The number of bytes to write. Must be a multiple of
+///  @c FLASH_WRITE_BYTES and the write must not run past the end of the data
+///  area.
+///
+/// @returns ERR_OK if successful, otherwise an error code indicating
+///  the nature of the problem encountered. If a write unit which wasn't erased
+///  is given anything other than all zeroes the write stops there and
+///  ERR_PERM is returned.
+err_t flash_write(uint32_t offset, const void *data, uint_fast16_t size);
+
+///
+/// Read part of the flash data area.
+///
+/// @param offset The offset into the data area to start reading at.
+/// @param data The buffer to read into. Must not be NULL.
+/// @param size The number of bytes to read. The read must not run past the
+///  end of the data area.
+///
+/// @returns ERR_OK if successful, otherwise an error code indicating
+///  the nature of the problem encountered.
+err_t flash_read(uint32_t offset, void *data, uint_fast16_t size);
@@ -148,3 +148,90 @@ err_t i2c_transmit_block_continue(const uint8_t *tx_buffer, txsize_t tx_size, ut
 /// @returns ERR_OK if successful, otherwise an error code indicating
 ///  the nature of the problem encountered.
 err_t i2c_transmit_block_end(void);
+
+#if uHAL_I2C_USE_QUEUE || __HAVE_DOXYGEN__
+///
+/// @name Queued I2C Transactions
+///
+/// @note
+/// These are only available when @c uHAL_I2C_USE_QUEUE is set. The
+/// transactions are run by the peripheral's interrupts and i2c_transmit_block()
+/// and i2c_receive_block() use them internally, sleeping until they finish.
+/// The @c i2c_*_block_begin(), @c _continue(), and @c _end() functions still
+/// poll the bus; i2c_*_block_begin() waits for the queue to empty first and
+/// anything queued in the meantime is started by i2c_*_block_end().
+/// @{
+//
+///
+/// The type of the function called when a queued transaction finishes.
+///
+/// @attention
+/// This is normally called from an interrupt handler.
+///
+/// @param res ERR_OK if the transaction finished, otherwise an error code
+///  indicating the nature of the problem encountered.
+/// @param cb_data The @c cb_data field of the transaction.
+typedef void (*i2c_callback_t)(err_t res, void *cb_data);
+///
+/// Description of a single I2C transaction.
+///
+/// If both @c tx_size and @c rx_size are non-zero, the bytes in @c tx_buffer
+/// are sent and then the bytes for @c rx_buffer are read after a repeated
+/// start, which is how most register-based devices are read.
+typedef struct i2c_transaction_t {
+	const uint8_t *tx_buffer; ///< The bytes to send. May be NULL if @c tx_size is 0.
+	uint8_t *rx_buffer;       ///< The bytes received. May be NULL if @c rx_size is 0.
+	i2c_callback_t callback;  ///< Called when the transaction finishes. May be NULL.
+	void *cb_data;            ///< Passed to @c callback.
+	txsize_t tx_size;         ///< The number of bytes in @c tx_buffer.
+	txsize_t rx_size;         ///< The number of bytes to receive into @c rx_buffer.
+	uint8_t addr;             ///< The address of the device.
+
+	volatile bool busy;       ///< Set while the transaction is queued or running.
+	volatile err_t res;       ///< The result once @c busy is cleared.
+	struct i2c_transaction_t *next; ///< Used internally.
+} i2c_transaction_t;
+///
+/// Add a transaction to the queue and return without waiting for it to finish.
+///
+/// Transactions are run in the order they're queued. Those queued while
+/// another one is running follow it with a repeated start instead of
+/// releasing the bus in between.
+///
+/// @attention
+/// The transaction and its buffers must stay valid until it finishes.
+///
+/// @param txn The transaction to queue. At least one of @c tx_size and
+///  @c rx_size must be > 0.
+///
+/// @retval ERR_OK if the transaction was queued.
+/// @retval ERR_RETRY if @c txn is already queued.
+/// @returns Otherwise an error code indicating the nature of the problem
+///  encountered.
+err_t i2c_queue_transaction(i2c_transaction_t *txn);
+///
+/// Check if any queued transactions are still waiting or running.
+///
+/// @retval true if the queue isn't empty.
+/// @retval false if the queue is empty.
+bool i2c_queue_is_busy(void);
+///
+/// Sleep until a queued transaction finishes.
+///
+/// Everything still in the queue is aborted if it takes too long; the
+/// callbacks are called with ERR_TIMEOUT in that case.
+///
+/// @attention
+/// This must not be called from an interrupt handler or with interrupts
+/// disabled.
+///
+/// @param txn The transaction to wait for. If NULL, wait for the queue to
+///  empty.
+/// @param timeout Abort if the operation takes more than this many milliseconds.
+///  Must be > 0.
+///
+/// @returns The result of @c txn if given, otherwise ERR_OK if the queue
+///  emptied or ERR_TIMEOUT if it didn't.
+err_t i2c_queue_wait(const i2c_transaction_t *txn, utime_t timeout);
+/// @}
+#endif // uHAL_I2C_USE_QUEUE
@@ -0,0 +1,147 @@
+//
+// Generated by tools/serial/logger_token_hash.sh on Sun Oct 18 08:27:22 UTC 2026
+//
+// LOGGER_TOKEN_HASH(s) computes a 65599 polynomial hash of the string literal
+// s at compile time:
+//    hash = strlen(s) + s[0]*65599^1 + s[1]*65599^2 + ... (mod 2^32)
+// Only the first 128 characters contribute to the hash.
+//
+// s must be a string literal (or a char array); any characters past the end
+// of the string read the terminating NUL so they don't affect the result.
+//
+#define LOGGER_TOKEN_HASH_LENGTH 128U
+
+#define _LOGGER_TOKEN_CHAR(_s_, _i_) \
+	((uint32_t )(uint8_t )(_s_)[((_i_) < sizeof(_s_)) ? (_i_) : (sizeof(_s_) - 1U)])
+
+#define LOGGER_TOKEN_HASH(_s_) ((uint32_t )( \
+	(uint32_t )(sizeof(_s_) - 1U) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 0U) * 0x0001003FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 1U) * 0x007E0F81UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 2U) * 0x2E86D0BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 3U) * 0x43EC5F01UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 4U) * 0x162C613FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 5U) * 0xD62AEE81UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 6U) * 0xA311B1BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 7U) * 0xD319BE01UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 8U) * 0xB156C23FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 9U) * 0x6698CD81UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 10U) * 0x0D1B92BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 11U) * 0xCC881D01UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 12U) * 0x7280233FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 13U) * 0x50C7AC81UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 14U) * 0x8DA473BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 15U) * 0x4F377C01UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 16U) * 0xFAA8843FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 17U) * 0x33B78B81UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 18U) * 0x45AC54BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 19U) * 0x7A27DB01UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 20U) * 0xEACFE53FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 21U) * 0xAE686A81UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 22U) * 0x563335BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 23U) * 0x6C593A01UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 24U) * 0xE3F6463FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 25U) * 0x5FDA4981UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 26U) * 0xE03916BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 27U) * 0x44CB9901UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 28U) * 0x871BA73FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 29U) * 0xE70D2881UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 30U) * 0x04BDF7BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 31U) * 0x227EF801UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 32U) * 0x7540083FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 33U) * 0xE3010781UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 34U) * 0xE4C1D8BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 35U) * 0x24735701UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 36U) * 0x4F63693FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 37U) * 0xF2B5E681UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 38U) * 0xA144B9BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 39U) * 0x69A8B601UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 40U) * 0xB685CA3FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 41U) * 0xB52BC581UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 42U) * 0x5B469ABFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 43U) * 0x111F1501UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 44U) * 0x4BA72B3FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 45U) * 0xC962A481UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 46U) * 0x33C77BBFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 47U) * 0x39D67401UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 48U) * 0xAFC78C3FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 49U) * 0xCE5A8381UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 50U) * 0x4BC75CBFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 51U) * 0x02CED301UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 52U) * 0x83E6ED3FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 53U) * 0x63136281UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 54U) * 0xC4463DBFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 55U) * 0x8B083201UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 56U) * 0x69054E3FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 57U) * 0x268D4181UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 58U) * 0xBE441EBFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 59U) * 0xF1829101UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 60U) * 0x0022AF3FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 61U) * 0xB7C82081UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 62U) * 0x5AC0FFBFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 63U) * 0x553DF001UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 64U) * 0xEA3F103FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 65U) * 0xB5C3FF81UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 66U) * 0xBABCE0BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 67U) * 0xD53A4F01UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 68U) * 0xC85A713FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 69U) * 0xBF80DE81UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 70U) * 0xFF37C1BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 71U) * 0x9077AE01UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 72U) * 0x3B74D23FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 73U) * 0x73FEBD81UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 74U) * 0x4931A2BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 75U) * 0xA5F60D01UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 76U) * 0xE48E333FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 77U) * 0x723D9C81UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 78U) * 0xB9AA83BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 79U) * 0x34B56C01UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 80U) * 0x64A6943FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 81U) * 0x593D7B81UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 82U) * 0x71A264BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 83U) * 0x5BB5CB01UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 84U) * 0x5CBDF53FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 85U) * 0xC7FE5A81UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 86U) * 0x921945BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 87U) * 0x39F72A01UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 88U) * 0x6DD4563FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 89U) * 0x5D803981UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 90U) * 0x3C0F26BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 91U) * 0xEE798901UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 92U) * 0x38E9B73FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 93U) * 0xB8C31881UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 94U) * 0x908407BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 95U) * 0x983CE801UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 96U) * 0x5EFE183FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 97U) * 0x78C6F781UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 98U) * 0xB077E8BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 99U) * 0x56414701UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 100U) * 0x8111793FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 101U) * 0x3C8BD681UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 102U) * 0xBCEAC9BFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 103U) * 0x4786A601UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 104U) * 0x4023DA3FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 105U) * 0xA311B581UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 106U) * 0xD6DCAABFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 107U) * 0x8B0D0501UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 108U) * 0x3D353B3FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 109U) * 0x4B589481UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 110U) * 0x1F4D8BBFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 111U) * 0x3FD46401UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 112U) * 0x19459C3FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 113U) * 0xD4607381UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 114U) * 0xB73D6CBFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 115U) * 0x84DCC301UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 116U) * 0x7554FD3FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 117U) * 0xDD295281UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 118U) * 0xBFAC4DBFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 119U) * 0x79262201UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 120U) * 0xF2635E3FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 121U) * 0x04B33181UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 122U) * 0x599A2EBFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 123U) * 0x3BB08101UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 124U) * 0x3170BF3FUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 125U) * 0xE9FE1081UL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 126U) * 0xA6070FBFUL) + \
+	(_LOGGER_TOKEN_CHAR(_s_, 127U) * 0xEB7BE001UL) \
+	))
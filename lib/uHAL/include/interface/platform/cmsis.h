@@ -65,3 +65,64 @@ err_t tim5_oscillator_calibration(osc_calib_t mode, uint32_t *LS_cycles, uint32_
 ///  the nature of the problem encountered.
 err_t calibrate_RTC_clock(void);
 /// @}
+
+#if uHAL_USE_SPI || __HAVE_DOXYGEN__
+///
+/// @name Asynchronous SPI Transfers
+///
+/// @note
+/// These only do anything when @c uHAL_SPI_USE_DMA is set and the DMA
+/// channels serving the SPI peripheral in use are known. The block transfer
+/// functions in interface/spi.h use them internally for transfers of at
+/// least @c SPI_DMA_MIN_BYTES bytes and sleep until they finish.
+/// @{
+//
+///
+/// The type of the function called when an asynchronous transfer finishes.
+///
+/// @attention
+/// This is normally called from an interrupt handler.
+///
+/// @param res ERR_OK if the transfer finished, otherwise an error code
+///  indicating the nature of the problem encountered.
+/// @param cb_data The value passed to spi_transfer_async().
+typedef void (*spi_callback_t)(err_t res, void *cb_data);
+///
+/// Start a full-duplex transfer and return without waiting for it to finish.
+///
+/// @attention
+/// The buffers must stay valid until the transfer finishes.
+///
+/// @param tx_buffer The bytes to send. If NULL, @c tx is sent for every byte.
+/// @param rx_buffer The bytes received. If NULL, they're discarded.
+/// @param size The number of bytes to exchange.
+///  Must be > 0.
+/// @param tx The byte to send when @c tx_buffer is NULL.
+/// @param callback Called when the transfer finishes. May be NULL.
+/// @param cb_data Passed to @c callback.
+///
+/// @retval ERR_OK if the transfer was started.
+/// @retval ERR_RETRY if another transfer is still running.
+/// @retval ERR_NOTSUP if DMA isn't available.
+/// @returns Otherwise an error code indicating the nature of the problem
+///  encountered.
+err_t spi_transfer_async(const uint8_t *tx_buffer, uint8_t *rx_buffer, txsize_t size, uint8_t tx, spi_callback_t callback, void *cb_data);
+///
+/// Check if an asynchronous transfer is running.
+///
+/// @retval true if a transfer is running.
+/// @retval false if no transfer is running.
+bool spi_transfer_is_busy(void);
+///
+/// Sleep until the running asynchronous transfer finishes.
+///
+/// The transfer is aborted if it takes too long; the callback is called with
+/// ERR_TIMEOUT in that case.
+///
+/// @param timeout Abort if the transfer takes more than this many milliseconds.
+///  Must be > 0.
+///
+/// @returns The result of the most recent transfer.
+err_t spi_transfer_wait(utime_t timeout);
+/// @}
+#endif // uHAL_USE_SPI
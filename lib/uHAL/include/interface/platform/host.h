@@ -0,0 +1,214 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+/// @file
+/// @brief Platform-specific features.
+/// @note
+///    This file should only be included by interface.h
+/// @note
+///    This file is only included when using the HOST platform
+///
+
+///
+/// @name Simulation Interface
+///
+/// There's no hardware behind the HOST platform's peripherals. These functions
+/// let the program running on it play the part of the outside world.
+/// @{
+//
+///
+/// Drive an input pin from outside.
+///
+/// If the pin is listening and the change matches its trigger,
+/// host_gpio_IRQHandler() is called before returning.
+///
+/// @param pin The pin to drive.
+/// @param new_state The level to drive the pin to. If @c GPIO_FLOAT, the pin is
+///  released and follows its bias again.
+///
+/// @returns ERR_OK if successful, otherwise an error code indicating
+///  the nature of the problem encountered.
+err_t host_gpio_set_input(gpio_pin_t pin, gpio_state_t new_state);
+///
+/// Handler called when a listening pin sees a matching edge.
+///
+/// @note
+/// The default implementation is weak and does nothing.
+void host_gpio_IRQHandler(void);
+
+#if uHAL_USE_ADC || __HAVE_DOXYGEN__
+///
+/// Set the value future ADC conversions on a pin will return.
+///
+/// @param pin The pin to set.
+/// @param value The conversion value. Must not be greater than @c ADC_MAX.
+///
+/// @returns ERR_OK if successful, otherwise an error code indicating
+///  the nature of the problem encountered.
+err_t host_adc_set_pin(gpio_pin_t pin, adc_t value);
+///
+/// Set the value returned by adc_read_vref_mV().
+///
+/// @param mV The new voltage. Must not be @c 0.
+///
+/// @returns ERR_OK if successful, otherwise an error code indicating
+///  the nature of the problem encountered.
+err_t host_adc_set_vref_mV(uint_fast16_t mV);
+///
+/// Counters kept by the simulated ADC.
+typedef struct {
+	uint32_t power_ups;   ///< Calls to adc_on() made while the ADC was off
+	uint32_t scans;       ///< Calls to adc_read_pin() and adc_read_pins()
+	uint32_t conversions; ///< Pins converted
+} host_adc_stats_t;
+///
+/// Get the simulated ADC's counters.
+///
+/// @param stats The structure to fill. Must not be NULL.
+void host_adc_get_stats(host_adc_stats_t *stats);
+///
+/// Reset the simulated ADC's counters to 0.
+void host_adc_reset_stats(void);
+#endif // uHAL_USE_ADC
+
+#if uHAL_USE_SPI || __HAVE_DOXYGEN__
+///
+/// Exchange a byte with the simulated SPI bus.
+///
+/// @note
+/// The default implementation is weak and behaves as if nothing were
+/// connected. When @c HOST_SD_CARD_EMULATION is set it's replaced by an
+/// emulated SD card.
+///
+/// @param tx The byte sent by the host.
+///
+/// @returns The byte sent by the device.
+uint8_t host_spi_exchange(uint8_t tx);
+#endif // uHAL_USE_SPI
+
+#if (uHAL_USE_SPI && HOST_SD_CARD_EMULATION) || __HAVE_DOXYGEN__
+///
+/// Counters kept by the emulated SD card.
+typedef struct {
+	uint32_t commands;            ///< Commands received, including CMD55
+	uint32_t single_block_reads;  ///< CMD17 commands
+	uint32_t multi_block_reads;   ///< CMD18 commands
+	uint32_t blocks_read;         ///< Data blocks sent to the host
+	uint32_t single_block_writes; ///< CMD24 commands
+	uint32_t multi_block_writes;  ///< CMD25 commands
+	uint32_t pre_erase_hints;     ///< ACMD23 commands
+	uint32_t blocks_written;      ///< Data blocks received from the host
+	uint32_t bytes_clocked;       ///< Bytes exchanged while the card was selected
+	uint32_t busy_bytes;          ///< Bytes during which the card reported busy
+	uint32_t stray_tokens;        ///< Data tokens received outside of a write
+} host_sd_stats_t;
+///
+/// Get the emulated SD card's counters.
+///
+/// The card emulation replaces host_spi_exchange() and is enabled with
+/// @c HOST_SD_CARD_EMULATION.
+///
+/// @param stats The structure to fill. Must not be NULL.
+void host_sd_get_stats(host_sd_stats_t *stats);
+///
+/// Reset the emulated SD card's counters to 0.
+void host_sd_reset_stats(void);
+///
+/// Cut and restore the emulated SD card's power.
+///
+/// Anything in progress, including an open multiple block write, is lost and
+/// the card has to be initialized again. The image and counters are kept.
+void host_sd_power_cycle(void);
+#endif // uHAL_USE_SPI && HOST_SD_CARD_EMULATION
+
+#if uHAL_USE_FLASH || __HAVE_DOXYGEN__
+///
+/// Counters kept by the emulated internal flash.
+typedef struct {
+	uint32_t page_erases;     ///< Calls to flash_erase_page()
+	uint32_t write_calls;     ///< Calls to flash_write()
+	uint32_t bytes_written;   ///< Bytes programmed by flash_write()
+	uint32_t read_calls;      ///< Calls to flash_read()
+	uint32_t bytes_read;      ///< Bytes returned by flash_read()
+	uint32_t busy_us;         ///< Estimated time spent erasing and programming
+	uint32_t max_page_erases; ///< The most times any one page has been erased since startup
+	uint32_t min_page_erases; ///< The fewest times any one page has been erased since startup
+} host_flash_stats_t;
+///
+/// Get the emulated internal flash's counters.
+///
+/// The per-page erase counts used for @c max_page_erases and
+/// @c min_page_erases aren't affected by host_flash_reset_stats().
+///
+/// @param stats The structure to fill. Must not be NULL.
+void host_flash_get_stats(host_flash_stats_t *stats);
+///
+/// Reset the emulated internal flash's counters to 0.
+void host_flash_reset_stats(void);
+#endif // uHAL_USE_FLASH
+
+#if uHAL_USE_I2C || __HAVE_DOXYGEN__
+///
+/// Send data to a device on the simulated I2C bus.
+///
+/// @note
+/// The default implementation is weak and returns ERR_NODEV.
+///
+/// @param addr The 7-bit address of the device.
+/// @param tx_buffer The data to send.
+/// @param tx_size The number of bytes in @c tx_buffer.
+///
+/// @returns ERR_OK if successful, otherwise an error code indicating
+///  the nature of the problem encountered.
+err_t host_i2c_transmit(uint8_t addr, const uint8_t *tx_buffer, txsize_t tx_size);
+///
+/// Receive data from a device on the simulated I2C bus.
+///
+/// @note
+/// The default implementation is weak and returns ERR_NODEV.
+///
+/// @param addr The 7-bit address of the device.
+/// @param rx_buffer The buffer to fill.
+/// @param rx_size The number of bytes to read into @c rx_buffer.
+///
+/// @returns ERR_OK if successful, otherwise an error code indicating
+///  the nature of the problem encountered.
+err_t host_i2c_receive(uint8_t addr, uint8_t *rx_buffer, txsize_t rx_size);
+#endif // uHAL_USE_I2C
+
+///
+/// Get the total time spent in sleep or hibernation.
+///
+/// @returns The number of milliseconds the virtual clock was skipped forward.
+uint_fast64_t host_get_virtual_sleep_ms(void);
+///
+/// Get the total time since the program started, including time asleep.
+///
+/// @returns The number of milliseconds of virtual time since startup.
+uint_fast64_t host_get_elapsed_ms(void);
+///
+/// Get the total time spent awake.
+///
+/// This is the host time the program has spent running plus any time skipped
+/// by virtual delays, so it's a rough measure of how long the real device
+/// would be awake for the same work.
+///
+/// @returns The number of microseconds spent awake since startup.
+uint_fast64_t host_get_awake_us(void);
+/// @}
@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+/// @file
+/// @brief Peripheral Power Management Interface
+/// @note
+///    This file should only be included by interface.h.
+///
+/// Peripherals are reference-counted so that code which only needs one for a
+/// moment doesn't have to care whether anything else is using it. A
+/// peripheral is turned on by the first power_acquire() and, when
+/// @c uHAL_POWER_DEFER_OFF is set, left on after the last power_release()
+/// until power_down_idle() is called; that happens automatically before
+/// hibernating. Everything which uses the peripheral during one wake then
+/// shares a single power-up, which matters when turning it on involves a
+/// stabilization delay as with the ADC.
+///
+/// Peripherals turned on directly with their @c *_on() function aren't
+/// turned off by the power manager.
+///
+
+///
+/// The peripherals managed by the power manager.
+///
+/// Only those which are enabled in the configuration are present.
+typedef enum {
+#if uHAL_USE_ADC || __HAVE_DOXYGEN__
+	POWER_DOMAIN_ADC, ///< The ADC, see adc_on().
+#endif
+#if uHAL_USE_SPI || __HAVE_DOXYGEN__
+	POWER_DOMAIN_SPI, ///< The SPI peripheral, see spi_on().
+#endif
+#if uHAL_USE_I2C || __HAVE_DOXYGEN__
+	POWER_DOMAIN_I2C, ///< The I2C peripheral, see i2c_on().
+#endif
+	POWER_DOMAIN_COUNT ///< The number of domains; not a valid domain.
+} power_domain_t;
+
+///
+/// Counters kept for each power domain.
+typedef struct {
+	uint32_t power_ups;    ///< Times the power manager turned the peripheral on
+	uint32_t power_downs;  ///< Times the power manager turned the peripheral off
+	uint32_t cycles_saved; ///< Acquisitions which found it still on after an earlier release
+} power_domain_stats_t;
+
+///
+/// Start using a peripheral, turning it on if needed.
+///
+/// @param domain The peripheral to use.
+///
+/// @returns ERR_OK if successful, otherwise an error code indicating
+///  the nature of the problem encountered.
+err_t power_acquire(power_domain_t domain);
+
+///
+/// Stop using a peripheral.
+///
+/// Every call to power_acquire() must be matched by a call to this.
+///
+/// @param domain The peripheral to release.
+///
+/// @returns ERR_OK if successful, otherwise an error code indicating
+///  the nature of the problem encountered.
+err_t power_release(power_domain_t domain);
+
+///
+/// Turn a peripheral off now if nothing is using it.
+///
+/// This is for when the peripheral needs to be off before something else
+/// happens, such as removing power from the devices attached to it.
+///
+/// @param domain The peripheral to turn off.
+///
+/// @retval ERR_OK if the peripheral is off or wasn't turned on by the power
+///  manager.
+/// @retval ERR_RETRY if the peripheral is still in use.
+/// @returns Otherwise an error code indicating the nature of the problem
+///  encountered.
+err_t power_down(power_domain_t domain);
+
+///
+/// Turn off every peripheral which was left on after its last release.
+///
+/// @note
+/// This is called by @c hibernate_s() and @c hibernate() after
+/// @c pre_hibernate_hook().
+void power_down_idle(void);
+
+///
+/// Get the counters kept for a power domain.
+///
+/// @param domain The domain to examine.
+/// @param stats The structure to fill. Must not be NULL.
+///
+/// @returns ERR_OK if successful, otherwise an error code indicating
+///  the nature of the problem encountered.
+err_t power_get_stats(power_domain_t domain, power_domain_stats_t *stats);
+
+///
+/// Reset the counters for every power domain to 0.
+void power_reset_stats(void);
@@ -47,6 +47,18 @@ void print_platform_info(void);
 void logger(const char *fmt, ...)
 	__attribute__ ((format(printf, 1, 2)));
 
+///
+/// Print a debug message without formatting it.
+///
+/// This is used by @c LOGGER() when @c LOGGER_TOKENIZED is set; it outputs
+/// a line consisting of a '$' followed by the base64-encoded token and
+/// arguments, which is turned back into text by tools/decode_logger.py.
+///
+/// @param token The hash of the format string as computed by @c LOGGER_TOKEN_HASH().
+/// @param arg_types The types of the arguments as computed by @c LOGGER_ARG_TYPES().
+/// @param ... The values for the format string.
+void logger_token(uint32_t token, uint32_t arg_types, ...);
+
 ///
 /// Replay past logger() output.
 ///
@@ -101,6 +113,7 @@ void terminal(void);
 # define serial_init()       ((void )0)
 # define print_system_info() ((void )0)
 # define logger(...)         ((void )0)
+# define logger_token(...)   ((void )0)
 # define serial_printf(...)  ((void )0)
 # define serial_print(...)   ((void )0)
 #endif
@@ -117,6 +130,21 @@ void terminal(void);
 //
 #if DEBUG || __HAVE_DOXYGEN__
 # ifndef LOGGER
+#  if LOGGER_TOKENIZED
+///
+/// Convenience macro for @c logger().
+///
+/// @note
+/// When @c LOGGER_TOKENIZED is set the format string isn't stored on the
+/// device; @c logger_token() is called with its hash instead. The format
+/// string must be a literal and there may be no more than 10 arguments, each
+/// of which must be an integer type no larger than a long or a string.
+///
+/// @param fmt A @c printf()-style format string.
+/// @param ... The values for the format string.
+#   define LOGGER(fmt, ...) (0 ? logger(fmt, ## __VA_ARGS__) : \
+	logger_token(LOGGER_TOKEN_HASH(fmt), LOGGER_ARG_TYPES(fmt, ## __VA_ARGS__), ## __VA_ARGS__))
+#  else
 ///
 /// Convenience macro for @c logger().
 ///
@@ -125,7 +153,8 @@ void terminal(void);
 ///
 /// @param fmt A @c printf()-style format string.
 /// @param ... The values for the format string.
-#  define LOGGER(fmt, ...)      logger(F1(fmt), ## __VA_ARGS__)
+#   define LOGGER(fmt, ...)      logger(F1(fmt), ## __VA_ARGS__)
+#  endif
 # endif
 # ifndef LOGGER_NOF
 ///
@@ -177,3 +206,70 @@ void terminal(void);
 /// @param len The length of the string. Calculated if 0.
 #define PUTS_NOF(msg, len)   serial_print(msg, len)
 /// @}
+
+#if LOGGER_TOKENIZED || __HAVE_DOXYGEN__
+# include "logger_token_hash.h"
+
+///
+/// @name Tokenized Logging Argument Types.
+///
+/// The type codes of the arguments passed to @c logger_token(); each takes
+/// 3 bits of the @c arg_types parameter, starting with the lowest bits for
+/// the first argument and ending with @c LOGGER_ARG_END.
+///
+/// Types smaller than an @c int are promoted when passed to a variadic
+/// function so they use the type they're promoted to.
+///
+/// @{
+#define LOGGER_ARG_END   0U
+#define LOGGER_ARG_INT   1U
+#define LOGGER_ARG_UINT  2U
+#define LOGGER_ARG_LONG  3U
+#define LOGGER_ARG_ULONG 4U
+#define LOGGER_ARG_STR   5U
+#define LOGGER_ARG_BITS  3U
+/// @}
+
+///
+/// Get the @c logger_token() type code of an argument.
+///
+/// @param x The argument to examine.
+#define LOGGER_ARG_TYPE(x) _Generic((x), \
+	_Bool: LOGGER_ARG_INT, \
+	char: LOGGER_ARG_INT, \
+	signed char: LOGGER_ARG_INT, \
+	unsigned char: LOGGER_ARG_INT, \
+	short: LOGGER_ARG_INT, \
+	unsigned short: ((sizeof(unsigned short) < sizeof(int)) ? LOGGER_ARG_INT : LOGGER_ARG_UINT), \
+	int: LOGGER_ARG_INT, \
+	unsigned int: LOGGER_ARG_UINT, \
+	long: LOGGER_ARG_LONG, \
+	unsigned long: LOGGER_ARG_ULONG, \
+	char *: LOGGER_ARG_STR, \
+	const char *: LOGGER_ARG_STR \
+	)
+
+///
+/// Get the @c arg_types parameter for @c logger_token().
+///
+/// @param fmt The format string, which is only used to count the arguments.
+/// @param ... The values for the format string.
+#define LOGGER_ARG_TYPES(fmt, ...) \
+	_LOGGER_CAT(_LOGGER_ARG_TYPES_, _LOGGER_NARGS(fmt, ## __VA_ARGS__, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0))(__VA_ARGS__)
+
+#define _LOGGER_CAT(a, b)  _LOGGER_CAT_(a, b)
+#define _LOGGER_CAT_(a, b) a ## b
+#define _LOGGER_NARGS(fmt, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, n, ...) n
+
+#define _LOGGER_ARG_TYPES_0(...)    (LOGGER_ARG_END)
+#define _LOGGER_ARG_TYPES_1(x)      ((uint32_t )LOGGER_ARG_TYPE(x))
+#define _LOGGER_ARG_TYPES_2(x, ...) (_LOGGER_ARG_TYPES_1(x) | (_LOGGER_ARG_TYPES_1(__VA_ARGS__) << LOGGER_ARG_BITS))
+#define _LOGGER_ARG_TYPES_3(x, ...) (_LOGGER_ARG_TYPES_1(x) | (_LOGGER_ARG_TYPES_2(__VA_ARGS__) << LOGGER_ARG_BITS))
+#define _LOGGER_ARG_TYPES_4(x, ...) (_LOGGER_ARG_TYPES_1(x) | (_LOGGER_ARG_TYPES_3(__VA_ARGS__) << LOGGER_ARG_BITS))
+#define _LOGGER_ARG_TYPES_5(x, ...) (_LOGGER_ARG_TYPES_1(x) | (_LOGGER_ARG_TYPES_4(__VA_ARGS__) << LOGGER_ARG_BITS))
+#define _LOGGER_ARG_TYPES_6(x, ...) (_LOGGER_ARG_TYPES_1(x) | (_LOGGER_ARG_TYPES_5(__VA_ARGS__) << LOGGER_ARG_BITS))
+#define _LOGGER_ARG_TYPES_7(x, ...) (_LOGGER_ARG_TYPES_1(x) | (_LOGGER_ARG_TYPES_6(__VA_ARGS__) << LOGGER_ARG_BITS))
+#define _LOGGER_ARG_TYPES_8(x, ...) (_LOGGER_ARG_TYPES_1(x) | (_LOGGER_ARG_TYPES_7(__VA_ARGS__) << LOGGER_ARG_BITS))
+#define _LOGGER_ARG_TYPES_9(x, ...) (_LOGGER_ARG_TYPES_1(x) | (_LOGGER_ARG_TYPES_8(__VA_ARGS__) << LOGGER_ARG_BITS))
+#define _LOGGER_ARG_TYPES_10(x, ...) (_LOGGER_ARG_TYPES_1(x) | (_LOGGER_ARG_TYPES_9(__VA_ARGS__) << LOGGER_ARG_BITS))
+#endif // LOGGER_TOKENIZED
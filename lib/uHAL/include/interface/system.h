@@ -110,6 +110,27 @@ void platform_reset(void);
 void pre_reset_hook(void);
 /// @}
 
+#if uHAL_RETAINED_MEMORY_BYTES > 0 || __HAVE_DOXYGEN__
+///
+/// @name Retained Memory Interface
+/// @{
+//
+///
+/// Get the block of RAM which is left alone by the startup code.
+///
+/// The block is @c uHAL_RETAINED_MEMORY_BYTES long and keeps its contents
+/// across any reset which doesn't cut power to the RAM, such as a watchdog
+/// timeout or platform_reset(). The contents are undefined after power-up so
+/// they need to be validated before use.
+///
+/// @note
+/// This is only available when @c uHAL_RETAINED_MEMORY_BYTES > 0.
+///
+/// @returns A pointer to the block, aligned to at least 8 bytes.
+void* get_retained_memory(void);
+/// @}
+#endif
+
 ///
 /// @name Sleep Interface
 /// @{
@@ -80,6 +80,8 @@ err_t uart_on(const uart_port_t *port);
 ///
 /// Turn a UART peripheral off.
 ///
+/// Any queued output is sent first, waiting up to @c UART_COMM_TIMEOUT_MS.
+///
 /// @param port The handle used to manage the port.
 ///  If the serial interface is enabled, passing NULL as the port will act on that.
 ///  Otherwise this must not be NULL.
@@ -119,6 +121,10 @@ err_t uart_receive_block(uart_port_t *port, uint8_t *buffer, txsize_t size, utim
 ///
 /// Transmit a block of data
 ///
+/// If @c UART_OUTPUT_BUFFER_BYTES is non-zero, this returns once the data has
+/// been queued and the transmit interrupt sends it in the background. Use
+/// uart_flush() to wait for it to finish.
+///
 /// @param port The handle used to manage the port.
 ///  If the serial interface is enabled, passing NULL as the port will act on that.
 ///  Otherwise this must not be NULL.
@@ -133,6 +139,23 @@ err_t uart_receive_block(uart_port_t *port, uint8_t *buffer, txsize_t size, utim
 ///  the nature of the problem encountered.
 err_t uart_transmit_block(uart_port_t *port, const uint8_t *buffer, txsize_t size, utime_t timeout);
 
+///
+/// Wait until all queued output has been sent.
+///
+/// This needs to be done before anything that stops the peripheral clock, such
+/// as deep sleep. hibernate_s() and hibernate() take care of it for the serial
+/// interface, and uart_off() takes care of it for the port being turned off.
+///
+/// @param port The handle used to manage the port.
+///  If the serial interface is enabled, passing NULL as the port will act on that.
+///  Otherwise this must not be NULL.
+/// @param timeout Abort if the operation takes more than this many milliseconds.
+///  Must be > 0.
+///
+/// @returns ERR_OK if successful, otherwise an error code indicating
+///  the nature of the problem encountered.
+err_t uart_flush(const uart_port_t *port, utime_t timeout);
+
 #if ENABLE_UART_LISTENING || __HAVE_DOXYGEN__
 ///
 /// Turn the UART receive interrupt on.
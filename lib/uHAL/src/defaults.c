@@ -72,7 +72,20 @@ void pre_hibernate_hook_caller(utime_t *s, sleep_mode_t *sleep_mode, uHAL_flags_
 		LOGGER("%s %s sleep mode for unknown time", type, mode);
 	}
 # endif
-	return pre_hibernate_hook(s, sleep_mode, flags);
+	pre_hibernate_hook(s, sleep_mode, flags);
+# if uHAL_USE_POWER_MANAGER
+	// Anything left on for the rest of the wake can go off now
+	power_down_idle();
+# endif
+# if uHAL_USE_UART_COMM && UART_OUTPUT_BUFFER_BYTES > 0
+	// The UART clock stops in deep sleep, which would cut off anything still
+	// being sent
+	if (uHAL_CHECK_STATUS(uHAL_FLAG_SERIAL_IS_UP)) {
+		uart_flush(UART_COMM_PORT, UART_COMM_TIMEOUT_MS);
+	}
+# endif
+
+	return;
 }
 __attribute__((weak))
 void post_hibernate_hook(utime_t s, sleep_mode_t sleep_mode, uHAL_flags_t flags) {
@@ -27,11 +27,28 @@
 
 #include "ulib/include/time.h"
 
+#include <string.h>
+
 
 #define ROWS_PER_PAGE 8U
 #define COLS_PER_PAGE 128U
 #define PAGES_PER_BANK 8U
 #define I2C_TIMEOUT 1000U
+//
+// The size of the buffer used to send fills to the device
+#define FILL_CHUNK_BYTES 16U
+//
+// The approximate number of bytes needed to set up a separate write to the
+// device; when flushing the framebuffer, neighboring pages are sent together
+// if that costs fewer bytes than sending them separately
+#define FLUSH_SPAN_OVERHEAD 11U
+
+#if SSD1306_FRAMEBUFFER_BYTES > (COLS_PER_PAGE * PAGES_PER_BANK)
+# error "SSD1306_FRAMEBUFFER_BYTES must be <= 1024"
+#endif
+#if SSD1306_MAX_PAGES != PAGES_PER_BANK
+# error "SSD1306_MAX_PAGES must be the same as PAGES_PER_BANK"
+#endif
 
 #if SSD1306_FONT_WIDTH > 0
 typedef union {
@@ -211,6 +228,11 @@ static const ssd1306_font_t *font_default = &_font_default;
 //
 //#define VALID_CFG(_cfg_) (((_cfg_) != NULL) && ((_cfg_)->width > 0) && ((_cfg_)->height > 0) && (BIT_IS_SET((_cfg_)->flags, SSD1306_CFG_FLAG_SPI|SSD1306_CFG_FLAG_I2C)))
 #define VALID_CFG(_cfg_) (((_cfg_) != NULL) && ((_cfg_)->width > 0) && ((_cfg_)->height > 0) && (BIT_IS_SET((_cfg_)->flags, SSD1306_CFG_FLAG_I2C)))
+#if SSD1306_FRAMEBUFFER_BYTES > 0
+# define VALID_FB_CFG(_cfg_) (((uint_fast16_t )(_cfg_)->width * ((_cfg_)->height / ROWS_PER_PAGE)) <= SSD1306_FRAMEBUFFER_BYTES)
+#else
+# define VALID_FB_CFG(_cfg_) (true)
+#endif
 #define VALID_INIT(_handle_) (((_handle_) != NULL) && ((_handle_)->cfg != NULL) && BIT_IS_SET((_handle_)->flags, SSD1306_STATUS_FLAG_INITIALIZED))
 #if SSD1306_FONT_WIDTH <= 0
 # define VALID_FONT(_font_) (((_font_) != NULL) && ((_font_)->glyphs != NULL) && ((_font_)->glyph_width > 0))
@@ -248,19 +270,79 @@ static const ssd1306_font_t *font_default = &_font_default;
 		CHECK_INVALID_INIT(_handle_); \
 	} while (0);
 
-static err_t set_position(const ssd1306_handle_t *handle, uint8_t x_pixel, uint8_t y_row) {
+//
+// Set the area written to by following data; once the last column of a page
+// is reached, writing continues from the first column of the next page
+static err_t set_window(const ssd1306_handle_t *handle, uint8_t x_first, uint8_t x_last, uint8_t y_first, uint8_t y_last) {
 	const uint8_t cmd_pos[] = {
 		SSD1306_CTRL_CMD_BATCH,
 		SSD1306_CMD_COL_RANGE,
-		x_pixel,
-		handle->cfg->width-1,
+		x_first,
+		x_last,
 		SSD1306_CMD_PAGE_RANGE,
-		y_row,
-		(handle->cfg->height/ROWS_PER_PAGE)-1,
+		y_first,
+		y_last,
 	};
 
 	return i2c_transmit_block(handle->cfg->access.address, cmd_pos, sizeof(cmd_pos), I2C_TIMEOUT);
 }
+#if SSD1306_FRAMEBUFFER_BYTES <= 0
+static err_t set_position(const ssd1306_handle_t *handle, uint8_t x_pixel, uint8_t y_row) {
+	return set_window(handle, x_pixel, handle->cfg->width-1, y_row, (handle->cfg->height/ROWS_PER_PAGE)-1);
+}
+#endif
+
+#if SSD1306_FRAMEBUFFER_BYTES > 0
+static bool is_dirty(const ssd1306_handle_t *handle, uint8_t page) {
+	return (handle->dirty_last[page] >= handle->dirty_first[page]);
+}
+static void mark_clean(ssd1306_handle_t *handle, uint8_t page) {
+	handle->dirty_first[page] = 0xFFU;
+	handle->dirty_last[page] = 0;
+
+	return;
+}
+static void mark_dirty(ssd1306_handle_t *handle, uint8_t page, uint8_t x_first, uint8_t x_last) {
+	if (!is_dirty(handle, page)) {
+		handle->dirty_first[page] = x_first;
+		handle->dirty_last[page] = x_last;
+	} else {
+		handle->dirty_first[page] = MIN(handle->dirty_first[page], x_first);
+		handle->dirty_last[page] = MAX(handle->dirty_last[page], x_last);
+	}
+
+	return;
+}
+//
+// Send a rectangle of the framebuffer to the device in one transaction
+static err_t flush_window(const ssd1306_handle_t *handle, uint8_t x_first, uint8_t x_last, uint8_t y_first, uint8_t y_last) {
+	err_t res;
+	const uint8_t mode = SSD1306_CTRL_DATA_BATCH;
+	txsize_t width = (txsize_t )(x_last - x_first) + 1U;
+
+	if ((res = set_window(handle, x_first, x_last, y_first, y_last)) != ERR_OK) {
+		return res;
+	}
+
+	if ((res = i2c_transmit_block_begin(handle->cfg->access.address, I2C_TIMEOUT)) != ERR_OK) {
+		goto I2C_END;
+	}
+	if ((res = i2c_transmit_block_continue(&mode, 1, I2C_TIMEOUT)) != ERR_OK) {
+		goto I2C_END;
+	}
+	for (uint8_t page = y_first; page <= y_last; ++page) {
+		const uint8_t *fb = &handle->framebuffer[((uint_fast16_t )page * handle->cfg->width) + x_first];
+
+		if ((res = i2c_transmit_block_continue(fb, width, I2C_TIMEOUT)) != ERR_OK) {
+			goto I2C_END;
+		}
+	}
+
+I2C_END:
+	i2c_transmit_block_end();
+	return res;
+}
+#endif // SSD1306_FRAMEBUFFER_BYTES > 0
 
 err_t ssd1306_init(ssd1306_handle_t *handle, const ssd1306_cfg_t *cfg) {
 	err_t res;
@@ -316,10 +398,11 @@ err_t ssd1306_init(ssd1306_handle_t *handle, const ssd1306_cfg_t *cfg) {
 
 	uHAL_assert(handle != NULL);
 	uHAL_assert(VALID_CFG(cfg));
+	uHAL_assert(VALID_FB_CFG(cfg));
 #if ! uHAL_SKIP_INIT_CHECKS
 #endif
 #if ! uHAL_SKIP_INVALID_ARG_CHECKS
-	if (!VALID_CFG(cfg) || (handle == NULL)) {
+	if (!VALID_CFG(cfg) || !VALID_FB_CFG(cfg) || (handle == NULL)) {
 		return ERR_BADARG;
 	}
 #endif
@@ -394,7 +477,15 @@ I2C_END:
 	handle->flags = SSD1306_STATUS_FLAG_INITIALIZED | SSD1306_STATUS_FLAG_DISPLAY_ON;
 	handle->contrast = SSD1306_CMD_CONTRAST_DEFAULT;
 
+#if SSD1306_FRAMEBUFFER_BYTES > 0
+	for (uint8_t page = 0; page < SSD1306_MAX_PAGES; ++page) {
+		mark_clean(handle, page);
+	}
+	ssd1306_clear_display(handle);
+	ssd1306_flush(handle);
+#else
 	ssd1306_clear_display(handle);
+#endif
 
 	// It takes ~100ms for the power to come up
 	sleep_ms(100);
@@ -403,12 +494,61 @@ END:
 	return res;
 }
 
-err_t ssd1306_fill_section(const ssd1306_handle_t *handle, uint8_t byte, uint8_t xp, uint8_t wp, uint8_t yp, uint8_t hp) {
+err_t ssd1306_flush(ssd1306_handle_t *handle) {
+#if SSD1306_FRAMEBUFFER_BYTES > 0
 	err_t res;
-	const uint8_t mode = SSD1306_CTRL_DATA_BATCH;
+	uint8_t pages;
 
 	CHECK_STD_ARGS(handle);
 
+	pages = handle->cfg->height / ROWS_PER_PAGE;
+	for (uint8_t page = 0; page < pages;) {
+		uint8_t first, last, end;
+		uint_fast16_t separate_bytes;
+
+		if (!is_dirty(handle, page)) {
+			++page;
+			continue;
+		}
+
+		// Extend the window over the following changed pages as long as
+		// re-sending their unchanged columns costs less than starting over
+		first = handle->dirty_first[page];
+		last = handle->dirty_last[page];
+		separate_bytes = (last - first) + 1U;
+		for (end = page + 1U; (end < pages) && is_dirty(handle, end); ++end) {
+			uint8_t new_first = MIN(first, handle->dirty_first[end]);
+			uint8_t new_last = MAX(last, handle->dirty_last[end]);
+			uint_fast16_t merged_bytes = (uint_fast16_t )((new_last - new_first) + 1U) * ((end - page) + 1U);
+
+			separate_bytes += (handle->dirty_last[end] - handle->dirty_first[end]) + 1U + FLUSH_SPAN_OVERHEAD;
+			if (merged_bytes > separate_bytes) {
+				break;
+			}
+			first = new_first;
+			last = new_last;
+		}
+
+		if ((res = flush_window(handle, first, last, page, end - 1U)) != ERR_OK) {
+			return res;
+		}
+		for (; page < end; ++page) {
+			mark_clean(handle, page);
+		}
+	}
+
+	return ERR_OK;
+
+#else // !SSD1306_FRAMEBUFFER_BYTES > 0
+	UNUSED(handle);
+
+	return ERR_OK;
+#endif // SSD1306_FRAMEBUFFER_BYTES > 0
+}
+
+err_t ssd1306_fill_section(ssd1306_handle_t *handle, uint8_t byte, uint8_t xp, uint8_t wp, uint8_t yp, uint8_t hp) {
+	CHECK_STD_ARGS(handle);
+
 #if ! uHAL_SKIP_INVALID_ARG_CHECKS
 	if ((xp >= handle->cfg->width) || (yp >= handle->cfg->height) || (xp + wp > handle->cfg->width) || (yp + hp > handle->cfg->height)) {
 		return ERR_BADARG;
@@ -424,8 +564,27 @@ err_t ssd1306_fill_section(const ssd1306_handle_t *handle, uint8_t byte, uint8_t
 	// yp/hp are the position in 8-bit high rows instead of pixels after this point
 	yp /= ROWS_PER_PAGE;
 	hp /= ROWS_PER_PAGE;
+	if (hp == 0) {
+		return ERR_OK;
+	}
+
+#if SSD1306_FRAMEBUFFER_BYTES > 0
+	for (uint8_t page = yp; page < (yp + hp); ++page) {
+		mem_init(&handle->framebuffer[((uint_fast16_t )page * handle->cfg->width) + xp], byte, wp);
+		mark_dirty(handle, page, xp, (xp + wp) - 1U);
+	}
 
-	if ((res = set_position(handle, xp, yp)) != ERR_OK) {
+	return ERR_OK;
+
+#else // !SSD1306_FRAMEBUFFER_BYTES > 0
+	err_t res;
+	const uint8_t mode = SSD1306_CTRL_DATA_BATCH;
+	uint8_t chunk[FILL_CHUNK_BYTES];
+	uint_fast16_t left = (uint_fast16_t )wp * hp;
+
+	// The window wraps to the start of the section at the end of each page
+	// so the whole thing can be sent as one block
+	if ((res = set_window(handle, xp, (xp + wp) - 1U, yp, (yp + hp) - 1U)) != ERR_OK) {
 		return res;
 	}
 
@@ -437,17 +596,20 @@ err_t ssd1306_fill_section(const ssd1306_handle_t *handle, uint8_t byte, uint8_t
 		goto I2C_END;
 	}
 
-	for (uint8_t y_i = 0; y_i < hp; ++y_i) {
-		for (uint8_t x_i = 0; x_i < wp; ++x_i) {
-			if ((res = i2c_transmit_block_continue(&byte, 1, I2C_TIMEOUT)) != ERR_OK) {
-				goto I2C_END;
-			}
+	mem_init(chunk, byte, sizeof(chunk));
+	while (left > 0) {
+		txsize_t n = (txsize_t )MIN(left, sizeof(chunk));
+
+		if ((res = i2c_transmit_block_continue(chunk, n, I2C_TIMEOUT)) != ERR_OK) {
+			goto I2C_END;
 		}
+		left -= n;
 	}
 
 I2C_END:
 	i2c_transmit_block_end();
 	return res;
+#endif // SSD1306_FRAMEBUFFER_BYTES > 0
 }
 err_t ssd1306_clear_display(ssd1306_handle_t *handle) {
 	return ssd1306_fill_section(handle, 0x00, 0, 0, 0, 0);
@@ -604,9 +766,11 @@ static err_t _ssd1306_draw_text_scaled(ssd1306_handle_t *handle, const ssd1306_f
 	err_t res = ERR_OK;
 	uint8_t max_x, max_y;
 
+#if SSD1306_FRAMEBUFFER_BYTES <= 0
 	const uint8_t cmd[] = {
 		SSD1306_CTRL_DATA_BATCH,
 	};
+#endif
 
 	max_x = (handle->cfg->width / GLYPH_WIDTH(font));
 	max_y = (handle->cfg->height / ROWS_PER_PAGE);
@@ -624,6 +788,11 @@ static err_t _ssd1306_draw_text_scaled(ssd1306_handle_t *handle, const ssd1306_f
 	max_x -= xt;
 	max_x /= scale_x;
 	for (uiter_t row = 0; (row < scale_y) && (yt < max_y); ++row, ++yt) {
+#if SSD1306_FRAMEBUFFER_BYTES > 0
+		uint8_t x_first = xt * GLYPH_WIDTH(font);
+		uint8_t *fb_start = &handle->framebuffer[((uint_fast16_t )yt * handle->cfg->width) + x_first];
+		uint8_t *fb = fb_start;
+#else
 		if ((res = set_position(handle, xt * GLYPH_WIDTH(font), yt)) != ERR_OK) {
 			return res;
 		}
@@ -634,6 +803,7 @@ static err_t _ssd1306_draw_text_scaled(ssd1306_handle_t *handle, const ssd1306_f
 		if ((res = i2c_transmit_block_continue(cmd, sizeof(cmd), I2C_TIMEOUT)) != ERR_OK) {
 			goto I2C_END;
 		}
+#endif
 
 		for (uiter_t i = 0; ((text[i] != 0) && (i < max_x)); ++i) {
 			uint8_t c = text[i];
@@ -688,19 +858,32 @@ static err_t _ssd1306_draw_text_scaled(ssd1306_handle_t *handle, const ssd1306_f
 					break;
 				}
 
+#if SSD1306_FRAMEBUFFER_BYTES > 0
+				mem_init(fb, glyph_line, scale_x);
+				fb += scale_x;
+#else
 				for (uiter_t col = 0; col < scale_x; ++col) {
 					if ((res = i2c_transmit_block_continue(&glyph_line, 1, I2C_TIMEOUT)) != ERR_OK) {
 						goto I2C_END;
 					}
 				}
+#endif
 			}
 		}
 
+#if SSD1306_FRAMEBUFFER_BYTES > 0
+		if (fb != fb_start) {
+			mark_dirty(handle, yt, x_first, (x_first + (uint8_t )(fb - fb_start)) - 1U);
+		}
+#else
 		i2c_transmit_block_end();
+#endif
 	}
 
+#if SSD1306_FRAMEBUFFER_BYTES <= 0
 I2C_END:
 	i2c_transmit_block_end();
+#endif
 
 	return res;
 }
@@ -730,12 +913,14 @@ err_t ssd1306_draw_text_scaled(ssd1306_handle_t *handle, const ssd1306_font_t *f
 }
 
 err_t ssd1306_draw_text(ssd1306_handle_t *handle, const ssd1306_font_t *font, uint8_t xt, uint8_t yt, const char *text) {
-	err_t res;
 	uint8_t max_x;
 
+#if SSD1306_FRAMEBUFFER_BYTES <= 0
+	err_t res;
 	const uint8_t cmd[] = {
 		SSD1306_CTRL_DATA_BATCH,
 	};
+#endif
 
 	if (SSD1306_INCLUDE_DEFAULT_FONT && font == NULL) {
 		font = font_default;
@@ -769,6 +954,34 @@ err_t ssd1306_draw_text(ssd1306_handle_t *handle, const ssd1306_font_t *font, ui
 #endif
 
 	max_x -= xt;
+#if SSD1306_FRAMEBUFFER_BYTES > 0
+	uint8_t x_first = xt * GLYPH_WIDTH(font);
+	uint8_t *fb = &handle->framebuffer[((uint_fast16_t )yt * handle->cfg->width) + x_first];
+	uiter_t i;
+
+	for (i = 0; ((text[i] != 0) && (i < max_x)); ++i) {
+		uint8_t c = text[i];
+
+		if ((c < font->char_min) || (c > font->char_max)) {
+			c = font->char_sub;
+		} else {
+			c += font->char_offset;
+		}
+# if SSD1306_FONT_WIDTH <= 0
+		memcpy(fb, &font->glyphs[c * GLYPH_WIDTH(font)], GLYPH_WIDTH(font));
+# else
+		font_access_t acc = { .ptr = font->glyphs };
+		memcpy(fb, acc.arr[c], SSD1306_FONT_WIDTH);
+# endif
+		fb += GLYPH_WIDTH(font);
+	}
+	if (i > 0) {
+		mark_dirty(handle, yt, x_first, (x_first + (i * GLYPH_WIDTH(font))) - 1U);
+	}
+
+	return ERR_OK;
+
+#else // !SSD1306_FRAMEBUFFER_BYTES > 0
 	if ((res = set_position(handle, xt * GLYPH_WIDTH(font), yt)) != ERR_OK) {
 		return res;
 	}
@@ -802,6 +1015,7 @@ I2C_END:
 	i2c_transmit_block_end();
 
 	return res;
+#endif // SSD1306_FRAMEBUFFER_BYTES > 0
 }
 
 
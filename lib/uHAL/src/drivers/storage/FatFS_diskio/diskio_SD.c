@@ -25,6 +25,7 @@
 #if uHAL_USE_FATFS_SD
 
 #include "diskio_SD.h"
+#include "include/drivers/storage/FatFS_diskio/diskio_SD.h"
 
 #include "ulib/include/time.h"
 
@@ -62,6 +63,21 @@ static volatile DSTATUS drive_status = STA_NOINIT;
 /* Card type flags */
 static BYTE drive_type;
 
+#if FF_FS_READONLY == 0
+/*
+* A CMD25 stream is left open after disk_write() returns so that a following
+* write to the next sector can continue it instead of starting a new command.
+* Anything else that talks to the card closes it first.
+*/
+static bool stream_open;
+/* Next sector the open stream will write to, in the card's addressing units */
+static DWORD stream_next_sect;
+/* Sector following the last single-sector write, used to detect sequential writes */
+static DWORD single_next_sect = (DWORD )-1;
+/* Number of sectors to pre-erase when the next stream is opened */
+static UINT write_hint;
+#endif
+
 
 /*-----------------------------------------------------------------------*/
 /* SPI controls (Platform dependent)                                     */
@@ -100,8 +116,9 @@ static BYTE xchg_spi (BYTE tx) {
 /*
 * buf: Pointer to data buffer
 * btr: Number of bytes to receive
+* 1:OK, 0:Failed
 */
-static void rx_spi_multi (BYTE *buf, UINT btr) {
+static int rx_spi_multi (BYTE *buf, UINT btr) {
 	uHAL_assert(buf != NULL);
 	uHAL_assert(btr > 0);
 
@@ -114,11 +131,8 @@ static void rx_spi_multi (BYTE *buf, UINT btr) {
 	}
 	*/
 
-	// TODO: Check the return value and propagate errors
 	// SD cards expect MOSI to be held high while they send data
-	spi_receive_block(buf, btr, 0xFF, 1000);
-
-	return;
+	return (spi_receive_block(buf, btr, 0xFF, 1000) == ERR_OK);
 }
 
 #if FF_FS_READONLY == 0
@@ -126,8 +140,9 @@ static void rx_spi_multi (BYTE *buf, UINT btr) {
 /*
 * buf: Pointer to the data
 * btx: Number of bytes to send
+* 1:OK, 0:Failed
 */
-static void tx_spi_multi (const BYTE *buf, UINT btx) {
+static int tx_spi_multi (const BYTE *buf, UINT btx) {
 	uHAL_assert(buf != NULL);
 	uHAL_assert(btx > 0);
 
@@ -142,10 +157,7 @@ static void tx_spi_multi (const BYTE *buf, UINT btx) {
 	}
 	*/
 
-	// FIXME: Check the return value and propagate errors
-	spi_transmit_block(buf, btx, 1000);
-
-	return;
+	return (spi_transmit_block(buf, btx, 1000) == ERR_OK);
 }
 #endif
 
@@ -227,7 +239,9 @@ static int rx_datablock (BYTE *buf, UINT btr) {
 		return 0;
 	}
 
-	rx_spi_multi(buf, btr); /* Store trailing data to the buffer */
+	if (!rx_spi_multi(buf, btr)) { /* Store trailing data to the buffer */
+		return 0;
+	}
 	xchg_spi(0xFF); xchg_spi(0xFF); /* Discard CRC */
 
 	return 1; /* Function succeeded */
@@ -245,7 +259,7 @@ static int rx_datablock (BYTE *buf, UINT btr) {
 static int tx_datablock (const BYTE *buf, BYTE token) {
 	BYTE resp;
 
-	uHAL_assert(buf != NULL);
+	uHAL_assert(buf != NULL || token == 0xFD);
 
 	/* Wait for card ready */
 	if (!wait_ready(500)) {
@@ -254,7 +268,9 @@ static int tx_datablock (const BYTE *buf, BYTE token) {
 
 	xchg_spi(token); /* Send token */
 	if (token != 0xFD) { /* Send data if token is other than StopTran */
-		tx_spi_multi(buf, 512); /* Data */
+		if (!tx_spi_multi(buf, 512)) { /* Data */
+			return 0;
+		}
 		xchg_spi(0xFF); xchg_spi(0xFF); /* Dummy CRC */
 
 		resp = xchg_spi(0xFF); /* Receive data resp */
@@ -264,6 +280,49 @@ static int tx_datablock (const BYTE *buf, BYTE token) {
 	}
 	return 1;
 }
+
+/*-----------------------------------------------------------------------*/
+/* Finish an open multiple block write                                   */
+/*-----------------------------------------------------------------------*/
+/*
+* 1:OK or nothing to do, 0:Failed
+*/
+static int close_stream (void) {
+	int res;
+
+	if (!stream_open) {
+		return 1;
+	}
+	stream_open = false;
+
+	res = tx_datablock(0, 0xFD); /* STOP_TRAN token */
+	deselect_drive();
+
+	return res;
+}
+
+/*-----------------------------------------------------------------------*/
+/* Forget about any open multiple block write                            */
+/*-----------------------------------------------------------------------*/
+/*
+* Used when the card has been (or is about to be) power cycled and so has
+* already forgotten the stream itself; sending it STOP_TRAN now would only
+* confuse it.
+*/
+static void drop_stream (void) {
+	stream_open = false;
+	single_next_sect = (DWORD )-1;
+	write_hint = 0;
+
+	return;
+}
+#else
+static int close_stream (void) {
+	return 1;
+}
+static void drop_stream (void) {
+	return;
+}
 #endif
 
 /*-----------------------------------------------------------------------*/
@@ -277,6 +336,9 @@ static int tx_datablock (const BYTE *buf, BYTE token) {
 static BYTE send_cmd (BYTE cmd, DWORD arg) {
 	BYTE n, res;
 
+	/* Any command ends an open multiple block write */
+	close_stream();
+
 	/* Send a CMD55 prior to ACMD<n> */
 	if (cmd & 0x80) {
 		cmd &= 0x7F;
@@ -363,6 +425,9 @@ DSTATUS disk_initialize (BYTE lun) {
 		return drive_status;
 	}
 
+	/* Whatever was going on before, the card is starting over */
+	drop_stream();
+
 	/* Send 80 dummy clocks */
 	for (n = 10; n; n--) {
 		xchg_spi(0xFF);
@@ -530,30 +595,75 @@ DRESULT disk_write (BYTE lun, const BYTE *buf, LBA_t sector, UINT count) {
 		sect *= 512;
 	}
 
-	if (count == 1) { /* Single sector write */
+	/*
+	* Continue an open stream if this picks up where it left off. Otherwise use
+	* CMD24 for lone sectors and start a new stream for runs of sectors or when
+	* single-sector writes are coming in sequentially.
+	*/
+	if (stream_open && sect == stream_next_sect) {
+		/* Keep going */
+	} else if (count == 1 && sect != single_next_sect) { /* Single sector write */
+		close_stream();
+		single_next_sect = sect + ((drive_type & CT_BLOCK) ? 1 : 512);
 		if ((send_cmd(CMD24, sect) == 0) && tx_datablock(buf, 0xFE)) { /* WRITE_BLOCK */
 			count = 0;
 		}
+		deselect_drive();
+
+		return count ? RES_ERROR : RES_OK; /* Return result */
 	} else { /* Multiple sector write */
-		if (drive_type & CT_SDC) send_cmd(ACMD23, count); /* Predefine number of sectors */
-		if (send_cmd(CMD25, sect) == 0) { /* WRITE_MULTIPLE_BLOCK */
-			do {
-				if (!tx_datablock(buf, 0xFC)){
-					break;
-				}
-				buf += 512;
-			} while (--count);
-			if (!tx_datablock(0, 0xFD)) { /* STOP_TRAN token */
-				count = 1;
-			}
+		if (!close_stream()) {
+			return RES_ERROR;
+		}
+		if (drive_type & CT_SDC) { /* Predefine number of sectors */
+			send_cmd(ACMD23, (write_hint > count) ? write_hint : count);
 		}
+		write_hint = 0;
+		if (send_cmd(CMD25, sect) != 0) { /* WRITE_MULTIPLE_BLOCK */
+			deselect_drive();
+			return RES_ERROR;
+		}
+		stream_open = true;
 	}
-	deselect_drive();
 
-	return count ? RES_ERROR : RES_OK; /* Return result */
+	single_next_sect = (DWORD )-1;
+	stream_next_sect = sect;
+	do {
+		if (!tx_datablock(buf, 0xFC)){
+			break;
+		}
+		buf += 512;
+		stream_next_sect += (drive_type & CT_BLOCK) ? 1 : 512;
+	} while (--count);
+
+	if (count != 0) {
+		close_stream();
+		return RES_ERROR;
+	}
+	return RES_OK;
+}
+
+void diskio_SD_set_write_hint(uint_fast16_t sectors) {
+	write_hint = (UINT )sectors;
+	return;
+}
+#else
+void diskio_SD_set_write_hint(uint_fast16_t sectors) {
+	UNUSED(sectors);
+	return;
 }
 #endif
 
+void diskio_SD_power_off(void) {
+	if (!(drive_status & STA_NOINIT)) {
+		close_stream();
+	}
+	drop_stream();
+	drive_status |= STA_NOINIT;
+
+	return;
+}
+
 
 /*-----------------------------------------------------------------------*/
 /* Miscellaneous drive controls other than data read/write               */
@@ -581,6 +691,10 @@ DRESULT disk_ioctl (BYTE lun, BYTE cmd, void *buf) {
 	if (drive_status & STA_NOINIT) {
 		return RES_NOTRDY;
 	}
+	/* Everything here either talks to the card or expects writes to be finished */
+	if (!close_stream()) {
+		return RES_ERROR;
+	}
 	res = RES_ERROR;
 
 	// check buf on a case-by-case basis because not all ioctls use it.
@@ -710,28 +824,5 @@ DRESULT disk_ioctl (BYTE lun, BYTE cmd, void *buf) {
 
 	return res;
 }
-//
-// http:// www.elm-chan.org/fsw/ff/doc/fattime.html
-DWORD get_fattime (void) {
-	uint32_t fatnow;
-	datetime_t dt;
-
-	get_RTC_datetime(&dt);
-
-	// bit31:25 Year origin from the 1980 (0..127, e.g. 37 for 2017)
-	fatnow = (uint32_t )((uint32_t )dt.year - 1980U) << 25U;
-	// bit24:21 Month (1..12)
-	fatnow |= (uint32_t )dt.month << 21U;
-	// bit20:16 Day of the month (1..31)
-	fatnow |= (uint32_t )dt.day << 16U;
-	// bit15:11 Hour (0..23)
-	fatnow |= (uint32_t )dt.hour << 11U;
-	// bit10:5 Minute (0..59)
-	fatnow |= (uint32_t )dt.minute << 5U;
-	// bit4:0 Second / 2 (0..29, e.g. 25 for 50) 
-	fatnow |= (uint32_t )(dt.second/2U);
-
-	return fatnow;
-}
 
 #endif // uHAL_USE_FATFS_SD
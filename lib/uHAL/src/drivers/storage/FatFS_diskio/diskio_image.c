@@ -0,0 +1,376 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// diskio_image.c
+// FatFS driver backed by a raw disk image file
+// NOTES:
+//   pread()/pwrite() are used rather than mmap() so that every access goes
+//   through one place where it can be counted and so that a short image
+//   shows up as an I/O error rather than a SIGBUS.
+//
+//   The volume layout is read once when the drive is initialized and used
+//   to sort accessed sectors into regions. It isn't updated if the volume
+//   is reformatted while mounted.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include "common.h"
+
+#if uHAL_USE_FATFS_IMAGE
+
+#include FATFS_FF_H_PATH
+#include FATFS_DISKIO_H_PATH
+#include "include/drivers/storage/FatFS_diskio/diskio_image.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SECTOR_BYTES 512U
+
+typedef struct {
+	LBA_t fat_start;
+	LBA_t dir_start;
+	LBA_t dir_end;
+	LBA_t data_start;
+	LBA_t vol_start;
+} layout_t;
+
+static DSTATUS drive_status = STA_NOINIT;
+static int image_fd = -1;
+static LBA_t image_sectors;
+static layout_t layout;
+static diskio_image_stats_t stats;
+
+
+static uint_fast16_t get_word(const BYTE *b) {
+	return (uint_fast16_t )b[0] | ((uint_fast16_t )b[1] << 8);
+}
+static uint32_t get_dword(const BYTE *b) {
+	return (uint32_t )get_word(b) | ((uint32_t )get_word(&b[2]) << 16);
+}
+//
+// Check whether a sector looks like a FAT boot sector
+static bool is_fat_vbr(const BYTE *b) {
+	return ((b[0] == 0xEBU) || (b[0] == 0xE9U) || (b[0] == 0xE8U)) &&
+	       (get_word(&b[11]) == SECTOR_BYTES) && (b[13] != 0) &&
+	       (get_word(&b[14]) != 0) && ((b[16] == 1) || (b[16] == 2));
+}
+static bool read_image(BYTE *buf, LBA_t sector, UINT count) {
+	size_t bytes = (size_t )count * SECTOR_BYTES;
+	off_t off = (off_t )sector * SECTOR_BYTES;
+
+	while (bytes > 0) {
+		ssize_t r = pread(image_fd, buf, bytes, off);
+
+		if (r <= 0) {
+			return false;
+		}
+		buf += r;
+		off += r;
+		bytes -= (size_t )r;
+	}
+
+	return true;
+}
+static bool write_image(const BYTE *buf, LBA_t sector, UINT count) {
+	size_t bytes = (size_t )count * SECTOR_BYTES;
+	off_t off = (off_t )sector * SECTOR_BYTES;
+
+	while (bytes > 0) {
+		ssize_t r = pwrite(image_fd, buf, bytes, off);
+
+		if (r <= 0) {
+			return false;
+		}
+		buf += r;
+		off += r;
+		bytes -= (size_t )r;
+	}
+
+	return true;
+}
+//
+// Find the FAT volume and work out where its regions are
+// This follows what FatFS does when FF_MULTI_PARTITION is 0: use sector 0 if
+// it's a boot sector, otherwise the first partition in the MBR
+static void read_layout(void) {
+	BYTE b[SECTOR_BYTES];
+	LBA_t vol = 0;
+	uint32_t fat_size, root_entries, root_clus;
+	uint_fast8_t clus_size;
+
+	layout = (layout_t ){ 0 };
+
+	if (!read_image(b, 0, 1) || (get_word(&b[510]) != 0xAA55U)) {
+		return;
+	}
+	if (!is_fat_vbr(b)) {
+		vol = get_dword(&b[446 + 8]);
+		if ((vol == 0) || !read_image(b, vol, 1) || !is_fat_vbr(b)) {
+			return;
+		}
+	}
+
+	clus_size = b[13];
+	root_entries = get_word(&b[17]);
+	fat_size = get_word(&b[22]);
+	if (fat_size == 0) {
+		fat_size = get_dword(&b[36]);
+	}
+
+	layout.vol_start = vol;
+	layout.fat_start = vol + get_word(&b[14]);
+	layout.dir_start = layout.fat_start + ((LBA_t )fat_size * b[16]);
+	if (root_entries != 0) {
+		// FAT12/16 root directory, fixed size and just before the data area
+		layout.dir_end = layout.dir_start + (((root_entries * 32U) + (SECTOR_BYTES - 1U)) / SECTOR_BYTES);
+		layout.data_start = layout.dir_end;
+	} else {
+		// FAT32 root directory, a cluster chain in the data area
+		layout.data_start = layout.dir_start;
+		root_clus = get_dword(&b[44]);
+		layout.dir_start = layout.data_start + ((LBA_t )(root_clus - 2U) * clus_size);
+		layout.dir_end = layout.dir_start + clus_size;
+	}
+
+	return;
+}
+static void count_sectors(LBA_t sector, UINT count, bool write) {
+	for (; count != 0; --count, ++sector) {
+		uint32_t *counter;
+
+		if ((layout.data_start == 0) || (sector < layout.vol_start)) {
+			counter = write ? &stats.data_writes : &stats.data_reads;
+		} else if (sector < layout.fat_start) {
+			counter = write ? &stats.reserved_writes : &stats.reserved_reads;
+		} else if ((sector >= layout.dir_start) && (sector < layout.dir_end)) {
+			counter = write ? &stats.dir_writes : &stats.dir_reads;
+		} else if (sector < layout.data_start) {
+			counter = write ? &stats.fat_writes : &stats.fat_reads;
+		} else {
+			counter = write ? &stats.data_writes : &stats.data_reads;
+		}
+		++(*counter);
+	}
+
+	return;
+}
+
+void diskio_image_get_stats(diskio_image_stats_t *s) {
+	uHAL_assert(s != NULL);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (s == NULL) {
+		return;
+	}
+#endif
+
+	*s = stats;
+
+	return;
+}
+void diskio_image_reset_stats(void) {
+	stats = (diskio_image_stats_t ){ 0 };
+
+	return;
+}
+
+/*-----------------------------------------------------------------------*/
+/* Initialize disk drive                                                 */
+/*-----------------------------------------------------------------------*/
+DSTATUS disk_initialize (BYTE lun) {
+	const char *path;
+	struct stat st;
+
+	UNUSED(lun);
+
+	uHAL_assert(lun == 0);
+
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (lun != 0) {
+		return STA_NOINIT;
+	}
+#endif
+
+	if (image_fd >= 0) {
+		close(image_fd);
+		image_fd = -1;
+	}
+
+	path = getenv("FATFS_IMAGE");
+	if (path == NULL) {
+		path = FATFS_IMAGE_PATH;
+	}
+	image_fd = open(path, O_RDWR);
+	if (image_fd < 0) {
+		drive_status = STA_NOINIT | STA_NODISK;
+		return drive_status;
+	}
+	if ((fstat(image_fd, &st) != 0) || (st.st_size < (off_t )SECTOR_BYTES)) {
+		close(image_fd);
+		image_fd = -1;
+		drive_status = STA_NOINIT;
+		return drive_status;
+	}
+	image_sectors = (LBA_t )(st.st_size / SECTOR_BYTES);
+
+	read_layout();
+	drive_status = 0;
+
+	return drive_status;
+}
+
+/*-----------------------------------------------------------------------*/
+/* Get disk status                                                       */
+/*-----------------------------------------------------------------------*/
+DSTATUS disk_status (BYTE lun) {
+	UNUSED(lun);
+
+	uHAL_assert(lun == 0);
+
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (lun != 0) {
+		return STA_NOINIT;
+	}
+#endif
+
+	return drive_status;
+}
+
+/*-----------------------------------------------------------------------*/
+/* Read sector(s)                                                        */
+/*-----------------------------------------------------------------------*/
+DRESULT disk_read (BYTE lun, BYTE *buf, LBA_t sector, UINT count) {
+	UNUSED(lun);
+
+	uHAL_assert(lun == 0);
+	uHAL_assert(buf != NULL);
+	uHAL_assert(count > 0);
+
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if ((lun != 0) || (buf == NULL) || (count == 0)) {
+		return RES_PARERR;
+	}
+#endif
+
+	if (drive_status & STA_NOINIT) {
+		return RES_NOTRDY;
+	}
+	if ((sector >= image_sectors) || (count > (image_sectors - sector))) {
+		return RES_PARERR;
+	}
+
+	++stats.read_calls;
+	count_sectors(sector, count, false);
+
+	return read_image(buf, sector, count) ? RES_OK : RES_ERROR;
+}
+
+/*-----------------------------------------------------------------------*/
+/* Write sector(s)                                                       */
+/*-----------------------------------------------------------------------*/
+#if FF_FS_READONLY == 0
+DRESULT disk_write (BYTE lun, const BYTE *buf, LBA_t sector, UINT count) {
+	UNUSED(lun);
+
+	uHAL_assert(lun == 0);
+	uHAL_assert(buf != NULL);
+	uHAL_assert(count > 0);
+
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if ((lun != 0) || (buf == NULL) || (count == 0)) {
+		return RES_PARERR;
+	}
+#endif
+
+	if (drive_status & STA_NOINIT) {
+		return RES_NOTRDY;
+	}
+	if ((sector >= image_sectors) || (count > (image_sectors - sector))) {
+		return RES_PARERR;
+	}
+
+	++stats.write_calls;
+	count_sectors(sector, count, true);
+
+	return write_image(buf, sector, count) ? RES_OK : RES_ERROR;
+}
+#endif // FF_FS_READONLY == 0
+
+/*-----------------------------------------------------------------------*/
+/* Miscellaneous drive controls other than data read/write               */
+/*-----------------------------------------------------------------------*/
+DRESULT disk_ioctl (BYTE lun, BYTE cmd, void *buf) {
+	UNUSED(lun);
+
+	uHAL_assert(lun == 0);
+
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (lun != 0) {
+		return RES_PARERR;
+	}
+#endif
+
+	if (drive_status & STA_NOINIT) {
+		return RES_NOTRDY;
+	}
+
+	// check buf on a case-by-case basis because not all ioctls use it.
+	switch (cmd) {
+	case CTRL_SYNC:
+	case CTRL_TRIM:
+		break;
+	default:
+		uHAL_assert(buf != NULL);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+		if (buf == NULL) {
+			return RES_PARERR;
+		}
+#endif
+		break;
+	}
+
+	switch (cmd) {
+	// Writes go straight to the host's page cache, there's nothing to wait
+	// for; just count it
+	case CTRL_SYNC:
+		++stats.sync_calls;
+		return RES_OK;
+
+	case GET_SECTOR_COUNT:
+		*(LBA_t *)buf = image_sectors;
+		return RES_OK;
+
+	// The erase block size of the image is unknown
+	case GET_BLOCK_SIZE:
+		*(DWORD *)buf = 1;
+		return RES_OK;
+
+	case CTRL_TRIM:
+		return RES_OK;
+
+	default:
+		break;
+	}
+
+	return RES_PARERR;
+}
+
+#endif // uHAL_USE_FATFS_IMAGE
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// fattime.c
+// Timestamp source for FatFS
+// NOTES:
+//   This is shared by all the diskio drivers.
+//
+#include "common.h"
+
+#if uHAL_USE_FATFS
+
+#include FATFS_FF_H_PATH
+#include FATFS_DISKIO_H_PATH
+
+#include "ulib/include/time.h"
+
+#if ! FF_FS_NORTC && ! FF_FS_READONLY
+//
+// http:// www.elm-chan.org/fsw/ff/doc/fattime.html
+DWORD get_fattime (void) {
+	uint32_t fatnow;
+	datetime_t dt;
+
+	get_RTC_datetime(&dt);
+
+	// bit31:25 Year origin from the 1980 (0..127, e.g. 37 for 2017)
+	fatnow = (uint32_t )((uint32_t )dt.year - 1980U) << 25U;
+	// bit24:21 Month (1..12)
+	fatnow |= (uint32_t )dt.month << 21U;
+	// bit20:16 Day of the month (1..31)
+	fatnow |= (uint32_t )dt.day << 16U;
+	// bit15:11 Hour (0..23)
+	fatnow |= (uint32_t )dt.hour << 11U;
+	// bit10:5 Minute (0..59)
+	fatnow |= (uint32_t )dt.minute << 5U;
+	// bit4:0 Second / 2 (0..29, e.g. 25 for 50) 
+	fatnow |= (uint32_t )(dt.second/2U);
+
+	return fatnow;
+}
+#endif // ! FF_FS_NORTC && ! FF_FS_READONLY
+
+#endif // uHAL_USE_FATFS
@@ -227,6 +227,28 @@ adc_t adc_read_pin(gpio_pin_t pin) {
 	}
 	return adc_read_channel(channel);
 }
+// There's only a single input multiplexer, so this is no faster than calling
+// adc_read_pin() for each pin
+err_t adc_read_pins(const gpio_pin_t *pins, adc_t *values, uint_fast8_t count) {
+	err_t res = ERR_OK;
+
+	uHAL_assert(pins != NULL);
+	uHAL_assert(values != NULL);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if ((pins == NULL) || (values == NULL)) {
+		return ERR_BADARG;
+	}
+#endif
+
+	for (uiter_t i = 0; i < count; ++i) {
+		values[i] = adc_read_pin(pins[i]);
+		if (values[i] == ERR_ADC) {
+			res = ERR_IO;
+		}
+	}
+
+	return res;
+}
 static adc_t adc_read_channel(uint8_t channel) {
 	adcm_t adc;
 #if ADC_TIMEOUT_MS
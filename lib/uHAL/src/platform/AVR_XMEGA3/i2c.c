@@ -20,6 +20,11 @@
 // i2c.c
 // Manage the I2C peripheral
 // NOTES:
+//   When the transaction queue is used, the transactions are run one byte at
+//   a time from the master interrupt. Smart mode is enabled so reading MDATA
+//   sends the ACK/NACK and starts the next byte, and writing MADDR while we
+//   own the bus sends a repeated start, which is how queued transactions are
+//   chained.
 //
 
 #include "i2c.h"
@@ -29,6 +34,10 @@
 
 #include <avr/io.h>
 #include <avr/power.h>
+#if uHAL_I2C_USE_QUEUE
+# include <avr/interrupt.h>
+# include <avr/sleep.h>
+#endif
 
 
 #if uHAL_USE_I2C
@@ -37,6 +46,7 @@
 // let's do this
 #if PINID(I2C_SCL_PIN) == PINID_I2C0_SCL && PINID(I2C_SDA_PIN) == PINID_I2C0_SDA
 # define TWIx TWI0
+# define TWIx_TWIM_vect TWI0_TWIM_vect
   //DEBUG_CPP_MACRO(TWIx)
   DEBUG_CPP_MSG("TWIx == TWI0")
 #else
@@ -63,6 +73,31 @@
 #define BUFFER_OK(_name_) (_name_ ## _buffer != NULL && _name_ ## _size > 0)
 #define TWIx_INIT_OK(_TWIx_) ((_TWIx_).MBAUD != 0 && BIT_IS_SET((_TWIx_).MCTRLA, TWI_ENABLE_bm) && SELECT_BITS((_TWIx_).MSTATUS, TWI_BUSSTATE_gm) != TWI_BUSSTATE_UNKNOWN_gc)
 
+#if uHAL_I2C_USE_QUEUE
+# define TXN_OK(_txn_) ( \
+	(((_txn_)->tx_size > 0) || ((_txn_)->rx_size > 0)) && \
+	(((_txn_)->tx_size == 0) || ((_txn_)->tx_buffer != NULL)) && \
+	(((_txn_)->rx_size == 0) || ((_txn_)->rx_buffer != NULL)))
+// The queue can only run when its interrupt can preempt whatever is waiting
+// on it
+# define IN_IRQ_CONTEXT() (!BIT_IS_SET(SREG, CPU_I_bm))
+
+static i2c_transaction_t *volatile queue_head = NULL;
+static i2c_transaction_t *queue_tail = NULL;
+// Position in the buffer of the current phase of the running transaction
+static txsize_t queue_pos;
+// Set once the read phase of the running transaction has started
+static bool queue_reading;
+// Set once the device has acknowledged the address
+static bool queue_addressed;
+// Set while i2c_transmit_block_begin() through _end() own the bus
+static bool stream_active = false;
+
+static void start_transaction(void);
+static void abort_queue(err_t res);
+static err_t queue_block(uint8_t addr, const uint8_t *tx_buffer, txsize_t tx_size, uint8_t *rx_buffer, txsize_t rx_size, utime_t timeout);
+#endif // uHAL_I2C_USE_QUEUE
+
 void i2c_init(void) {
 	uint16_t baud_min, baud_max, baud;
 	uint8_t reg;
@@ -150,6 +185,17 @@ err_t i2c_off(void) {
 	}
 #endif
 
+#if uHAL_I2C_USE_QUEUE
+	uint8_t sreg;
+
+	// Anything still queued is being abandoned
+	SAVE_INTERRUPTS(sreg);
+	cli();
+	abort_queue(ERR_INTERRUPT);
+	stream_active = false;
+	RESTORE_INTERRUPTS(sreg);
+#endif
+
 	// This probably isn't needed, the only time it might matter is if the
 	// peripheral is disabled before the stop condition has been fully
 	// broadcast
@@ -190,6 +236,17 @@ err_t i2c_receive_block(uint8_t addr, uint8_t *rx_buffer, txsize_t rx_size, utim
 	}
 #endif
 
+#if uHAL_I2C_USE_QUEUE
+	// With interrupts disabled the queue can't run so fall back to polling
+	// if it's idle
+	if (!IN_IRQ_CONTEXT()) {
+		return queue_block(addr, NULL, 0, rx_buffer, rx_size, timeout);
+	}
+	if ((queue_head != NULL) || stream_active) {
+		return ERR_RETRY;
+	}
+#endif
+
 	timeout = SET_TIMEOUT_MS(timeout);
 
 	// Make sure the bus is ready
@@ -310,6 +367,21 @@ err_t i2c_transmit_block_begin(uint8_t addr, utime_t timeout) {
 	}
 #endif
 
+#if uHAL_I2C_USE_QUEUE
+	if (IN_IRQ_CONTEXT()) {
+		if ((queue_head != NULL) || stream_active) {
+			return ERR_RETRY;
+		}
+	} else {
+		err_t res;
+
+		if ((res = i2c_queue_wait(NULL, timeout)) != ERR_OK) {
+			return res;
+		}
+	}
+	stream_active = true;
+#endif
+
 	timeout = SET_TIMEOUT_MS(timeout);
 
 	return _i2c_transmit_block_begin(addr, timeout);
@@ -379,13 +451,29 @@ err_t i2c_transmit_block_end(void) {
 		TWIx.MCTRLB = TWI_ACKACT_NACK_gc | TWI_MCMD_STOP_gc;
 	}
 
+#if uHAL_I2C_USE_QUEUE
+	uint8_t sreg;
+
+	// Start anything that was queued while we had the bus
+	SAVE_INTERRUPTS(sreg);
+	cli();
+	if (stream_active) {
+		stream_active = false;
+		if (queue_head != NULL) {
+			start_transaction();
+		}
+	}
+	RESTORE_INTERRUPTS(sreg);
+#endif
+
 	return ERR_OK;
 }
 
 // We can save program space just by using an alternative function that uses
 // a new timout for each call instead of a shared timeout, but that's probably
 // not what's normally wanted so only use it when desparate
-#if uHAL_USE_SMALL_CODE
+// The queue needs the full version to hand the transfer off
+#if uHAL_USE_SMALL_CODE && ! uHAL_I2C_USE_QUEUE
 err_t i2c_transmit_block(uint8_t addr, const uint8_t *tx_buffer, txsize_t tx_size, utime_t timeout) {
 	err_t res = ERR_OK;
 
@@ -418,6 +506,17 @@ err_t i2c_transmit_block(uint8_t addr, const uint8_t *tx_buffer, txsize_t tx_siz
 	}
 #endif
 
+#if uHAL_I2C_USE_QUEUE
+	// With interrupts disabled the queue can't run so fall back to polling
+	// if it's idle
+	if (!IN_IRQ_CONTEXT()) {
+		return queue_block(addr, tx_buffer, tx_size, NULL, 0, timeout);
+	}
+	if ((queue_head != NULL) || stream_active) {
+		return ERR_RETRY;
+	}
+#endif
+
 	timeout = SET_TIMEOUT_MS(timeout);
 
 	if ((res = _i2c_transmit_block_begin(addr, timeout)) != ERR_OK) {
@@ -429,7 +528,244 @@ END:
 	_i2c_transmit_block_end();
 	return res;
 }
-#endif // uHAL_USE_SMALL_CODE
+#endif // uHAL_USE_SMALL_CODE && ! uHAL_I2C_USE_QUEUE
+
+
+#if uHAL_I2C_USE_QUEUE
+//
+// The running transaction is always at the head of the queue
+//
+// Start the transaction at the head of the queue
+// If we still own the bus from the last one this sends a repeated start
+static void start_transaction(void) {
+	i2c_transaction_t *txn = queue_head;
+
+	queue_pos = 0;
+	queue_addressed = false;
+	queue_reading = (txn->tx_size == 0);
+
+	SET_BIT(TWIx.MCTRLA, TWI_RIEN_bm|TWI_WIEN_bm);
+	// Setting MADDR resets any bus error flags
+	TWIx.MADDR = (txn->addr << 1U) | ((queue_reading) ? 0x01U : 0x00U);
+
+	return;
+}
+//
+// Report the result of a transaction removed from the queue
+static void report_transaction(i2c_transaction_t *txn, err_t res) {
+	i2c_callback_t cb = txn->callback;
+
+	txn->next = NULL;
+	txn->res = res;
+	txn->busy = false;
+	if (cb != NULL) {
+		cb(res, txn->cb_data);
+	}
+
+	return;
+}
+//
+// Remove the running transaction from the queue and move on to the next one,
+// which follows with a repeated start; the bus is only released when the
+// queue is empty
+// The callback is called last so that it can queue a new transaction
+static void finish_transaction(err_t res) {
+	i2c_transaction_t *txn = queue_head;
+
+	queue_head = txn->next;
+	if (queue_head == NULL) {
+		queue_tail = NULL;
+		CLEAR_BIT(TWIx.MCTRLA, TWI_RIEN_bm|TWI_WIEN_bm);
+		if (SELECT_BITS(TWIx.MSTATUS, TWI_BUSSTATE_gm) == TWI_BUSSTATE_OWNER_gc) {
+			TWIx.MCTRLB = TWI_ACKACT_NACK_gc | TWI_MCMD_STOP_gc;
+		}
+	} else {
+		start_transaction();
+	}
+	report_transaction(txn, res);
+
+	return;
+}
+//
+// Stop the running transaction and drop everything in the queue
+static void abort_queue(err_t res) {
+	i2c_transaction_t *txn = queue_head;
+
+	CLEAR_BIT(TWIx.MCTRLA, TWI_RIEN_bm|TWI_WIEN_bm);
+	if (txn == NULL) {
+		return;
+	}
+
+	if (SELECT_BITS(TWIx.MSTATUS, TWI_BUSSTATE_gm) == TWI_BUSSTATE_OWNER_gc) {
+		TWIx.MCTRLB = TWI_ACKACT_NACK_gc | TWI_MCMD_STOP_gc;
+	}
+	CLEAR_STATUS();
+
+	// The whole queue is detached first in case a callback queues something new
+	queue_head = NULL;
+	queue_tail = NULL;
+	while (txn != NULL) {
+		i2c_transaction_t *next = txn->next;
+
+		report_transaction(txn, res);
+		txn = next;
+	}
+
+	return;
+}
+
+ISR(TWIx_TWIM_vect) {
+	i2c_transaction_t *txn = queue_head;
+	uint8_t status = TWIx.MSTATUS;
+
+	if (txn == NULL) {
+		CLEAR_BIT(TWIx.MCTRLA, TWI_RIEN_bm|TWI_WIEN_bm);
+		return;
+	}
+
+	if (BIT_IS_SET(status, TWI_ARBLOST_bm)) {
+		finish_transaction(ERR_RETRY);
+		return;
+	}
+	if (BIT_IS_SET(status, TWI_BUSERR_bm)) {
+		finish_transaction(ERR_UNKNOWN);
+		return;
+	}
+
+	// WIF is set after the address or a data byte is sent; in the read phase
+	// that only happens if the address wasn't acknowledged
+	if (BIT_IS_SET(status, TWI_WIF_bm)) {
+		// A NACK of the address means there's nothing there, after that it
+		// means the device couldn't or didn't want to take more data
+		if (BIT_IS_SET(status, TWI_RXACK_bm) || queue_reading) {
+			finish_transaction((queue_addressed) ? ERR_INTERRUPT : ERR_NODEV);
+		} else if (queue_pos < txn->tx_size) {
+			queue_addressed = true;
+			TWIx.MDATA = txn->tx_buffer[queue_pos++];
+		} else if (txn->rx_size > 0) {
+			queue_pos = 0;
+			queue_addressed = false;
+			queue_reading = true;
+			// Writing MADDR while we own the bus sends a repeated start
+			TWIx.MADDR = (txn->addr << 1U) | 0x01U;
+		} else {
+			finish_transaction(ERR_OK);
+		}
+
+	// RIF is set when a byte arrives, the first one follows the address
+	// automatically
+	} else if (BIT_IS_SET(status, TWI_RIF_bm)) {
+		queue_addressed = true;
+		// The value of ACKACT in MCTRLB is automatcally sent when MDATA is read
+		// and smart mode is enabled; the last byte gets a NACK
+		if ((txn->rx_size - queue_pos) > 1) {
+			TWIx.MCTRLB = TWI_ACKACT_ACK_gc;
+			txn->rx_buffer[queue_pos++] = TWIx.MDATA;
+		} else {
+			TWIx.MCTRLB = TWI_ACKACT_NACK_gc;
+			txn->rx_buffer[queue_pos++] = TWIx.MDATA;
+			finish_transaction(ERR_OK);
+		}
+	}
+
+	return;
+}
+
+err_t i2c_queue_transaction(i2c_transaction_t *txn) {
+	uint8_t sreg;
+
+	uHAL_assert(TWIx_INIT_OK(TWIx));
+	uHAL_assert(txn != NULL);
+	uHAL_assert(ADDRESS_OK(txn->addr));
+	uHAL_assert(TXN_OK(txn));
+#if ! uHAL_SKIP_INIT_CHECKS
+	if (!TWIx_INIT_OK(TWIx)) {
+		return ERR_INIT;
+	}
+#endif
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if ((txn == NULL) || !ADDRESS_OK(txn->addr) || !TXN_OK(txn)) {
+		return ERR_BADARG;
+	}
+#endif
+	if (txn->busy) {
+		return ERR_RETRY;
+	}
+
+	txn->next = NULL;
+	txn->res = ERR_OK;
+	txn->busy = true;
+
+	SAVE_INTERRUPTS(sreg);
+	cli();
+	if (queue_head == NULL) {
+		queue_head = txn;
+		queue_tail = txn;
+		// The bus may be in use by i2c_transmit_block_begin() through _end(),
+		// in which case the queue is started by i2c_transmit_block_end()
+		if (!stream_active) {
+			start_transaction();
+		}
+	} else {
+		queue_tail->next = txn;
+		queue_tail = txn;
+	}
+	RESTORE_INTERRUPTS(sreg);
+
+	return ERR_OK;
+}
+bool i2c_queue_is_busy(void) {
+	return (queue_head != NULL);
+}
+err_t i2c_queue_wait(const i2c_transaction_t *txn, utime_t timeout) {
+	timeout = SET_TIMEOUT_MS(timeout);
+
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	while ((txn != NULL) ? txn->busy : (queue_head != NULL)) {
+		// Interrupts are masked between checking the flag and sleeping so that
+		// the last interrupt can't slip in between and leave us waiting on the
+		// next systick; the instruction following sei() always runs before any
+		// interrupt is handled
+		cli();
+		if ((txn != NULL) ? txn->busy : (queue_head != NULL)) {
+			sleep_enable();
+			sei();
+			sleep_cpu();
+			sleep_disable();
+		}
+		sei();
+
+		if (TIMES_UP(timeout)) {
+			cli();
+			if ((txn != NULL) ? txn->busy : (queue_head != NULL)) {
+				abort_queue(ERR_TIMEOUT);
+			}
+			sei();
+			break;
+		}
+	}
+
+	if (txn != NULL) {
+		return txn->res;
+	}
+	return (queue_head == NULL) ? ERR_OK : ERR_TIMEOUT;
+}
+static err_t queue_block(uint8_t addr, const uint8_t *tx_buffer, txsize_t tx_size, uint8_t *rx_buffer, txsize_t rx_size, utime_t timeout) {
+	err_t res;
+	i2c_transaction_t txn = {
+		.tx_buffer = tx_buffer,
+		.rx_buffer = rx_buffer,
+		.tx_size = tx_size,
+		.rx_size = rx_size,
+		.addr = addr,
+	};
+
+	if ((res = i2c_queue_transaction(&txn)) != ERR_OK) {
+		return res;
+	}
+	return i2c_queue_wait(&txn, timeout);
+}
+#endif // uHAL_I2C_USE_QUEUE
 
 
 #endif // uHAL_USE_I2C
@@ -196,6 +196,9 @@ typedef struct {
 #if UART_INPUT_BUFFER_BYTES > 0 && ENABLE_UART_LISTENING
 	volatile uart_buffer_t rx_buf;
 #endif
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	volatile uart_tx_buffer_t tx_buf;
+#endif
 } uart_port_t;
 
 typedef struct {
@@ -178,6 +178,16 @@ void platform_reset(void) {
 	_PROTECTED_WRITE(RSTCTRL.SWRR, RSTCTRL_SWRE_bm);
 }
 
+#if uHAL_RETAINED_MEMORY_BYTES > 0
+//
+// avr-libc's startup code leaves .noinit alone
+static uint8_t retained_memory[uHAL_RETAINED_MEMORY_BYTES] __attribute__((section(".noinit"), aligned(8)));
+
+void* get_retained_memory(void) {
+	return retained_memory;
+}
+#endif
+
 static sleep_mode_t limit_hibernation_depth(sleep_mode_t sleep_mode) {
 	if (uHAL_CHECK_STATUS(uHAL_FLAG_INHIBIT_HIBERNATION)) {
 		sleep_mode = HIBERNATE_LIGHT;
@@ -45,6 +45,12 @@
 #define CLEAR_STATUS(uartx) (uartx->STATUS = USART_TXCIF_bm | USART_RXSIF_bm | USART_ISFIF_bm | USART_BDF_bm)
 
 DEBUG_CPP_MACRO(UART_INPUT_BUFFER_BYTES)
+DEBUG_CPP_MACRO(UART_OUTPUT_BUFFER_BYTES)
+
+// The buffer indices need to be read and written in a single instruction
+#if UART_OUTPUT_BUFFER_BYTES > 0xFFU
+# error "UART_OUTPUT_BUFFER_BYTES can not be > 0xFF on this platform"
+#endif
 
 #ifdef UART_COMM_PORT
 # define SET_DEFAULT_PORT(_p_) do { if ((_p_) == NULL) (_p_) = UART_COMM_PORT; } while (0)
@@ -75,6 +81,10 @@ DEBUG_CPP_MACRO(UART_INPUT_BUFFER_BYTES)
 //#define BUFFER_OK(_buf_, _size_) ((_buf_) != NULL && (_size_) > 0)
 #define BUFFER_OK(_buf_, _size_) ((_buf_) != NULL)
 
+#if UART_OUTPUT_BUFFER_BYTES > 0
+static void poll_tx_buffer(const uart_port_t *p);
+#endif
+
 err_t uart_init_port(uart_port_t *p, const uart_port_cfg_t *conf) {
 	SET_DEFAULT_PORT(p);
 
@@ -129,6 +139,11 @@ err_t uart_init_port(uart_port_t *p, const uart_port_cfg_t *conf) {
 		write_reg16(&p->uartx->BAUD, 8U * (G_freq_UARTCLK / conf->baud_rate));
 	}
 
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	p->tx_buf.head = 0;
+	p->tx_buf.tail = 0;
+#endif
+
 	CLEAR_STATUS(p->uartx);
 #if ENABLE_UART_LISTENING
 	uart_listen_off(p);
@@ -152,6 +167,15 @@ err_t uart_off(const uart_port_t *p) {
 	SET_DEFAULT_PORT(p);
 	VERIFY_PORT(p);
 
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	if (BIT_IS_SET(p->uartx->CTRLB, USART_TXEN_bm)) {
+		uart_flush(p, UART_COMM_TIMEOUT_MS);
+	}
+	CLEAR_BIT(p->uartx->CTRLA, (USART_DREIE_bm | USART_TXCIE_bm));
+	// Anything that couldn't be sent is lost
+	((uart_port_t *)p)->tx_buf.tail = p->tx_buf.head;
+#endif
+
 	// There's a bug listed in the errata where disabling the transmitter doesn't
 	// release the TX pin unless the reciever is still enabled
 	//CLEAR_BIT(p->uartx->CTRLB, (USART_TXEN_bm | USART_RXEN_bm | USART_SFDEN_bm));
@@ -174,10 +198,20 @@ err_t uart_listen_on(const uart_port_t *p) {
 	SET_DEFAULT_PORT(p);
 	VERIFY_PORT(p);
 
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	uint8_t sreg;
+
+	// The transmit ISRs modify CTRLA too
+	SAVE_INTERRUPTS(sreg);
+	cli();
+#endif
 	// We enable the frame start interrupt just so we can wake from deep sleep
 	// via UART input
 	SET_BIT(p->uartx->CTRLA, (USART_RXCIE_bm | USART_RXSIE_bm));
 	SET_BIT(p->uartx->CTRLB, (USART_SFDEN_bm));
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	RESTORE_INTERRUPTS(sreg);
+#endif
 
 	return ERR_OK;
 }
@@ -185,8 +219,17 @@ err_t uart_listen_off(const uart_port_t *p) {
 	SET_DEFAULT_PORT(p);
 	VERIFY_PORT(p);
 
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	uint8_t sreg;
+
+	SAVE_INTERRUPTS(sreg);
+	cli();
+#endif
 	CLEAR_BIT(p->uartx->CTRLA, (USART_RXCIE_bm | USART_RXSIE_bm));
 	CLEAR_BIT(p->uartx->CTRLB, (USART_SFDEN_bm));
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	RESTORE_INTERRUPTS(sreg);
+#endif
 
 	return ERR_OK;
 }
@@ -214,7 +257,6 @@ bool uart_rx_is_available(const uart_port_t *p) {
 err_t uart_transmit_block(uart_port_t *p, const uint8_t *buffer, txsize_t size, utime_t timeout) {
 	err_t res;
 	USART_t *uartx;
-	txsize_t i = 0;
 
 	SET_DEFAULT_PORT(p);
 	VERIFY_PORT(p);
@@ -233,7 +275,30 @@ err_t uart_transmit_block(uart_port_t *p, const uint8_t *buffer, txsize_t size,
 	res = ERR_OK;
 	timeout = SET_TIMEOUT_MS(timeout);
 
-	for (; i < size; ++i) {
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	while (size > 0) {
+		txsize_t queued = uart_tx_buffer_push(&p->tx_buf, buffer, size);
+
+		if (queued > 0) {
+			uint8_t sreg;
+
+			buffer += queued;
+			size -= queued;
+			// The ISRs turn this back off when the buffer runs dry
+			SAVE_INTERRUPTS(sreg);
+			cli();
+			SET_BIT(uartx->CTRLA, USART_DREIE_bm);
+			RESTORE_INTERRUPTS(sreg);
+		} else if (TIMES_UP(timeout)) {
+			res = ERR_TIMEOUT;
+			break;
+		} else {
+			poll_tx_buffer(p);
+		}
+	}
+
+#else // UART_OUTPUT_BUFFER_BYTES > 0
+	for (txsize_t i = 0; i < size; ++i) {
 		while (!BIT_IS_SET(uartx->STATUS, USART_DREIF_bm)) {
 			if (TIMES_UP(timeout)) {
 				res = ERR_TIMEOUT;
@@ -250,8 +315,37 @@ err_t uart_transmit_block(uart_port_t *p, const uint8_t *buffer, txsize_t size,
 	}
 
 END:
+#endif // UART_OUTPUT_BUFFER_BYTES > 0
 	return res;
 }
+err_t uart_flush(const uart_port_t *p, utime_t timeout) {
+	SET_DEFAULT_PORT(p);
+	VERIFY_PORT(p);
+
+#if UART_OUTPUT_BUFFER_BYTES > 0
+# if ! uHAL_SKIP_OTHER_CHECKS
+	if (!BIT_IS_SET(p->uartx->CTRLB, USART_TXEN_bm)) {
+		return ERR_INIT;
+	}
+# endif
+
+	timeout = SET_TIMEOUT_MS(timeout);
+	// The transmit complete interrupt is only turned off once the buffer is
+	// empty and the last byte has left the shift register
+	while (BIT_IS_SET(p->uartx->CTRLA, (USART_DREIE_bm | USART_TXCIE_bm))) {
+		if (TIMES_UP(timeout)) {
+			return ERR_TIMEOUT;
+		}
+		poll_tx_buffer(p);
+	}
+
+#else // UART_OUTPUT_BUFFER_BYTES > 0
+	// uart_transmit_block() doesn't return until it's done
+	UNUSED(timeout);
+#endif // UART_OUTPUT_BUFFER_BYTES > 0
+
+	return ERR_OK;
+}
 err_t uart_receive_block(uart_port_t *p, uint8_t *buffer, txsize_t size, utime_t timeout) {
 	err_t res;
 	volatile USART_t *uartx;
@@ -299,5 +393,25 @@ END:
 	return res;
 }
 
+#if UART_OUTPUT_BUFFER_BYTES > 0
+//
+// The buffer won't drain on its own when interrupts are disabled (such as when
+// reporting an error from inside an ISR), so in that case move it along by
+// hand
+static void poll_tx_buffer(const uart_port_t *p) {
+	USART_t *uartx = p->uartx;
+
+	if (BIT_IS_SET(SREG, CPU_I_bm)) {
+		return;
+	}
+	if (BIT_IS_SET(uartx->CTRLA, USART_DREIE_bm) && BIT_IS_SET(uartx->STATUS, USART_DREIF_bm)) {
+		UARTx_DRE_IRQHandler((uart_port_t *)p);
+	} else if (BIT_IS_SET(uartx->CTRLA, USART_TXCIE_bm) && BIT_IS_SET(uartx->STATUS, USART_TXCIF_bm)) {
+		UARTx_TXC_IRQHandler((uart_port_t *)p);
+	}
+
+	return;
+}
+#endif // UART_OUTPUT_BUFFER_BYTES > 0
 
 #endif // uHAL_USE_UART
@@ -1,11 +1,12 @@
 //
-// Generated by tools/xmega3/uart_define_irq.sh on Fri Jul 26 03:53:43 AM EDT 2024
+// Generated by tools/xmega3/uart_define_irq.sh on Sun Oct 18 08:19:57 UTC 2026
 //
 
-#if ENABLE_UART_LISTENING
+#if ENABLE_UART_LISTENING || UART_OUTPUT_BUFFER_BYTES > 0
 
 #define ASSIGN_IRQ_PORT(_irqn_, _p_) do { uart ## _irqn_ ## _port = (_p_); } while (0);
 
+#if ENABLE_UART_LISTENING
 static void UARTx_RXC_IRQHandler(uart_port_t *p) {
 #if UART_INPUT_BUFFER_BYTES > 0
 	if (p->rx_buf.bytes < UART_INPUT_BUFFER_BYTES) {
@@ -24,6 +25,31 @@ static void UARTx_RXC_IRQHandler(uart_port_t *p) {
 
 	return;
 }
+#endif // ENABLE_UART_LISTENING
+
+#if UART_OUTPUT_BUFFER_BYTES > 0
+static void UARTx_DRE_IRQHandler(uart_port_t *p) {
+	uint8_t c;
+
+	if (uart_tx_buffer_pop(&p->tx_buf, &c)) {
+		// TXCIF is only meaningful for the last byte written
+		p->uartx->STATUS = USART_TXCIF_bm;
+		p->uartx->TXDATAL = c;
+	} else {
+		// Nothing left to queue, switch to the transmit complete interrupt so
+		// that uart_flush() can tell when the last byte is out
+		MODIFY_BITS(p->uartx->CTRLA, USART_DREIE_bm|USART_TXCIE_bm, USART_TXCIE_bm);
+	}
+
+	return;
+}
+static void UARTx_TXC_IRQHandler(uart_port_t *p) {
+	p->uartx->STATUS = USART_TXCIF_bm;
+	CLEAR_BIT(p->uartx->CTRLA, USART_TXCIE_bm);
+
+	return;
+}
+#endif // UART_OUTPUT_BUFFER_BYTES > 0
 
 //
 // USART0
@@ -31,6 +57,7 @@ static void UARTx_RXC_IRQHandler(uart_port_t *p) {
 #if HAVE_UART0
 static uart_port_t *uart0_port;
 
+#if ENABLE_UART_LISTENING
 ISR(USART0_RXC_vect) {
 	// Set RXSIF bit to '1' to clear it
 	USART0.STATUS = USART_RXSIF_bm | USART_ISFIF_bm;
@@ -40,6 +67,15 @@ ISR(USART0_RXC_vect) {
 	}
 }
 #endif
+#if UART_OUTPUT_BUFFER_BYTES > 0
+ISR(USART0_DRE_vect) {
+	UARTx_DRE_IRQHandler(uart0_port);
+}
+ISR(USART0_TXC_vect) {
+	UARTx_TXC_IRQHandler(uart0_port);
+}
+#endif
+#endif
 
 //
 // USART1
@@ -47,6 +83,7 @@ ISR(USART0_RXC_vect) {
 #if HAVE_UART1
 static uart_port_t *uart1_port;
 
+#if ENABLE_UART_LISTENING
 ISR(USART1_RXC_vect) {
 	// Set RXSIF bit to '1' to clear it
 	USART1.STATUS = USART_RXSIF_bm | USART_ISFIF_bm;
@@ -56,6 +93,15 @@ ISR(USART1_RXC_vect) {
 	}
 }
 #endif
+#if UART_OUTPUT_BUFFER_BYTES > 0
+ISR(USART1_DRE_vect) {
+	UARTx_DRE_IRQHandler(uart1_port);
+}
+ISR(USART1_TXC_vect) {
+	UARTx_TXC_IRQHandler(uart1_port);
+}
+#endif
+#endif
 
 //
 // USART2
@@ -63,6 +109,7 @@ ISR(USART1_RXC_vect) {
 #if HAVE_UART2
 static uart_port_t *uart2_port;
 
+#if ENABLE_UART_LISTENING
 ISR(USART2_RXC_vect) {
 	// Set RXSIF bit to '1' to clear it
 	USART2.STATUS = USART_RXSIF_bm | USART_ISFIF_bm;
@@ -72,6 +119,15 @@ ISR(USART2_RXC_vect) {
 	}
 }
 #endif
+#if UART_OUTPUT_BUFFER_BYTES > 0
+ISR(USART2_DRE_vect) {
+	UARTx_DRE_IRQHandler(uart2_port);
+}
+ISR(USART2_TXC_vect) {
+	UARTx_TXC_IRQHandler(uart2_port);
+}
+#endif
+#endif
 
 //
 // USART3
@@ -79,6 +135,7 @@ ISR(USART2_RXC_vect) {
 #if HAVE_UART3
 static uart_port_t *uart3_port;
 
+#if ENABLE_UART_LISTENING
 ISR(USART3_RXC_vect) {
 	// Set RXSIF bit to '1' to clear it
 	USART3.STATUS = USART_RXSIF_bm | USART_ISFIF_bm;
@@ -88,7 +145,16 @@ ISR(USART3_RXC_vect) {
 	}
 }
 #endif
-#else // ENABLE_UART_LISTENING
+#if UART_OUTPUT_BUFFER_BYTES > 0
+ISR(USART3_DRE_vect) {
+	UARTx_DRE_IRQHandler(uart3_port);
+}
+ISR(USART3_TXC_vect) {
+	UARTx_TXC_IRQHandler(uart3_port);
+}
+#endif
+#endif
+#else // ENABLE_UART_LISTENING || UART_OUTPUT_BUFFER_BYTES > 0
 #define ASSIGN_IRQ_PORT(_irqn_, _p_) ((void )0U)
 
-#endif // ENABLE_UART_LISTENING
+#endif // ENABLE_UART_LISTENING || UART_OUTPUT_BUFFER_BYTES > 0
@@ -20,6 +20,12 @@
 // adc.c
 // Manage the ADC peripheral
 // NOTES:
+//   adc_read_pins() puts the ADC in scan mode and has the DMA controller
+//   collect the results so that a whole group of pins is converted in one
+//   burst. ADC1 requests are hard-wired to DMA1 channel 1 on the F1 line;
+//   on the F4 line they can be served by DMA2 stream 0 or 4 and stream 4 is
+//   used so that it doesn't collide with SPI1. A scan takes a few
+//   microseconds so the transfer is polled rather than interrupt-driven.
 //
 #include "adc.h"
 
@@ -57,6 +63,30 @@
 # error "F_ADC must be F_PCLK2 / (2|4|6|8)"
 #endif
 
+#if uHAL_ADC_USE_DMA
+# if HAVE_STM32F1_DMA
+#  define ADCx_DMA_CLOCKEN RCC_PERIPH_DMA1
+#  define ADCx_DMA_CH    DMA1_Channel1
+#  define ADCx_DMA_ISR   (DMA1->ISR)
+#  define ADCx_DMA_IFCR  (DMA1->IFCR)
+#  define ADCx_DMA_TCIF  DMA_ISR_TCIF1
+#  define ADCx_DMA_TEIF  DMA_ISR_TEIF1
+#  define ADCx_DMA_FLAGS (DMA_IFCR_CGIF1|DMA_IFCR_CTCIF1|DMA_IFCR_CHTIF1|DMA_IFCR_CTEIF1)
+# else
+#  define ADCx_DMA_CLOCKEN RCC_PERIPH_DMA2
+#  define ADCx_DMA_CHSEL 0U
+#  define ADCx_DMA_CH    DMA2_Stream4
+#  define ADCx_DMA_ISR   (DMA2->HISR)
+#  define ADCx_DMA_IFCR  (DMA2->HIFCR)
+#  define ADCx_DMA_TCIF  DMA_HISR_TCIF4
+#  define ADCx_DMA_TEIF  DMA_HISR_TEIF4
+#  define ADCx_DMA_FLAGS (DMA_HIFCR_CTCIF4|DMA_HIFCR_CHTIF4|DMA_HIFCR_CTEIF4|DMA_HIFCR_CDMEIF4|DMA_HIFCR_CFEIF4)
+# endif
+#endif // uHAL_ADC_USE_DMA
+
+// The regular sequence registers have room for 16 conversions
+#define ADC_SEQUENCE_MAX 16U
+
 DEBUG_CPP_MACRO(ADC_SAMPLE_CYCLES)
 DEBUG_CPP_MACRO(ADC_SAMPLES_PER_S)
 //DEBUG_CPP_MACRO(ADC_SAMPLE_TIME)
@@ -244,6 +274,218 @@ static adc_t adc_read_channel(uint_fast32_t channel) {
 	return adc;
 }
 
+#if uHAL_ADC_USE_DMA
+static void dma_setup(volatile uint16_t *buffer, uint_fast8_t count) {
+#if HAVE_STM32F1_DMA
+	CLEAR_BIT(ADCx_DMA_CH->CCR, DMA_CCR_EN);
+	ADCx_DMA_IFCR = ADCx_DMA_FLAGS;
+
+	ADCx_DMA_CH->CPAR = (uint32_t )&ADCx->DR;
+	ADCx_DMA_CH->CMAR = (uint32_t )buffer;
+	ADCx_DMA_CH->CNDTR = count;
+	ADCx_DMA_CH->CCR =
+		(0b0U  << DMA_CCR_DIR_Pos  ) | // Read from peripheral
+		(0b1U  << DMA_CCR_MINC_Pos ) | // Increment memory address
+		(0b0U  << DMA_CCR_PINC_Pos ) | // Don't increment peripheral address
+		(0b01U << DMA_CCR_MSIZE_Pos) | // 16-bit memory access
+		(0b01U << DMA_CCR_PSIZE_Pos) | // 16-bit peripheral access
+		(0b00U << DMA_CCR_PL_Pos   ) | // Low priority
+		DMA_CCR_EN;
+#else
+	// The stream can't be configured until it's actually stopped
+	CLEAR_BIT(ADCx_DMA_CH->CR, DMA_SxCR_EN);
+	while (BIT_IS_SET(ADCx_DMA_CH->CR, DMA_SxCR_EN)) {
+		// Nothing to do here
+	}
+	ADCx_DMA_IFCR = ADCx_DMA_FLAGS;
+
+	ADCx_DMA_CH->PAR = (uint32_t )&ADCx->DR;
+	ADCx_DMA_CH->M0AR = (uint32_t )buffer;
+	ADCx_DMA_CH->NDTR = count;
+	// Direct mode, no FIFO
+	ADCx_DMA_CH->FCR = 0;
+	ADCx_DMA_CH->CR =
+		(ADCx_DMA_CHSEL << DMA_SxCR_CHSEL_Pos) | // Request channel
+		(0b00U << DMA_SxCR_DIR_Pos  ) | // Read from peripheral
+		(0b1U  << DMA_SxCR_MINC_Pos ) | // Increment memory address
+		(0b0U  << DMA_SxCR_PINC_Pos ) | // Don't increment peripheral address
+		(0b01U << DMA_SxCR_MSIZE_Pos) | // 16-bit memory access
+		(0b01U << DMA_SxCR_PSIZE_Pos) | // 16-bit peripheral access
+		(0b00U << DMA_SxCR_PL_Pos   ) | // Low priority
+		DMA_SxCR_EN;
+
+	// Without DDS set the ADC stops making requests after the last transfer
+	// of the previous scan; toggling the DMA bit re-arms it
+	CLEAR_BIT(ADCx->CR2, ADC_CR2_DMA);
+	SET_BIT(ADCx->CR2, ADC_CR2_DMA);
+#endif
+
+	return;
+}
+static void dma_stop(void) {
+#if HAVE_STM32F1_DMA
+	CLEAR_BIT(ADCx_DMA_CH->CCR, DMA_CCR_EN);
+#else
+	CLEAR_BIT(ADCx_DMA_CH->CR, DMA_SxCR_EN);
+	while (BIT_IS_SET(ADCx_DMA_CH->CR, DMA_SxCR_EN)) {
+		// Nothing to do here
+	}
+#endif
+	ADCx_DMA_IFCR = ADCx_DMA_FLAGS;
+
+	return;
+}
+static err_t adc_scan_channels(const uint8_t *channels, adc_t *values, uint_fast8_t count) {
+	// The DMA controller writes to this behind the compiler's back
+	// It's static because the stack may be in core-coupled memory which the
+	// DMA controller can't reach
+	static volatile uint16_t samples[ADC_SEQUENCE_MAX];
+	adcm_t sums[ADC_SEQUENCE_MAX];
+	uint32_t sqr[3] = { 0, 0, 0 };
+	err_t res = ERR_OK;
+#if ADC_TIMEOUT_MS
+	utime_t timeout;
+#endif
+
+	uHAL_assert(count > 0 && count <= ADC_SEQUENCE_MAX);
+
+	// The DMA controller may be shared with SPI
+	dma_clock_acquire(ADCx_DMA_CLOCKEN);
+
+	// SQR3 holds conversions 1-6, SQR2 7-12, and SQR1 13-16
+	for (uiter_t i = 0; i < count; ++i) {
+		sqr[2U - (i / 6U)] |= (uint32_t )channels[i] << ((i % 6U) * 5U);
+		sums[i] = 0;
+	}
+	ADCx->SQR1 = sqr[0] | ((uint32_t )(count - 1U) << ADC_SQR1_L_Pos);
+	ADCx->SQR2 = sqr[1];
+	ADCx->SQR3 = sqr[2];
+
+	SET_BIT(ADCx->CR1, ADC_CR1_SCAN);
+	SET_BIT(ADCx->CR2, ADC_CR2_DMA);
+
+#if ADC_TIMEOUT_MS
+	timeout = SET_TIMEOUT_MS(ADC_TIMEOUT_MS);
+#endif
+
+	// Unlike adc_read_channel(), ADON isn't set again to start things off on
+	// the F1; the conversion is started by SWSTART for every pass which is
+	// always available once adc_on() has woken the ADC
+	ADCx->SR = 0;
+	for (uiter_t s = 0; s < ADC_SAMPLE_COUNT; ++s) {
+		dma_setup(samples, count);
+		SET_BIT(ADCx->CR2, ADC_CR2_SWSTART);
+
+		while (!BIT_IS_SET(ADCx_DMA_ISR, ADCx_DMA_TCIF)) {
+			if (BIT_IS_SET(ADCx_DMA_ISR, ADCx_DMA_TEIF)) {
+				res = ERR_IO;
+				goto END;
+			}
+#if ! HAVE_STM32F1_ADC
+			// An overrun stops DMA requests, so it would just end in a timeout
+			if (BIT_IS_SET(ADCx->SR, ADC_SR_OVR)) {
+				res = ERR_IO;
+				goto END;
+			}
+#endif
+#if ADC_TIMEOUT_MS
+			if (TIMES_UP(timeout)) {
+				res = ERR_TIMEOUT;
+				goto END;
+			}
+#endif
+		}
+		for (uiter_t i = 0; i < count; ++i) {
+			sums[i] += SELECT_BITS(samples[i], ADC_MAX);
+		}
+	}
+	for (uiter_t i = 0; i < count; ++i) {
+		values[i] = sums[i] / ADC_SAMPLE_COUNT;
+	}
+
+END:
+	dma_stop();
+	CLEAR_BIT(ADCx->CR2, ADC_CR2_DMA);
+	CLEAR_BIT(ADCx->CR1, ADC_CR1_SCAN);
+	// adc_read_channel() only sets the first conversion and expects the
+	// sequence length to be 1
+	ADCx->SQR1 = 0;
+	ADCx->SR = 0;
+
+	dma_clock_release(ADCx_DMA_CLOCKEN);
+
+	return res;
+}
+#else // ! uHAL_ADC_USE_DMA
+static err_t adc_scan_channels(const uint8_t *channels, adc_t *values, uint_fast8_t count) {
+	err_t res = ERR_OK;
+
+	for (uiter_t i = 0; i < count; ++i) {
+		values[i] = adc_read_channel(channels[i]);
+		if (values[i] == ERR_ADC) {
+			res = ERR_IO;
+		}
+	}
+
+	return res;
+}
+#endif // uHAL_ADC_USE_DMA
+err_t adc_read_pins(const gpio_pin_t *pins, adc_t *values, uint_fast8_t count) {
+	uint8_t channels[ADC_SEQUENCE_MAX];
+	adc_t results[ADC_SEQUENCE_MAX];
+	uint8_t slots[ADC_SEQUENCE_MAX];
+	uint_fast8_t n = 0;
+	err_t res = ERR_OK, tmp;
+
+	uHAL_assert(pins != NULL);
+	uHAL_assert(values != NULL);
+
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if ((pins == NULL) || (values == NULL)) {
+		return ERR_BADARG;
+	}
+#endif
+#if ! uHAL_SKIP_OTHER_CHECKS
+	if (!clock_is_enabled(ADCx_CLOCKEN)) {
+		for (uiter_t i = 0; i < count; ++i) {
+			values[i] = ERR_ADC;
+		}
+		return ERR_INIT;
+	}
+#endif
+
+	//
+	// Pins without an ADC channel are skipped rather than failing the
+	// whole batch; everything else is converted in groups of up to
+	// ADC_SEQUENCE_MAX
+	for (uiter_t i = 0; i < count; ++i) {
+		uint8_t ch = GPIO_PIN_IS_VALID(pins[i]) ? pin_to_channel(pins[i]) : 0xFFU;
+
+		values[i] = ERR_ADC;
+		if (ch > 0b11111U) {
+			res = ERR_BADARG;
+		} else {
+			channels[n] = ch;
+			slots[n] = i;
+			++n;
+		}
+
+		if ((n == ADC_SEQUENCE_MAX) || ((i + 1U) == count && n > 0)) {
+			tmp = adc_scan_channels(channels, results, n);
+			if (tmp != ERR_OK) {
+				res = tmp;
+			} else {
+				for (uiter_t j = 0; j < n; ++j) {
+					values[slots[j]] = results[j];
+				}
+			}
+			n = 0;
+		}
+	}
+
+	return res;
+}
+
 uint_fast16_t adc_read_vref_mV(void) {
 	adc_t adc;
 	uint_fast16_t vref;
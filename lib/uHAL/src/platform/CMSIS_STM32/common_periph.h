@@ -77,6 +77,13 @@
 # define RCC_PERIPH_GPIOJ (RCC_BUS_AHB1 | RCC_AHB1ENR_GPIOJEN)
 # define RCC_PERIPH_GPIOK (RCC_BUS_AHB1 | RCC_AHB1ENR_GPIOKEN)
 #endif
+#if HAVE_STM32F1_DMA
+# define RCC_PERIPH_DMA1 (RCC_BUS_AHB1 | RCC_AHBENR_DMA1EN)
+# define RCC_PERIPH_DMA2 (RCC_BUS_AHB1 | RCC_AHBENR_DMA2EN)
+#else
+# define RCC_PERIPH_DMA1 (RCC_BUS_AHB1 | RCC_AHB1ENR_DMA1EN)
+# define RCC_PERIPH_DMA2 (RCC_BUS_AHB1 | RCC_AHB1ENR_DMA2EN)
+#endif
 //
 // APB1
 #define RCC_PERIPH_TIM2  (RCC_BUS_APB1 | RCC_APB1ENR_TIM2EN)
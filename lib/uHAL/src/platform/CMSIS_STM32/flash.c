@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// flash.c
+// Manage the internal flash data area
+// NOTES:
+//    Only the STM32F1 flash controller is supported. The F4's sectors are
+//    16KB-128KB, which is too coarse to set aside a few of them for data, and
+//    XL-density F1 devices keep the end of flash in a second bank with its own
+//    set of registers which isn't handled here.
+//
+//    The data area is found at run time from the flash size register. The
+//    linker isn't told about it, so it's up to the user to make sure the
+//    program doesn't grow into it; the end of the program image is checked
+//    before anything is erased or written.
+//
+//    The HSI must be running while the flash is erased or programmed. It's
+//    turned on for the duration if it isn't already.
+//
+//    The CPU stalls on any flash access while an operation is in progress, so
+//    interrupts are effectively delayed until it finishes.
+//
+#include "common.h"
+
+#if uHAL_USE_FLASH
+
+#if ! HAVE_STM32F1_FLASH
+# error "uHAL_USE_FLASH is only supported on STM32F1 devices"
+#endif
+#if defined(STM32F103xF) || defined(STM32F103xG)
+# error "uHAL_USE_FLASH is not supported on XL-density devices"
+#endif
+
+#include <string.h>
+
+//
+// These are defined by the linker
+// Note that it's the *address* of the identifier that's important, not it's
+// value.
+//
+// Start address for the initialization values of the .data section
+extern char _sidata;
+// Start address for the .data section
+extern char _sdata;
+// End address for the .data section
+extern char _edata;
+
+#define FLASH_KEY_1 0x45670123UL
+#define FLASH_KEY_2 0xCDEF89ABUL
+
+#define FLASH_IS_BUSY() (BIT_IS_SET(FLASH->SR, FLASH_SR_BSY))
+#define FLASH_SR_ERRORS (FLASH_SR_PGERR | FLASH_SR_WRPRTERR)
+
+
+//
+// Find the start of the data area, or 0 if it overlaps the program
+static uintptr_t data_area_address(void) {
+	uintptr_t start, image_end;
+	uint32_t flash_bytes = (uint32_t )(*(uint16_t *)FLASHSIZE_BASE) * 1024UL;
+
+	if (flash_bytes < FLASH_DATA_BYTES) {
+		return 0;
+	}
+	start = FLASH_BASE + (flash_bytes - FLASH_DATA_BYTES);
+	// The initial values of .data are stored directly after the code
+	image_end = (uintptr_t )&_sidata + (uintptr_t )(&_edata - &_sdata);
+
+	return (image_end <= start) ? start : 0;
+}
+
+static bool begin_operation(void) {
+	bool hsi_was_off = !BIT_IS_SET(RCC->CR, RCC_CR_HSION);
+
+	if (hsi_was_off) {
+		SET_BIT(RCC->CR, RCC_CR_HSION);
+		while (!BIT_IS_SET(RCC->CR, RCC_CR_HSIRDY)) {
+			// Nothing to do here
+		}
+	}
+	while (FLASH_IS_BUSY()) {
+		// Nothing to do here
+	}
+	if (BIT_IS_SET(FLASH->CR, FLASH_CR_LOCK)) {
+		FLASH->KEYR = FLASH_KEY_1;
+		FLASH->KEYR = FLASH_KEY_2;
+	}
+	// The status flags are cleared by writing 1 to them
+	FLASH->SR = FLASH_SR_EOP | FLASH_SR_ERRORS;
+
+	return hsi_was_off;
+}
+static void end_operation(bool hsi_was_off) {
+	CLEAR_BIT(FLASH->CR, FLASH_CR_PG|FLASH_CR_PER);
+	SET_BIT(FLASH->CR, FLASH_CR_LOCK);
+	if (hsi_was_off) {
+		CLEAR_BIT(RCC->CR, RCC_CR_HSION);
+	}
+
+	return;
+}
+static err_t wait_for_operation(void) {
+	while (FLASH_IS_BUSY()) {
+		// Nothing to do here
+	}
+	if (BIT_IS_SET(FLASH->SR, FLASH_SR_WRPRTERR)) {
+		return ERR_ACCESS;
+	}
+	if (BIT_IS_SET(FLASH->SR, FLASH_SR_PGERR)) {
+		return ERR_PERM;
+	}
+
+	return ERR_OK;
+}
+
+err_t flash_erase_page(uint_fast16_t page) {
+	uintptr_t base;
+	bool hsi_was_off;
+	err_t res;
+
+	uHAL_assert(page < uHAL_FLASH_DATA_PAGES);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (page >= uHAL_FLASH_DATA_PAGES) {
+		return ERR_BADARG;
+	}
+#endif
+
+	if ((base = data_area_address()) == 0) {
+		return ERR_NOMEM;
+	}
+
+	hsi_was_off = begin_operation();
+	SET_BIT(FLASH->CR, FLASH_CR_PER);
+	FLASH->AR = (uint32_t )(base + ((uint32_t )page * FLASH_PAGE_BYTES));
+	SET_BIT(FLASH->CR, FLASH_CR_STRT);
+	res = wait_for_operation();
+	end_operation(hsi_was_off);
+
+	return res;
+}
+
+err_t flash_write(uint32_t offset, const void *data, uint_fast16_t size) {
+	const uint8_t *src = data;
+	volatile uint16_t *dest;
+	uintptr_t base;
+	bool hsi_was_off;
+	err_t res = ERR_OK;
+
+	uHAL_assert(data != NULL);
+	uHAL_assert((offset % FLASH_WRITE_BYTES) == 0);
+	uHAL_assert((size % FLASH_WRITE_BYTES) == 0);
+	uHAL_assert(offset + size <= FLASH_DATA_BYTES);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if ((data == NULL) || ((offset % FLASH_WRITE_BYTES) != 0) || ((size % FLASH_WRITE_BYTES) != 0)) {
+		return ERR_BADARG;
+	}
+	if (offset + size > FLASH_DATA_BYTES) {
+		return ERR_RANGE;
+	}
+#endif
+
+	if ((base = data_area_address()) == 0) {
+		return ERR_NOMEM;
+	}
+	dest = (volatile uint16_t *)(base + offset);
+
+	hsi_was_off = begin_operation();
+	SET_BIT(FLASH->CR, FLASH_CR_PG);
+	for (uint_fast16_t i = 0; i < size; i += FLASH_WRITE_BYTES) {
+		uint16_t hw;
+
+		// The source may not be aligned
+		memcpy(&hw, &src[i], sizeof(hw));
+		*dest++ = hw;
+		if ((res = wait_for_operation()) != ERR_OK) {
+			break;
+		}
+	}
+	end_operation(hsi_was_off);
+
+	return res;
+}
+
+err_t flash_read(uint32_t offset, void *data, uint_fast16_t size) {
+	uintptr_t base;
+
+	uHAL_assert(data != NULL);
+	uHAL_assert(offset + size <= FLASH_DATA_BYTES);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (data == NULL) {
+		return ERR_BADARG;
+	}
+	if (offset + size > FLASH_DATA_BYTES) {
+		return ERR_RANGE;
+	}
+#endif
+
+	if ((base = data_area_address()) == 0) {
+		return ERR_NOMEM;
+	}
+	memcpy(data, (const void *)(base + offset), size);
+
+	return ERR_OK;
+}
+
+#endif // uHAL_USE_FLASH
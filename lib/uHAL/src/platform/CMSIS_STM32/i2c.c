@@ -23,6 +23,14 @@
 //   Arbitration loss is detected when a master releases SDA but it remains
 //   high, it therefore can only occur during transmissions
 //
+//   When the transaction queue is used, the transactions are run one byte at
+//   a time from the event and error interrupts. The reception end-game
+//   follows the same reference manual procedures as i2c_receive_block(), with
+//   the BTF waits replaced by BTF interrupts; the clock is stretched while
+//   they're pending so interrupt latency doesn't lose anything. The
+//   interrupts are only enabled in the peripheral while the queue is running
+//   so the polled functions are unaffected.
+//
 #include "i2c.h"
 #include "system.h"
 #include "gpio.h"
@@ -80,6 +88,44 @@ DEBUG_CPP_MACRO(USE_FAST_DUTY_MODE)
 #define BUS_IS_OWNED(_if_) (BITS_ARE_SET((_if_)->SR2, I2C_SR2_BUSY|I2C_SR2_MSL))
 #define PERIPH_IS_INITIALIZED(_if_) ((_if_)->CCR != 0 && BIT_IS_SET((_if_)->CR1, I2C_CR1_PE))
 
+#if uHAL_I2C_USE_QUEUE
+# define I2C_CR2_IT_ALL (I2C_CR2_ITEVTEN|I2C_CR2_ITERREN|I2C_CR2_ITBUFEN)
+# define TXN_OK(_txn_) ( \
+	(((_txn_)->tx_size > 0) || ((_txn_)->rx_size > 0)) && \
+	(((_txn_)->tx_size == 0) || ((_txn_)->tx_buffer != NULL)) && \
+	(((_txn_)->rx_size == 0) || ((_txn_)->rx_buffer != NULL)))
+// The queue can only run when its interrupts can preempt whatever is waiting
+// on it
+# define IN_IRQ_CONTEXT() ((__get_PRIMASK() != 0) || (__get_IPSR() != 0))
+// Limit on the spin waiting for a stop condition to go out before the next
+// start is requested; every loop takes at least one core cycle so this is at
+// least a few bit periods
+# define STOP_WAIT_LOOPS ((G_freq_HCLK / I2C_FREQUENCY_HZ) * 4U)
+
+typedef enum {
+	QSTATE_START_TX, // Waiting for SB to send the address for writing
+	QSTATE_START_RX, // Waiting for SB to send the address for reading
+	QSTATE_TX,
+	QSTATE_RX
+} queue_state_t;
+
+static i2c_transaction_t *volatile queue_head = NULL;
+static i2c_transaction_t *queue_tail = NULL;
+static queue_state_t queue_state;
+// Position in the buffer of the current phase of the running transaction
+static txsize_t queue_pos;
+// Set once the device has acknowledged the address
+static bool queue_addressed;
+// Set if the running transaction ended with a repeated start for the next one
+static bool queue_restarting;
+// Set while i2c_transmit_block_begin() through _end() own the bus
+static bool stream_active = false;
+
+static void start_transaction(void);
+static void abort_queue(err_t res);
+static err_t queue_block(uint8_t addr, const uint8_t *tx_buffer, txsize_t tx_size, uint8_t *rx_buffer, txsize_t rx_size, utime_t timeout);
+#endif // uHAL_I2C_USE_QUEUE
+
 void i2c_init(void) {
 	uint32_t pclk_MHz, reg;
 
@@ -144,6 +190,11 @@ void i2c_init(void) {
 	}
 	MODIFY_BITS(I2Cx->TRISE, I2C_TRISE_TRISE, reg);
 
+#if uHAL_I2C_USE_QUEUE
+	NVIC_SetPriority(I2Cx_EV_IRQn, I2C_IRQp);
+	NVIC_SetPriority(I2Cx_ER_IRQn, I2C_IRQp);
+#endif
+
 	i2c_off();
 
 	return;
@@ -182,6 +233,13 @@ err_t i2c_on(void) {
 	}
 	pins_on();
 
+#if uHAL_I2C_USE_QUEUE
+	NVIC_ClearPendingIRQ(I2Cx_EV_IRQn);
+	NVIC_ClearPendingIRQ(I2Cx_ER_IRQn);
+	NVIC_EnableIRQ(I2Cx_EV_IRQn);
+	NVIC_EnableIRQ(I2Cx_ER_IRQn);
+#endif
+
 	return ERR_OK;
 }
 err_t i2c_off(void) {
@@ -194,6 +252,16 @@ err_t i2c_off(void) {
 		return ERR_OK;
 	}
 
+#if uHAL_I2C_USE_QUEUE
+	NVIC_DisableIRQ(I2Cx_EV_IRQn);
+	NVIC_DisableIRQ(I2Cx_ER_IRQn);
+	// Anything still queued is being abandoned
+	abort_queue(ERR_INTERRUPT);
+	stream_active = false;
+	NVIC_ClearPendingIRQ(I2Cx_EV_IRQn);
+	NVIC_ClearPendingIRQ(I2Cx_ER_IRQn);
+#endif
+
 	// This probably isn't needed, the only time it might matter is if the
 	// peripheral is disabled before the stop condition has been fully
 	// broadcast
@@ -244,6 +312,17 @@ err_t i2c_receive_block(uint8_t addr, uint8_t *rx_buffer, txsize_t rx_size, utim
 	}
 #endif
 
+#if uHAL_I2C_USE_QUEUE
+	// Inside an interrupt handler the queue may not be able to run so fall
+	// back to polling if it's idle
+	if (!IN_IRQ_CONTEXT()) {
+		return queue_block(addr, NULL, 0, rx_buffer, rx_size, timeout);
+	}
+	if ((queue_head != NULL) || stream_active) {
+		return ERR_RETRY;
+	}
+#endif
+
 	res = ERR_OK;
 	timeout = SET_TIMEOUT_MS(timeout);
 
@@ -503,6 +582,21 @@ err_t i2c_transmit_block_begin(uint8_t addr, utime_t timeout) {
 	}
 #endif
 
+#if uHAL_I2C_USE_QUEUE
+	if (IN_IRQ_CONTEXT()) {
+		if ((queue_head != NULL) || stream_active) {
+			return ERR_RETRY;
+		}
+	} else {
+		err_t res;
+
+		if ((res = i2c_queue_wait(NULL, timeout)) != ERR_OK) {
+			return res;
+		}
+	}
+	stream_active = true;
+#endif
+
 	timeout = SET_TIMEOUT_MS(timeout);
 
 	return _i2c_transmit_block_begin(addr, timeout);
@@ -573,6 +667,20 @@ err_t i2c_transmit_block_end(void) {
 		SET_BIT(I2Cx->CR1, I2C_CR1_STOP);
 	}
 
+#if uHAL_I2C_USE_QUEUE
+	// Start anything that was queued while we had the bus
+	NVIC_DisableIRQ(I2Cx_EV_IRQn);
+	NVIC_DisableIRQ(I2Cx_ER_IRQn);
+	if (stream_active) {
+		stream_active = false;
+		if (queue_head != NULL) {
+			start_transaction();
+		}
+	}
+	NVIC_EnableIRQ(I2Cx_EV_IRQn);
+	NVIC_EnableIRQ(I2Cx_ER_IRQn);
+#endif
+
 #if DEBUG && 0
 	if ((I2Cx->SR1 & ~(I2C_SR1_TXE|I2C_SR1_RXNE|I2C_SR1_BTF)) != 0) {
 		LOGGER("TX I2Cx_SR1: 0x%04X", (uint )I2Cx->SR1);
@@ -606,6 +714,17 @@ err_t i2c_transmit_block(uint8_t addr, const uint8_t *tx_buffer, txsize_t tx_siz
 	}
 #endif
 
+#if uHAL_I2C_USE_QUEUE
+	// Inside an interrupt handler the queue may not be able to run so fall
+	// back to polling if it's idle
+	if (!IN_IRQ_CONTEXT()) {
+		return queue_block(addr, tx_buffer, tx_size, NULL, 0, timeout);
+	}
+	if ((queue_head != NULL) || stream_active) {
+		return ERR_RETRY;
+	}
+#endif
+
 	timeout = SET_TIMEOUT_MS(timeout);
 
 	if ((res = _i2c_transmit_block_begin(addr, timeout)) != ERR_OK) {
@@ -621,6 +740,385 @@ END:
 }
 
 
+#if uHAL_I2C_USE_QUEUE
+//
+// The running transaction is always at the head of the queue
+//
+// Start the transaction at the head of the queue; if the last one ended with
+// a repeated start, the start has already been requested
+static void start_transaction(void) {
+	i2c_transaction_t *txn = queue_head;
+
+	queue_pos = 0;
+	queue_addressed = false;
+	queue_state = (txn->tx_size > 0) ? QSTATE_START_TX : QSTATE_START_RX;
+
+	if (!queue_restarting) {
+		// A stop condition needs to finish going out before the next start is
+		// requested
+		for (uint32_t i = STOP_WAIT_LOOPS; (i > 0) && BIT_IS_SET(I2Cx->CR1, I2C_CR1_STOP); --i) {
+			// Nothing to do here
+		}
+		CLEAR_BIT(I2Cx->SR1, I2C_SR1_BERR|I2C_SR1_ARLO|I2C_SR1_AF|I2C_SR1_OVR);
+		SET_BIT(I2Cx->CR1, I2C_CR1_START);
+	}
+	queue_restarting = false;
+
+	MODIFY_BITS(I2Cx->CR2, I2C_CR2_IT_ALL, I2C_CR2_ITEVTEN|I2C_CR2_ITERREN);
+
+	return;
+}
+//
+// End the bus activity of the running transaction; if another one is waiting
+// it follows with a repeated start, otherwise the bus is released
+static void release_bus(const i2c_transaction_t *txn) {
+	if (txn->next != NULL) {
+		queue_restarting = true;
+		SET_BIT(I2Cx->CR1, I2C_CR1_START);
+	} else {
+		queue_restarting = false;
+		SET_BIT(I2Cx->CR1, I2C_CR1_STOP);
+	}
+
+	return;
+}
+//
+// Report the result of a transaction removed from the queue
+static void report_transaction(i2c_transaction_t *txn, err_t res) {
+	i2c_callback_t cb = txn->callback;
+
+	txn->next = NULL;
+	txn->res = res;
+	txn->busy = false;
+	if (cb != NULL) {
+		cb(res, txn->cb_data);
+	}
+
+	return;
+}
+//
+// Remove the running transaction from the queue and move on to the next one
+// The callback is called last so that it can queue a new transaction
+static void finish_transaction(err_t res) {
+	i2c_transaction_t *txn = queue_head;
+
+	queue_head = txn->next;
+	if (queue_head == NULL) {
+		queue_tail = NULL;
+		CLEAR_BIT(I2Cx->CR2, I2C_CR2_IT_ALL);
+	} else {
+		start_transaction();
+	}
+	report_transaction(txn, res);
+
+	return;
+}
+//
+// Stop the running transaction and drop everything in the queue
+static void abort_queue(err_t res) {
+	i2c_transaction_t *txn = queue_head;
+
+	CLEAR_BIT(I2Cx->CR2, I2C_CR2_IT_ALL);
+	if (txn == NULL) {
+		return;
+	}
+
+	CLEAR_BIT(I2Cx->CR1, I2C_CR1_START);
+	if (BUS_IS_OWNED(I2Cx)) {
+		SET_BIT(I2Cx->CR1, I2C_CR1_STOP);
+	}
+	CLEAR_BIT(I2Cx->CR1, I2C_CR1_POS);
+	queue_restarting = false;
+
+	// The whole queue is detached first in case a callback queues something new
+	queue_head = NULL;
+	queue_tail = NULL;
+	while (txn != NULL) {
+		i2c_transaction_t *next = txn->next;
+
+		report_transaction(txn, res);
+		txn = next;
+	}
+
+	return;
+}
+
+static void begin_reception(i2c_transaction_t *txn) {
+	volatile uint32_t tmp;
+
+	// The stop procedures are taken from the reference manual, the same as in
+	// i2c_receive_block()
+	switch (txn->rx_size) {
+	case 1:
+		CLEAR_BIT(I2Cx->CR1, I2C_CR1_ACK|I2C_CR1_POS);
+		// Read SR2 to clear the ADDR flag
+		tmp = I2Cx->SR2;
+		release_bus(txn);
+		// Wait for RXNE
+		SET_BIT(I2Cx->CR2, I2C_CR2_ITBUFEN);
+		break;
+
+	case 2:
+		MODIFY_BITS(I2Cx->CR1, I2C_CR1_ACK|I2C_CR1_POS, I2C_CR1_POS);
+		// Read SR2 to clear the ADDR flag
+		tmp = I2Cx->SR2;
+		// Wait for BTF, which means both bytes have arrived
+		CLEAR_BIT(I2Cx->CR2, I2C_CR2_ITBUFEN);
+		break;
+
+	default:
+		MODIFY_BITS(I2Cx->CR1, I2C_CR1_ACK|I2C_CR1_POS, I2C_CR1_ACK);
+		// Read SR2 to clear the ADDR flag
+		tmp = I2Cx->SR2;
+		// Use RXNE for all but the last 3 bytes and BTF for those
+		if (txn->rx_size > 3) {
+			SET_BIT(I2Cx->CR2, I2C_CR2_ITBUFEN);
+		} else {
+			CLEAR_BIT(I2Cx->CR2, I2C_CR2_ITBUFEN);
+		}
+		break;
+	}
+
+	UNUSED(tmp);
+	return;
+}
+static void receive_event(i2c_transaction_t *txn, uint32_t sr1) {
+	txsize_t left = txn->rx_size - queue_pos;
+
+	if (left == 1) {
+		// Only reached by single-byte receptions, the bus was already released
+		// when the address was acknowledged
+		if (BIT_IS_SET(sr1, I2C_SR1_RXNE)) {
+			txn->rx_buffer[queue_pos++] = I2Cx->DR;
+			finish_transaction(ERR_OK);
+		}
+	} else if (left > 3) {
+		if (BIT_IS_SET(sr1, I2C_SR1_RXNE)) {
+			txn->rx_buffer[queue_pos++] = I2Cx->DR;
+			if (left == 4) {
+				CLEAR_BIT(I2Cx->CR2, I2C_CR2_ITBUFEN);
+			}
+		}
+	} else if (BIT_IS_SET(sr1, I2C_SR1_BTF)) {
+		// Byte n-2 is in DR and n-1 is in the shift register
+		if (left == 3) {
+			CLEAR_BIT(I2Cx->CR1, I2C_CR1_ACK);
+			txn->rx_buffer[queue_pos++] = I2Cx->DR;
+		// Byte n-1 is in DR and n is in the shift register
+		} else {
+			release_bus(txn);
+			txn->rx_buffer[queue_pos++] = I2Cx->DR;
+			txn->rx_buffer[queue_pos++] = I2Cx->DR;
+			finish_transaction(ERR_OK);
+		}
+	}
+
+	return;
+}
+static void transmit_event(i2c_transaction_t *txn, uint32_t sr1) {
+	if (queue_pos < txn->tx_size) {
+		if (BIT_IS_SET(sr1, I2C_SR1_TXE)) {
+			I2Cx->DR = txn->tx_buffer[queue_pos++];
+			// Wait for BTF once the last byte is in, so we know it's been sent
+			if (queue_pos == txn->tx_size) {
+				CLEAR_BIT(I2Cx->CR2, I2C_CR2_ITBUFEN);
+			}
+		}
+	} else if (BIT_IS_SET(sr1, I2C_SR1_BTF)) {
+		if (txn->rx_size > 0) {
+			queue_pos = 0;
+			queue_addressed = false;
+			queue_state = QSTATE_START_RX;
+			SET_BIT(I2Cx->CR1, I2C_CR1_START);
+		} else {
+			release_bus(txn);
+			finish_transaction(ERR_OK);
+		}
+	}
+
+	return;
+}
+void I2Cx_EV_IRQHandler(void) {
+	i2c_transaction_t *txn = queue_head;
+	uint32_t sr1 = I2Cx->SR1;
+	volatile uint32_t tmp;
+
+	if (txn == NULL) {
+		CLEAR_BIT(I2Cx->CR2, I2C_CR2_IT_ALL);
+		return;
+	}
+
+	switch (queue_state) {
+	// BTF may stay set for a little while after a repeated start is requested
+	// and nothing else is interesting until the start goes out
+	case QSTATE_START_TX:
+	case QSTATE_START_RX:
+		if (BIT_IS_SET(sr1, I2C_SR1_SB)) {
+			// Writing DR clears the SB flag
+			if (queue_state == QSTATE_START_TX) {
+				queue_state = QSTATE_TX;
+				I2Cx->DR = (txn->addr << 1U) | 0x00U;
+			} else {
+				queue_state = QSTATE_RX;
+				I2Cx->DR = (txn->addr << 1U) | 0x01U;
+			}
+		}
+		break;
+
+	case QSTATE_TX:
+		if (BIT_IS_SET(sr1, I2C_SR1_ADDR)) {
+			queue_addressed = true;
+			// Read SR2 to clear the ADDR flag
+			tmp = I2Cx->SR2;
+			// Wait for TXE
+			SET_BIT(I2Cx->CR2, I2C_CR2_ITBUFEN);
+		} else {
+			transmit_event(txn, sr1);
+		}
+		break;
+
+	case QSTATE_RX:
+		if (BIT_IS_SET(sr1, I2C_SR1_ADDR)) {
+			queue_addressed = true;
+			begin_reception(txn);
+		} else {
+			receive_event(txn, sr1);
+		}
+		break;
+	}
+
+	UNUSED(tmp);
+	return;
+}
+void I2Cx_ER_IRQHandler(void) {
+	uint32_t sr1 = I2Cx->SR1;
+	err_t res;
+
+	CLEAR_BIT(I2Cx->SR1, I2C_SR1_BERR|I2C_SR1_ARLO|I2C_SR1_AF|I2C_SR1_OVR);
+	if (queue_head == NULL) {
+		CLEAR_BIT(I2Cx->CR2, I2C_CR2_IT_ALL);
+		return;
+	}
+
+	if (BIT_IS_SET(sr1, I2C_SR1_ARLO)) {
+		// The peripheral drops back to slave mode by itself
+		res = ERR_RETRY;
+	} else if (BIT_IS_SET(sr1, I2C_SR1_AF)) {
+		// A NACK of the address means there's nothing there, after that it
+		// means the device couldn't or didn't want to take more data
+		res = (queue_addressed) ? ERR_INTERRUPT : ERR_NODEV;
+	} else if (BIT_IS_SET(sr1, I2C_SR1_BERR)) {
+		res = ERR_UNKNOWN;
+	} else if (BIT_IS_SET(sr1, I2C_SR1_OVR)) {
+		res = ERR_IO;
+	} else {
+		return;
+	}
+
+	CLEAR_BIT(I2Cx->CR1, I2C_CR1_START|I2C_CR1_POS);
+	if (BUS_IS_OWNED(I2Cx)) {
+		SET_BIT(I2Cx->CR1, I2C_CR1_STOP);
+	}
+	queue_restarting = false;
+	finish_transaction(res);
+
+	return;
+}
+
+err_t i2c_queue_transaction(i2c_transaction_t *txn) {
+	uHAL_assert(PERIPH_IS_INITIALIZED(I2Cx));
+	uHAL_assert(txn != NULL);
+	uHAL_assert(txn->addr <= 0x7FU);
+	uHAL_assert(TXN_OK(txn));
+#if ! uHAL_SKIP_INIT_CHECKS
+	if (!PERIPH_IS_INITIALIZED(I2Cx)) {
+		return ERR_INIT;
+	}
+#endif
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if ((txn == NULL) || (txn->addr > 0x7FU) || !TXN_OK(txn)) {
+		return ERR_BADARG;
+	}
+#endif
+	if (txn->busy) {
+		return ERR_RETRY;
+	}
+
+	txn->next = NULL;
+	txn->res = ERR_OK;
+	txn->busy = true;
+
+	NVIC_DisableIRQ(I2Cx_EV_IRQn);
+	NVIC_DisableIRQ(I2Cx_ER_IRQn);
+	if (queue_head == NULL) {
+		queue_head = txn;
+		queue_tail = txn;
+		// The bus may be in use by i2c_transmit_block_begin() through _end(),
+		// in which case the queue is started by i2c_transmit_block_end()
+		if (!stream_active) {
+			queue_restarting = false;
+			start_transaction();
+		}
+	} else {
+		queue_tail->next = txn;
+		queue_tail = txn;
+	}
+	NVIC_EnableIRQ(I2Cx_EV_IRQn);
+	NVIC_EnableIRQ(I2Cx_ER_IRQn);
+
+	return ERR_OK;
+}
+bool i2c_queue_is_busy(void) {
+	return (queue_head != NULL);
+}
+err_t i2c_queue_wait(const i2c_transaction_t *txn, utime_t timeout) {
+	timeout = SET_TIMEOUT_MS(timeout);
+
+	while ((txn != NULL) ? txn->busy : (queue_head != NULL)) {
+		// Interrupts are masked between checking the flag and sleeping so that
+		// the last interrupt can't slip in between and leave us waiting on the
+		// next systick; a pending IRQ still ends WFI
+		__disable_irq();
+		if ((txn != NULL) ? txn->busy : (queue_head != NULL)) {
+			__WFI();
+		}
+		__enable_irq();
+
+		if (TIMES_UP(timeout)) {
+			NVIC_DisableIRQ(I2Cx_EV_IRQn);
+			NVIC_DisableIRQ(I2Cx_ER_IRQn);
+			if ((txn != NULL) ? txn->busy : (queue_head != NULL)) {
+				abort_queue(ERR_TIMEOUT);
+			}
+			NVIC_EnableIRQ(I2Cx_EV_IRQn);
+			NVIC_EnableIRQ(I2Cx_ER_IRQn);
+			break;
+		}
+	}
+
+	if (txn != NULL) {
+		return txn->res;
+	}
+	return (queue_head == NULL) ? ERR_OK : ERR_TIMEOUT;
+}
+static err_t queue_block(uint8_t addr, const uint8_t *tx_buffer, txsize_t tx_size, uint8_t *rx_buffer, txsize_t rx_size, utime_t timeout) {
+	err_t res;
+	i2c_transaction_t txn = {
+		.tx_buffer = tx_buffer,
+		.rx_buffer = rx_buffer,
+		.tx_size = tx_size,
+		.rx_size = rx_size,
+		.addr = addr,
+	};
+
+	if ((res = i2c_queue_transaction(&txn)) != ERR_OK) {
+		return res;
+	}
+	return i2c_queue_wait(&txn, timeout);
+}
+#endif // uHAL_I2C_USE_QUEUE
+
+
 /*
 err_t i2c_transmit_block(uint8_t addr, const uint8_t *tx_buffer, txsize_t tx_size, utime_t timeout) {
 	err_t res;
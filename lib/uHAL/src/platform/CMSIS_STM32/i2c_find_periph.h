@@ -1,5 +1,5 @@
 //
-// Generated by tools/cmsis/i2c_find_periph.sh on Mon Nov 25 03:58:32 PM EST 2024
+// Generated by tools/cmsis/i2c_find_periph.sh on Sun Oct 18 08:38:20 UTC 2026
 //
 
 #if INCLUDED_BY_I2C_C
@@ -55,6 +55,10 @@
 #  define I2Cx I2C1
 #  define I2Cx_CLOCKEN RCC_PERIPH_I2C1
 #  define I2Cx_AF GPIOAF_I2C1
+#  define I2Cx_EV_IRQn I2C1_EV_IRQn
+#  define I2Cx_ER_IRQn I2C1_ER_IRQn
+#  define I2Cx_EV_IRQHandler I2C1_EV_IRQHandler
+#  define I2Cx_ER_IRQHandler I2C1_ER_IRQHandler
 # endif
 
 #else // HAVE_I2C1
@@ -111,6 +115,10 @@
 #  define I2Cx I2C2
 #  define I2Cx_CLOCKEN RCC_PERIPH_I2C2
 #  define I2Cx_AF GPIOAF_I2C2
+#  define I2Cx_EV_IRQn I2C2_EV_IRQn
+#  define I2Cx_ER_IRQn I2C2_ER_IRQn
+#  define I2Cx_EV_IRQHandler I2C2_EV_IRQHandler
+#  define I2Cx_ER_IRQHandler I2C2_ER_IRQHandler
 # endif
 
 #else // HAVE_I2C2
@@ -167,6 +175,10 @@
 #  define I2Cx I2C3
 #  define I2Cx_CLOCKEN RCC_PERIPH_I2C3
 #  define I2Cx_AF GPIOAF_I2C3
+#  define I2Cx_EV_IRQn I2C3_EV_IRQn
+#  define I2Cx_ER_IRQn I2C3_ER_IRQn
+#  define I2Cx_EV_IRQHandler I2C3_EV_IRQHandler
+#  define I2Cx_ER_IRQHandler I2C3_ER_IRQHandler
 # endif
 
 #else // HAVE_I2C3
@@ -232,6 +232,16 @@ typedef struct {
 	uint8_t buffer[UART_INPUT_BUFFER_BYTES];
 	uint8_t bytes;
 } uart_buffer_t;
+#if UART_OUTPUT_BUFFER_BYTES > 0
+typedef uint_fast16_t uart_tx_index_t;
+// The head is only written by the transmit functions and the tail only by the
+// ISR, so neither side needs to disable interrupts to touch the buffer
+typedef struct {
+	uint8_t buffer[UART_OUTPUT_BUFFER_BYTES];
+	uart_tx_index_t head;
+	uart_tx_index_t tail;
+} uart_tx_buffer_t;
+#endif
 typedef struct {
 	USART_TypeDef *uartx;
 	// Need to know the pins and clock when turning the peripheral on or off.
@@ -246,6 +256,9 @@ typedef struct {
 #if UART_INPUT_BUFFER_BYTES > 0
 	volatile uart_buffer_t rx_buf;
 #endif
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	volatile uart_tx_buffer_t tx_buf;
+#endif
 } uart_port_t;
 
 typedef enum {
@@ -40,6 +40,7 @@
 #define HAVE_STM32F1_HSI    1
 #define HAVE_STM32F1_LSI    1
 #define HAVE_STM32F1_FLASH  1
+#define HAVE_STM32F1_DMA    1
 #define HAVE_AHB2           0
 #define HAVE_AHB_RESET      0
 //
@@ -49,6 +49,16 @@
 # endif
 #endif
 
+//
+// Flash page size, which is what the flash data area is allocated in
+// Programming is always done in half-words
+#if defined(STM32F103x4) || defined(STM32F103x6) || defined(STM32F103xB) || defined(STM32F103x8)
+# define FLASH_PAGE_BYTES 1024U
+#else
+# define FLASH_PAGE_BYTES 2048U
+#endif
+#define FLASH_WRITE_BYTES 2U
+
 //
 // This is used when setting up the PLL clock source
 //
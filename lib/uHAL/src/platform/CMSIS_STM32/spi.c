@@ -24,6 +24,13 @@
 //    mode can be corrupted if the GPIO clock is set too slow for the APB bus
 //    clock. Bus speeds below 28MHz would seem to be unaffected by this.
 //
+//    When DMA is used, every transfer runs both channels even if only one
+//    direction is wanted: receive-only transfers send a fixed fill byte from
+//    a non-incrementing source and transmit-only transfers dump what comes
+//    back into a non-incrementing sink. That keeps RXNE drained so there's
+//    no overrun to clean up and lets the RX channel's transfer-complete flag
+//    mark the end of the transfer in both cases.
+//
 #include "spi.h"
 #include "system.h"
 #include "gpio.h"
@@ -38,6 +45,15 @@
 # error "Can't determine SPI peripheral"
 #endif
 
+#if uHAL_SPI_USE_DMA
+# include "spi_dma.h"
+#endif
+#if uHAL_SPI_USE_DMA && defined(SPIx_DMA)
+# define USE_SPI_DMA 1
+#else
+# define USE_SPI_DMA 0
+#endif
+
 #if (SPIx_CLOCKEN & RCC_BUS_MASK) == RCC_BUS_APB1
 # define SPIx_BUSFREQ G_freq_PCLK1
 #elif (SPIx_CLOCKEN & RCC_BUS_MASK) == RCC_BUS_APB2
@@ -59,6 +75,55 @@
 
 #define BUS_IS_FREE(_spix_) (SELECT_BITS((_spix_)->SR, SPI_SR_TXE|SPI_SR_BSY) == SPI_SR_TXE)
 
+#if USE_SPI_DMA
+# if HAVE_STM32F1_DMA
+#  define DMA_CH_CR(_ch_)  ((_ch_)->CCR)
+#  define DMA_CR_EN   DMA_CCR_EN
+#  define DMA_CR_TCIE DMA_CCR_TCIE
+#  define DMA_CR_TEIE DMA_CCR_TEIE
+// Each channel has 4 flags in the ISR and IFCR registers
+#  define DMA_FLAG_POS(_ch_) (4U * ((_ch_) - 1U))
+#  define DMA_FLAGS(_ch_) (0x0FU << DMA_FLAG_POS(_ch_))
+#  define DMA_TCIF(_ch_)  (DMA_ISR_TCIF1 << DMA_FLAG_POS(_ch_))
+#  define DMA_TEIF(_ch_)  (DMA_ISR_TEIF1 << DMA_FLAG_POS(_ch_))
+#  define DMA_ISR(_ch_)  (SPIx_DMA->ISR)
+#  define DMA_IFCR(_ch_) (SPIx_DMA->IFCR)
+typedef DMA_Channel_TypeDef dma_ch_t;
+# else
+#  define DMA_CH_CR(_ch_)  ((_ch_)->CR)
+#  define DMA_CR_EN   DMA_SxCR_EN
+#  define DMA_CR_TCIE DMA_SxCR_TCIE
+#  define DMA_CR_TEIE DMA_SxCR_TEIE
+// Streams 0-3 have their flags in the low registers and 4-7 in the high
+// registers, at bit offsets 0, 6, 16, and 22
+#  define DMA_FLAG_POS(_ch_) ((((_ch_) & 0x03U) * 6U) + ((((_ch_) & 0x03U) > 1U) ? 4U : 0U))
+#  define DMA_FLAGS(_ch_) (0x3DU << DMA_FLAG_POS(_ch_))
+#  define DMA_TCIF(_ch_)  (DMA_LISR_TCIF0 << DMA_FLAG_POS(_ch_))
+#  define DMA_TEIF(_ch_)  (DMA_LISR_TEIF0 << DMA_FLAG_POS(_ch_))
+#  define DMA_ISR(_ch_)  (((_ch_) < 4U) ? SPIx_DMA->LISR : SPIx_DMA->HISR)
+#  define DMA_IFCR(_ch_) (*(((_ch_) < 4U) ? &SPIx_DMA->LIFCR : &SPIx_DMA->HIFCR))
+typedef DMA_Stream_TypeDef dma_ch_t;
+# endif
+
+// Channel priorities; the RX channel is higher so that a received byte is
+// always collected before the next one can arrive
+# define DMA_RX_PRIORITY 0b10U
+# define DMA_TX_PRIORITY 0b01U
+
+static volatile bool dma_busy = false;
+// Set while we hold a use of the DMA controller's clock
+static bool dma_clock_held = false;
+static volatile err_t dma_res = ERR_OK;
+static spi_callback_t dma_callback = NULL;
+static void *dma_cb_data = NULL;
+// Source of the fill byte for receive-only transfers and sink for the bytes
+// received during transmit-only transfers
+static uint8_t dma_tx_fill;
+static uint8_t dma_rx_sink;
+
+static void dma_stop(void);
+static void finish_dma_transfer(err_t res);
+#endif // USE_SPI_DMA
 
 static uint32_t calculate_prescaler(uint32_t goal);
 
@@ -83,6 +148,10 @@ void spi_init(void) {
 		calculate_prescaler(SPI_FREQUENCY_HZ) | // Baud rate prescaler
 		0);
 
+#if USE_SPI_DMA
+	NVIC_SetPriority(SPIx_DMA_RX_IRQn, SPI_DMA_IRQp);
+#endif
+
 	spi_off();
 
 	return;
@@ -150,6 +219,15 @@ err_t spi_on(void) {
 
 	pins_on();
 
+#if USE_SPI_DMA
+	if (!dma_clock_held) {
+		dma_clock_acquire(SPIx_DMA_CLOCKEN);
+		dma_clock_held = true;
+	}
+	NVIC_ClearPendingIRQ(SPIx_DMA_RX_IRQn);
+	NVIC_EnableIRQ(SPIx_DMA_RX_IRQn);
+#endif
+
 	return ERR_OK;
 }
 err_t spi_off(void) {
@@ -166,6 +244,20 @@ err_t spi_off(void) {
 	}
 #endif
 
+#if USE_SPI_DMA
+	NVIC_DisableIRQ(SPIx_DMA_RX_IRQn);
+	// Anything still running is being abandoned
+	if (dma_busy) {
+		finish_dma_transfer(ERR_INTERRUPT);
+	}
+	NVIC_ClearPendingIRQ(SPIx_DMA_RX_IRQn);
+	// The ADC may be using the same controller
+	if (dma_clock_held) {
+		dma_clock_release(SPIx_DMA_CLOCKEN);
+		dma_clock_held = false;
+	}
+#endif
+
 	// If the SPI peripheral clock is already disabled but the status flags
 	// for whatever reason haven't been cleared, this would become an infinite
 	// loop
@@ -200,6 +292,206 @@ bool spi_is_on(void) {
 	return (clock_is_enabled(SPIx_CLOCKEN) && BIT_IS_SET(SPIx->CR1, SPI_CR1_SPE));
 }
 
+#if USE_SPI_DMA
+static void dma_channel_setup(dma_ch_t *ch, volatile void *mem, txsize_t size, bool to_periph, bool increment, uint32_t priority, uint32_t irqs) {
+#if HAVE_STM32F1_DMA
+	CLEAR_BIT(ch->CCR, DMA_CCR_EN);
+
+	ch->CPAR = (uint32_t )&SPIx->DR;
+	ch->CMAR = (uint32_t )mem;
+	ch->CNDTR = size;
+	ch->CCR =
+		((to_periph ? 0b1U : 0b0U) << DMA_CCR_DIR_Pos  ) | // Direction
+		((increment ? 0b1U : 0b0U) << DMA_CCR_MINC_Pos ) | // Increment memory address
+		(0b0U                      << DMA_CCR_PINC_Pos ) | // Don't increment peripheral address
+		(0b00U                     << DMA_CCR_MSIZE_Pos) | // 8-bit memory access
+		(0b00U                     << DMA_CCR_PSIZE_Pos) | // 8-bit peripheral access
+		(priority                  << DMA_CCR_PL_Pos   ) | // Channel priority
+		irqs;
+#else
+	// The stream can't be configured until it's actually stopped
+	CLEAR_BIT(ch->CR, DMA_SxCR_EN);
+	while (BIT_IS_SET(ch->CR, DMA_SxCR_EN)) {
+		// Nothing to do here
+	}
+
+	ch->PAR = (uint32_t )&SPIx->DR;
+	ch->M0AR = (uint32_t )mem;
+	ch->NDTR = size;
+	// Direct mode, no FIFO
+	ch->FCR = 0;
+	ch->CR =
+		(SPIx_DMA_CHSEL            << DMA_SxCR_CHSEL_Pos) | // Request channel
+		((to_periph ? 0b01U : 0b00U) << DMA_SxCR_DIR_Pos) | // Direction
+		((increment ? 0b1U : 0b0U) << DMA_SxCR_MINC_Pos ) | // Increment memory address
+		(0b0U                      << DMA_SxCR_PINC_Pos ) | // Don't increment peripheral address
+		(0b00U                     << DMA_SxCR_MSIZE_Pos) | // 8-bit memory access
+		(0b00U                     << DMA_SxCR_PSIZE_Pos) | // 8-bit peripheral access
+		(priority                  << DMA_SxCR_PL_Pos   ) | // Stream priority
+		irqs;
+#endif
+
+	return;
+}
+static void dma_start(const uint8_t *tx_buffer, uint8_t *rx_buffer, txsize_t size) {
+	uint16_t rx;
+
+	// Clear any leftover data or overrun flag from earlier polled transfers
+	rx = SPIx->DR;
+	rx = SPIx->SR;
+	UNUSED(rx);
+
+	DMA_IFCR(SPIx_DMA_RX_CH) = DMA_FLAGS(SPIx_DMA_RX_CH);
+	DMA_IFCR(SPIx_DMA_TX_CH) = DMA_FLAGS(SPIx_DMA_TX_CH);
+
+	if (rx_buffer != NULL) {
+		dma_channel_setup(SPIx_DMA_RX, rx_buffer, size, false, true, DMA_RX_PRIORITY, DMA_CR_TCIE|DMA_CR_TEIE);
+	} else {
+		dma_channel_setup(SPIx_DMA_RX, &dma_rx_sink, size, false, false, DMA_RX_PRIORITY, DMA_CR_TCIE|DMA_CR_TEIE);
+	}
+	if (tx_buffer != NULL) {
+		dma_channel_setup(SPIx_DMA_TX, (volatile void *)tx_buffer, size, true, true, DMA_TX_PRIORITY, DMA_CR_TEIE);
+	} else {
+		dma_channel_setup(SPIx_DMA_TX, &dma_tx_fill, size, true, false, DMA_TX_PRIORITY, DMA_CR_TEIE);
+	}
+
+	// The reference manual has the RX request enabled before the channels
+	// and the TX request after; since TXE is already set the first byte goes
+	// out as soon as it's enabled
+	SET_BIT(SPIx->CR2, SPI_CR2_RXDMAEN);
+	SET_BIT(DMA_CH_CR(SPIx_DMA_RX), DMA_CR_EN);
+	SET_BIT(DMA_CH_CR(SPIx_DMA_TX), DMA_CR_EN);
+	SET_BIT(SPIx->CR2, SPI_CR2_TXDMAEN);
+
+	return;
+}
+static void dma_stop(void) {
+	CLEAR_BIT(SPIx->CR2, SPI_CR2_TXDMAEN|SPI_CR2_RXDMAEN);
+	CLEAR_BIT(DMA_CH_CR(SPIx_DMA_TX), DMA_CR_EN);
+	CLEAR_BIT(DMA_CH_CR(SPIx_DMA_RX), DMA_CR_EN);
+
+	DMA_IFCR(SPIx_DMA_RX_CH) = DMA_FLAGS(SPIx_DMA_RX_CH);
+	DMA_IFCR(SPIx_DMA_TX_CH) = DMA_FLAGS(SPIx_DMA_TX_CH);
+
+	return;
+}
+static void finish_dma_transfer(err_t res) {
+	spi_callback_t cb = dma_callback;
+
+	dma_stop();
+
+	dma_callback = NULL;
+	dma_res = res;
+	dma_busy = false;
+
+	if (cb != NULL) {
+		cb(res, dma_cb_data);
+	}
+
+	return;
+}
+void SPIx_DMA_RX_IRQHandler(void) {
+	uint32_t flags;
+
+	flags = DMA_ISR(SPIx_DMA_RX_CH) & (DMA_TCIF(SPIx_DMA_RX_CH)|DMA_TEIF(SPIx_DMA_RX_CH));
+	// A TX channel error stops the transfer so the RX channel never completes;
+	// that's caught by the timeout in spi_transfer_wait()
+	if (BIT_IS_SET(flags, DMA_TEIF(SPIx_DMA_RX_CH))) {
+		finish_dma_transfer(ERR_IO);
+	} else if (BIT_IS_SET(flags, DMA_TCIF(SPIx_DMA_RX_CH))) {
+		finish_dma_transfer(ERR_OK);
+	} else {
+		DMA_IFCR(SPIx_DMA_RX_CH) = DMA_FLAGS(SPIx_DMA_RX_CH);
+	}
+	NVIC_ClearPendingIRQ(SPIx_DMA_RX_IRQn);
+
+	return;
+}
+
+err_t spi_transfer_async(const uint8_t *tx_buffer, uint8_t *rx_buffer, txsize_t size, uint8_t tx, spi_callback_t callback, void *cb_data) {
+	uHAL_assert(size > 0);
+#if ! uHAL_SKIP_INIT_CHECKS
+	if (!spi_is_on()) {
+		return ERR_INIT;
+	}
+#endif
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (size == 0) {
+		return ERR_BADARG;
+	}
+#endif
+	if (dma_busy) {
+		return ERR_RETRY;
+	}
+
+	dma_busy = true;
+	dma_res = ERR_OK;
+	dma_callback = callback;
+	dma_cb_data = cb_data;
+	dma_tx_fill = tx;
+
+	dma_start(tx_buffer, rx_buffer, size);
+
+	return ERR_OK;
+}
+bool spi_transfer_is_busy(void) {
+	return dma_busy;
+}
+err_t spi_transfer_wait(utime_t timeout) {
+	timeout = SET_TIMEOUT_MS(timeout);
+
+	while (dma_busy) {
+		// Interrupts are masked between checking the flag and sleeping so that
+		// the completion IRQ can't slip in between and leave us waiting on
+		// the next systick; a pending IRQ still ends WFI
+		__disable_irq();
+		if (dma_busy) {
+			__WFI();
+		}
+		__enable_irq();
+
+		if (TIMES_UP(timeout)) {
+			NVIC_DisableIRQ(SPIx_DMA_RX_IRQn);
+			if (dma_busy) {
+				finish_dma_transfer(ERR_TIMEOUT);
+			}
+			NVIC_EnableIRQ(SPIx_DMA_RX_IRQn);
+			break;
+		}
+	}
+
+	return dma_res;
+}
+static err_t dma_transfer_block(const uint8_t *tx_buffer, uint8_t *rx_buffer, txsize_t size, uint8_t tx, utime_t timeout) {
+	err_t res;
+
+	if ((res = spi_transfer_async(tx_buffer, rx_buffer, size, tx, NULL, NULL)) != ERR_OK) {
+		return res;
+	}
+	return spi_transfer_wait(timeout);
+}
+
+#else // USE_SPI_DMA
+err_t spi_transfer_async(const uint8_t *tx_buffer, uint8_t *rx_buffer, txsize_t size, uint8_t tx, spi_callback_t callback, void *cb_data) {
+	UNUSED(tx_buffer);
+	UNUSED(rx_buffer);
+	UNUSED(size);
+	UNUSED(tx);
+	UNUSED(callback);
+	UNUSED(cb_data);
+
+	return ERR_NOTSUP;
+}
+bool spi_transfer_is_busy(void) {
+	return false;
+}
+err_t spi_transfer_wait(utime_t timeout) {
+	UNUSED(timeout);
+
+	return ERR_OK;
+}
+#endif // USE_SPI_DMA
+
 err_t spi_exchange_byte(uint8_t tx, uint8_t *rx, utime_t timeout) {
 	err_t res;
 
@@ -212,6 +504,12 @@ err_t spi_exchange_byte(uint8_t tx, uint8_t *rx, utime_t timeout) {
 	}
 #endif
 
+#if USE_SPI_DMA && ! uHAL_SKIP_OTHER_CHECKS
+	if (dma_busy) {
+		return ERR_RETRY;
+	}
+#endif
+
 	res = ERR_OK;
 	timeout = SET_TIMEOUT_MS(timeout);
 
@@ -250,6 +548,17 @@ err_t spi_receive_block(uint8_t *rx_buffer, txsize_t rx_size, uint8_t tx, utime_
 	}
 #endif
 
+#if USE_SPI_DMA
+	if (rx_size >= SPI_DMA_MIN_BYTES) {
+		return dma_transfer_block(NULL, rx_buffer, rx_size, tx, timeout);
+	}
+# if ! uHAL_SKIP_OTHER_CHECKS
+	if (dma_busy) {
+		return ERR_RETRY;
+	}
+# endif
+#endif
+
 	res = ERR_OK;
 	timeout = SET_TIMEOUT_MS(timeout);
 
@@ -309,6 +618,17 @@ err_t spi_transmit_block(const uint8_t *tx_buffer, txsize_t tx_size, utime_t tim
 	}
 #endif
 
+#if USE_SPI_DMA
+	if (tx_size >= SPI_DMA_MIN_BYTES) {
+		return dma_transfer_block(tx_buffer, NULL, tx_size, 0xFFU, timeout);
+	}
+# if ! uHAL_SKIP_OTHER_CHECKS
+	if (dma_busy) {
+		return ERR_RETRY;
+	}
+# endif
+#endif
+
 	res = ERR_OK;
 	timeout = SET_TIMEOUT_MS(timeout);
 
@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// spi_dma.h
+// Find the DMA channels serving the SPI peripheral
+// NOTES:
+//   This should only be included by spi.c, after spi_find_periph.h
+//
+//   The channel assignments come from the DMA request mapping tables in the
+//   reference manuals (RM0008 tables 78 and 79 for the F1 line, RM0368 tables
+//   27 and 28 for the F401/F411). Only the RX channel interrupt is used; the
+//   last byte received marks the end of the transfer in both directions.
+//
+//   If no channels are found SPIx_DMA is left undefined and the block
+//   transfer functions fall back to polling.
+//
+
+#if INCLUDED_BY_SPI_C
+
+#if HAVE_STM32F1_DMA
+//
+// SPI1
+//
+# if !defined(SPIx_DMA) && IS_SPI1(SPI_MOSI_PIN, SPI_MISO_PIN, SPI_SCK_PIN) && defined(DMA1_Channel2)
+#  define SPIx_DMA DMA1
+#  define SPIx_DMA_CLOCKEN RCC_PERIPH_DMA1
+#  define SPIx_DMA_RX DMA1_Channel2
+#  define SPIx_DMA_RX_CH 2U
+#  define SPIx_DMA_RX_IRQn DMA1_Channel2_IRQn
+#  define SPIx_DMA_RX_IRQHandler DMA1_Channel2_IRQHandler
+#  define SPIx_DMA_TX DMA1_Channel3
+#  define SPIx_DMA_TX_CH 3U
+# endif
+//
+// SPI2
+//
+# if !defined(SPIx_DMA) && IS_SPI2(SPI_MOSI_PIN, SPI_MISO_PIN, SPI_SCK_PIN) && defined(DMA1_Channel4)
+#  define SPIx_DMA DMA1
+#  define SPIx_DMA_CLOCKEN RCC_PERIPH_DMA1
+#  define SPIx_DMA_RX DMA1_Channel4
+#  define SPIx_DMA_RX_CH 4U
+#  define SPIx_DMA_RX_IRQn DMA1_Channel4_IRQn
+#  define SPIx_DMA_RX_IRQHandler DMA1_Channel4_IRQHandler
+#  define SPIx_DMA_TX DMA1_Channel5
+#  define SPIx_DMA_TX_CH 5U
+# endif
+//
+// SPI3
+//
+# if !defined(SPIx_DMA) && IS_SPI3(SPI_MOSI_PIN, SPI_MISO_PIN, SPI_SCK_PIN) && defined(DMA2_Channel1)
+#  define SPIx_DMA DMA2
+#  define SPIx_DMA_CLOCKEN RCC_PERIPH_DMA2
+#  define SPIx_DMA_RX DMA2_Channel1
+#  define SPIx_DMA_RX_CH 1U
+#  define SPIx_DMA_RX_IRQn DMA2_Channel1_IRQn
+#  define SPIx_DMA_RX_IRQHandler DMA2_Channel1_IRQHandler
+#  define SPIx_DMA_TX DMA2_Channel2
+#  define SPIx_DMA_TX_CH 2U
+# endif
+
+#else // HAVE_STM32F1_DMA
+//
+// SPI1
+//
+# if !defined(SPIx_DMA) && IS_SPI1(SPI_MOSI_PIN, SPI_MISO_PIN, SPI_SCK_PIN) && defined(DMA2_Stream0)
+#  define SPIx_DMA DMA2
+#  define SPIx_DMA_CLOCKEN RCC_PERIPH_DMA2
+#  define SPIx_DMA_CHSEL 3U
+#  define SPIx_DMA_RX DMA2_Stream0
+#  define SPIx_DMA_RX_CH 0U
+#  define SPIx_DMA_RX_IRQn DMA2_Stream0_IRQn
+#  define SPIx_DMA_RX_IRQHandler DMA2_Stream0_IRQHandler
+#  define SPIx_DMA_TX DMA2_Stream3
+#  define SPIx_DMA_TX_CH 3U
+# endif
+//
+// SPI2
+//
+# if !defined(SPIx_DMA) && IS_SPI2(SPI_MOSI_PIN, SPI_MISO_PIN, SPI_SCK_PIN) && defined(DMA1_Stream3)
+#  define SPIx_DMA DMA1
+#  define SPIx_DMA_CLOCKEN RCC_PERIPH_DMA1
+#  define SPIx_DMA_CHSEL 0U
+#  define SPIx_DMA_RX DMA1_Stream3
+#  define SPIx_DMA_RX_CH 3U
+#  define SPIx_DMA_RX_IRQn DMA1_Stream3_IRQn
+#  define SPIx_DMA_RX_IRQHandler DMA1_Stream3_IRQHandler
+#  define SPIx_DMA_TX DMA1_Stream4
+#  define SPIx_DMA_TX_CH 4U
+# endif
+//
+// SPI3
+//
+# if !defined(SPIx_DMA) && IS_SPI3(SPI_MOSI_PIN, SPI_MISO_PIN, SPI_SCK_PIN) && defined(DMA1_Stream0)
+#  define SPIx_DMA DMA1
+#  define SPIx_DMA_CLOCKEN RCC_PERIPH_DMA1
+#  define SPIx_DMA_CHSEL 0U
+#  define SPIx_DMA_RX DMA1_Stream0
+#  define SPIx_DMA_RX_CH 0U
+#  define SPIx_DMA_RX_IRQn DMA1_Stream0_IRQn
+#  define SPIx_DMA_RX_IRQHandler DMA1_Stream0_IRQHandler
+#  define SPIx_DMA_TX DMA1_Stream5
+#  define SPIx_DMA_TX_CH 5U
+# endif
+//
+// SPI4
+//
+# if !defined(SPIx_DMA) && IS_SPI4(SPI_MOSI_PIN, SPI_MISO_PIN, SPI_SCK_PIN) && defined(DMA2_Stream0)
+#  define SPIx_DMA DMA2
+#  define SPIx_DMA_CLOCKEN RCC_PERIPH_DMA2
+#  define SPIx_DMA_CHSEL 4U
+#  define SPIx_DMA_RX DMA2_Stream0
+#  define SPIx_DMA_RX_CH 0U
+#  define SPIx_DMA_RX_IRQn DMA2_Stream0_IRQn
+#  define SPIx_DMA_RX_IRQHandler DMA2_Stream0_IRQHandler
+#  define SPIx_DMA_TX DMA2_Stream1
+#  define SPIx_DMA_TX_CH 1U
+# endif
+#endif // HAVE_STM32F1_DMA
+
+#endif // INCLUDED_BY_SPI_C
@@ -20,6 +20,10 @@
 // system.c
 // General platform initialization
 // NOTES:
+//   The retained memory block is placed in .noinit, which the startup code
+//   doesn't clear. The linker script has to keep that section out of .bss
+//   and below the heap, which retained_memory.ld checks at link time; none
+//   of the supported devices have backup SRAM to use instead.
 //
 #include "system.h"
 #include "adc.h"
@@ -187,6 +191,10 @@ DEBUG_CPP_MACRO(G_freq_PCLK2)
 
 
 static uint_fast8_t bd_write_enabled = 0;
+//
+// The DMA controllers are shared, so their clocks are only turned off once the
+// last peripheral using them is done
+static uint_fast8_t dma_clock_users[2] = { 0 };
 
 
 static void clocks_init(void);
@@ -196,6 +204,15 @@ void platform_reset(void) {
 	NVIC_SystemReset();
 }
 
+#if uHAL_RETAINED_MEMORY_BYTES > 0
+// Not static so that retained_memory.ld can find it
+uint8_t uHAL_retained_memory[uHAL_RETAINED_MEMORY_BYTES] __attribute__((section(".noinit"), aligned(8)));
+
+void* get_retained_memory(void) {
+	return uHAL_retained_memory;
+}
+#endif
+
 void platform_init(void) {
 	clocks_init();
 
@@ -817,6 +834,30 @@ void clock_init(rcc_periph_t periph_clock) {
 	return;
 }
 
+void dma_clock_acquire(rcc_periph_t dma_clock) {
+	uint_fast8_t *users = &dma_clock_users[(dma_clock == RCC_PERIPH_DMA1) ? 0 : 1];
+
+	if (*users == 0) {
+		clock_enable(dma_clock);
+	}
+	++*users;
+
+	return;
+}
+void dma_clock_release(rcc_periph_t dma_clock) {
+	uint_fast8_t *users = &dma_clock_users[(dma_clock == RCC_PERIPH_DMA1) ? 0 : 1];
+
+	if (*users == 0) {
+		return;
+	}
+	--*users;
+	if (*users == 0) {
+		clock_disable(dma_clock);
+	}
+
+	return;
+}
+
 void BD_write_enable(void) {
 	if (bd_write_enabled == 0) {
 		SET_BIT(PWR->CR, PWR_CR_DBP);
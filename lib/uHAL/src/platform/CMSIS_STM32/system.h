@@ -38,6 +38,8 @@
 #define UART_IRQp        4
 #define SLEEP_ALARM_IRQp 5
 #define USCOUNTER_IRQp   6
+#define SPI_DMA_IRQp     7
+#define I2C_IRQp         8
 
 
 // Initialize/Enable/Disable one or more peripheral clocks
@@ -47,6 +49,11 @@ void clock_enable(rcc_periph_t periph_clock);
 void clock_disable(rcc_periph_t periph_clock);
 // Check if a peripheral clock is enabled.
 bool clock_is_enabled(rcc_periph_t periph_clock);
+// Enable/Disable the clock of a DMA controller shared by several peripherals
+// The clock is only disabled once every peripheral that enabled it has
+// released it.
+void dma_clock_acquire(rcc_periph_t dma_clock);
+void dma_clock_release(rcc_periph_t dma_clock);
 
 // Enable/Disable writes to backup-domain registers
 void BD_write_enable(void);
@@ -51,6 +51,7 @@
 #endif
 
 DEBUG_CPP_MACRO(UART_INPUT_BUFFER_BYTES)
+DEBUG_CPP_MACRO(UART_OUTPUT_BUFFER_BYTES)
 
 #if defined(UART_COMM_PORT)
 # define SET_DEFAULT_PORT(_p_) do { if ((_p_) == NULL) (_p_) = UART_COMM_PORT; } while (0)
@@ -59,6 +60,9 @@ DEBUG_CPP_MACRO(UART_INPUT_BUFFER_BYTES)
 #endif
 
 static uint16_t calculate_baud_div(uint32_t baud, uint32_t busfreq);
+#if UART_OUTPUT_BUFFER_BYTES > 0
+static void poll_tx_buffer(const uart_port_t *p);
+#endif
 
 err_t uart_init_port(uart_port_t *p, const uart_port_cfg_t *conf) {
 	uint32_t tmp;
@@ -154,11 +158,12 @@ err_t uart_init_port(uart_port_t *p, const uart_port_cfg_t *conf) {
 
 	clock_init(p->clocken);
 
-	MODIFY_BITS(p->uartx->CR1, USART_CR1_M|USART_CR1_PCE|USART_CR1_PS|USART_CR1_RXNEIE|USART_CR1_UE|USART_CR1_TE|USART_CR1_RE,
+	MODIFY_BITS(p->uartx->CR1, USART_CR1_M|USART_CR1_PCE|USART_CR1_PS|USART_CR1_RXNEIE|USART_CR1_TXEIE|USART_CR1_UE|USART_CR1_TE|USART_CR1_RE,
 		(0b0 << USART_CR1_M_Pos     ) | // 0 for 8 data bits
 		(0b0 << USART_CR1_PCE_Pos   ) | // 0 to disable parity
 		(0b0 << USART_CR1_PS_Pos    ) | // 0 for even parity, 1 for odd parity
-		(0b1 << USART_CR1_RXNEIE_Pos) | // RXNE interrupt enable
+		(0b0 << USART_CR1_RXNEIE_Pos) | // RXNE interrupt enable; set by uart_listen_on()
+		(0b0 << USART_CR1_TXEIE_Pos ) | // TXE interrupt enable; set when output is queued
 		(0b1 << USART_CR1_TE_Pos    ) | // Enable transmission
 		(0b1 << USART_CR1_RE_Pos    ) | // Enable reception
 		0);
@@ -189,6 +194,10 @@ err_t uart_init_port(uart_port_t *p, const uart_port_cfg_t *conf) {
 #if UART_INPUT_BUFFER_BYTES > 0
 	p->rx_buf.bytes = 0;
 #endif
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	p->tx_buf.head = 0;
+	p->tx_buf.tail = 0;
+#endif
 
 	NVIC_SetPriority(p->irqn, UART_IRQp);
 #if ENABLE_UART_LISTENING
@@ -241,6 +250,11 @@ err_t uart_on(const uart_port_t *p) {
 	while (!BIT_IS_SET(p->uartx->CR1, USART_CR1_UE)) {
 		// Nothing to do here
 	}
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	// The IRQ is needed to drain the output buffer whether or not we're
+	// listening
+	NVIC_EnableIRQ(p->irqn);
+#endif
 
 	return ERR_OK;
 }
@@ -258,6 +272,15 @@ err_t uart_off(const uart_port_t *p) {
 	}
 #endif
 
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	if (BIT_IS_SET(p->uartx->CR1, USART_CR1_UE)) {
+		uart_flush(p, UART_COMM_TIMEOUT_MS);
+	}
+	CLEAR_BIT(p->uartx->CR1, USART_CR1_TXEIE);
+	// Anything that couldn't be sent is lost
+	((uart_port_t *)p)->tx_buf.tail = p->tx_buf.head;
+#endif
+
 	CLEAR_BIT(p->uartx->CR1, USART_CR1_UE);
 	while (BIT_IS_SET(p->uartx->CR1, USART_CR1_UE)) {
 		// Nothing to do here
@@ -299,6 +322,7 @@ err_t uart_listen_on(const uart_port_t *p) {
 	}
 #endif
 
+	SET_BIT(p->uartx->CR1, USART_CR1_RXNEIE);
 	NVIC_ClearPendingIRQ(p->irqn);
 	NVIC_EnableIRQ(p->irqn);
 
@@ -318,8 +342,11 @@ err_t uart_listen_off(const uart_port_t *p) {
 	}
 #endif
 
+	CLEAR_BIT(p->uartx->CR1, USART_CR1_RXNEIE);
+#if UART_OUTPUT_BUFFER_BYTES == 0
 	NVIC_DisableIRQ(p->irqn);
 	NVIC_ClearPendingIRQ(p->irqn);
+#endif
 
 	return ERR_OK;
 }
@@ -337,7 +364,12 @@ bool uart_is_listening(const uart_port_t *p) {
 	}
 #endif
 
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	// The IRQ is left enabled for transmission so it doesn't tell us anything
+	return BIT_IS_SET(p->uartx->CR1, USART_CR1_RXNEIE);
+#else
 	return (NVIC_GetEnableIRQ(p->irqn) != 0);
+#endif
 }
 bool uart_rx_is_available(const uart_port_t *p) {
 #if UART_INPUT_BUFFER_BYTES > 0
@@ -370,6 +402,24 @@ err_t uart_transmit_block(uart_port_t *p, const uint8_t *buffer, txsize_t size,
 	res = ERR_OK;
 	timeout = SET_TIMEOUT_MS(timeout);
 
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	while (size > 0) {
+		txsize_t queued = uart_tx_buffer_push(&p->tx_buf, buffer, size);
+
+		if (queued > 0) {
+			buffer += queued;
+			size -= queued;
+			// The ISR turns this back off when the buffer runs dry
+			SET_BIT(p->uartx->CR1, USART_CR1_TXEIE);
+		} else if (TIMES_UP(timeout)) {
+			res = ERR_TIMEOUT;
+			break;
+		} else {
+			poll_tx_buffer(p);
+		}
+	}
+
+#else // UART_OUTPUT_BUFFER_BYTES > 0
 	for (txsize_t i = 0; i < size; ++i) {
 		p->uartx->DR = buffer[i];
 		while (!BIT_IS_SET(p->uartx->SR, USART_SR_TXE)) {
@@ -387,8 +437,48 @@ err_t uart_transmit_block(uart_port_t *p, const uint8_t *buffer, txsize_t size,
 	}
 
 END:
+#endif // UART_OUTPUT_BUFFER_BYTES > 0
 	return res;
 }
+err_t uart_flush(const uart_port_t *p, utime_t timeout) {
+	SET_DEFAULT_PORT(p);
+
+	uHAL_assert(p != NULL);
+	uHAL_assert(p->uartx != NULL);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (p == NULL) {
+		return ERR_BADARG;
+	}
+	if (p->uartx == NULL) {
+		return ERR_INIT;
+	}
+#endif
+#if ! uHAL_SKIP_OTHER_CHECKS
+	// The status register can't be read while the clock is off
+	if (!uart_is_on(p)) {
+		return ERR_INIT;
+	}
+#endif
+
+	timeout = SET_TIMEOUT_MS(timeout);
+
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	while (!uart_tx_buffer_is_empty(&p->tx_buf)) {
+		if (TIMES_UP(timeout)) {
+			return ERR_TIMEOUT;
+		}
+		poll_tx_buffer(p);
+	}
+#endif
+	// The last byte may still be in the shift register
+	while (!BIT_IS_SET(p->uartx->SR, USART_SR_TC)) {
+		if (TIMES_UP(timeout)) {
+			return ERR_TIMEOUT;
+		}
+	}
+
+	return ERR_OK;
+}
 err_t uart_receive_block(uart_port_t *p, uint8_t *buffer, txsize_t size, utime_t timeout) {
 	err_t res;
 
@@ -439,6 +529,23 @@ END:
 	return res;
 }
 
+#if UART_OUTPUT_BUFFER_BYTES > 0
+//
+// The buffer won't drain on its own when interrupts are masked or we're in a
+// handler that may outrank the UART IRQ (such as when reporting an error), so
+// in those cases move it along by hand
+static void poll_tx_buffer(const uart_port_t *p) {
+	if (((__get_PRIMASK() != 0) || (__get_IPSR() != 0)) && BIT_IS_SET(p->uartx->SR, USART_SR_TXE)) {
+		// Keep the ISR from pulling from the buffer at the same time
+		NVIC_DisableIRQ(p->irqn);
+		UARTx_TXE_IRQHandler((uart_port_t *)p);
+		NVIC_EnableIRQ(p->irqn);
+	}
+
+	return;
+}
+#endif // UART_OUTPUT_BUFFER_BYTES > 0
+
 static uint16_t calculate_baud_div(uint32_t baud, uint32_t busfreq) {
 	uint32_t tmp;
 
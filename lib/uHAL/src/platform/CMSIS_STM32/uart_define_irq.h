@@ -1,11 +1,12 @@
 //
-// Generated by tools/cmsis/uart_define_irq.sh on Thu Aug  8 06:39:17 PM EDT 2024
+// Generated by tools/cmsis/uart_define_irq.sh on Sun Oct 18 08:17:21 UTC 2026
 //
 
-#if ENABLE_UART_LISTENING
+#if ENABLE_UART_LISTENING || UART_OUTPUT_BUFFER_BYTES > 0
 
 #define ASSIGN_IRQ_PORT(_irqn_, _p_) do { uart ## _irqn_ ## _port = (_p_); } while (0);
 
+#if ENABLE_UART_LISTENING
 static void UARTx_RXNE_IRQHandler(uart_port_t *p) {
 #if UART_INPUT_BUFFER_BYTES > 0
 	if (p->rx_buf.bytes < UART_INPUT_BUFFER_BYTES) {
@@ -29,6 +30,22 @@ static void UARTx_RXNE_IRQHandler(uart_port_t *p) {
 
 	return;
 }
+#endif // ENABLE_UART_LISTENING
+
+#if UART_OUTPUT_BUFFER_BYTES > 0
+static void UARTx_TXE_IRQHandler(uart_port_t *p) {
+	uint8_t c;
+
+	if (uart_tx_buffer_pop(&p->tx_buf, &c)) {
+		p->uartx->DR = c;
+	} else {
+		// Nothing left to send, stop the interrupt until something is queued
+		CLEAR_BIT(p->uartx->CR1, USART_CR1_TXEIE);
+	}
+
+	return;
+}
+#endif // UART_OUTPUT_BUFFER_BYTES > 0
 
 
 //
@@ -38,10 +55,17 @@ static void UARTx_RXNE_IRQHandler(uart_port_t *p) {
 static uart_port_t *uart1_port;
 //__attribute__((weak))
 void USART1_IRQHandler(void) {
-	if (BIT_IS_SET(uart1_port->uartx->SR, USART_SR_RXNE)) {
+#if ENABLE_UART_LISTENING
+	if (BIT_IS_SET(uart1_port->uartx->SR, USART_SR_RXNE) && BIT_IS_SET(uart1_port->uartx->CR1, USART_CR1_RXNEIE)) {
 		UARTx_RXNE_IRQHandler(uart1_port);
 		uart_rx_irq_hook(uart1_port);
 	}
+#endif
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	if (BIT_IS_SET(uart1_port->uartx->SR, USART_SR_TXE) && BIT_IS_SET(uart1_port->uartx->CR1, USART_CR1_TXEIE)) {
+		UARTx_TXE_IRQHandler(uart1_port);
+	}
+#endif
 
 	return;
 }
@@ -54,10 +78,17 @@ void USART1_IRQHandler(void) {
 static uart_port_t *uart2_port;
 //__attribute__((weak))
 void USART2_IRQHandler(void) {
-	if (BIT_IS_SET(uart2_port->uartx->SR, USART_SR_RXNE)) {
+#if ENABLE_UART_LISTENING
+	if (BIT_IS_SET(uart2_port->uartx->SR, USART_SR_RXNE) && BIT_IS_SET(uart2_port->uartx->CR1, USART_CR1_RXNEIE)) {
 		UARTx_RXNE_IRQHandler(uart2_port);
 		uart_rx_irq_hook(uart2_port);
 	}
+#endif
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	if (BIT_IS_SET(uart2_port->uartx->SR, USART_SR_TXE) && BIT_IS_SET(uart2_port->uartx->CR1, USART_CR1_TXEIE)) {
+		UARTx_TXE_IRQHandler(uart2_port);
+	}
+#endif
 
 	return;
 }
@@ -70,10 +101,17 @@ void USART2_IRQHandler(void) {
 static uart_port_t *uart3_port;
 //__attribute__((weak))
 void USART3_IRQHandler(void) {
-	if (BIT_IS_SET(uart3_port->uartx->SR, USART_SR_RXNE)) {
+#if ENABLE_UART_LISTENING
+	if (BIT_IS_SET(uart3_port->uartx->SR, USART_SR_RXNE) && BIT_IS_SET(uart3_port->uartx->CR1, USART_CR1_RXNEIE)) {
 		UARTx_RXNE_IRQHandler(uart3_port);
 		uart_rx_irq_hook(uart3_port);
 	}
+#endif
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	if (BIT_IS_SET(uart3_port->uartx->SR, USART_SR_TXE) && BIT_IS_SET(uart3_port->uartx->CR1, USART_CR1_TXEIE)) {
+		UARTx_TXE_IRQHandler(uart3_port);
+	}
+#endif
 
 	return;
 }
@@ -86,10 +124,17 @@ void USART3_IRQHandler(void) {
 static uart_port_t *uart6_port;
 //__attribute__((weak))
 void USART6_IRQHandler(void) {
-	if (BIT_IS_SET(uart6_port->uartx->SR, USART_SR_RXNE)) {
+#if ENABLE_UART_LISTENING
+	if (BIT_IS_SET(uart6_port->uartx->SR, USART_SR_RXNE) && BIT_IS_SET(uart6_port->uartx->CR1, USART_CR1_RXNEIE)) {
 		UARTx_RXNE_IRQHandler(uart6_port);
 		uart_rx_irq_hook(uart6_port);
 	}
+#endif
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	if (BIT_IS_SET(uart6_port->uartx->SR, USART_SR_TXE) && BIT_IS_SET(uart6_port->uartx->CR1, USART_CR1_TXEIE)) {
+		UARTx_TXE_IRQHandler(uart6_port);
+	}
+#endif
 
 	return;
 }
@@ -102,10 +147,17 @@ void USART6_IRQHandler(void) {
 static uart_port_t *uart4_port;
 //__attribute__((weak))
 void UART4_IRQHandler(void) {
-	if (BIT_IS_SET(uart4_port->uartx->SR, USART_SR_RXNE)) {
+#if ENABLE_UART_LISTENING
+	if (BIT_IS_SET(uart4_port->uartx->SR, USART_SR_RXNE) && BIT_IS_SET(uart4_port->uartx->CR1, USART_CR1_RXNEIE)) {
 		UARTx_RXNE_IRQHandler(uart4_port);
 		uart_rx_irq_hook(uart4_port);
 	}
+#endif
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	if (BIT_IS_SET(uart4_port->uartx->SR, USART_SR_TXE) && BIT_IS_SET(uart4_port->uartx->CR1, USART_CR1_TXEIE)) {
+		UARTx_TXE_IRQHandler(uart4_port);
+	}
+#endif
 
 	return;
 }
@@ -118,10 +170,17 @@ void UART4_IRQHandler(void) {
 static uart_port_t *uart5_port;
 //__attribute__((weak))
 void UART5_IRQHandler(void) {
-	if (BIT_IS_SET(uart5_port->uartx->SR, USART_SR_RXNE)) {
+#if ENABLE_UART_LISTENING
+	if (BIT_IS_SET(uart5_port->uartx->SR, USART_SR_RXNE) && BIT_IS_SET(uart5_port->uartx->CR1, USART_CR1_RXNEIE)) {
 		UARTx_RXNE_IRQHandler(uart5_port);
 		uart_rx_irq_hook(uart5_port);
 	}
+#endif
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	if (BIT_IS_SET(uart5_port->uartx->SR, USART_SR_TXE) && BIT_IS_SET(uart5_port->uartx->CR1, USART_CR1_TXEIE)) {
+		UARTx_TXE_IRQHandler(uart5_port);
+	}
+#endif
 
 	return;
 }
@@ -134,10 +193,17 @@ void UART5_IRQHandler(void) {
 static uart_port_t *uart7_port;
 //__attribute__((weak))
 void UART7_IRQHandler(void) {
-	if (BIT_IS_SET(uart7_port->uartx->SR, USART_SR_RXNE)) {
+#if ENABLE_UART_LISTENING
+	if (BIT_IS_SET(uart7_port->uartx->SR, USART_SR_RXNE) && BIT_IS_SET(uart7_port->uartx->CR1, USART_CR1_RXNEIE)) {
 		UARTx_RXNE_IRQHandler(uart7_port);
 		uart_rx_irq_hook(uart7_port);
 	}
+#endif
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	if (BIT_IS_SET(uart7_port->uartx->SR, USART_SR_TXE) && BIT_IS_SET(uart7_port->uartx->CR1, USART_CR1_TXEIE)) {
+		UARTx_TXE_IRQHandler(uart7_port);
+	}
+#endif
 
 	return;
 }
@@ -150,16 +216,23 @@ void UART7_IRQHandler(void) {
 static uart_port_t *uart8_port;
 //__attribute__((weak))
 void UART8_IRQHandler(void) {
-	if (BIT_IS_SET(uart8_port->uartx->SR, USART_SR_RXNE)) {
+#if ENABLE_UART_LISTENING
+	if (BIT_IS_SET(uart8_port->uartx->SR, USART_SR_RXNE) && BIT_IS_SET(uart8_port->uartx->CR1, USART_CR1_RXNEIE)) {
 		UARTx_RXNE_IRQHandler(uart8_port);
 		uart_rx_irq_hook(uart8_port);
 	}
+#endif
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	if (BIT_IS_SET(uart8_port->uartx->SR, USART_SR_TXE) && BIT_IS_SET(uart8_port->uartx->CR1, USART_CR1_TXEIE)) {
+		UARTx_TXE_IRQHandler(uart8_port);
+	}
+#endif
 
 	return;
 }
 #endif // HAVE_UART8
 
-#else // ENABLE_UART_LISTENING
+#else // ENABLE_UART_LISTENING || UART_OUTPUT_BUFFER_BYTES > 0
 #define ASSIGN_IRQ_PORT(_irqn_, _p_) ((void )0U)
 
-#endif // ENABLE_UART_LISTENING
+#endif // ENABLE_UART_LISTENING || UART_OUTPUT_BUFFER_BYTES > 0
@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// adc.c
+// Manage the ADC peripheral
+// NOTES:
+//   Every pin can be used as an analog input. The value read is whatever was
+//   last set with host_adc_set_pin(), or half-scale if it hasn't been set
+//   since it's less likely to trip up sensor drivers than 0.
+//
+//   adc_read_pins() is just a loop over the pins, but it's counted as a
+//   single scan in the statistics so the effect of batching reads can be
+//   seen.
+//
+
+#include "adc.h"
+#include "system.h"
+#include "gpio.h"
+
+#if uHAL_USE_ADC
+
+static adc_t pin_values[GPIO_PORT_COUNT][16];
+static uint_fast16_t vref_mV;
+static bool adc_enabled;
+static host_adc_stats_t stats;
+
+
+void adc_init(void) {
+	for (uiter_t p = 0; p < GPIO_PORT_COUNT; ++p) {
+		for (uiter_t i = 0; i < 16U; ++i) {
+			pin_values[p][i] = ADC_MAX / 2U;
+		}
+	}
+	vref_mV = REGULATED_VOLTAGE_mV;
+
+	adc_off();
+
+	return;
+}
+err_t adc_on(void) {
+	if (!adc_enabled) {
+		++stats.power_ups;
+	}
+	adc_enabled = true;
+
+	return ERR_OK;
+}
+bool adc_is_on(void) {
+	return adc_enabled;
+}
+err_t adc_off(void) {
+	adc_enabled = false;
+
+	return ERR_OK;
+}
+
+err_t host_adc_set_pin(gpio_pin_t pin, adc_t value) {
+	uHAL_assert(GPIO_PIN_IS_VALID(pin));
+	uHAL_assert(value <= ADC_MAX);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (!GPIO_PIN_IS_VALID(pin) || (value > ADC_MAX)) {
+		return ERR_BADARG;
+	}
+#endif
+
+	pin_values[GPIO_GET_PORTNO(pin) - 1U][GPIO_GET_PINNO(pin)] = value;
+
+	return ERR_OK;
+}
+err_t host_adc_set_vref_mV(uint_fast16_t mV) {
+	uHAL_assert(mV != 0);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (mV == 0) {
+		return ERR_BADARG;
+	}
+#endif
+
+	vref_mV = mV;
+
+	return ERR_OK;
+}
+
+adc_t adc_read_pin(gpio_pin_t pin) {
+	uHAL_assert(GPIO_PIN_IS_VALID(pin));
+#if ! uHAL_SKIP_INIT_CHECKS
+	if (!adc_enabled) {
+		return ERR_ADC;
+	}
+#endif
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (!GPIO_PIN_IS_VALID(pin)) {
+		return ERR_ADC;
+	}
+#endif
+
+	++stats.conversions;
+	++stats.scans;
+	return pin_values[GPIO_GET_PORTNO(pin) - 1U][GPIO_GET_PINNO(pin)];
+}
+err_t adc_read_pins(const gpio_pin_t *pins, adc_t *values, uint_fast8_t count) {
+	err_t res = ERR_OK;
+
+	uHAL_assert(pins != NULL);
+	uHAL_assert(values != NULL);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if ((pins == NULL) || (values == NULL)) {
+		return ERR_BADARG;
+	}
+#endif
+#if ! uHAL_SKIP_INIT_CHECKS
+	if (!adc_enabled) {
+		for (uiter_t i = 0; i < count; ++i) {
+			values[i] = ERR_ADC;
+		}
+		return ERR_INIT;
+	}
+#endif
+
+	for (uiter_t i = 0; i < count; ++i) {
+		if (GPIO_PIN_IS_VALID(pins[i])) {
+			values[i] = pin_values[GPIO_GET_PORTNO(pins[i]) - 1U][GPIO_GET_PINNO(pins[i])];
+			++stats.conversions;
+		} else {
+			values[i] = ERR_ADC;
+			res = ERR_BADARG;
+		}
+	}
+	++stats.scans;
+
+	return res;
+}
+uint_fast16_t adc_read_vref_mV(void) {
+	return vref_mV;
+}
+adc_t adc_read_ac_amplitude(gpio_pin_t pin, uint_fast32_t period_ms, adc_t *min, adc_t *max) {
+	adc_t adc;
+
+	adc = adc_read_pin(pin);
+	if (adc == ERR_ADC) {
+		return ERR_ADC;
+	}
+	// The simulated signal doesn't change while we're watching, but the caller
+	// still expects the sampling period to elapse
+	delay_ms(period_ms);
+
+	if (min != NULL) {
+		*min = adc;
+	}
+	if (max != NULL) {
+		*max = adc;
+	}
+	return 0;
+}
+
+void host_adc_get_stats(host_adc_stats_t *s) {
+	uHAL_assert(s != NULL);
+
+	*s = stats;
+
+	return;
+}
+void host_adc_reset_stats(void) {
+	stats = (host_adc_stats_t ){ 0 };
+
+	return;
+}
+
+
+#endif // uHAL_USE_ADC
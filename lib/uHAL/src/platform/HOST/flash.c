@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// flash.c
+// Emulate the internal flash data area
+// NOTES:
+//   The data area is kept in memory and every erase or write is copied to
+//   the file at HOST_FLASH_PATH as it happens, so that it survives the
+//   program being stopped the same way real flash would survive a reset.
+//
+//   Programming follows the STM32F1 rules: a write unit can only be written
+//   if it's erased or if it's being cleared to 0. Erase and programming time
+//   isn't simulated, it's only added up in the statistics.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include "common.h"
+
+#if uHAL_USE_FLASH
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static struct {
+	int fd;
+	bool loaded;
+	uint8_t data[FLASH_DATA_BYTES];
+	uint32_t page_erases[uHAL_FLASH_DATA_PAGES];
+} flash = { .fd = -1 };
+
+static host_flash_stats_t stats;
+
+
+static bool load_flash(void) {
+	const char *path;
+	ssize_t got;
+
+	if (flash.loaded) {
+		return (flash.fd >= 0);
+	}
+	flash.loaded = true;
+
+	memset(flash.data, FLASH_ERASED_BYTE, FLASH_DATA_BYTES);
+
+	path = getenv("HOST_FLASH_FILE");
+	if (path == NULL) {
+		path = HOST_FLASH_PATH;
+	}
+	if ((flash.fd = open(path, O_RDWR|O_CREAT, 0644)) < 0) {
+		return false;
+	}
+	// Anything past the end of the file stays erased
+	got = pread(flash.fd, flash.data, FLASH_DATA_BYTES, 0);
+	if (got < (ssize_t )FLASH_DATA_BYTES) {
+		got = (got < 0) ? 0 : got;
+		memset(&flash.data[got], FLASH_ERASED_BYTE, FLASH_DATA_BYTES - (size_t )got);
+	}
+
+	return true;
+}
+static err_t save_flash(uint32_t offset, uint32_t size) {
+	if (pwrite(flash.fd, &flash.data[offset], size, (off_t )offset) != (ssize_t )size) {
+		return ERR_IO;
+	}
+
+	return ERR_OK;
+}
+
+err_t flash_erase_page(uint_fast16_t page) {
+	uint32_t offset;
+
+	uHAL_assert(page < uHAL_FLASH_DATA_PAGES);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (page >= uHAL_FLASH_DATA_PAGES) {
+		return ERR_BADARG;
+	}
+#endif
+
+	if (!load_flash()) {
+		return ERR_IO;
+	}
+
+	++stats.page_erases;
+	++flash.page_erases[page];
+	stats.busy_us += HOST_FLASH_ERASE_US;
+
+	offset = (uint32_t )page * FLASH_PAGE_BYTES;
+	memset(&flash.data[offset], FLASH_ERASED_BYTE, FLASH_PAGE_BYTES);
+
+	return save_flash(offset, FLASH_PAGE_BYTES);
+}
+
+err_t flash_write(uint32_t offset, const void *data, uint_fast16_t size) {
+	const uint8_t *src = data;
+	uint32_t done = 0;
+	err_t res = ERR_OK;
+
+	uHAL_assert(data != NULL);
+	uHAL_assert((offset % FLASH_WRITE_BYTES) == 0);
+	uHAL_assert((size % FLASH_WRITE_BYTES) == 0);
+	uHAL_assert(offset + size <= FLASH_DATA_BYTES);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if ((data == NULL) || ((offset % FLASH_WRITE_BYTES) != 0) || ((size % FLASH_WRITE_BYTES) != 0)) {
+		return ERR_BADARG;
+	}
+	if (offset + size > FLASH_DATA_BYTES) {
+		return ERR_RANGE;
+	}
+#endif
+
+	if (!load_flash()) {
+		return ERR_IO;
+	}
+
+	++stats.write_calls;
+
+	for (; done < size; done += FLASH_WRITE_BYTES) {
+		uint8_t *dest = &flash.data[offset + done];
+		bool erased = true, clearing = true;
+
+		for (uiter_t i = 0; i < FLASH_WRITE_BYTES; ++i) {
+			erased = erased && (dest[i] == FLASH_ERASED_BYTE);
+			clearing = clearing && (src[done + i] == 0);
+		}
+		if (!erased && !clearing) {
+			res = ERR_PERM;
+			break;
+		}
+		memcpy(dest, &src[done], FLASH_WRITE_BYTES);
+		stats.busy_us += HOST_FLASH_WRITE_US;
+	}
+	stats.bytes_written += done;
+
+	if (done > 0) {
+		err_t sres = save_flash(offset, done);
+
+		res = (res == ERR_OK) ? sres : res;
+	}
+
+	return res;
+}
+
+err_t flash_read(uint32_t offset, void *data, uint_fast16_t size) {
+	uHAL_assert(data != NULL);
+	uHAL_assert(offset + size <= FLASH_DATA_BYTES);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (data == NULL) {
+		return ERR_BADARG;
+	}
+	if (offset + size > FLASH_DATA_BYTES) {
+		return ERR_RANGE;
+	}
+#endif
+
+	if (!load_flash()) {
+		return ERR_IO;
+	}
+
+	++stats.read_calls;
+	stats.bytes_read += size;
+	memcpy(data, &flash.data[offset], size);
+
+	return ERR_OK;
+}
+
+void host_flash_get_stats(host_flash_stats_t *s) {
+	uHAL_assert(s != NULL);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (s == NULL) {
+		return;
+	}
+#endif
+
+	*s = stats;
+	s->max_page_erases = 0;
+	s->min_page_erases = flash.page_erases[0];
+	for (uint_fast16_t i = 0; i < uHAL_FLASH_DATA_PAGES; ++i) {
+		if (flash.page_erases[i] > s->max_page_erases) {
+			s->max_page_erases = flash.page_erases[i];
+		}
+		if (flash.page_erases[i] < s->min_page_erases) {
+			s->min_page_erases = flash.page_erases[i];
+		}
+	}
+
+	return;
+}
+void host_flash_reset_stats(void) {
+	stats = (host_flash_stats_t ){ 0 };
+
+	return;
+}
+
+#endif // uHAL_USE_FLASH
@@ -0,0 +1,497 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// gpio.c
+// Manage the GPIO peripheral
+// NOTES:
+//   Each virtual port is tracked with a set of bit masks standing in for the
+//   registers of a real port. The level seen by inputs is whatever was last
+//   set with host_gpio_set_input() or, if the pin isn't being driven from
+//   outside, whatever the bias would pull it to.
+//
+//   Unlike the AVR there are both pullups and pulldowns.
+//
+
+#include "gpio.h"
+#include "system.h"
+
+// If 1, setting an output pin to GPIO_FLOAT will toggle it
+#if defined(uHAL_TOGGLE_GPIO_OUTPUT_WITH_FLOAT) && uHAL_TOGGLE_GPIO_OUTPUT_WITH_FLOAT > 0
+# define FLOAT_TOGGLES_OUTPUT 1
+#else
+# define FLOAT_TOGGLES_OUTPUT 0
+#endif
+
+typedef struct {
+	uint16_t dir;        // Set for outputs
+	uint16_t out;        // Output level
+	uint16_t ien;        // Set for digital inputs
+	uint16_t pullup;     // Input pulled up
+	uint16_t pulldown;   // Input pulled down
+	uint16_t ext_driven; // Set when the pin is driven by something outside
+	uint16_t ext_level;  // The level of externally-driven pins
+	uint16_t in;         // The level seen by the pin
+	uint16_t irq_en;     // Set when the pin is listening
+	uint16_t irq_rise;   // Listen for rising edges
+	uint16_t irq_fall;   // Listen for falling edges
+} host_port_t;
+
+static host_port_t ports[GPIO_PORT_COUNT];
+
+
+static host_port_t* gpio_get_port(gpio_pin_t pin) {
+	gpio_pin_t port;
+
+	port = GPIO_GET_PORTNO(pin);
+	if ((port == 0) || (port > GPIO_PORT_COUNT)) {
+		return NULL;
+	}
+
+	return &ports[port - 1U];
+}
+//
+// Update the input levels after changing anything that could affect them
+static void update_input(host_port_t *port) {
+	uint16_t floating;
+
+	floating = ~(port->dir | port->ext_driven);
+	port->in = (port->dir & port->out) | (port->ext_driven & port->ext_level) | (floating & port->pullup);
+
+	return;
+}
+
+__attribute__((weak))
+void host_gpio_IRQHandler(void) {
+	return;
+}
+
+void gpio_init(void) {
+	for (uiter_t i = 0; i < GPIO_PORT_COUNT; ++i) {
+		host_port_t *port = &ports[i];
+
+		*port = (host_port_t ){ 0 };
+	}
+
+	return;
+}
+
+err_t host_gpio_set_input(gpio_pin_t pin, gpio_state_t new_state) {
+	uint16_t pinmask, old_in, edges;
+	host_port_t *PORTx;
+
+	uHAL_assert(GPIO_PIN_IS_VALID(pin));
+	PORTx = gpio_get_port(pin);
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (PORTx == NULL) {
+			return ERR_BADARG;
+		}
+	}
+
+	pinmask = GPIO_GET_PINMASK(pin);
+	old_in = PORTx->in;
+	switch (new_state) {
+	case GPIO_HIGH:
+		SET_BIT(PORTx->ext_driven, pinmask);
+		SET_BIT(PORTx->ext_level, pinmask);
+		break;
+	case GPIO_LOW:
+		SET_BIT(PORTx->ext_driven, pinmask);
+		CLEAR_BIT(PORTx->ext_level, pinmask);
+		break;
+	case GPIO_FLOAT:
+		CLEAR_BIT(PORTx->ext_driven, pinmask);
+		break;
+	}
+	update_input(PORTx);
+
+	edges  = (~old_in & PORTx->in) & PORTx->irq_rise;
+	edges |= (old_in & ~PORTx->in) & PORTx->irq_fall;
+	if (BIT_IS_SET(edges & PORTx->irq_en, pinmask)) {
+		host_gpio_IRQHandler();
+	}
+
+	return ERR_OK;
+}
+
+err_t gpio_set_state(gpio_pin_t pin, gpio_state_t new_state) {
+	uHAL_assert(GPIO_PIN_IS_VALID(pin));
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (gpio_get_port(pin) == NULL) {
+			return ERR_BADARG;
+		}
+	}
+
+	if (gpio_get_mode(pin) == GPIO_MODE_PP) {
+		return gpio_set_output_state(pin, new_state);
+	}
+	return gpio_set_input_state(pin, new_state);
+}
+err_t gpio_set_input_state(gpio_pin_t pin, gpio_state_t new_state) {
+	uint16_t pinmask;
+	host_port_t *PORTx;
+
+	uHAL_assert(GPIO_PIN_IS_VALID(pin));
+	PORTx = gpio_get_port(pin);
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (PORTx == NULL) {
+			return ERR_BADARG;
+		}
+	}
+	pinmask = GPIO_GET_PINMASK(pin);
+	if (!uHAL_SKIP_INIT_CHECKS) {
+		if (BIT_IS_SET(PORTx->dir, pinmask)) {
+			return ERR_INIT;
+		}
+	}
+
+	CLEAR_BIT(PORTx->pullup, pinmask);
+	CLEAR_BIT(PORTx->pulldown, pinmask);
+	switch (new_state) {
+	case GPIO_HIGH:
+		SET_BIT(PORTx->pullup, pinmask);
+		break;
+	case GPIO_LOW:
+		SET_BIT(PORTx->pulldown, pinmask);
+		break;
+	case GPIO_FLOAT:
+		break;
+	}
+	update_input(PORTx);
+
+	return ERR_OK;
+}
+err_t gpio_set_output_state(gpio_pin_t pin, gpio_state_t new_state) {
+	uint16_t pinmask;
+	host_port_t *PORTx;
+
+	uHAL_assert(GPIO_PIN_IS_VALID(pin));
+	PORTx = gpio_get_port(pin);
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (PORTx == NULL) {
+			return ERR_BADARG;
+		}
+	}
+	pinmask = GPIO_GET_PINMASK(pin);
+	if (!uHAL_SKIP_INIT_CHECKS) {
+		if (!BIT_IS_SET(PORTx->dir, pinmask)) {
+			return ERR_INIT;
+		}
+	}
+
+	switch (new_state) {
+	case GPIO_HIGH:
+		SET_BIT(PORTx->out, pinmask);
+		break;
+	case GPIO_LOW:
+		CLEAR_BIT(PORTx->out, pinmask);
+		break;
+	case GPIO_FLOAT:
+#if FLOAT_TOGGLES_OUTPUT
+		TOGGLE_BIT(PORTx->out, pinmask);
+#endif
+		break;
+	}
+	update_input(PORTx);
+
+	return ERR_OK;
+}
+
+err_t gpio_toggle_state(gpio_pin_t pin) {
+	uHAL_assert(GPIO_PIN_IS_VALID(pin));
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (gpio_get_port(pin) == NULL) {
+			return ERR_BADARG;
+		}
+	}
+
+	if (gpio_get_mode(pin) == GPIO_MODE_PP) {
+		return gpio_toggle_output_state(pin);
+	}
+	return gpio_toggle_input_state(pin);
+}
+err_t gpio_toggle_input_state(gpio_pin_t pin) {
+	uint16_t pinmask;
+	host_port_t *PORTx;
+
+	uHAL_assert(GPIO_PIN_IS_VALID(pin));
+	PORTx = gpio_get_port(pin);
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (PORTx == NULL) {
+			return ERR_BADARG;
+		}
+	}
+	pinmask = GPIO_GET_PINMASK(pin);
+
+	// Both biases are available, so leave floating inputs alone
+	if (BIT_IS_SET(PORTx->pullup, pinmask)) {
+		return gpio_set_input_state(pin, GPIO_LOW);
+	} else if (BIT_IS_SET(PORTx->pulldown, pinmask)) {
+		return gpio_set_input_state(pin, GPIO_HIGH);
+	}
+	return gpio_set_input_state(pin, GPIO_FLOAT);
+}
+err_t gpio_toggle_output_state(gpio_pin_t pin) {
+	uint16_t pinmask;
+	host_port_t *PORTx;
+
+	uHAL_assert(GPIO_PIN_IS_VALID(pin));
+	PORTx = gpio_get_port(pin);
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (PORTx == NULL) {
+			return ERR_BADARG;
+		}
+	}
+	pinmask = GPIO_GET_PINMASK(pin);
+	if (!uHAL_SKIP_INIT_CHECKS) {
+		if (!BIT_IS_SET(PORTx->dir, pinmask)) {
+			return ERR_INIT;
+		}
+	}
+
+	TOGGLE_BIT(PORTx->out, pinmask);
+	update_input(PORTx);
+
+	return ERR_OK;
+}
+
+gpio_state_t gpio_get_state(gpio_pin_t pin) {
+	switch (gpio_get_mode(pin)) {
+	case GPIO_MODE_PP:
+		return gpio_get_output_state(pin);
+	case GPIO_MODE_IN:
+		return gpio_get_input_state(pin);
+	default:
+		break;
+	}
+
+	return GPIO_FLOAT;
+}
+gpio_state_t gpio_get_input_state(gpio_pin_t pin) {
+	uint16_t pinmask;
+	host_port_t *PORTx;
+
+	uHAL_assert(GPIO_PIN_IS_VALID(pin));
+	PORTx = gpio_get_port(pin);
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (PORTx == NULL) {
+			return GPIO_FLOAT;
+		}
+	}
+	pinmask = GPIO_GET_PINMASK(pin);
+	if (!BIT_IS_SET(PORTx->ien, pinmask)) {
+		return GPIO_FLOAT;
+	}
+
+	return BIT_IS_SET(PORTx->in, pinmask) ? GPIO_HIGH : GPIO_LOW;
+}
+gpio_state_t gpio_get_output_state(gpio_pin_t pin) {
+	uint16_t pinmask;
+	host_port_t *PORTx;
+
+	uHAL_assert(GPIO_PIN_IS_VALID(pin));
+	PORTx = gpio_get_port(pin);
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (PORTx == NULL) {
+			return GPIO_FLOAT;
+		}
+	}
+	pinmask = GPIO_GET_PINMASK(pin);
+	if (!BIT_IS_SET(PORTx->dir, pinmask)) {
+		return GPIO_FLOAT;
+	}
+
+	return BIT_IS_SET(PORTx->out, pinmask) ? GPIO_HIGH : GPIO_LOW;
+}
+
+err_t gpio_quickread_prepare(gpio_quick_t *qpin, gpio_pin_t pin) {
+	host_port_t *PORTx;
+
+	uHAL_assert(qpin != NULL);
+	uHAL_assert(GPIO_PIN_IS_VALID(pin));
+	PORTx = gpio_get_port(pin);
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if ((qpin == NULL) || (PORTx == NULL)) {
+			return ERR_BADARG;
+		}
+	}
+
+	qpin->mask = GPIO_GET_PINMASK(pin);
+	qpin->port = &PORTx->in;
+
+	return ERR_OK;
+}
+
+err_t gpio_set_mode(gpio_pin_t pin, gpio_mode_t mode, gpio_state_t istate) {
+	uint16_t pinmask;
+	host_port_t *PORTx;
+
+	uHAL_assert(GPIO_PIN_IS_VALID(pin));
+	PORTx = gpio_get_port(pin);
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (PORTx == NULL) {
+			return ERR_BADARG;
+		}
+	}
+	pinmask = GPIO_GET_PINMASK(pin);
+
+	CLEAR_BIT(PORTx->pullup, pinmask);
+	CLEAR_BIT(PORTx->pulldown, pinmask);
+	switch (mode) {
+	case GPIO_MODE_IN:
+		CLEAR_BIT(PORTx->dir, pinmask);
+		SET_BIT(PORTx->ien, pinmask);
+		if (istate == GPIO_HIGH) {
+			SET_BIT(PORTx->pullup, pinmask);
+		} else if (istate == GPIO_LOW) {
+			SET_BIT(PORTx->pulldown, pinmask);
+		}
+		break;
+
+	case GPIO_MODE_PP:
+		CLEAR_BIT(PORTx->ien, pinmask);
+		SET_BIT(PORTx->dir, pinmask);
+		if (istate == GPIO_HIGH) {
+			SET_BIT(PORTx->out, pinmask);
+		} else {
+			CLEAR_BIT(PORTx->out, pinmask);
+		}
+		break;
+
+	case GPIO_MODE_AIN:
+	case GPIO_MODE_HiZ:
+	case GPIO_MODE_RESET:
+		CLEAR_BIT(PORTx->ien, pinmask);
+		CLEAR_BIT(PORTx->dir, pinmask);
+		CLEAR_BIT(PORTx->out, pinmask);
+		break;
+	}
+	update_input(PORTx);
+
+	return ERR_OK;
+}
+gpio_mode_t gpio_get_mode(gpio_pin_t pin) {
+	uint16_t pinmask;
+	host_port_t *PORTx;
+
+	uHAL_assert(GPIO_PIN_IS_VALID(pin));
+	PORTx = gpio_get_port(pin);
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (PORTx == NULL) {
+			return GPIO_MODE_RESET;
+		}
+	}
+	pinmask = GPIO_GET_PINMASK(pin);
+
+	if (BIT_IS_SET(PORTx->dir, pinmask)) {
+		return GPIO_MODE_PP;
+	}
+	if (BIT_IS_SET(PORTx->ien, pinmask)) {
+		return GPIO_MODE_IN;
+	}
+
+	return GPIO_MODE_AIN;
+}
+
+err_t gpio_listen_init(gpio_listen_t *handle, const gpio_listen_cfg_t *conf) {
+	uHAL_assert(handle != NULL);
+	uHAL_assert(conf != NULL);
+	uHAL_assert(GPIO_PIN_IS_VALID(conf->pin));
+
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (handle == NULL || conf == NULL || gpio_get_port(conf->pin) == NULL) {
+			return ERR_BADARG;
+		}
+		if (SELECT_BITS(conf->trigger, GPIO_TRIGGER_RISING|GPIO_TRIGGER_FALLING) == 0) {
+			return ERR_BADARG;
+		}
+	}
+
+	handle->pin = conf->pin;
+	handle->trigger = conf->trigger;
+
+	return ERR_OK;
+}
+err_t gpio_listen_on(gpio_listen_t *handle) {
+	uint16_t pinmask;
+	host_port_t *PORTx;
+
+	uHAL_assert(handle != NULL);
+
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (handle == NULL) {
+			return ERR_BADARG;
+		}
+	}
+	PORTx = gpio_get_port(handle->pin);
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (PORTx == NULL) {
+			return ERR_INIT;
+		}
+	}
+	pinmask = GPIO_GET_PINMASK(handle->pin);
+
+	if (BIT_IS_SET(handle->trigger, GPIO_TRIGGER_RISING)) {
+		SET_BIT(PORTx->irq_rise, pinmask);
+	} else {
+		CLEAR_BIT(PORTx->irq_rise, pinmask);
+	}
+	if (BIT_IS_SET(handle->trigger, GPIO_TRIGGER_FALLING)) {
+		SET_BIT(PORTx->irq_fall, pinmask);
+	} else {
+		CLEAR_BIT(PORTx->irq_fall, pinmask);
+	}
+	SET_BIT(PORTx->irq_en, pinmask);
+
+	return ERR_OK;
+}
+err_t gpio_listen_off(gpio_listen_t *handle) {
+	host_port_t *PORTx;
+
+	uHAL_assert(handle != NULL);
+
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (handle == NULL) {
+			return ERR_BADARG;
+		}
+	}
+	PORTx = gpio_get_port(handle->pin);
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (PORTx == NULL) {
+			return ERR_INIT;
+		}
+	}
+
+	CLEAR_BIT(PORTx->irq_en, GPIO_GET_PINMASK(handle->pin));
+
+	return ERR_OK;
+}
+bool gpio_is_listening(gpio_pin_t pin) {
+	host_port_t *PORTx;
+
+	uHAL_assert(GPIO_PIN_IS_VALID(pin));
+
+	PORTx = gpio_get_port(pin);
+	if (!uHAL_SKIP_INVALID_ARG_CHECKS) {
+		if (PORTx == NULL) {
+			return false;
+		}
+	}
+
+	return BIT_IS_SET(PORTx->irq_en, GPIO_GET_PINMASK(pin));
+}
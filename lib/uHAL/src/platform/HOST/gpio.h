@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// gpio.h
+// Manage the GPIO peripheral
+// NOTES:
+//   Prototypes for most of the related functions are in interface.h
+//
+#ifndef _uHAL_PLATFORM_HOST_GPIO_H
+#define _uHAL_PLATFORM_HOST_GPIO_H
+
+#include "common.h"
+
+
+// Initialize the GPIO peripherals
+void gpio_init(void);
+
+
+#endif // _uHAL_PLATFORM_HOST_GPIO_H
@@ -0,0 +1,377 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// i2c.c
+// Manage the I2C peripheral
+// NOTES:
+//   There's no bus behind this, transfers are passed to host_i2c_transmit()
+//   and host_i2c_receive() which by default behave as if nothing were
+//   connected.
+//
+//   Queued transactions are run immediately unless another one is already
+//   running (in which case it's a callback queueing more) or the bus is held
+//   by the i2c_*_block_begin() functions, in which case they run when it's
+//   released.
+//
+
+#include "i2c.h"
+#include "system.h"
+#include "gpio.h"
+
+
+#if uHAL_USE_I2C
+
+#define NO_ADDR 0xFFU
+
+static bool i2c_enabled;
+// Address of the transfer started by i2c_*_block_begin()
+static uint8_t active_addr = NO_ADDR;
+
+#if uHAL_I2C_USE_QUEUE
+# define TXN_OK(_txn_) ( \
+	(((_txn_)->tx_size > 0) || ((_txn_)->rx_size > 0)) && \
+	(((_txn_)->tx_size == 0) || ((_txn_)->tx_buffer != NULL)) && \
+	(((_txn_)->rx_size == 0) || ((_txn_)->rx_buffer != NULL)))
+
+static i2c_transaction_t *queue_head = NULL;
+static i2c_transaction_t *queue_tail = NULL;
+static bool queue_running = false;
+
+static void run_queue(void);
+static void abort_queue(err_t res);
+static err_t queue_block(uint8_t addr, const uint8_t *tx_buffer, txsize_t tx_size, uint8_t *rx_buffer, txsize_t rx_size);
+#endif // uHAL_I2C_USE_QUEUE
+
+
+__attribute__((weak))
+err_t host_i2c_transmit(uint8_t addr, const uint8_t *tx_buffer, txsize_t tx_size) {
+	UNUSED(addr);
+	UNUSED(tx_buffer);
+	UNUSED(tx_size);
+
+	return ERR_NODEV;
+}
+__attribute__((weak))
+err_t host_i2c_receive(uint8_t addr, uint8_t *rx_buffer, txsize_t rx_size) {
+	UNUSED(addr);
+	UNUSED(rx_buffer);
+	UNUSED(rx_size);
+
+	return ERR_NODEV;
+}
+
+void i2c_init(void) {
+	i2c_off();
+
+	return;
+}
+err_t i2c_on(void) {
+	i2c_enabled = true;
+	active_addr = NO_ADDR;
+
+	return ERR_OK;
+}
+err_t i2c_off(void) {
+	i2c_enabled = false;
+	active_addr = NO_ADDR;
+#if uHAL_I2C_USE_QUEUE
+	// Anything still queued is being abandoned
+	abort_queue(ERR_INTERRUPT);
+#endif
+
+	return ERR_OK;
+}
+bool i2c_is_on(void) {
+	return i2c_enabled;
+}
+
+err_t i2c_receive_block(uint8_t addr, uint8_t *rx_buffer, txsize_t rx_size, utime_t timeout) {
+	err_t res;
+
+	res = i2c_receive_block_begin(addr, timeout);
+	if (res == ERR_OK) {
+#if uHAL_I2C_USE_QUEUE
+		active_addr = NO_ADDR;
+		res = queue_block(addr, NULL, 0, rx_buffer, rx_size);
+#else
+		res = i2c_receive_block_continue(rx_buffer, rx_size, timeout);
+#endif
+	}
+	active_addr = NO_ADDR;
+
+	return res;
+}
+err_t i2c_receive_block_begin(uint8_t addr, utime_t timeout) {
+	UNUSED(timeout);
+
+#if ! uHAL_SKIP_INIT_CHECKS
+	if (!i2c_enabled) {
+		return ERR_INIT;
+	}
+#endif
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (addr > 0x7FU) {
+		return ERR_BADARG;
+	}
+#endif
+
+	active_addr = addr;
+
+	return ERR_OK;
+}
+err_t i2c_receive_block_continue(uint8_t *rx_buffer, txsize_t rx_size, utime_t timeout) {
+	UNUSED(timeout);
+
+	uHAL_assert(rx_buffer != NULL);
+	uHAL_assert(rx_size > 0);
+#if ! uHAL_SKIP_INIT_CHECKS
+	if (active_addr == NO_ADDR) {
+		return ERR_INIT;
+	}
+#endif
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if ((rx_buffer == NULL) || (rx_size == 0)) {
+		return ERR_BADARG;
+	}
+#endif
+
+	return host_i2c_receive(active_addr, rx_buffer, rx_size);
+}
+err_t i2c_receive_block_end(uint8_t *rx_byte) {
+	err_t res = ERR_OK;
+
+#if ! uHAL_SKIP_INIT_CHECKS
+	if (active_addr == NO_ADDR) {
+		return ERR_INIT;
+	}
+#endif
+
+	if (rx_byte != NULL) {
+		res = host_i2c_receive(active_addr, rx_byte, 1);
+	}
+	active_addr = NO_ADDR;
+
+#if uHAL_I2C_USE_QUEUE
+	// Run anything that was queued while we had the bus
+	run_queue();
+#endif
+
+	return res;
+}
+
+err_t i2c_transmit_block(uint8_t addr, const uint8_t *tx_buffer, txsize_t tx_size, utime_t timeout) {
+	err_t res;
+
+	res = i2c_transmit_block_begin(addr, timeout);
+	if (res == ERR_OK) {
+#if uHAL_I2C_USE_QUEUE
+		active_addr = NO_ADDR;
+		res = queue_block(addr, tx_buffer, tx_size, NULL, 0);
+#else
+		res = i2c_transmit_block_continue(tx_buffer, tx_size, timeout);
+#endif
+	}
+	active_addr = NO_ADDR;
+
+	return res;
+}
+err_t i2c_transmit_block_begin(uint8_t addr, utime_t timeout) {
+	return i2c_receive_block_begin(addr, timeout);
+}
+err_t i2c_transmit_block_continue(const uint8_t *tx_buffer, txsize_t tx_size, utime_t timeout) {
+	UNUSED(timeout);
+
+	uHAL_assert(tx_buffer != NULL);
+	uHAL_assert(tx_size > 0);
+#if ! uHAL_SKIP_INIT_CHECKS
+	if (active_addr == NO_ADDR) {
+		return ERR_INIT;
+	}
+#endif
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if ((tx_buffer == NULL) || (tx_size == 0)) {
+		return ERR_BADARG;
+	}
+#endif
+
+	return host_i2c_transmit(active_addr, tx_buffer, tx_size);
+}
+err_t i2c_transmit_block_end(void) {
+	active_addr = NO_ADDR;
+
+#if uHAL_I2C_USE_QUEUE
+	// Run anything that was queued while we had the bus
+	run_queue();
+#endif
+
+	return ERR_OK;
+}
+
+
+#if uHAL_I2C_USE_QUEUE
+//
+// Report the result of a transaction removed from the queue
+static void report_transaction(i2c_transaction_t *txn, err_t res) {
+	i2c_callback_t cb = txn->callback;
+
+	txn->next = NULL;
+	txn->res = res;
+	txn->busy = false;
+	if (cb != NULL) {
+		cb(res, txn->cb_data);
+	}
+
+	return;
+}
+//
+// Run a transaction; the write phase is followed by a repeated start on a
+// real bus
+static err_t run_transaction(const i2c_transaction_t *txn) {
+	err_t res = ERR_OK;
+
+	if (txn->tx_size > 0) {
+		res = host_i2c_transmit(txn->addr, txn->tx_buffer, txn->tx_size);
+	}
+	if ((res == ERR_OK) && (txn->rx_size > 0)) {
+		res = host_i2c_receive(txn->addr, txn->rx_buffer, txn->rx_size);
+	}
+
+	return res;
+}
+//
+// Run everything in the queue, including anything the callbacks add
+static void run_queue(void) {
+	if (queue_running || (active_addr != NO_ADDR)) {
+		return;
+	}
+
+	queue_running = true;
+	while (queue_head != NULL) {
+		i2c_transaction_t *txn = queue_head;
+		err_t res = run_transaction(txn);
+
+		queue_head = txn->next;
+		if (queue_head == NULL) {
+			queue_tail = NULL;
+		}
+		report_transaction(txn, res);
+	}
+	queue_running = false;
+
+	return;
+}
+//
+// Drop everything in the queue
+static void abort_queue(err_t res) {
+	i2c_transaction_t *txn = queue_head;
+
+	// The whole queue is detached first in case a callback queues something new
+	queue_head = NULL;
+	queue_tail = NULL;
+	while (txn != NULL) {
+		i2c_transaction_t *next = txn->next;
+
+		report_transaction(txn, res);
+		txn = next;
+	}
+
+	return;
+}
+
+err_t i2c_queue_transaction(i2c_transaction_t *txn) {
+	uHAL_assert(txn != NULL);
+	uHAL_assert(txn->addr <= 0x7FU);
+	uHAL_assert(TXN_OK(txn));
+#if ! uHAL_SKIP_INIT_CHECKS
+	if (!i2c_enabled) {
+		return ERR_INIT;
+	}
+#endif
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if ((txn == NULL) || (txn->addr > 0x7FU) || !TXN_OK(txn)) {
+		return ERR_BADARG;
+	}
+#endif
+	if (txn->busy) {
+		return ERR_RETRY;
+	}
+
+	txn->next = NULL;
+	txn->res = ERR_OK;
+	txn->busy = true;
+
+	if (queue_head == NULL) {
+		queue_head = txn;
+	} else {
+		queue_tail->next = txn;
+	}
+	queue_tail = txn;
+	run_queue();
+
+	return ERR_OK;
+}
+bool i2c_queue_is_busy(void) {
+	return (queue_head != NULL);
+}
+err_t i2c_queue_wait(const i2c_transaction_t *txn, utime_t timeout) {
+	UNUSED(timeout);
+
+	// Nothing runs in the background here so anything still waiting is
+	// stuck behind a callback or the bus being held and can't finish
+	if ((txn != NULL) ? txn->busy : (queue_head != NULL)) {
+		abort_queue(ERR_TIMEOUT);
+	}
+
+	if (txn != NULL) {
+		return txn->res;
+	}
+	return (queue_head == NULL) ? ERR_OK : ERR_TIMEOUT;
+}
+static err_t queue_block(uint8_t addr, const uint8_t *tx_buffer, txsize_t tx_size, uint8_t *rx_buffer, txsize_t rx_size) {
+	err_t res;
+	i2c_transaction_t txn = {
+		.tx_buffer = tx_buffer,
+		.rx_buffer = rx_buffer,
+		.tx_size = tx_size,
+		.rx_size = rx_size,
+		.addr = addr,
+	};
+
+	// From inside a callback the transaction would have to wait for the
+	// callback to return, so do it directly the same as a device does from
+	// inside an interrupt handler
+	if (queue_running) {
+		uHAL_assert(TXN_OK(&txn));
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+		if (!TXN_OK(&txn)) {
+			return ERR_BADARG;
+		}
+#endif
+		return run_transaction(&txn);
+	}
+
+	if ((res = i2c_queue_transaction(&txn)) != ERR_OK) {
+		return res;
+	}
+	return i2c_queue_wait(&txn, 1);
+}
+#endif // uHAL_I2C_USE_QUEUE
+
+
+#endif // uHAL_USE_I2C
@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// platform.h
+// Platform-specific shim for the frontend
+// NOTES:
+//   This file is for defining platform-specific features for the frontend
+//   that need to be known before configuration and should only be included
+//   from there.
+//
+//   The HOST platform runs the program as an ordinary POSIX process. There's
+//   no hardware behind any of the peripherals; GPIO and ADC state is kept in
+//   memory where it can be manipulated through the functions declared in
+//   interface/platform/host.h, the UART is mapped to stdin/stdout, and sleep
+//   advances a virtual clock instead of actually waiting.
+//
+#ifndef _uHAL_PLATFORM_HOST_H
+#define _uHAL_PLATFORM_HOST_H
+
+#define PLATFORM_INTERFACE_H "interface/platform/host.h"
+
+#include "ulib/include/time.h"
+#include "ulib/include/types.h"
+
+//
+// MCU-specific configuration
+#define HAVE_HOST 1
+
+//
+// Oscillator frequency
+// There's no real oscillator, these are only used for messages and the odd
+// calculation that expects them to exist
+#ifndef F_OSC
+# undef F_OSC
+# define F_OSC 1000000000UL
+#endif
+#ifndef F_CORE
+# undef F_CORE
+# define F_CORE F_OSC
+#endif
+#define G_freq_CORECLK F_CORE
+
+#include "platform_base_pins.h"
+
+//
+// Value returned on ADC conversion error
+#define ERR_ADC ((adc_t )-1)
+//
+// Ideal voltage on the Vcc pin
+#if ! REGULATED_VOLTAGE_mV
+# define REGULATED_VOLTAGE_mV 3300U
+#endif
+//
+// Voltage of the internal reference in mV
+#ifndef INTERNAL_VREF_mV
+# define INTERNAL_VREF_mV 1200U
+#endif
+
+//
+// Internal flash geometry
+// Programming is done in half-words the same as on the STM32F1
+#define FLASH_PAGE_BYTES HOST_FLASH_PAGE_BYTES
+#define FLASH_WRITE_BYTES 2U
+
+//
+// The system tick is derived from the host's monotonic clock and is always
+// in milliseconds
+#undef SYSTICKS_PER_S
+#define SYSTICKS_PER_S (1000U)
+#ifndef uHAL_USE_RTC_EMULATION
+# define uHAL_USE_RTC_EMULATION uHAL_USE_RTC
+#endif
+#ifndef uHAL_USE_UPTIME_EMULATION
+# define uHAL_USE_UPTIME_EMULATION uHAL_USE_UPTIME
+#endif
+
+
+typedef struct {
+	volatile const uint16_t *port;
+	uint16_t mask;
+} gpio_quick_t;
+
+typedef enum {
+	GPIO_MODE_RESET = 0, // Reset state of the pin
+	GPIO_MODE_PP,    // Push-pull output
+	GPIO_MODE_IN,    // Input
+	GPIO_MODE_AIN,   // Analog input
+	GPIO_MODE_HiZ,   // High-impedence mode
+
+	GPIO_MODE_RESET_ALIAS = GPIO_MODE_AIN,
+	GPIO_MODE_HiZ_ALIAS   = GPIO_MODE_AIN
+} gpio_mode_t;
+// This allows checking if we have a mode via the preprocessor while still getting
+// the benefits that an enum provides
+#define GPIO_MODE_RESET GPIO_MODE_RESET
+#define GPIO_MODE_PP    GPIO_MODE_PP
+#define GPIO_MODE_IN    GPIO_MODE_IN
+#define GPIO_MODE_AIN   GPIO_MODE_AIN
+#define GPIO_MODE_HiZ   GPIO_MODE_HiZ
+#define GPIO_MODE_RESET_ALIAS GPIO_MODE_RESET_ALIAS
+#define GPIO_MODE_HiZ_ALIAS   GPIO_MODE_HiZ_ALIAS
+
+#include "platform/common/uart_buf.h"
+typedef struct {
+	int rx_fd;
+	int tx_fd;
+	gpio_pin_t rx_pin;
+	gpio_pin_t tx_pin;
+	bool is_on;
+	bool is_listening;
+#if UART_INPUT_BUFFER_BYTES > 0 && ENABLE_UART_LISTENING
+	volatile uart_buffer_t rx_buf;
+#endif
+} uart_port_t;
+
+typedef struct {
+	gpio_pin_t pin;
+	uint8_t trigger;
+} gpio_listen_t;
+
+typedef struct {
+	gpio_pin_t pin;
+	uint_fast16_t duty_cycle;
+} pwm_output_t;
+
+#define GPIO_QUICK_READ(_qpin_) (SELECT_BITS(*((_qpin_).port), (_qpin_).mask) != 0)
+
+extern volatile utime_t G_sys_msticks;
+
+//
+// Update G_sys_msticks from the host clock and return the new value
+utime_t host_update_msticks(void);
+#define NOW_MS() host_update_msticks()
+
+
+#endif // _uHAL_PLATFORM_HOST_H
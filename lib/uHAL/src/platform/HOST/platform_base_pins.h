@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// platform_base_pins.h
+// Platform-specific shim for the frontend
+// NOTES:
+//   This file is for defining the base pin IDs without cluttering platform.h
+//   and should only be included by platform.h
+//
+//   The virtual ports are 16 pins wide to match the widest of the real
+//   platforms so that pin definitions from either can be used unchanged.
+//
+
+//
+// IO bit masks
+//
+// 4 bits (16 possible pins)
+#define GPIO_PIN_OFFSET (0U)
+#define GPIO_PIN_MASK  (0x0FU)
+//
+// 3 bits, can't be 0 (7 possible ports)
+#define GPIO_PORT_OFFSET (4U)
+#define GPIO_PORT_MASK (0b111U << GPIO_PORT_OFFSET)
+//
+// 3 bits
+#define GPIO_CTRL_OFFSET (8U)
+#define GPIO_CTRL_MASK (0b111U << GPIO_CTRL_OFFSET)
+
+typedef uint_fast16_t gpio_pin_t;
+
+#define GPIO_PIN_IS_VALID(_pin_) (((_pin_) & GPIO_PORT_MASK) != 0)
+
+//
+// There's no reason to leave out any of the ports on a virtual device, so
+// unlike the real platforms these can't be disabled
+#define HAVE_GPIO_PORTA 1
+#define HAVE_GPIO_PORTB 1
+#define HAVE_GPIO_PORTC 1
+#define HAVE_GPIO_PORTD 1
+#define GPIO_PORT_COUNT 4U
+
+//
+// Port A
+#define GPIO_PORTA 1U
+#define GPIO_PORTA_MASK (GPIO_PORTA << GPIO_PORT_OFFSET)
+#define PINID_A0   (GPIO_PORTA_MASK | 0x00U)
+#define PINID_A1   (GPIO_PORTA_MASK | 0x01U)
+#define PINID_A2   (GPIO_PORTA_MASK | 0x02U)
+#define PINID_A3   (GPIO_PORTA_MASK | 0x03U)
+#define PINID_A4   (GPIO_PORTA_MASK | 0x04U)
+#define PINID_A5   (GPIO_PORTA_MASK | 0x05U)
+#define PINID_A6   (GPIO_PORTA_MASK | 0x06U)
+#define PINID_A7   (GPIO_PORTA_MASK | 0x07U)
+#define PINID_A8   (GPIO_PORTA_MASK | 0x08U)
+#define PINID_A9   (GPIO_PORTA_MASK | 0x09U)
+#define PINID_A10  (GPIO_PORTA_MASK | 0x0AU)
+#define PINID_A11  (GPIO_PORTA_MASK | 0x0BU)
+#define PINID_A12  (GPIO_PORTA_MASK | 0x0CU)
+#define PINID_A13  (GPIO_PORTA_MASK | 0x0DU)
+#define PINID_A14  (GPIO_PORTA_MASK | 0x0EU)
+#define PINID_A15  (GPIO_PORTA_MASK | 0x0FU)
+
+//
+// Port B
+#define GPIO_PORTB 2U
+#define GPIO_PORTB_MASK (GPIO_PORTB << GPIO_PORT_OFFSET)
+#define PINID_B0   (GPIO_PORTB_MASK | 0x00U)
+#define PINID_B1   (GPIO_PORTB_MASK | 0x01U)
+#define PINID_B2   (GPIO_PORTB_MASK | 0x02U)
+#define PINID_B3   (GPIO_PORTB_MASK | 0x03U)
+#define PINID_B4   (GPIO_PORTB_MASK | 0x04U)
+#define PINID_B5   (GPIO_PORTB_MASK | 0x05U)
+#define PINID_B6   (GPIO_PORTB_MASK | 0x06U)
+#define PINID_B7   (GPIO_PORTB_MASK | 0x07U)
+#define PINID_B8   (GPIO_PORTB_MASK | 0x08U)
+#define PINID_B9   (GPIO_PORTB_MASK | 0x09U)
+#define PINID_B10  (GPIO_PORTB_MASK | 0x0AU)
+#define PINID_B11  (GPIO_PORTB_MASK | 0x0BU)
+#define PINID_B12  (GPIO_PORTB_MASK | 0x0CU)
+#define PINID_B13  (GPIO_PORTB_MASK | 0x0DU)
+#define PINID_B14  (GPIO_PORTB_MASK | 0x0EU)
+#define PINID_B15  (GPIO_PORTB_MASK | 0x0FU)
+
+//
+// Port C
+#define GPIO_PORTC 3U
+#define GPIO_PORTC_MASK (GPIO_PORTC << GPIO_PORT_OFFSET)
+#define PINID_C0   (GPIO_PORTC_MASK | 0x00U)
+#define PINID_C1   (GPIO_PORTC_MASK | 0x01U)
+#define PINID_C2   (GPIO_PORTC_MASK | 0x02U)
+#define PINID_C3   (GPIO_PORTC_MASK | 0x03U)
+#define PINID_C4   (GPIO_PORTC_MASK | 0x04U)
+#define PINID_C5   (GPIO_PORTC_MASK | 0x05U)
+#define PINID_C6   (GPIO_PORTC_MASK | 0x06U)
+#define PINID_C7   (GPIO_PORTC_MASK | 0x07U)
+#define PINID_C8   (GPIO_PORTC_MASK | 0x08U)
+#define PINID_C9   (GPIO_PORTC_MASK | 0x09U)
+#define PINID_C10  (GPIO_PORTC_MASK | 0x0AU)
+#define PINID_C11  (GPIO_PORTC_MASK | 0x0BU)
+#define PINID_C12  (GPIO_PORTC_MASK | 0x0CU)
+#define PINID_C13  (GPIO_PORTC_MASK | 0x0DU)
+#define PINID_C14  (GPIO_PORTC_MASK | 0x0EU)
+#define PINID_C15  (GPIO_PORTC_MASK | 0x0FU)
+
+//
+// Port D
+#define GPIO_PORTD 4U
+#define GPIO_PORTD_MASK (GPIO_PORTD << GPIO_PORT_OFFSET)
+#define PINID_D0   (GPIO_PORTD_MASK | 0x00U)
+#define PINID_D1   (GPIO_PORTD_MASK | 0x01U)
+#define PINID_D2   (GPIO_PORTD_MASK | 0x02U)
+#define PINID_D3   (GPIO_PORTD_MASK | 0x03U)
+#define PINID_D4   (GPIO_PORTD_MASK | 0x04U)
+#define PINID_D5   (GPIO_PORTD_MASK | 0x05U)
+#define PINID_D6   (GPIO_PORTD_MASK | 0x06U)
+#define PINID_D7   (GPIO_PORTD_MASK | 0x07U)
+#define PINID_D8   (GPIO_PORTD_MASK | 0x08U)
+#define PINID_D9   (GPIO_PORTD_MASK | 0x09U)
+#define PINID_D10  (GPIO_PORTD_MASK | 0x0AU)
+#define PINID_D11  (GPIO_PORTD_MASK | 0x0BU)
+#define PINID_D12  (GPIO_PORTD_MASK | 0x0CU)
+#define PINID_D13  (GPIO_PORTD_MASK | 0x0DU)
+#define PINID_D14  (GPIO_PORTD_MASK | 0x0EU)
+#define PINID_D15  (GPIO_PORTD_MASK | 0x0FU)
@@ -0,0 +1,459 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// sd_card.c
+// Emulate an SD card on the SPI bus
+// NOTES:
+//   This implements host_spi_exchange() with an SDHC card in SPI mode backed
+//   by the same image file used by the FatFS image driver, so that the real
+//   SD card driver can be run against it. Only the commands that driver uses
+//   are understood; anything else is answered with 'illegal command'.
+//
+//   The card is selected while SPI_CS_SD_PIN is low. Programming time is
+//   modeled as a number of bytes the card reports busy for after each write,
+//   which is enough to compare access patterns but doesn't match any
+//   particular card. A block that wasn't pre-erased with ACMD23 costs as much
+//   as a single-block write.
+//
+//   CRCs are neither checked nor generated.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include "spi.h"
+#include "gpio.h"
+
+#if uHAL_USE_SPI && HOST_SD_CARD_EMULATION
+
+#if ! defined(SPI_CS_SD_PIN)
+# error "HOST_SD_CARD_EMULATION requires SPI_CS_SD_PIN"
+#endif
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BLOCK_BYTES 512U
+
+#define R1_IDLE    0x01U
+#define R1_ILLEGAL 0x04U
+
+#define TOKEN_SINGLE 0xFEU
+#define TOKEN_MULTI  0xFCU
+#define TOKEN_STOP   0xFDU
+#define DATA_ACCEPTED 0xE5U
+#define DATA_WRITE_ERROR 0xEDU
+
+typedef enum {
+	SD_CMD = 0,     // Waiting for or receiving a command
+	SD_RESPOND,     // Sending the response queue
+	SD_WRITE_TOKEN, // Waiting for a data token
+	SD_WRITE_DATA,  // Receiving a data block
+	SD_READ_DATA    // Sending data blocks for CMD18
+} sd_state_t;
+
+static struct {
+	sd_state_t state;
+	int fd;
+	bool idle;
+	bool app_cmd;
+	bool multi;
+
+	uint8_t cmd[6];
+	uint_fast8_t cmd_len;
+
+	uint8_t out[BLOCK_BYTES + 16];
+	uint_fast16_t out_len;
+	uint_fast16_t out_pos;
+	sd_state_t after_respond;
+
+	uint8_t block[BLOCK_BYTES + 2];
+	uint_fast16_t block_pos;
+	uint32_t sector;
+	uint32_t pre_erased;
+	uint32_t busy;
+} card = { .fd = -1, .idle = true };
+
+static host_sd_stats_t stats;
+
+
+static bool open_image(void) {
+	const char *path;
+
+	if (card.fd >= 0) {
+		return true;
+	}
+
+	path = getenv("FATFS_IMAGE");
+	if (path == NULL) {
+		path = FATFS_IMAGE_PATH;
+	}
+	card.fd = open(path, O_RDWR);
+
+	return (card.fd >= 0);
+}
+static uint32_t image_sectors(void) {
+	struct stat st;
+
+	if (!open_image() || (fstat(card.fd, &st) != 0)) {
+		return 0;
+	}
+
+	return (uint32_t )(st.st_size / BLOCK_BYTES);
+}
+static bool read_block(uint8_t *buf, uint32_t sector) {
+	return open_image() && (pread(card.fd, buf, BLOCK_BYTES, (off_t )sector * BLOCK_BYTES) == (ssize_t )BLOCK_BYTES);
+}
+static bool write_block(const uint8_t *buf, uint32_t sector) {
+	return open_image() && (pwrite(card.fd, buf, BLOCK_BYTES, (off_t )sector * BLOCK_BYTES) == (ssize_t )BLOCK_BYTES);
+}
+
+static void queue_byte(uint8_t b) {
+	if (card.out_len < SIZEOF_ARRAY(card.out)) {
+		card.out[card.out_len++] = b;
+	}
+	return;
+}
+static void queue_r1(uint8_t flags) {
+	// One byte of NCR before the response
+	card.out_len = 0;
+	card.out_pos = 0;
+	queue_byte(0xFFU);
+	queue_byte((card.idle ? R1_IDLE : 0) | flags);
+	card.state = SD_RESPOND;
+	card.after_respond = SD_CMD;
+
+	return;
+}
+//
+// Queue a data block after the response
+static void queue_block(const uint8_t *data, uint_fast16_t size) {
+	queue_byte(0xFFU);
+	queue_byte(TOKEN_SINGLE);
+	for (uint_fast16_t i = 0; i < size; ++i) {
+		queue_byte(data[i]);
+	}
+	// CRC
+	queue_byte(0xFFU);
+	queue_byte(0xFFU);
+
+	return;
+}
+static void queue_read_block(void) {
+	uint8_t buf[BLOCK_BYTES];
+
+	card.out_len = 0;
+	card.out_pos = 0;
+	if (!read_block(buf, card.sector)) {
+		// Data error token
+		queue_byte(0x08U);
+	} else {
+		queue_block(buf, BLOCK_BYTES);
+		++stats.blocks_read;
+	}
+	++card.sector;
+
+	return;
+}
+
+static void do_cmd(void) {
+	const uint_fast8_t cmd = card.cmd[0] & 0x3FU;
+	const uint32_t arg = ((uint32_t )card.cmd[1] << 24) | ((uint32_t )card.cmd[2] << 16) | ((uint32_t )card.cmd[3] << 8) | card.cmd[4];
+	const bool app = card.app_cmd;
+
+	++stats.commands;
+	card.app_cmd = false;
+
+	if (app) {
+		switch (cmd) {
+		case 41: // SD_SEND_OP_COND
+			card.idle = false;
+			queue_r1(0);
+			return;
+		case 23: // SET_WR_BLK_ERASE_COUNT
+			card.pre_erased = arg & 0x7FFFFFU;
+			++stats.pre_erase_hints;
+			queue_r1(0);
+			return;
+		case 13: { // SD_STATUS
+			uint8_t status[64] = { 0 };
+
+			queue_r1(0);
+			// R2 has a second status byte
+			queue_byte(0);
+			queue_block(status, SIZEOF_ARRAY(status));
+			return;
+		}
+		default:
+			break;
+		}
+	}
+
+	switch (cmd) {
+	case 0: // GO_IDLE_STATE
+		card.idle = true;
+		queue_r1(0);
+		break;
+	case 8: // SEND_IF_COND
+		queue_r1(0);
+		queue_byte(0);
+		queue_byte(0);
+		queue_byte((uint8_t )((arg >> 8) & 0x0FU));
+		queue_byte((uint8_t )(arg & 0xFFU));
+		break;
+	case 58: // READ_OCR, powered up and block addressed
+		queue_r1(0);
+		queue_byte(0xC0U);
+		queue_byte(0xFFU);
+		queue_byte(0x80U);
+		queue_byte(0x00U);
+		break;
+	case 55: // APP_CMD
+		card.app_cmd = true;
+		queue_r1(0);
+		break;
+	case 16: // SET_BLOCKLEN
+		queue_r1((arg == BLOCK_BYTES) ? 0 : 0x40U);
+		break;
+	case 9: { // SEND_CSD, version 2
+		uint8_t csd[16] = { 0x40U };
+		uint32_t c_size = (image_sectors() / 1024U);
+
+		c_size = (c_size > 0) ? c_size - 1U : 0;
+		csd[7] = (uint8_t )((c_size >> 16) & 0x3FU);
+		csd[8] = (uint8_t )(c_size >> 8);
+		csd[9] = (uint8_t )c_size;
+		// ERASE_BLK_EN
+		csd[10] = 0x40U;
+		queue_r1(0);
+		queue_block(csd, SIZEOF_ARRAY(csd));
+		break;
+	}
+	case 10: { // SEND_CID
+		uint8_t cid[16] = { 0 };
+
+		queue_r1(0);
+		queue_block(cid, SIZEOF_ARRAY(cid));
+		break;
+	}
+	case 17: // READ_SINGLE_BLOCK
+	case 18: // READ_MULTIPLE_BLOCK
+		if (cmd == 17) {
+			++stats.single_block_reads;
+		} else {
+			++stats.multi_block_reads;
+		}
+		card.sector = arg;
+		queue_r1(0);
+		if (cmd == 17) {
+			uint8_t buf[BLOCK_BYTES];
+
+			if (read_block(buf, arg)) {
+				queue_block(buf, BLOCK_BYTES);
+				++stats.blocks_read;
+			} else {
+				queue_byte(0x08U);
+			}
+		} else {
+			card.after_respond = SD_READ_DATA;
+		}
+		break;
+	case 12: // STOP_TRANSMISSION
+		queue_r1(0);
+		break;
+	case 24: // WRITE_BLOCK
+	case 25: // WRITE_MULTIPLE_BLOCK
+		if (cmd == 24) {
+			++stats.single_block_writes;
+			card.pre_erased = 0;
+		} else {
+			++stats.multi_block_writes;
+		}
+		card.multi = (cmd == 25);
+		card.sector = arg;
+		queue_r1(0);
+		card.after_respond = SD_WRITE_TOKEN;
+		break;
+	default:
+		queue_r1(R1_ILLEGAL);
+		break;
+	}
+
+	return;
+}
+
+static uint8_t exchange_cmd(uint8_t tx) {
+	if (card.cmd_len == 0 && (tx & 0xC0U) != 0x40U) {
+		if (tx == TOKEN_STOP || tx == TOKEN_MULTI || tx == TOKEN_SINGLE) {
+			++stats.stray_tokens;
+		}
+		return 0xFFU;
+	}
+
+	card.cmd[card.cmd_len++] = tx;
+	if (card.cmd_len == SIZEOF_ARRAY(card.cmd)) {
+		card.cmd_len = 0;
+		do_cmd();
+	}
+
+	return 0xFFU;
+}
+static uint8_t exchange_write(uint8_t tx) {
+	if (card.state == SD_WRITE_TOKEN) {
+		if (tx == TOKEN_STOP && card.multi) {
+			card.busy = HOST_SD_PROGRAM_BUSY_BYTES;
+			card.pre_erased = 0;
+			card.state = SD_CMD;
+		} else if ((tx == TOKEN_SINGLE && !card.multi) || (tx == TOKEN_MULTI && card.multi)) {
+			card.block_pos = 0;
+			card.state = SD_WRITE_DATA;
+		} else if ((tx & 0xC0U) == 0x40U && !card.multi) {
+			// A new command instead of the data
+			card.state = SD_CMD;
+			return exchange_cmd(tx);
+		}
+		return 0xFFU;
+	}
+
+	card.block[card.block_pos++] = tx;
+	if (card.block_pos < SIZEOF_ARRAY(card.block)) {
+		return 0xFFU;
+	}
+
+	// The data response goes out on the next exchange
+	card.out_len = 0;
+	card.out_pos = 0;
+	card.state = SD_RESPOND;
+	if (write_block(card.block, card.sector)) {
+		queue_byte(DATA_ACCEPTED);
+		++stats.blocks_written;
+	} else {
+		queue_byte(DATA_WRITE_ERROR);
+	}
+	++card.sector;
+
+	if (!card.multi) {
+		card.busy = HOST_SD_PROGRAM_BUSY_BYTES;
+		card.after_respond = SD_CMD;
+	} else {
+		if (card.pre_erased > 0) {
+			--card.pre_erased;
+			card.busy = HOST_SD_STREAM_BUSY_BYTES;
+		} else {
+			card.busy = HOST_SD_PROGRAM_BUSY_BYTES;
+		}
+		card.after_respond = SD_WRITE_TOKEN;
+	}
+
+	return 0xFFU;
+}
+
+uint8_t host_spi_exchange(uint8_t tx) {
+	uint8_t rx = 0xFFU;
+
+	if (gpio_get_output_state(SPI_CS_SD_PIN) != GPIO_LOW) {
+		// Deselecting the card drops any pending output but doesn't stop
+		// programming or an open multiple block write
+		card.cmd_len = 0;
+		if (card.state == SD_RESPOND || card.state == SD_READ_DATA) {
+			card.state = (card.after_respond == SD_WRITE_TOKEN) ? SD_WRITE_TOKEN : SD_CMD;
+		}
+		return 0xFFU;
+	}
+	++stats.bytes_clocked;
+
+	switch (card.state) {
+	case SD_RESPOND:
+		rx = card.out[card.out_pos++];
+		if (card.out_pos >= card.out_len) {
+			card.state = card.after_respond;
+			if (card.state == SD_READ_DATA) {
+				queue_read_block();
+			}
+		}
+		return rx;
+
+	case SD_READ_DATA:
+		// A command (STOP_TRANSMISSION) can come in while data is going out
+		if (card.cmd_len > 0 || (tx & 0xC0U) == 0x40U) {
+			exchange_cmd(tx);
+			return 0xFFU;
+		}
+		rx = card.out[card.out_pos++];
+		if (card.out_pos >= card.out_len) {
+			queue_read_block();
+		}
+		return rx;
+
+	default:
+		break;
+	}
+
+	if (card.busy > 0) {
+		--card.busy;
+		++stats.busy_bytes;
+		return 0x00U;
+	}
+
+	switch (card.state) {
+	case SD_WRITE_TOKEN:
+	case SD_WRITE_DATA:
+		rx = exchange_write(tx);
+		break;
+	default:
+		rx = exchange_cmd(tx);
+		break;
+	}
+
+	return rx;
+}
+
+void host_sd_get_stats(host_sd_stats_t *s) {
+	uHAL_assert(s != NULL);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (s == NULL) {
+		return;
+	}
+#endif
+
+	*s = stats;
+
+	return;
+}
+void host_sd_reset_stats(void) {
+	stats = (host_sd_stats_t ){ 0 };
+
+	return;
+}
+void host_sd_power_cycle(void) {
+	card.state = SD_CMD;
+	card.idle = true;
+	card.app_cmd = false;
+	card.multi = false;
+	card.cmd_len = 0;
+	card.out_len = 0;
+	card.out_pos = 0;
+	card.block_pos = 0;
+	card.pre_erased = 0;
+	card.busy = 0;
+
+	return;
+}
+
+#endif // uHAL_USE_SPI && HOST_SD_CARD_EMULATION
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// spi.c
+// Manage the SPI peripheral
+// NOTES:
+//   There's no bus behind this, every byte is passed to host_spi_exchange()
+//   which by default behaves as if nothing were connected and returns 0xFF.
+//
+
+#include "spi.h"
+#include "system.h"
+#include "gpio.h"
+
+
+#if uHAL_USE_SPI
+
+static bool spi_enabled;
+
+
+__attribute__((weak))
+uint8_t host_spi_exchange(uint8_t tx) {
+	UNUSED(tx);
+
+	return 0xFFU;
+}
+
+void spi_init(void) {
+	spi_off();
+
+	return;
+}
+err_t spi_on(void) {
+#if ! uHAL_SKIP_OTHER_CHECKS
+	if (spi_enabled) {
+		return ERR_OK;
+	}
+#endif
+
+	gpio_set_mode(SPI_SCK_PIN,  GPIO_MODE_PP, GPIO_HIGH);
+	gpio_set_mode(SPI_MOSI_PIN, GPIO_MODE_PP, GPIO_HIGH);
+	gpio_set_mode(SPI_MISO_PIN, GPIO_MODE_IN, GPIO_FLOAT);
+	spi_enabled = true;
+
+	return ERR_OK;
+}
+err_t spi_off(void) {
+#if ! uHAL_SKIP_OTHER_CHECKS
+	if (!spi_enabled) {
+		return ERR_OK;
+	}
+#endif
+
+	spi_enabled = false;
+	gpio_set_mode(SPI_SCK_PIN,  GPIO_MODE_RESET, GPIO_FLOAT);
+	gpio_set_mode(SPI_MOSI_PIN, GPIO_MODE_RESET, GPIO_FLOAT);
+	gpio_set_mode(SPI_MISO_PIN, GPIO_MODE_RESET, GPIO_FLOAT);
+
+	return ERR_OK;
+}
+bool spi_is_on(void) {
+	return spi_enabled;
+}
+
+err_t spi_exchange_byte(uint8_t tx, uint8_t *rx, utime_t timeout) {
+	uint8_t rx_byte;
+
+	UNUSED(timeout);
+
+#if ! uHAL_SKIP_INIT_CHECKS
+	if (!spi_enabled) {
+		return ERR_INIT;
+	}
+#endif
+
+	rx_byte = host_spi_exchange(tx);
+	if (rx != NULL) {
+		*rx = rx_byte;
+	}
+
+	return ERR_OK;
+}
+err_t spi_receive_block(uint8_t *rx_buffer, txsize_t rx_size, uint8_t tx, utime_t timeout) {
+	uHAL_assert(rx_buffer != NULL);
+	uHAL_assert(rx_size > 0);
+	UNUSED(timeout);
+
+#if ! uHAL_SKIP_INIT_CHECKS
+	if (!spi_enabled) {
+		return ERR_INIT;
+	}
+#endif
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if ((rx_buffer == NULL) || (rx_size == 0)) {
+		return ERR_BADARG;
+	}
+#endif
+
+	for (txsize_t i = 0; i < rx_size; ++i) {
+		rx_buffer[i] = host_spi_exchange(tx);
+	}
+
+	return ERR_OK;
+}
+err_t spi_transmit_block(const uint8_t *tx_buffer, txsize_t tx_size, utime_t timeout) {
+	uHAL_assert(tx_buffer != NULL);
+	uHAL_assert(tx_size > 0);
+	UNUSED(timeout);
+
+#if ! uHAL_SKIP_INIT_CHECKS
+	if (!spi_enabled) {
+		return ERR_INIT;
+	}
+#endif
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if ((tx_buffer == NULL) || (tx_size == 0)) {
+		return ERR_BADARG;
+	}
+#endif
+
+	for (txsize_t i = 0; i < tx_size; ++i) {
+		host_spi_exchange(tx_buffer[i]);
+	}
+
+	return ERR_OK;
+}
+
+
+#endif // uHAL_USE_SPI
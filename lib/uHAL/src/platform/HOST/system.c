@@ -0,0 +1,247 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// system.c
+// General platform initialization
+// NOTES:
+//   Hibernation doesn't wait, it just skips the virtual clock forward by the
+//   requested period. Anything that could have woken the device in the
+//   meantime (that is, UART input) is checked for before skipping.
+//
+//   There's no memory set aside by the linker for halloc() to use like there
+//   is on the real platforms, so a static array is used for the heap instead.
+//   Build with '-DHALLOC_HEAP_START_LINKER_VAR=uHAL_host_heap' to use it.
+//
+//   The retained memory block is kept in a file between runs; running the
+//   program again with the same file is the equivalent of a reset.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include "system.h"
+#include "adc.h"
+#include "gpio.h"
+#include "spi.h"
+#include "time.h"
+#include "i2c.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+void pre_hibernate_hook_caller(utime_t *s, sleep_mode_t *sleep_mode, uHAL_flags_t flags);
+void post_hibernate_hook_caller(utime_t s, sleep_mode_t sleep_mode, uHAL_flags_t flags);
+
+
+#if ULIB_ENABLE_HALLOC
+char uHAL_host_heap[HOST_HEAP_BYTES] __attribute__((aligned(16)));
+
+//
+// halloc() normally checks for the heap running into the stack; make it check
+// for the end of the heap array instead
+uintptr_t ulib_get_stack_pointer_addr(void) {
+	return (uintptr_t )&uHAL_host_heap[HOST_HEAP_BYTES];
+}
+#endif
+
+#if uHAL_RETAINED_MEMORY_BYTES > 0
+static uint8_t retained_memory[uHAL_RETAINED_MEMORY_BYTES] __attribute__((aligned(16)));
+static const char *retained_memory_path;
+
+static void save_retained_memory(void) {
+	FILE *f;
+
+	if ((f = fopen(retained_memory_path, "wb")) == NULL) {
+		return;
+	}
+	if (fwrite(retained_memory, 1, sizeof(retained_memory), f) != sizeof(retained_memory)) {
+		LOGGER("Failed to save retained memory to %s", retained_memory_path);
+	}
+	fclose(f);
+
+	return;
+}
+static void load_retained_memory(void) {
+	FILE *f;
+
+	if ((retained_memory_path = getenv("HOST_RETAINED_MEMORY_FILE")) == NULL) {
+		retained_memory_path = HOST_RETAINED_MEMORY_PATH;
+	}
+	//
+	// A missing or short file is the same as powering up, which leaves the
+	// contents undefined; zeroes will do
+	if ((f = fopen(retained_memory_path, "rb")) != NULL) {
+		if (fread(retained_memory, 1, sizeof(retained_memory), f) != sizeof(retained_memory)) {
+			LOGGER("Short read of retained memory from %s", retained_memory_path);
+		}
+		fclose(f);
+	}
+	atexit(save_retained_memory);
+
+	return;
+}
+
+void* get_retained_memory(void) {
+	return retained_memory;
+}
+#endif // uHAL_RETAINED_MEMORY_BYTES > 0
+
+static uint_fast64_t run_limit_ms = (uint_fast64_t )HOST_RUN_LIMIT_S * 1000U;
+
+static void check_run_limit(void) {
+	if ((run_limit_ms != 0) && (host_get_elapsed_ms() >= run_limit_ms)) {
+		LOGGER("Run time limit of %lus reached", (unsigned long )(run_limit_ms / 1000U));
+		exit(EXIT_SUCCESS);
+	}
+
+	return;
+}
+
+void platform_init(void) {
+	const char *env;
+
+	// The run time limit can be adjusted without rebuilding
+	if ((env = getenv("HOST_RUN_LIMIT_S")) != NULL) {
+		run_limit_ms = (uint_fast64_t )strtoul(env, NULL, 10) * 1000U;
+	}
+#if uHAL_RETAINED_MEMORY_BYTES > 0
+	load_retained_memory();
+#endif
+
+	time_init();
+
+	gpio_init();
+
+#if uHAL_USE_UPTIME
+	init_uptime();
+#endif
+
+#if uHAL_USE_UART_COMM
+	const uart_port_cfg_t uart_cfg = {
+		.rx_pin = UART_COMM_RX_PIN,
+		.tx_pin = UART_COMM_TX_PIN,
+		.baud_rate = UART_COMM_BAUDRATE,
+	};
+	if (uart_init_port(UART_COMM_PORT, &uart_cfg) == ERR_OK) {
+		uart_on(UART_COMM_PORT);
+		serial_init();
+	} else {
+		error_state_crude();
+	}
+#endif
+
+#if uHAL_USE_SPI
+	spi_init();
+#endif
+
+#if uHAL_USE_I2C
+	i2c_init();
+#endif
+
+#if uHAL_USE_ADC
+	adc_init();
+#endif
+
+	return;
+}
+
+void platform_reset(void) {
+	pre_reset_hook();
+	// There's no way to reset the host, so just go away and let whoever
+	// started us decide whether to start again
+	exit(EXIT_SUCCESS);
+}
+
+bool host_check_IRQs(utime_t wait_ms) {
+#if uHAL_USE_UART
+	return uart_poll_input(wait_ms);
+#else
+	UNUSED(wait_ms);
+	return false;
+#endif
+}
+
+static sleep_mode_t limit_hibernation_depth(sleep_mode_t sleep_mode) {
+	if (uHAL_CHECK_STATUS(uHAL_FLAG_INHIBIT_HIBERNATION)) {
+		sleep_mode = HIBERNATE_LIGHT;
+	} else if (uHAL_HIBERNATE_LIMIT != 0 && sleep_mode > uHAL_HIBERNATE_LIMIT) {
+		sleep_mode = uHAL_HIBERNATE_LIMIT;
+	}
+
+	return sleep_mode;
+}
+
+#if uHAL_USE_HIBERNATE
+void sleep_ms(utime_t ms) {
+	skip_virtual_ms(ms);
+
+	return;
+}
+
+void hibernate_s(utime_t s, sleep_mode_t sleep_mode, uHAL_flags_t flags) {
+	sleep_mode = limit_hibernation_depth(sleep_mode);
+
+	pre_hibernate_hook_caller(&s, &sleep_mode, flags);
+	const utime_t begin_s = s;
+	if (!uHAL_SKIP_OTHER_CHECKS) {
+		sleep_mode = limit_hibernation_depth(sleep_mode);
+	}
+
+	// Anything that arrived while we were awake would have cut the sleep
+	// short immediately, so handle it before deciding whether to sleep at all
+	if (BIT_IS_SET(flags, uHAL_CFG_ALLOW_INTERRUPTS)) {
+		host_check_IRQs(0);
+	}
+	if ((!IRQ_IS_WAITING(flags)) && (s != 0)) {
+		skip_virtual_ms((uint_fast32_t )s * 1000U);
+	}
+
+	if (IRQ_IS_REQUESTED) {
+		LOGGER("Hibernation ending with uHAL_status at 0x%02X", (uint_t )uHAL_status);
+	}
+
+	post_hibernate_hook_caller(begin_s, sleep_mode, flags);
+	check_run_limit();
+
+	return;
+}
+#endif // uHAL_USE_HIBERNATE
+
+void hibernate(sleep_mode_t sleep_mode, uHAL_flags_t flags) {
+	sleep_mode = limit_hibernation_depth(sleep_mode);
+
+	pre_hibernate_hook_caller(NULL, &sleep_mode, flags);
+	if (!uHAL_SKIP_OTHER_CHECKS) {
+		sleep_mode = limit_hibernation_depth(sleep_mode);
+	}
+
+	// Without an alarm only an interrupt can end the sleep, so wait for one in
+	// real time because there's no telling how far forward the virtual clock
+	// should go
+	while (!IRQ_IS_REQUESTED) {
+		if (!host_check_IRQs(1000)) {
+			LOGGER("Nothing can end hibernation, giving up");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	post_hibernate_hook_caller(0, sleep_mode, flags);
+	check_run_limit();
+
+	return;
+}
@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// system.h
+// General platform initialization
+// NOTES:
+//   Prototypes for some of the related functions are in interface.h
+//
+#ifndef _uHAL_PLATFORM_HOST_SYSTEM_H
+#define _uHAL_PLATFORM_HOST_SYSTEM_H
+
+
+#include "common.h"
+
+
+//
+// Check for any pending input that would have generated an interrupt on
+// real hardware and run the associated handlers
+// If wait_ms is non-zero, block for up to that many milliseconds of real time
+// waiting for input.
+// Returns false if there's nothing that could ever generate an interrupt.
+bool host_check_IRQs(utime_t wait_ms);
+
+#if uHAL_USE_UART
+//
+// Check the UART for received data, handling it like the RX interrupt would
+// Returns false if the UART isn't listening.
+bool uart_poll_input(utime_t wait_ms);
+#endif
+
+
+#endif // _uHAL_PLATFORM_HOST_SYSTEM_H
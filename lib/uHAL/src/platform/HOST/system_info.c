@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// system_info.c
+// Return information about the running system
+// NOTES:
+//
+
+#include "common.h"
+#include "system.h"
+#include "time.h"
+
+#include "ulib/include/printf.h"
+#include "ulib/include/halloc.h"
+
+
+void _print_platform_info(void (*printf_putc)(uint_fast8_t c)) {
+	int heap_size = 0;
+	uint_fast64_t elapsed_s, slept_s;
+
+	uHAL_assert(printf_putc != NULL);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (printf_putc == NULL) {
+		return;
+	}
+#endif
+
+	elapsed_s = host_get_elapsed_ms() / 1000U;
+	slept_s = host_get_virtual_sleep_ms() / 1000U;
+	ulib_printf(printf_putc, F("Host process, virtual time: %lus, of which %lus asleep\r\n"),
+		(unsigned long )elapsed_s,
+		(unsigned long )slept_s
+		);
+
+#if ULIB_ENABLE_HALLOC
+	heap_size = (int )halloc_total_allocated();
+#endif
+	ulib_printf(printf_putc, F("RAM used: %dB of %dB heap\r\n"), (int )heap_size, (int )HOST_HEAP_BYTES);
+
+	return;
+}
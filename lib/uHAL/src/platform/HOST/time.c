@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// time.c
+// Manage the time-keeping peripherals
+//
+// NOTES:
+//   The systick counter follows the host's monotonic clock while the program
+//   is awake, plus any time spent in delay_ms(). Unless HOST_REALTIME_DELAYS
+//   is set, delays don't actually wait; they just move the counter forward so
+//   that things like LED flashes don't slow down a simulation.
+//
+//   Sleeping is handled by skip_virtual_ms(), which adds the time to the
+//   emulated RTC the same way the real platforms do after waking. The systick
+//   counter isn't touched because it doesn't advance during sleep on real
+//   hardware either.
+//
+//   <time.h> is shadowed by ulib's time.h when ulib/include is in the include
+//   path, so the host clock is read with gettimeofday() and real delays use
+//   poll().
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include "time.h"
+#include "system.h"
+
+#include <poll.h>
+#include <sys/time.h>
+
+
+// System ticks, milliseconds
+volatile utime_t G_sys_msticks = 0;
+// Offset between the host clock and G_sys_msticks, adjusted when the systick
+// is paused and by virtual delays
+static utime_t msticks_offset = 0;
+static bool systick_enabled = false;
+// Total time spent in virtual sleep
+static uint_fast64_t virtual_sleep_ms = 0;
+// Total time skipped by virtual delays
+static uint_fast64_t virtual_delay_ms = 0;
+
+static struct timeval boot_time;
+
+
+static uint_fast64_t host_elapsed_us(void) {
+	struct timeval now;
+	uint_fast64_t us;
+
+	gettimeofday(&now, NULL);
+	us  = (uint_fast64_t )(now.tv_sec - boot_time.tv_sec) * 1000000U;
+	us += (int_fast64_t )now.tv_usec - (int_fast64_t )boot_time.tv_usec;
+
+	return us;
+}
+static utime_t host_elapsed_ms(void) {
+	return (utime_t )(host_elapsed_us() / 1000U);
+}
+
+void time_init(void) {
+	gettimeofday(&boot_time, NULL);
+	G_sys_msticks = 0;
+	msticks_offset = 0;
+	virtual_sleep_ms = 0;
+	virtual_delay_ms = 0;
+
+	enable_systick();
+
+	return;
+}
+
+utime_t host_update_msticks(void) {
+	if (systick_enabled) {
+		G_sys_msticks = host_elapsed_ms() + msticks_offset;
+	}
+
+	return G_sys_msticks;
+}
+void enable_systick(void) {
+	if (!systick_enabled) {
+		// Pick up where we left off instead of jumping forward by however long
+		// the systick was disabled
+		msticks_offset = G_sys_msticks - host_elapsed_ms();
+		systick_enabled = true;
+	}
+
+	return;
+}
+void disable_systick(void) {
+	host_update_msticks();
+	systick_enabled = false;
+
+	return;
+}
+bool systick_is_enabled(void) {
+	return systick_enabled;
+}
+
+void skip_virtual_ms(uint_fast32_t ms) {
+	virtual_sleep_ms += ms;
+
+#if uHAL_USE_RTC && uHAL_USE_RTC_EMULATION
+	while (ms > 0) {
+		uint_fast16_t chunk = (ms < 0xFFFFU) ? ms : 0xFFFFU;
+
+		add_RTC_millis(chunk);
+		ms -= chunk;
+	}
+#endif
+
+	return;
+}
+uint_fast64_t host_get_virtual_sleep_ms(void) {
+	return virtual_sleep_ms;
+}
+uint_fast64_t host_get_elapsed_ms(void) {
+	return virtual_sleep_ms + host_update_msticks();
+}
+uint_fast64_t host_get_awake_us(void) {
+	return host_elapsed_us() + (virtual_delay_ms * 1000U);
+}
+
+//
+// Delay stuff
+//
+#if HOST_REALTIME_DELAYS
+static void host_sleep_ms(utime_t ms) {
+	utime_t timeout;
+
+	// poll() may return early if interrupted by a signal
+	timeout = SET_TIMEOUT_MS(ms);
+	while (!TIMES_UP(timeout)) {
+		poll(NULL, 0, (int )(timeout - NOW_MS()));
+	}
+
+	return;
+}
+#endif
+void delay_ms(utime_t ms) {
+#if HOST_REALTIME_DELAYS
+	host_sleep_ms(ms);
+#else
+	msticks_offset += ms;
+	virtual_delay_ms += ms;
+#endif
+	host_update_msticks();
+
+	return;
+}
+void dumb_delay_ms(utime_t ms) {
+	delay_ms(ms);
+	return;
+}
+void dumb_delay_cycles(uint_fast32_t cycles) {
+#if HOST_REALTIME_DELAYS
+	host_sleep_ms(cycles / (G_freq_CORECLK / 1000U));
+#else
+	UNUSED(cycles);
+#endif
+	return;
+}
+
+//
+// Microsecond counter
+//
+#if uHAL_USE_USCOUNTER
+static uint_fast64_t uscounter_start_us = 0;
+
+err_t uscounter_on(void) {
+	return ERR_OK;
+}
+err_t uscounter_off(void) {
+	return ERR_OK;
+}
+err_t uscounter_start(void) {
+	uscounter_start_us = host_elapsed_us();
+
+	return ERR_OK;
+}
+uint_fast32_t uscounter_stop(void) {
+	return uscounter_read();
+}
+uint_fast32_t uscounter_read(void) {
+	return (uint_fast32_t )(host_elapsed_us() - uscounter_start_us);
+}
+#endif // uHAL_USE_USCOUNTER
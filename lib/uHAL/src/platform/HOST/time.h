@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// time.h
+// Manage the time-keeping peripherals
+// NOTES:
+//   Prototypes for most of the related functions are in interface.h
+//
+#ifndef _uHAL_PLATFORM_HOST_TIME_H
+#define _uHAL_PLATFORM_HOST_TIME_H
+
+#include "common.h"
+
+//
+// Initialize the time-keeping peripherals
+void time_init(void);
+
+//
+// Skip the virtual clock forward as if the system had been asleep for this
+// many milliseconds
+// The systick doesn't advance during sleep on real hardware, so only the
+// emulated RTC is affected.
+void skip_virtual_ms(uint_fast32_t ms);
+
+#endif // _uHAL_PLATFORM_HOST_TIME_H
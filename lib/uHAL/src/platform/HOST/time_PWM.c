@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// time_PWM.c
+// Manage PWM outputs
+// NOTES:
+//   There's no timer behind this, the duty cycle is only remembered so that
+//   it can be inspected through the handle.
+//
+
+#include "time.h"
+#include "system.h"
+
+#if uHAL_USE_PWM
+
+//
+// PWM stuff
+//
+err_t pwm_set(pwm_output_t *output, uint_fast16_t duty_cycle) {
+	uHAL_assert(output != NULL);
+	uHAL_assert(PINID(output->pin) != 0);
+	uHAL_assert(duty_cycle <= PWM_DUTY_CYCLE_SCALE);
+
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (output == NULL || PINID(output->pin) == 0) {
+		return ERR_BADARG;
+	}
+#endif
+	if (duty_cycle > PWM_DUTY_CYCLE_SCALE) {
+		duty_cycle = PWM_DUTY_CYCLE_SCALE;
+	}
+
+	output->duty_cycle = duty_cycle;
+
+	return ERR_OK;
+}
+err_t pwm_on(pwm_output_t *output, gpio_pin_t pin, uint_fast16_t duty_cycle) {
+	uHAL_assert(output != NULL);
+
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (output == NULL) {
+		return ERR_BADARG;
+	}
+#endif
+
+	if (PINID(pin) != 0) {
+		output->pin = pin;
+	}
+	if (!GPIO_PIN_IS_VALID(output->pin)) {
+		return ERR_BADARG;
+	}
+	gpio_set_mode(output->pin, GPIO_MODE_PP, GPIO_LOW);
+
+	return pwm_set(output, duty_cycle);
+}
+err_t pwm_off(pwm_output_t *output) {
+	uHAL_assert(output != NULL);
+	uHAL_assert(PINID(output->pin) != 0);
+
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (output == NULL || PINID(output->pin) == 0) {
+		return ERR_BADARG;
+	}
+#endif
+
+	output->duty_cycle = 0;
+	gpio_set_mode(output->pin, GPIO_MODE_RESET, GPIO_FLOAT);
+
+	return ERR_OK;
+}
+
+
+#endif // uHAL_USE_PWM
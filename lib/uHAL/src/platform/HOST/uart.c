@@ -0,0 +1,302 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// uart.c
+// Manage the UART peripheral
+// NOTES:
+//   There's only a single UART on the host, mapped to stdin and stdout.
+//
+//   Received data is picked up by host_check_IRQs(), which is called whenever
+//   the program would be sleeping on real hardware and hands it off to the
+//   same IRQ handling the real platforms use.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include "common.h"
+#if uHAL_USE_UART
+
+#include "system.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+// For memcpy() and memmove()
+#include <string.h>
+
+
+#include "platform/common/uart_buf.c"
+
+DEBUG_CPP_MACRO(UART_INPUT_BUFFER_BYTES)
+
+#ifdef UART_COMM_PORT
+# define SET_DEFAULT_PORT(_p_) do { if ((_p_) == NULL) (_p_) = UART_COMM_PORT; } while (0)
+#else
+# define SET_DEFAULT_PORT(_p_)
+#endif
+
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+# define VERIFY_PORT(_p_) \
+	do { \
+		uHAL_assert(p != NULL); \
+		uHAL_assert(p->tx_fd >= 0); \
+		if (p == NULL) { \
+			return ERR_BADARG; \
+		} \
+		if (p->tx_fd < 0) { \
+			return ERR_INIT; \
+		} \
+	} while (0)
+#else
+# define VERIFY_PORT(_p_) \
+	do { \
+		uHAL_assert(p != NULL); \
+		uHAL_assert(p->tx_fd >= 0); \
+	} while (0)
+#endif
+
+//#define BUFFER_OK(_buf_, _size_) ((_buf_) != NULL && (_size_) > 0)
+#define BUFFER_OK(_buf_, _size_) ((_buf_) != NULL)
+
+static uart_port_t *host_port = NULL;
+
+//
+// Wait up to timeout ms of real time for the fd to become ready
+static bool fd_is_ready(int fd, short events, utime_t timeout) {
+	struct pollfd pfd = {
+		.fd = fd,
+		.events = events,
+	};
+
+	return (poll(&pfd, 1, (int )timeout) > 0 && BIT_IS_SET(pfd.revents, events));
+}
+
+err_t uart_init_port(uart_port_t *p, const uart_port_cfg_t *conf) {
+	SET_DEFAULT_PORT(p);
+
+	uHAL_assert(conf != NULL);
+	uHAL_assert(p != NULL);
+
+# if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if ((conf == NULL) || (p == NULL)) {
+		return ERR_BADARG;
+	}
+# endif
+	if ((host_port != NULL) && (host_port != p)) {
+		return ERR_INUSE;
+	}
+
+	p->rx_fd = STDIN_FILENO;
+	p->tx_fd = STDOUT_FILENO;
+	p->rx_pin = conf->rx_pin;
+	p->tx_pin = conf->tx_pin;
+	p->is_on = false;
+	p->is_listening = false;
+#if UART_INPUT_BUFFER_BYTES > 0 && ENABLE_UART_LISTENING
+	p->rx_buf.bytes = 0;
+#endif
+	host_port = p;
+
+	return ERR_OK;
+}
+err_t uart_on(const uart_port_t *p) {
+	SET_DEFAULT_PORT(p);
+	VERIFY_PORT(p);
+
+	((uart_port_t *)p)->is_on = true;
+
+	return ERR_OK;
+}
+err_t uart_off(const uart_port_t *p) {
+	SET_DEFAULT_PORT(p);
+	VERIFY_PORT(p);
+
+	((uart_port_t *)p)->is_on = false;
+	((uart_port_t *)p)->is_listening = false;
+
+	return ERR_OK;
+}
+bool uart_is_on(const uart_port_t *p) {
+	SET_DEFAULT_PORT(p);
+	return p->is_on;
+}
+
+#if ENABLE_UART_LISTENING
+err_t uart_listen_on(const uart_port_t *p) {
+	SET_DEFAULT_PORT(p);
+	VERIFY_PORT(p);
+
+	((uart_port_t *)p)->is_listening = true;
+
+	return ERR_OK;
+}
+err_t uart_listen_off(const uart_port_t *p) {
+	SET_DEFAULT_PORT(p);
+	VERIFY_PORT(p);
+
+	((uart_port_t *)p)->is_listening = false;
+
+	return ERR_OK;
+}
+bool uart_is_listening(const uart_port_t *p) {
+	SET_DEFAULT_PORT(p);
+	VERIFY_PORT(p);
+
+	return p->is_listening;
+}
+bool uart_rx_is_available(const uart_port_t *p) {
+#if UART_INPUT_BUFFER_BYTES > 0
+	SET_DEFAULT_PORT(p);
+	VERIFY_PORT(p);
+	return (p->rx_buf.bytes != 0);
+#else
+	UNUSED(p);
+	return false;
+#endif
+}
+#endif // ENABLE_UART_LISTENING
+
+bool uart_poll_input(utime_t wait_ms) {
+	uart_port_t *p = host_port;
+	uint8_t rx;
+
+	if ((p == NULL) || !p->is_listening) {
+		return false;
+	}
+	if (!fd_is_ready(p->rx_fd, POLLIN, wait_ms)) {
+		return true;
+	}
+
+	switch (read(p->rx_fd, &rx, 1)) {
+	case 1:
+		break;
+	case 0:
+		// Nothing more is coming, so stop listening instead of waking up over
+		// and over
+		p->is_listening = false;
+		return false;
+	default:
+		return true;
+	}
+
+#if UART_INPUT_BUFFER_BYTES > 0 && ENABLE_UART_LISTENING
+	if (p->rx_buf.bytes < UART_INPUT_BUFFER_BYTES) {
+		p->rx_buf.buffer[p->rx_buf.bytes] = rx;
+		++p->rx_buf.bytes;
+	}
+#endif
+	uart_rx_irq_hook(p);
+
+	return true;
+}
+
+err_t uart_transmit_block(uart_port_t *p, const uint8_t *buffer, txsize_t size, utime_t timeout) {
+	err_t res;
+	txsize_t i = 0;
+
+	SET_DEFAULT_PORT(p);
+	VERIFY_PORT(p);
+
+	uHAL_assert(BUFFER_OK(buffer, size));
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (!BUFFER_OK(buffer, size)) {
+		return ERR_BADARG;
+	}
+	if (size == 0) {
+		return ERR_OK;
+	}
+#endif
+
+	res = ERR_OK;
+	timeout = SET_TIMEOUT_MS(timeout);
+
+	while (i < size) {
+		ssize_t sent = write(p->tx_fd, &buffer[i], size - i);
+
+		if (sent > 0) {
+			i += sent;
+		} else if ((sent < 0) && (errno != EINTR) && (errno != EAGAIN)) {
+			res = ERR_IO;
+			break;
+		}
+		if ((i < size) && TIMES_UP(timeout)) {
+			res = ERR_TIMEOUT;
+			break;
+		}
+	}
+
+	return res;
+}
+err_t uart_flush(const uart_port_t *p, utime_t timeout) {
+	SET_DEFAULT_PORT(p);
+	VERIFY_PORT(p);
+
+	// uart_transmit_block() doesn't return until write() has taken everything
+	UNUSED(timeout);
+
+	return ERR_OK;
+}
+err_t uart_receive_block(uart_port_t *p, uint8_t *buffer, txsize_t size, utime_t timeout) {
+	err_t res;
+	txsize_t i;
+
+	SET_DEFAULT_PORT(p);
+	VERIFY_PORT(p);
+
+	uHAL_assert(BUFFER_OK(buffer, size));
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (!BUFFER_OK(buffer, size)) {
+		return ERR_BADARG;
+	}
+	if (size == 0) {
+		return ERR_OK;
+	}
+#endif
+
+	res = ERR_OK;
+	timeout = SET_TIMEOUT_MS(timeout);
+
+	for (i = eat_uart_buffer(p, buffer, size); i < size;) {
+		utime_t now = NOW_MS();
+		ssize_t got;
+
+		if (now >= timeout) {
+			res = ERR_TIMEOUT;
+			break;
+		}
+		if (!fd_is_ready(p->rx_fd, POLLIN, timeout - now)) {
+			continue;
+		}
+		got = read(p->rx_fd, &buffer[i], size - i);
+		if (got > 0) {
+			i += got;
+		} else if (got == 0) {
+			res = ERR_IO;
+			break;
+		} else if ((errno != EINTR) && (errno != EAGAIN)) {
+			res = ERR_IO;
+			break;
+		}
+	}
+
+	return res;
+}
+
+
+#endif // uHAL_USE_UART
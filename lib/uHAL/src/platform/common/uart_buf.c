@@ -59,3 +59,54 @@ INLINE txsize_t eat_uart_buffer(uart_port_t *p, uint8_t *buffer, txsize_t size)
 	return 0;
 }
 #endif // UART_INPUT_BUFFER_BYTES > 0 && ENABLE_UART_LISTENING
+
+#if UART_OUTPUT_BUFFER_BYTES > 0
+//
+// Copy as much of buffer into the TX ring as will fit and return the number of
+// bytes copied
+// One slot is always left empty so that head == tail can only mean the ring
+// is empty
+INLINE txsize_t uart_tx_buffer_push(volatile uart_tx_buffer_t *tx, const uint8_t *buffer, txsize_t size) {
+	uart_tx_index_t head = tx->head;
+	const uart_tx_index_t tail = tx->tail;
+	txsize_t i = 0;
+
+	for (; i < size; ++i) {
+		uart_tx_index_t next = head + 1U;
+
+		if (next == UART_OUTPUT_BUFFER_BYTES) {
+			next = 0;
+		}
+		if (next == tail) {
+			break;
+		}
+		tx->buffer[head] = buffer[i];
+		head = next;
+	}
+	// Only publish the new head once the bytes are in place
+	tx->head = head;
+
+	return i;
+}
+//
+// Take the next byte out of the TX ring, returning false if it's empty
+// This is meant to be called from the transmit ISR
+INLINE bool uart_tx_buffer_pop(volatile uart_tx_buffer_t *tx, uint8_t *c) {
+	uart_tx_index_t tail = tx->tail;
+
+	if (tail == tx->head) {
+		return false;
+	}
+	*c = tx->buffer[tail];
+	++tail;
+	if (tail == UART_OUTPUT_BUFFER_BYTES) {
+		tail = 0;
+	}
+	tx->tail = tail;
+
+	return true;
+}
+INLINE bool uart_tx_buffer_is_empty(const volatile uart_tx_buffer_t *tx) {
+	return (tx->head == tx->tail);
+}
+#endif // UART_OUTPUT_BUFFER_BYTES > 0
@@ -14,3 +14,19 @@ typedef struct {
 	uart_buffer_size_t bytes;
 } uart_buffer_t;
 #endif
+
+#if UART_OUTPUT_BUFFER_BYTES > 0
+# if UART_OUTPUT_BUFFER_BYTES <= 0xFFU
+typedef uint_fast8_t uart_tx_index_t;
+# else
+typedef uint_fast16_t uart_tx_index_t;
+# endif
+//
+// The head is only written by the transmit functions and the tail only by the
+// ISR, so neither side needs to disable interrupts to touch the buffer
+typedef struct {
+	uint8_t buffer[UART_OUTPUT_BUFFER_BYTES];
+	uart_tx_index_t head;
+	uart_tx_index_t tail;
+} uart_tx_buffer_t;
+#endif
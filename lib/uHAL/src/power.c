@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// power.c
+// Reference-counted peripheral power management
+// NOTES:
+//   A domain is only turned off by the power manager if the power manager
+//   was what turned it on, so code which still calls the *_on() and *_off()
+//   functions directly is left alone.
+//
+
+#include "common.h"
+
+
+#if uHAL_USE_POWER_MANAGER
+
+#define DOMAIN_OK(_d_) ((_d_) < POWER_DOMAIN_COUNT)
+
+typedef struct {
+	err_t (*on)(void);
+	err_t (*off)(void);
+	bool (*is_on)(void);
+} power_domain_ops_t;
+
+typedef struct {
+	power_domain_stats_t stats;
+	uint8_t users;
+	// Set if the domain was turned on by us and hasn't been turned off since
+	bool owned;
+} power_domain_status_t;
+
+static const power_domain_ops_t domain_ops[POWER_DOMAIN_COUNT] = {
+#if uHAL_USE_ADC
+	[POWER_DOMAIN_ADC] = { adc_on, adc_off, adc_is_on },
+#endif
+#if uHAL_USE_SPI
+	[POWER_DOMAIN_SPI] = { spi_on, spi_off, spi_is_on },
+#endif
+#if uHAL_USE_I2C
+	[POWER_DOMAIN_I2C] = { i2c_on, i2c_off, i2c_is_on },
+#endif
+};
+static power_domain_status_t domains[POWER_DOMAIN_COUNT];
+
+
+static err_t turn_off(power_domain_t domain) {
+	const power_domain_ops_t *ops = &domain_ops[domain];
+	power_domain_status_t *d = &domains[domain];
+
+	d->owned = false;
+	// Someone else may have already turned it off
+	if (!ops->is_on()) {
+		return ERR_OK;
+	}
+	++d->stats.power_downs;
+
+	return ops->off();
+}
+
+err_t power_acquire(power_domain_t domain) {
+	const power_domain_ops_t *ops;
+	power_domain_status_t *d;
+	err_t res = ERR_OK;
+
+	uHAL_assert(DOMAIN_OK(domain));
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (!DOMAIN_OK(domain)) {
+		return ERR_BADARG;
+	}
+#endif
+
+	ops = &domain_ops[domain];
+	d = &domains[domain];
+
+	uHAL_assert(d->users < 0xFFU);
+#if ! uHAL_SKIP_OTHER_CHECKS
+	if (d->users == 0xFFU) {
+		return ERR_NOMEM;
+	}
+#endif
+
+	if (!ops->is_on()) {
+		if ((res = ops->on()) != ERR_OK) {
+			return res;
+		}
+		++d->stats.power_ups;
+		d->owned = true;
+	} else if ((d->users == 0) && d->owned) {
+		// Without deferral this would have been an off-on cycle
+		++d->stats.cycles_saved;
+	}
+	++d->users;
+
+	return res;
+}
+err_t power_release(power_domain_t domain) {
+	power_domain_status_t *d;
+
+	uHAL_assert(DOMAIN_OK(domain));
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (!DOMAIN_OK(domain)) {
+		return ERR_BADARG;
+	}
+#endif
+
+	d = &domains[domain];
+
+	uHAL_assert(d->users > 0);
+#if ! uHAL_SKIP_OTHER_CHECKS
+	if (d->users == 0) {
+		return ERR_INIT;
+	}
+#endif
+
+	--d->users;
+#if ! uHAL_POWER_DEFER_OFF
+	if ((d->users == 0) && d->owned) {
+		return turn_off(domain);
+	}
+#endif
+
+	return ERR_OK;
+}
+err_t power_down(power_domain_t domain) {
+	power_domain_status_t *d;
+
+	uHAL_assert(DOMAIN_OK(domain));
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (!DOMAIN_OK(domain)) {
+		return ERR_BADARG;
+	}
+#endif
+
+	d = &domains[domain];
+	if (d->users != 0) {
+		return ERR_RETRY;
+	}
+	if (!d->owned) {
+		return ERR_OK;
+	}
+
+	return turn_off(domain);
+}
+void power_down_idle(void) {
+	for (uiter_t i = 0; i < POWER_DOMAIN_COUNT; ++i) {
+		if ((domains[i].users == 0) && domains[i].owned) {
+			turn_off((power_domain_t )i);
+		}
+	}
+
+	return;
+}
+
+err_t power_get_stats(power_domain_t domain, power_domain_stats_t *stats) {
+	uHAL_assert(DOMAIN_OK(domain));
+	uHAL_assert(stats != NULL);
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+	if (!DOMAIN_OK(domain) || (stats == NULL)) {
+		return ERR_BADARG;
+	}
+#endif
+
+	*stats = domains[domain].stats;
+
+	return ERR_OK;
+}
+void power_reset_stats(void) {
+	for (uiter_t i = 0; i < POWER_DOMAIN_COUNT; ++i) {
+		domains[i].stats = (power_domain_stats_t ){ 0 };
+	}
+
+	return;
+}
+
+#endif // uHAL_USE_POWER_MANAGER
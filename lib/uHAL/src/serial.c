@@ -42,6 +42,7 @@
 
 DEBUG_CPP_MACRO(UART_COMM_BUFFER_BYTES)
 DEBUG_CPP_MACRO(LOGGER_HISTORY_BUFFER_BYTES)
+DEBUG_CPP_MACRO(LOGGER_TOKENIZED)
 
 #if LOGGER_HISTORY_BUFFER_BYTES > 0xFFFFFFFFU
 # error "LOGGER_HISTORY_BUFFER_BYTES must be <= 0xFFFFFFFF"
@@ -54,6 +55,19 @@ typedef uint_fast8_t replay_size_t;
 #endif
 
 
+#if LOGGER_TOKENIZED
+//
+// The size of the largest logger_token() record before base64 encoding
+// Any arguments which don't fit are dropped and strings are truncated
+// The string length prefix is assumed to fit in a single byte so this must
+// be < 64
+# define LOGGER_TOKEN_RECORD_BYTES 48U
+//
+// Flags set in the first byte of a logger_token() record
+// If set, the token is followed by the system up time
+# define LOGGER_TOKEN_FLAG_TIME 0x01U
+#endif
+
 #if LOGGER_HISTORY_BUFFER_BYTES > 0
 typedef struct {
 	char output[LOGGER_HISTORY_BUFFER_BYTES];
@@ -74,8 +88,30 @@ static uint8_t printf_buffer_size = 0;
 
 void _print_platform_info(void (*printf_putc)(uint_fast8_t c));
 
+//
+// printf() output is copied straight into the unused part of printf_buffer
+// and serial_sink_write() is only called when that fills up
+typedef struct {
+	printf_sink_t sink;
+#if LOGGER_HISTORY_BUFFER_BYTES > 0
+	// If set, the output is also copied to the logger replay buffer
+	bool record;
+	// The start of the output in the window which hasn't been copied to the
+	// replay buffer yet
+	uint8_t *unrecorded;
+#endif
+} serial_sink_t;
+
 static void flush_printf_buffer(void);
 static void serial_putc(uint_fast8_t c);
+static void init_serial_sink(serial_sink_t *ss, bool record);
+static void sync_serial_sink(serial_sink_t *ss);
+#if LOGGER_HISTORY_BUFFER_BYTES > 0
+static void record_logger_output(const uint8_t *data, size_t len);
+#endif
+#if LOGGER_TOKENIZED
+static void serial_sink_putc(serial_sink_t *ss, uint_fast8_t c);
+#endif
 
 
 err_t serial_init(void) {
@@ -129,6 +165,72 @@ static void serial_putc(uint_fast8_t c) {
 	return;
 }
 #endif // UART_COMM_BUFFER_BYTES > 0
+static void open_serial_sink(serial_sink_t *ss) {
+#if UART_COMM_BUFFER_BYTES > 0
+	ss->sink.buf = &printf_buffer[printf_buffer_size];
+	ss->sink.size = UART_COMM_BUFFER_BYTES - printf_buffer_size;
+#else
+	ss->sink.buf = NULL;
+	ss->sink.size = 0;
+#endif
+#if LOGGER_HISTORY_BUFFER_BYTES > 0
+	ss->unrecorded = ss->sink.buf;
+#endif
+
+	return;
+}
+static void serial_sink_write(printf_sink_t *sink, const uint8_t *data, size_t len) {
+	serial_sink_t *ss = (serial_sink_t *)sink;
+
+	sync_serial_sink(ss);
+#if LOGGER_HISTORY_BUFFER_BYTES > 0
+	if (ss->record) {
+		record_logger_output(data, len);
+	}
+#endif
+
+	flush_printf_buffer();
+#if UART_COMM_BUFFER_BYTES > 0
+	if (len < UART_COMM_BUFFER_BYTES) {
+		memcpy(printf_buffer, data, len);
+		printf_buffer_size = (uint8_t )len;
+	} else
+#endif
+	{
+		uart_transmit_block(NULL, data, (txsize_t )len, UART_COMM_TIMEOUT_MS);
+	}
+	open_serial_sink(ss);
+
+	return;
+}
+static void init_serial_sink(serial_sink_t *ss, bool record) {
+	ss->sink.write = serial_sink_write;
+#if LOGGER_HISTORY_BUFFER_BYTES > 0
+	ss->record = record;
+#else
+	UNUSED(record);
+#endif
+	open_serial_sink(ss);
+
+	return;
+}
+//
+// Account for whatever was written to the sink window
+static void sync_serial_sink(serial_sink_t *ss) {
+#if LOGGER_HISTORY_BUFFER_BYTES > 0
+	if (ss->record) {
+		record_logger_output(ss->unrecorded, (size_t )(ss->sink.buf - ss->unrecorded));
+	}
+	ss->unrecorded = ss->sink.buf;
+#endif
+#if UART_COMM_BUFFER_BYTES > 0
+	printf_buffer_size = (uint8_t )(ss->sink.buf - printf_buffer);
+#else
+	UNUSED(ss);
+#endif
+
+	return;
+}
 void serial_print(const char *msg, txsize_t len) {
 	uHAL_assert(msg != NULL);
 
@@ -158,6 +260,7 @@ void serial_print(const char *msg, txsize_t len) {
 }
 void serial_printf(const char *fmt, ...) {
 	va_list arp;
+	serial_sink_t ss;
 
 	uHAL_assert(fmt != NULL);
 #if ! uHAL_SKIP_INVALID_ARG_CHECKS
@@ -170,24 +273,28 @@ void serial_printf(const char *fmt, ...) {
 		return;
 	}
 
+	init_serial_sink(&ss, false);
 	va_start(arp, fmt);
-	ulib_vprintf(serial_putc, fmt, arp);
-	flush_printf_buffer();
+	ulib_vprintf_sink(&ss.sink, fmt, arp);
 	va_end(arp);
+	sync_serial_sink(&ss);
+	flush_printf_buffer();
 
 	return;
 }
 
 #if LOGGER_HISTORY_BUFFER_BYTES > 0
-static void logger_putc(uint_fast8_t c) {
+static void record_logger_output(const uint8_t *data, size_t len) {
 	uHAL_assert(logger_replay_buffer.size <= LOGGER_HISTORY_BUFFER_BYTES);
 
-	serial_putc(c);
+	while (len > 0) {
+		replay_size_t n = (replay_size_t )MIN(len, (size_t )(LOGGER_HISTORY_BUFFER_BYTES - logger_replay_buffer.tail));
 
-	logger_replay_buffer.output[logger_replay_buffer.tail] = c;
-	logger_replay_buffer.tail = (logger_replay_buffer.tail + 1) % LOGGER_HISTORY_BUFFER_BYTES;
-	if (logger_replay_buffer.size != LOGGER_HISTORY_BUFFER_BYTES) {
-		++logger_replay_buffer.size;
+		memcpy(&logger_replay_buffer.output[logger_replay_buffer.tail], data, n);
+		logger_replay_buffer.tail = (logger_replay_buffer.tail + n) % LOGGER_HISTORY_BUFFER_BYTES;
+		logger_replay_buffer.size = (replay_size_t )MIN((size_t )logger_replay_buffer.size + n, (size_t )LOGGER_HISTORY_BUFFER_BYTES);
+		data += n;
+		len -= n;
 	}
 
 	return;
@@ -222,17 +329,13 @@ void logger_replay(void) {
 	return;
 }
 #else // !LOGGER_HISTORY_BUFFER_BYTES > 0
-static void logger_putc(uint_fast8_t c) {
-	serial_putc(c);
-
-	return;
-}
 void logger_replay(void) {
 	return;
 }
 #endif // LOGGER_HISTORY_BUFFER_BYTES > 0
 void logger(const char *fmt, ...) {
 	va_list arp;
+	serial_sink_t ss;
 
 	uHAL_assert(fmt != NULL);
 #if ! uHAL_SKIP_INIT_CHECKS
@@ -247,19 +350,178 @@ void logger(const char *fmt, ...) {
 		return;
 	}
 
-	va_start(arp, fmt);
+	init_serial_sink(&ss, true);
 #if uHAL_USE_RTC
 	// Prefix message with system up time
-	ulib_printf(logger_putc, "%04lu:  ", (long unsigned int )NOW());
+	ulib_printf_sink(&ss.sink, "%04lu:  ", (long unsigned int )NOW());
 #endif
-	ulib_vprintf(logger_putc, fmt, arp);
+	va_start(arp, fmt);
+	ulib_vprintf_sink(&ss.sink, fmt, arp);
+	va_end(arp);
 	// Append message with a newline
-	logger_putc('\r'); logger_putc('\n');
+	ulib_printf_sink(&ss.sink, "\r\n");
+	sync_serial_sink(&ss);
 	flush_printf_buffer();
+
+	return;
+}
+
+#if LOGGER_TOKENIZED
+static void serial_sink_putc(serial_sink_t *ss, uint_fast8_t c) {
+	if (ss->sink.size > 0) {
+		*ss->sink.buf = (uint8_t )c;
+		++ss->sink.buf;
+		--ss->sink.size;
+	} else {
+		uint8_t c8 = (uint8_t )c;
+
+		ss->sink.write(&ss->sink, &c8, 1);
+	}
+
+	return;
+}
+//
+// Integers are stored as a sign and magnitude using a variable number of bytes
+// The first byte holds the sign in the low bit and the lowest 6 bits of the
+// magnitude, each following byte holds the next 7 bits; the high bit is set in
+// every byte but the last
+// Returns the number of bytes used or 0 if there wasn't enough room
+static uint_fast8_t put_logger_varint(uint8_t *buf, uint_fast8_t size, unsigned long mag, bool negative) {
+	uint8_t tmp[(sizeof(mag) * 8U / 7U) + 1U];
+	uint_fast8_t len;
+
+	tmp[0] = (uint8_t )(((mag & 0x3FU) << 1U) | (negative ? 1U : 0U));
+	mag >>= 6U;
+	for (len = 1; mag != 0; ++len) {
+		tmp[len-1] |= 0x80U;
+		tmp[len] = (uint8_t )(mag & 0x7FU);
+		mag >>= 7U;
+	}
+	if (len > size) {
+		return 0;
+	}
+	memcpy(buf, tmp, len);
+
+	return len;
+}
+//
+// Strings are stored as their length followed by their characters without
+// the terminating NUL
+// Returns the number of bytes used or 0 if there wasn't enough room
+static uint_fast8_t put_logger_string(uint8_t *buf, uint_fast8_t size, const char *s) {
+	uint_fast8_t len;
+
+	if (size < 1) {
+		return 0;
+	}
+	--size;
+	for (len = 0; (s != NULL) && (s[len] != 0) && (len < size); ++len) {
+		buf[len+1] = (uint8_t )s[len];
+	}
+	put_logger_varint(buf, 1, len, false);
+
+	return len + 1;
+}
+static uint_fast8_t base64_char(uint_fast8_t v) {
+	if (v < 26U) {
+		return 'A' + v;
+	} else if (v < 52U) {
+		return 'a' + (v - 26U);
+	} else if (v < 62U) {
+		return '0' + (v - 52U);
+	}
+	return (v == 62U) ? '+' : '/';
+}
+void logger_token(uint32_t token, uint32_t arg_types, ...) {
+	va_list arp;
+	serial_sink_t ss;
+	uint8_t record[LOGGER_TOKEN_RECORD_BYTES];
+	uint_fast8_t len, n;
+
+#if ! uHAL_SKIP_INIT_CHECKS
+#endif
+#if ! uHAL_SKIP_INVALID_ARG_CHECKS
+#endif
+
+	if (!uHAL_CHECK_STATUS(uHAL_FLAG_SERIAL_IS_UP)) {
+		return;
+	}
+
+	// The record is a flag byte, the token in little-endian order, the
+	// system up time if enabled, and then the arguments
+	record[0] = 0;
+	record[1] = (uint8_t )(token);
+	record[2] = (uint8_t )(token >> 8U);
+	record[3] = (uint8_t )(token >> 16U);
+	record[4] = (uint8_t )(token >> 24U);
+	len = 5;
+#if uHAL_USE_RTC
+	record[0] |= LOGGER_TOKEN_FLAG_TIME;
+	len += put_logger_varint(&record[len], LOGGER_TOKEN_RECORD_BYTES - len, (unsigned long )NOW(), false);
+#endif
+
+	va_start(arp, arg_types);
+	for (n = 1; (arg_types != LOGGER_ARG_END) && (n != 0); arg_types >>= LOGGER_ARG_BITS) {
+		uint8_t *buf = &record[len];
+		uint_fast8_t size = LOGGER_TOKEN_RECORD_BYTES - len;
+
+		switch (arg_types & ((1U << LOGGER_ARG_BITS) - 1U)) {
+		case LOGGER_ARG_INT: {
+			int v = va_arg(arp, int);
+			n = put_logger_varint(buf, size, (v < 0) ? 0UL - (unsigned long )v : (unsigned long )v, (v < 0));
+			break;
+		}
+		case LOGGER_ARG_UINT:
+			n = put_logger_varint(buf, size, va_arg(arp, unsigned int), false);
+			break;
+		case LOGGER_ARG_LONG: {
+			long v = va_arg(arp, long);
+			n = put_logger_varint(buf, size, (v < 0) ? 0UL - (unsigned long )v : (unsigned long )v, (v < 0));
+			break;
+		}
+		case LOGGER_ARG_ULONG:
+			n = put_logger_varint(buf, size, va_arg(arp, unsigned long), false);
+			break;
+		case LOGGER_ARG_STR:
+			n = put_logger_string(buf, size, va_arg(arp, const char *));
+			break;
+		default:
+			// There's no way to know the size of an unknown argument so
+			// nothing after it can be read
+			n = 0;
+			break;
+		}
+		len += n;
+	}
 	va_end(arp);
 
+	init_serial_sink(&ss, true);
+	serial_sink_putc(&ss, '$');
+	// Padding is left off the end of the base64 output, the decoder can work
+	// it out from the line length
+	for (uint_fast8_t i = 0; i < len; i += 3U) {
+		uint_fast8_t left = len - i;
+		uint_fast8_t chars = (left >= 3U) ? 4U : (left + 1U);
+		uint_fast32_t v = (uint_fast32_t )record[i] << 16U;
+
+		if ((i + 1U) < len) {
+			v |= (uint_fast32_t )record[i+1] << 8U;
+		}
+		if ((i + 2U) < len) {
+			v |= (uint_fast32_t )record[i+2];
+		}
+		for (uint_fast8_t j = 0; j < chars; ++j) {
+			serial_sink_putc(&ss, base64_char((uint_fast8_t )(v >> (18U - (j * 6U))) & 0x3FU));
+		}
+	}
+	serial_sink_putc(&ss, '\r');
+	serial_sink_putc(&ss, '\n');
+	sync_serial_sink(&ss);
+	flush_printf_buffer();
+
 	return;
 }
+#endif // LOGGER_TOKENIZED
 
 void print_system_info(void) {
 	if (!uHAL_CHECK_STATUS(uHAL_FLAG_SERIAL_IS_UP)) {
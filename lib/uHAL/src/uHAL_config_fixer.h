@@ -37,6 +37,15 @@
 #if uHAL_USE_FATFS_SD && !uHAL_USE_FATFS
 # error "uHAL_USE_FATFS_SD requires uHAL_USE_FATFS"
 #endif
+#if uHAL_USE_FATFS_IMAGE && !uHAL_USE_FATFS
+# error "uHAL_USE_FATFS_IMAGE requires uHAL_USE_FATFS"
+#endif
+#if uHAL_USE_FATFS_IMAGE && uHAL_USE_FATFS_SD
+# error "uHAL_USE_FATFS_IMAGE and uHAL_USE_FATFS_SD can't both be used"
+#endif
+#if uHAL_USE_FATFS_IMAGE && !(defined(HAVE_HOST) && HAVE_HOST)
+# error "uHAL_USE_FATFS_IMAGE is only available on the HOST platform"
+#endif
 #if uHAL_USE_FDISK && !uHAL_USE_FATFS
 # error "uHAL_USE_FDISK requires uHAL_USE_FATFS"
 #endif
@@ -49,9 +58,18 @@
 #if uHAL_USE_UART_COMM && !uHAL_USE_UART
 # error "uHAL_USE_UART_COMM requires uHAL_USE_UART"
 #endif
+#if UART_OUTPUT_BUFFER_BYTES == 1
+# error "UART_OUTPUT_BUFFER_BYTES must be 0 or > 1"
+#endif
+#if UART_OUTPUT_BUFFER_BYTES > 0xFFFFU
+# error "UART_OUTPUT_BUFFER_BYTES can not be > 0xFFFF"
+#endif
 #if uHAL_USE_FATFS_SD && !uHAL_USE_SPI
 # error "uHAL_USE_FATFS_SD requires uHAL_USE_SPI"
 #endif
+#if uHAL_USE_FLASH && uHAL_FLASH_DATA_PAGES <= 0
+# error "uHAL_USE_FLASH requires uHAL_FLASH_DATA_PAGES > 0"
+#endif
 // We use a 16-bit duty cycle
 #if PWM_DUTY_CYCLE_SCALE > 0xFFFFU
 # error "PWM_DUTY_CYCLE_SCALE can not be > 0xFFFF"
@@ -63,5 +81,8 @@
 # define uHAL_USE_RTC_EMULATION 0
 #endif
 
+// The power manager handles every peripheral that can be turned on and off
+#define uHAL_USE_POWER_MANAGER (uHAL_USE_ADC || uHAL_USE_SPI || uHAL_USE_I2C)
+
 
 #endif // _CONFIG_FIXER_H
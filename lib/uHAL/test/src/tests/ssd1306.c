@@ -115,6 +115,7 @@ void loop_SSD1306(void) {
 	ssd1306_draw_text_scaled(&ssd1306_status, &font,            1,      1, 9, 5, ssd1306_loopno);
 	ssd1306_draw_text_scaled(&ssd1306_status, &font_small,      1,      1, 0, 7, "loop no: ");
 	ssd1306_draw_text_scaled(&ssd1306_status, &font_small,      1,      1, 9, 7, ssd1306_loopno);
+	ssd1306_flush(&ssd1306_status);
 
 	return;
 }
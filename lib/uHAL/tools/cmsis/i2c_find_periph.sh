@@ -53,6 +53,10 @@ template="
 #  define I2Cx I2Cnnn
 #  define I2Cx_CLOCKEN RCC_PERIPH_I2Cnnn
 #  define I2Cx_AF GPIOAF_I2Cnnn
+#  define I2Cx_EV_IRQn I2Cnnn_EV_IRQn
+#  define I2Cx_ER_IRQn I2Cnnn_ER_IRQn
+#  define I2Cx_EV_IRQHandler I2Cnnn_EV_IRQHandler
+#  define I2Cx_ER_IRQHandler I2Cnnn_ER_IRQHandler
 # endif
 
 #else // HAVE_I2Cnnn
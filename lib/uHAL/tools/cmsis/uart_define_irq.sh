@@ -8,10 +8,11 @@ cat << EOF
 // Generated by ${0} on $(date)
 //
 
-#if ENABLE_UART_LISTENING
+#if ENABLE_UART_LISTENING || UART_OUTPUT_BUFFER_BYTES > 0
 
 #define ASSIGN_IRQ_PORT(_irqn_, _p_) do { uart ## _irqn_ ## _port = (_p_); } while (0);
 
+#if ENABLE_UART_LISTENING
 static void UARTx_RXNE_IRQHandler(uart_port_t *p) {
 #if UART_INPUT_BUFFER_BYTES > 0
 	if (p->rx_buf.bytes < UART_INPUT_BUFFER_BYTES) {
@@ -35,6 +36,22 @@ static void UARTx_RXNE_IRQHandler(uart_port_t *p) {
 
 	return;
 }
+#endif // ENABLE_UART_LISTENING
+
+#if UART_OUTPUT_BUFFER_BYTES > 0
+static void UARTx_TXE_IRQHandler(uart_port_t *p) {
+	uint8_t c;
+
+	if (uart_tx_buffer_pop(&p->tx_buf, &c)) {
+		p->uartx->DR = c;
+	} else {
+		// Nothing left to send, stop the interrupt until something is queued
+		CLEAR_BIT(p->uartx->CR1, USART_CR1_TXEIE);
+	}
+
+	return;
+}
+#endif // UART_OUTPUT_BUFFER_BYTES > 0
 
 EOF
 
@@ -46,10 +63,17 @@ template="
 static uart_port_t *uartnnn_port;
 //__attribute__((weak))
 void USARTnnn_IRQHandler(void) {
-	if (BIT_IS_SET(uartnnn_port->uartx->SR, U_S_ART_SR_RXNE)) {
+#if ENABLE_UART_LISTENING
+	if (BIT_IS_SET(uartnnn_port->uartx->SR, U_S_ART_SR_RXNE) && BIT_IS_SET(uartnnn_port->uartx->CR1, U_S_ART_CR1_RXNEIE)) {
 		UARTx_RXNE_IRQHandler(uartnnn_port);
 		uart_rx_irq_hook(uartnnn_port);
 	}
+#endif
+#if UART_OUTPUT_BUFFER_BYTES > 0
+	if (BIT_IS_SET(uartnnn_port->uartx->SR, U_S_ART_SR_TXE) && BIT_IS_SET(uartnnn_port->uartx->CR1, U_S_ART_CR1_TXEIE)) {
+		UARTx_TXE_IRQHandler(uartnnn_port);
+	}
+#endif
 
 	return;
 }
@@ -65,8 +89,8 @@ done
 
 cat << EOF
 
-#else // ENABLE_UART_LISTENING
+#else // ENABLE_UART_LISTENING || UART_OUTPUT_BUFFER_BYTES > 0
 #define ASSIGN_IRQ_PORT(_irqn_, _p_) ((void )0U)
 
-#endif // ENABLE_UART_LISTENING
+#endif // ENABLE_UART_LISTENING || UART_OUTPUT_BUFFER_BYTES > 0
 EOF
@@ -1,8 +1,13 @@
 Import('env')
-from os.path import join, realpath
+from os.path import join, realpath, isfile
 
 for item in env.get("CPPDEFINES", []):
     if isinstance(item, tuple) and item[0] == "uHAL_PLATFORM":
         #env.Append(CPPPATH=[realpath(join("platform", item[1]))])
         env.Replace(SRC_FILTER=["+<*>", "-<platform/>", "+<platform/%s>" % item[1]])
+        # Platforms can check the placement of their retained memory at link
+        # time; the check has to be added to the final program, not the library
+        ldcheck = realpath(join(Dir(".").srcnode().abspath, "..", "..", "src", "platform", item[1], "retained_memory.ld"))
+        if isfile(ldcheck):
+            DefaultEnvironment().Append(LINKFLAGS=[ldcheck])
         break
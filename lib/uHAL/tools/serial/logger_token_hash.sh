@@ -0,0 +1,50 @@
+#!/bin/bash
+#
+# Generate the compile-time hash used to turn LOGGER() format strings into
+# tokens when LOGGER_TOKENIZED is set
+#
+# This must be kept in sync with token_hash() in tools/decode_logger.py in
+# the top-level project
+#
+
+# The number of characters of the format string that contribute to the hash;
+# the length of the whole string is always included
+hash_len=128
+# The multiplier for each character
+hash_coef=65599
+
+cat << EOF
+//
+// Generated by ${0} on $(date)
+//
+// LOGGER_TOKEN_HASH(s) computes a 65599 polynomial hash of the string literal
+// s at compile time:
+//    hash = strlen(s) + s[0]*65599^1 + s[1]*65599^2 + ... (mod 2^32)
+// Only the first ${hash_len} characters contribute to the hash.
+//
+// s must be a string literal (or a char array); any characters past the end
+// of the string read the terminating NUL so they don't affect the result.
+//
+#define LOGGER_TOKEN_HASH_LENGTH ${hash_len}U
+
+#define _LOGGER_TOKEN_CHAR(_s_, _i_) \\
+	((uint32_t )(uint8_t )(_s_)[((_i_) < sizeof(_s_)) ? (_i_) : (sizeof(_s_) - 1U)])
+
+#define LOGGER_TOKEN_HASH(_s_) ((uint32_t )( \\
+	(uint32_t )(sizeof(_s_) - 1U) + \\
+EOF
+
+coef=${hash_coef}
+for (( i=0; i < hash_len; i++ )); do
+	if [ $(( i + 1 )) -lt ${hash_len} ]; then
+		end=" + \\"
+	else
+		end=" \\"
+	fi
+	printf "\t(_LOGGER_TOKEN_CHAR(_s_, %uU) * 0x%08XUL)%s\n" ${i} ${coef} "${end}"
+	coef=$(( (coef * hash_coef) & 0xFFFFFFFF ))
+done
+
+cat << EOF
+	))
+EOF
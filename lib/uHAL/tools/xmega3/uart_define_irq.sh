@@ -9,6 +9,7 @@ template="
 #if HAVE_UARTnnn
 static uart_port_t *uartnnn_port;
 
+#if ENABLE_UART_LISTENING
 ISR(USARTnnn_RXC_vect) {
 	// Set RXSIF bit to '1' to clear it
 	USARTnnn.STATUS = USART_RXSIF_bm | USART_ISFIF_bm;
@@ -18,6 +19,15 @@ ISR(USARTnnn_RXC_vect) {
 	}
 }
 #endif
+#if UART_OUTPUT_BUFFER_BYTES > 0
+ISR(USARTnnn_DRE_vect) {
+	UARTx_DRE_IRQHandler(uartnnn_port);
+}
+ISR(USARTnnn_TXC_vect) {
+	UARTx_TXC_IRQHandler(uartnnn_port);
+}
+#endif
+#endif
 "
 
 cat << EOF
@@ -25,10 +35,11 @@ cat << EOF
 // Generated by ${0} on $(date)
 //
 
-#if ENABLE_UART_LISTENING
+#if ENABLE_UART_LISTENING || UART_OUTPUT_BUFFER_BYTES > 0
 
 #define ASSIGN_IRQ_PORT(_irqn_, _p_) do { uart ## _irqn_ ## _port = (_p_); } while (0);
 
+#if ENABLE_UART_LISTENING
 static void UARTx_RXC_IRQHandler(uart_port_t *p) {
 #if UART_INPUT_BUFFER_BYTES > 0
 	if (p->rx_buf.bytes < UART_INPUT_BUFFER_BYTES) {
@@ -47,6 +58,31 @@ static void UARTx_RXC_IRQHandler(uart_port_t *p) {
 
 	return;
 }
+#endif // ENABLE_UART_LISTENING
+
+#if UART_OUTPUT_BUFFER_BYTES > 0
+static void UARTx_DRE_IRQHandler(uart_port_t *p) {
+	uint8_t c;
+
+	if (uart_tx_buffer_pop(&p->tx_buf, &c)) {
+		// TXCIF is only meaningful for the last byte written
+		p->uartx->STATUS = USART_TXCIF_bm;
+		p->uartx->TXDATAL = c;
+	} else {
+		// Nothing left to queue, switch to the transmit complete interrupt so
+		// that uart_flush() can tell when the last byte is out
+		MODIFY_BITS(p->uartx->CTRLA, USART_DREIE_bm|USART_TXCIE_bm, USART_TXCIE_bm);
+	}
+
+	return;
+}
+static void UARTx_TXC_IRQHandler(uart_port_t *p) {
+	p->uartx->STATUS = USART_TXCIF_bm;
+	CLEAR_BIT(p->uartx->CTRLA, USART_TXCIE_bm);
+
+	return;
+}
+#endif // UART_OUTPUT_BUFFER_BYTES > 0
 EOF
 
 for u in ${USARTs}; do
@@ -54,8 +90,8 @@ for u in ${USARTs}; do
 done
 
 cat << EOF
-#else // ENABLE_UART_LISTENING
+#else // ENABLE_UART_LISTENING || UART_OUTPUT_BUFFER_BYTES > 0
 #define ASSIGN_IRQ_PORT(_irqn_, _p_) ((void )0U)
 
-#endif // ENABLE_UART_LISTENING
+#endif // ENABLE_UART_LISTENING || UART_OUTPUT_BUFFER_BYTES > 0
 EOF
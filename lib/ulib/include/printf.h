@@ -89,5 +89,28 @@ void ulib_printf(void (*pputc)(uint_fast8_t c), const char *restrict fmt, ...)
 	__attribute__ ((format(printf, 2, 3)));
 void ulib_vprintf(void (*pputc)(uint_fast8_t c), const char *restrict fmt, va_list arp);
 
+//
+// A destination for ulib_printf_sink() and ulib_vprintf_sink()
+// Output is copied directly into the 'size' bytes at 'buf', which are advanced
+// past whatever is written. Anything that doesn't fit is passed to write(),
+// which can flush the buffer and move the window along for the output that
+// follows. A sink without a buffer (buf NULL and size 0) sends everything to
+// write().
+// Sinks which need more state than this can embed printf_sink_t as the first
+// member of a larger struct and cast the pointer passed to write().
+typedef struct printf_sink_s printf_sink_t;
+struct printf_sink_s {
+	uint8_t *buf;
+	size_t size;
+	void (*write)(printf_sink_t *sink, const uint8_t *data, size_t len);
+};
+//
+// Like ulib_printf() and ulib_vprintf(), but copying runs of output into
+// the sink all at once instead of calling a function for every character.
+// ulib_vprintf_sink() is defined weakly like ulib_vprintf().
+void ulib_printf_sink(printf_sink_t *sink, const char *restrict fmt, ...)
+	__attribute__ ((format(printf, 2, 3)));
+void ulib_vprintf_sink(printf_sink_t *sink, const char *restrict fmt, va_list arp);
+
 #endif // ULIB_ENABLE_PRINTF
 #endif // _ULIB_PRINTF_H
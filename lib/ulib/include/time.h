@@ -111,6 +111,30 @@ const char* print_duration(char *buf, uint_fast8_t buf_size, utime_t seconds);
 // Returns A pointer to the start of the string within buf if successful
 //  or an empty string otherwise.
 const char* print_datetime(char *buf, uint_fast8_t buf_size, datetime_t *datetime);
+//
+// The last time converted by seconds_to_datetime_cached()
+// Converting a time close after the cached one only needs the difference
+// applied to the cached date, and printing it only needs the digits which
+// changed rewritten. Must be zeroed before the first use.
+typedef struct {
+	utime_t day_start;    // The cached time at midnight
+	utime_t day_seconds;  // Seconds since midnight of the cached time
+	datetime_t datetime;
+	char str[20];         // The cached time printed by print_datetime()
+	bool valid;
+} datetime_cache_t;
+//
+// Like seconds_to_datetime(), but working from the time held in 'cache' and
+// leaving the result there
+// Times earlier than midnight of the cached date or more than a month after
+// it are converted in full.
+const datetime_t* seconds_to_datetime_cached(utime_t seconds, datetime_cache_t *cache);
+//
+// Like print_datetime() for a time in seconds, but working from the time held
+// in 'cache'
+// Returns a pointer to the string held in 'cache', which is only good until
+// the next time the cache is used.
+const char* print_seconds_datetime_cached(utime_t seconds, datetime_cache_t *cache);
 
 
 /*
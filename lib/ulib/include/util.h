@@ -35,6 +35,12 @@
 // Initialize a block of memory
 void mem_init(void *mem, uint8_t value, size_t size);
 
+//
+// Update a CRC-16/CCITT-FALSE checksum with 'size' bytes of data
+// Start a new checksum with 'crc' set to 0xFFFF and continue one by passing
+// the previous result.
+uint16_t crc16_ccitt(uint16_t crc, const uint8_t *data, size_t size);
+
 //
 // Determine the system endianess
 #if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__) || defined(__BIG_ENDIAN) || defined(_BIG_ENDIAN)
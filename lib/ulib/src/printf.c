@@ -27,6 +27,7 @@
 
 #include "debug.h"
 #include "ascii.h"
+#include "fmem.h"
 #include "util.h"
 
 #include <limits.h>
@@ -78,6 +79,15 @@ void ulib_printf(void (*pputc)(uint_fast8_t c), const char *restrict fmt, ...) {
 
 	return;
 }
+void ulib_printf_sink(printf_sink_t *sink, const char *restrict fmt, ...) {
+	va_list arp;
+
+	va_start(arp, fmt);
+	ulib_vprintf_sink(sink, fmt, arp);
+	va_end(arp);
+
+	return;
+}
 
 #if PACK_OPT_STRUCT
 typedef struct {
@@ -162,7 +172,134 @@ typedef enum {
 		(_var_) = (printf_uint_t )((_type_ )tmp); \
 	} while (0)
 
-static void print_int(void(*pputc)(uint_fast8_t c), printf_uint_t n, const printf_opts_t *opts) {
+//
+// Output goes to the sink window as long as there's room, and anything left
+// over goes to the sink's write()
+static void sink_write(printf_sink_t *sink, const uint8_t *data, size_t len) {
+	size_t n = MIN(len, sink->size);
+
+	// Most runs are only a few bytes long, which isn't worth a call to memcpy()
+	for (size_t i = 0; i < n; ++i) {
+		sink->buf[i] = data[i];
+	}
+	sink->buf += n;
+	sink->size -= n;
+	if (n < len) {
+		sink->write(sink, &data[n], len - n);
+	}
+
+	return;
+}
+static void sink_putc(printf_sink_t *sink, uint_fast8_t c) {
+	if (sink->size > 0) {
+		*sink->buf = (uint8_t )c;
+		++sink->buf;
+		--sink->size;
+	} else {
+		uint8_t c8 = (uint8_t )c;
+
+		sink->write(sink, &c8, 1);
+	}
+
+	return;
+}
+//
+// The per-character interface is handled by a sink without a window
+typedef struct {
+	printf_sink_t sink;
+	void (*pputc)(uint_fast8_t c);
+} putc_sink_t;
+static void putc_sink_write(printf_sink_t *sink, const uint8_t *data, size_t len) {
+	void (*pputc)(uint_fast8_t c) = ((putc_sink_t *)sink)->pputc;
+
+	for (size_t i = 0; i < len; ++i) {
+		pputc(data[i]);
+	}
+
+	return;
+}
+
+#if PRINTF_USE_DIGIT_PAIRS
+static FMEM_STORAGE const char digit_pairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+#endif
+
+// Store the two decimal digits of r, which must be less than 100, in reverse
+// order
+static void print_digit_pair(uint8_t *buf, uint_fast8_t r) {
+#if PRINTF_USE_DIGIT_PAIRS
+	buf[0] = (uint8_t )digit_pairs[(r * 2U) + 1U];
+	buf[1] = (uint8_t )digit_pairs[(r * 2U)];
+#else
+	buf[0] = (uint8_t )((r % 10U) + '0');
+	buf[1] = (uint8_t )((r / 10U) + '0');
+#endif
+
+	return;
+}
+//
+// Decimal integers are by far the most commonly printed so they get their own
+// path: the divisor is a constant the compiler can optimize, digits are
+// produced two at a time, and the value is moved to a narrower type as soon
+// as it fits so that printing small numbers doesn't need a full-width division
+// for every digit.
+// Like the generic path in print_int(), the digits are stored in reverse
+// order. n must not be 0.
+static printf_int_len_t print_decimal(uint8_t *buf, printf_uint_t n) {
+	printf_int_len_t i = 0;
+	uint_fast16_t n16;
+
+#if PRINTF_MAX_INT_BYTES > 4
+	for (; n > UINT32_MAX; i += 2) {
+		printf_uint_t q = n / 100U;
+
+		print_digit_pair(&buf[i], (uint_fast8_t )(n - (q * 100U)));
+		n = q;
+	}
+#endif
+#if PRINTF_MAX_INT_BYTES > 2
+	{
+		uint_fast32_t n32 = (uint_fast32_t )n;
+
+		for (; n32 > UINT16_MAX; i += 2) {
+			uint_fast32_t q = n32 / 100U;
+
+			print_digit_pair(&buf[i], (uint_fast8_t )(n32 - (q * 100U)));
+			n32 = q;
+		}
+		n16 = (uint_fast16_t )n32;
+	}
+#else
+	n16 = (uint_fast16_t )n;
+#endif
+
+	for (; n16 >= 100U; i += 2) {
+		uint_fast16_t q = n16 / 100U;
+
+		print_digit_pair(&buf[i], (uint_fast8_t )(n16 - (q * 100U)));
+		n16 = q;
+	}
+	if (n16 >= 10U) {
+		print_digit_pair(&buf[i], (uint_fast8_t )n16);
+		i += 2;
+	} else {
+		buf[i] = (uint8_t )(n16 + '0');
+		++i;
+	}
+
+	return i;
+}
+
+static void print_int(printf_sink_t *sink, printf_uint_t n, const printf_opts_t *opts) {
 	uint8_t print_buf[PRINTF_BUFFER_BYTES];
 	printf_int_len_t buf_i = 0;
 	uint_fast8_t base;
@@ -193,6 +330,8 @@ static void print_int(void(*pputc)(uint_fast8_t c), printf_uint_t n, const print
 		for (; n != 0; ++buf_i, n >>= 1) {
 			print_buf[buf_i] = ((n & 0x01U) == 0) ? '0' : '1';
 		}
+	} else if (base == 10) {
+		buf_i = print_decimal(print_buf, n);
 	} else {
 		uint_fast8_t c;
 		uint_fast8_t xmod = (ALLOW_LOWERCASE_HEX && opts->lower_hex) ? 'a' - 0x0AU : 'A' - 0x0AU;
@@ -226,26 +365,26 @@ static void print_int(void(*pputc)(uint_fast8_t c), printf_uint_t n, const print
 	pad_chars = (opts->width > pad_chars) ? opts->width - pad_chars : 0;
 	if (!left_adjust) {
 		for (; pad_chars != 0; --pad_chars) {
-			pputc(' ');
+			sink_putc(sink, ' ');
 		}
 	}
 
 	if (opts->is_signed) {
 		if (opts->is_negative) {
-			pputc('-');
+			sink_putc(sink, '-');
 		} else if (opts->pos_sign == POS_SIGN_BLANK) {
-			pputc(' ');
+			sink_putc(sink, ' ');
 		} else if (opts->pos_sign == POS_SIGN_PLUS) {
-			pputc('+');
+			sink_putc(sink, '+');
 		}
 	} else if (USE_ALT_FORM && opts->alt_form && base != 10) {
-		pputc('0');
+		sink_putc(sink, '0');
 		if (PRINTF_USE_o_FOR_OCTAL && base == 8) {
-			pputc('o');
+			sink_putc(sink, 'o');
 		} else if (PRINT_BINARY && base == 2) {
-			pputc('b');
+			sink_putc(sink, 'b');
 		} else if (base == 16) {
-			pputc('x');
+			sink_putc(sink, 'x');
 		}
 	}
 
@@ -258,25 +397,30 @@ static void print_int(void(*pputc)(uint_fast8_t c), printf_uint_t n, const print
 			if (places == 3) {
 				places = 0;
 				if (buf_i > 0) {
-					pputc(PRINTF_INT_GROUPING_CHAR);
+					sink_putc(sink, PRINTF_INT_GROUPING_CHAR);
 				}
 			}
 			if (ASCII_IS_DIGIT(print_buf[buf_i])) {
 				++places;
 			}
 
-			pputc(print_buf[buf_i]);
+			sink_putc(sink, print_buf[buf_i]);
 		}
 	} else {
-		while (buf_i != 0) {
-			--buf_i;
-			pputc(print_buf[buf_i]);
+		// The digits are stored backwards, turn them around so that they can
+		// all be written at once
+		for (printf_int_len_t i = 0, j = buf_i - 1; i < j; ++i, --j) {
+			uint8_t tmp = print_buf[i];
+
+			print_buf[i] = print_buf[j];
+			print_buf[j] = tmp;
 		}
+		sink_write(sink, print_buf, buf_i);
 	}
 
 	if (ALLOW_LEFT_ADJUST) {
 		for (; pad_chars != 0; --pad_chars) {
-			pputc(' ');
+			sink_putc(sink, ' ');
 		}
 	}
 
@@ -284,7 +428,7 @@ static void print_int(void(*pputc)(uint_fast8_t c), printf_uint_t n, const print
 	return;
 }
 
-static void print_string(void(*pputc)(uint_fast8_t c), const char *s, const printf_opts_t *opts) {
+static void print_string(printf_sink_t *sink, const char *s, const printf_opts_t *opts) {
 	uint len = 0;
 
 	if (DO_PRINTF_SAFETY_CHECKS && s == NULL) {
@@ -300,31 +444,26 @@ static void print_string(void(*pputc)(uint_fast8_t c), const char *s, const prin
 		uint pad_chars = (opts->width > len) ? opts->width - len : 0;
 		if (!ALLOW_LEFT_ADJUST || !opts->left_adjust) {
 			for (; pad_chars != 0; --pad_chars) {
-				pputc(' ');
+				sink_putc(sink, ' ');
 			}
 		}
 
-		for (uint i = 0; i < len; ++i) {
-			pputc((uint_fast8_t )s[i]);
-		}
+		sink_write(sink, (const uint8_t *)s, len);
 
 		if (ALLOW_LEFT_ADJUST) {
 			for (; pad_chars != 0; --pad_chars) {
-				pputc(' ');
+				sink_putc(sink, ' ');
 			}
 		}
 	} else {
-		//for (; *s != 0; ++s, ++len) {
-		for (; *s != 0; ++s) {
-			pputc((uint_fast8_t )*s);
-		}
+		sink_write(sink, (const uint8_t *)s, strlen(s));
 	}
 
 	//return MAX(len, opts->width);
 	return;
 }
 
-static void print_char(void(*pputc)(uint_fast8_t c), char c, const printf_opts_t *opts) {
+static void print_char(printf_sink_t *sink, char c, const printf_opts_t *opts) {
 	if (DO_PRINTF_SAFETY_CHECKS && (c == 0)) {
 		c = '.';
 		//return;
@@ -335,19 +474,19 @@ static void print_char(void(*pputc)(uint_fast8_t c), char c, const printf_opts_t
 
 		if (!ALLOW_LEFT_ADJUST || !opts->left_adjust) {
 			for (; pad_chars != 0; --pad_chars) {
-				pputc(' ');
+				sink_putc(sink, ' ');
 			}
 		}
 
-		pputc((uint_fast8_t )c);
+		sink_putc(sink, (uint_fast8_t )c);
 
 		if (ALLOW_LEFT_ADJUST) {
 			for (; pad_chars != 0; --pad_chars) {
-				pputc(' ');
+				sink_putc(sink, ' ');
 			}
 		}
 	} else {
-		pputc((uint_fast8_t )c);
+		sink_putc(sink, (uint_fast8_t )c);
 	}
 
 	//return MAX(1, opts->width);
@@ -356,11 +495,29 @@ static void print_char(void(*pputc)(uint_fast8_t c), char c, const printf_opts_t
 
 __attribute__((weak))
 void ulib_vprintf(void(*pputc)(uint_fast8_t c), const char *restrict fmt_s, va_list arp) {
+	putc_sink_t ps = { { NULL, 0, putc_sink_write }, pputc };
+
 	ulib_assert(pputc != NULL);
+
+	if (DO_PRINTF_SAFETY_CHECKS) {
+		if (pputc == NULL) {
+			//return -EINVAL;
+			return;
+		}
+	}
+
+	ulib_vprintf_sink(&ps.sink, fmt_s, arp);
+
+	return;
+}
+
+__attribute__((weak))
+void ulib_vprintf_sink(printf_sink_t *sink, const char *restrict fmt_s, va_list arp) {
+	ulib_assert(sink != NULL);
 	ulib_assert(fmt_s != NULL);
 
 	if (DO_PRINTF_SAFETY_CHECKS) {
-		if (pputc == NULL || fmt_s == NULL) {
+		if (sink == NULL || sink->write == NULL || fmt_s == NULL) {
 			//return -EINVAL;
 			return;
 		}
@@ -368,13 +525,19 @@ void ulib_vprintf(void(*pputc)(uint_fast8_t c), const char *restrict fmt_s, va_l
 
 	const uint8_t *fmt = (uint8_t *)fmt_s;
 	while (true) {
+		const uint8_t *literal = fmt;
 		uint_fast8_t c;
-		for (c = *fmt++; c != '%' && c != 0; c = *fmt++) {
-			pputc(c);
+
+		for (c = *fmt; c != '%' && c != 0; c = *++fmt) {
+			// Nothing to do here
+		}
+		if (fmt != literal) {
+			sink_write(sink, literal, (size_t )(fmt - literal));
 		}
 		if (c == 0) {
 			break;
 		}
+		++fmt;
 		c = *fmt++;
 
 		//
@@ -566,7 +729,7 @@ void ulib_vprintf(void(*pputc)(uint_fast8_t c), const char *restrict fmt_s, va_l
 			break;
 
 		case '%':
-			pputc('%');
+			sink_putc(sink, '%');
 			break;
 
 #if PRINT_BINARY || PARSE_IGNORED_FIELDS
@@ -575,8 +738,8 @@ void ulib_vprintf(void(*pputc)(uint_fast8_t c), const char *restrict fmt_s, va_l
 			break;
 #endif
 		case 'c':
-			//pputc(va_arg(arp, unsigned char));
-			print_char(pputc, (char )va_arg(arp, int), &opts);
+			//sink_putc(sink, va_arg(arp, unsigned char));
+			print_char(sink, (char )va_arg(arp, int), &opts);
 			break;
 		case 'd':
 		case 'i':
@@ -587,7 +750,7 @@ void ulib_vprintf(void(*pputc)(uint_fast8_t c), const char *restrict fmt_s, va_l
 			opts.int_base = 8;
 			break;
 		case 's':
-			print_string(pputc, va_arg(arp, const char *), &opts);
+			print_string(sink, va_arg(arp, const char *), &opts);
 			break;
 		case 'u':
 			opts.int_base = 10;
@@ -620,8 +783,8 @@ void ulib_vprintf(void(*pputc)(uint_fast8_t c), const char *restrict fmt_s, va_l
 #endif
 
 		default:
-			pputc('%');
-			pputc(c);
+			sink_putc(sink, '%');
+			sink_putc(sink, c);
 			break;
 		}
 		if (c == 0) {
@@ -675,8 +838,8 @@ void ulib_vprintf(void(*pputc)(uint_fast8_t c), const char *restrict fmt_s, va_l
 				}
 			}
 
-			//char_count += print_int(pputc, n, opts);
-			print_int(pputc, n, &opts);
+			//char_count += print_int(sink, n, opts);
+			print_int(sink, n, &opts);
 		}
 	}
 
@@ -82,10 +82,13 @@ INLINE strlen_t COMBINED_LENGTH(strlen_t a, strlen_t b) {
 //#define ASSERT_ARP(a) ulib_assert(POINTER_IS_VALID(a))
 #define ASSERT_ARP(a) ((void )0U)
 
-// A pointer set by string_appendf_va and used by the non-reentrant string_putc()
-// function so that it can have the same signature as putc().
+// printf() output is copied straight into the space left in the string and
+// string_sink_write() is only called when that runs out.
 #if STRINGS_USE_INTERNAL_PRINTF
-static string_t *S_printf_string;
+typedef struct {
+	printf_sink_t sink;
+	string_t *s;
+} string_sink_t;
 #endif
 
 // Make sure the value returned by strlen() is <= STRING_MAX_BYTES
@@ -386,15 +389,42 @@ string_t* string_appendf(string_t *restrict s, const char *restrict format, ...)
 	return s;
 }
 #if STRINGS_USE_INTERNAL_PRINTF
-static void string_putc(uint_fast8_t c) {
-	//ulib_assert(S_printf_string != NULL);
+static void open_string_sink(string_sink_t *ss) {
+	string_t *s = ss->s;
+	strlen_t capacity;
+
+#if STRINGS_USE_MALLOC
+	// One byte is needed for the trailing NUL
+	capacity = (strlen_t )MIN(s->allocated - 1U, STRING_MAX_BYTES);
+#else
+	capacity = STRING_MAX_BYTES;
+#endif
+
+	ss->sink.buf = (uint8_t *)&s->cstring[s->length];
+	ss->sink.size = capacity - s->length;
+
+	return;
+}
+static void close_string_sink(string_sink_t *ss) {
+	string_t *s = ss->s;
+
+	s->length = (strlen_t )((char *)ss->sink.buf - s->cstring);
+	s->cstring[s->length] = 0;
+
+	return;
+}
+static void string_sink_write(printf_sink_t *sink, const uint8_t *data, size_t len) {
+	string_sink_t *ss = (string_sink_t *)sink;
 
-	string_append_from_char(S_printf_string, (char )c);
+	close_string_sink(ss);
+	// This takes care of growing the string or dropping whatever won't fit
+	string_append_from_cstring(ss->s, (const char *)data, (strlen_t )MIN(len, STRING_MAX_BYTES));
+	open_string_sink(ss);
 
 	return;
 }
 string_t* string_appendf_va(string_t *restrict s, const char *restrict format, va_list arp) {
-	string_t *bs;
+	string_sink_t ss;
 
 	ASSERT_STRING(s);
 	ASSERT_CSTRING(format);
@@ -409,10 +439,11 @@ string_t* string_appendf_va(string_t *restrict s, const char *restrict format, v
 	}
 #endif
 
-	bs = S_printf_string;
-	S_printf_string = s;
-	ulib_vprintf(string_putc, format, arp);
-	S_printf_string = bs;
+	ss.sink.write = string_sink_write;
+	ss.s = s;
+	open_string_sink(&ss);
+	ulib_vprintf_sink(&ss.sink, format, arp);
+	close_string_sink(&ss);
 
 	return s;
 }
@@ -135,9 +135,10 @@ void seconds_to_date(utime_t seconds, datetime_t *ret_datetime) {
 	if (leap_days > tmp_day) {
 		// FIXME: Handle tmp_year == 0? Don't know how we'd ever get that though.
 		--tmp_year;
-		// Day 1 of one year is the same as day 366 of the previous year
+		// Day 1 of one year is the same as day 366 (or 367 in a leap year) of
+		// the previous year
 		// We're still 0-indexed so we use 365 instead of 366
-		tmp_day = 365 - (uint_fast16_t )(leap_days - tmp_day);
+		tmp_day = (IS_LEAP_YEAR(tmp_year) ? 366U : 365U) - (uint_fast16_t )(leap_days - tmp_day);
 	} else {
 		tmp_day -= leap_days;
 	}
@@ -145,7 +146,8 @@ void seconds_to_date(utime_t seconds, datetime_t *ret_datetime) {
 	// Months and days are 1-indexed
 	tmp_month = 1;
 	++tmp_day;
-	for (uiter_t i = 0; (days_per_month[i] < tmp_day); ++i) {
+	// The last day of a leap year would otherwise run off the end of the table
+	for (uiter_t i = 0; ((i < 11) && (days_per_month[i] < tmp_day)); ++i) {
 		tmp_day -= days_per_month[i];
 		++tmp_month;
 	}
@@ -327,6 +329,140 @@ const char* print_datetime(char *buf, uint_fast8_t buf_size, datetime_t *datetim
 	return buf;
 }
 
+//
+// If the cached date is this many days or more behind, it's converted from
+// scratch instead of being advanced a day at a time
+#define DATETIME_CACHE_MAX_DAYS 31U
+
+static void print_2_digits(char *buf, uint_fast8_t value) {
+	buf[0] = (char )('0' + (value / 10U));
+	buf[1] = (char )('0' + (value % 10U));
+
+	return;
+}
+//
+// Rewrite the parts of a string printed by print_datetime() which differ
+// between 'old' and 'new'
+static void patch_datetime(char *buf, const datetime_t *old, const datetime_t *new) {
+	if (old->year != new->year) {
+		print_2_digits(&buf[0], (uint_fast8_t )(new->year / 100U));
+		print_2_digits(&buf[2], (uint_fast8_t )(new->year % 100U));
+	}
+	if (old->month != new->month) {
+		print_2_digits(&buf[5], new->month);
+	}
+	if (old->day != new->day) {
+		print_2_digits(&buf[8], new->day);
+	}
+	if (old->hour != new->hour) {
+		print_2_digits(&buf[11], new->hour);
+	}
+	if (old->minute != new->minute) {
+		print_2_digits(&buf[14], new->minute);
+	}
+	if (old->second != new->second) {
+		print_2_digits(&buf[17], new->second);
+	}
+
+	return;
+}
+
+const datetime_t* seconds_to_datetime_cached(utime_t seconds, datetime_cache_t *cache) {
+	datetime_t old, *dt;
+	utime_t elapsed;
+	uint_fast16_t rest;
+
+	ulib_assert(cache != NULL);
+
+#if DO_TIME_SAFETY_CHECKS
+	if (cache == NULL) {
+		return NULL;
+	}
+#endif
+
+	dt = &cache->datetime;
+	if (!cache->valid || (seconds < cache->day_start) || ((seconds - cache->day_start) >= (DATETIME_CACHE_MAX_DAYS * SECONDS_PER_DAY))) {
+		seconds_to_datetime(seconds, dt);
+		cache->day_seconds = time_to_seconds(dt);
+		cache->day_start = seconds - cache->day_seconds;
+		print_datetime(cache->str, SIZEOF_ARRAY(cache->str), dt);
+		cache->valid = true;
+
+		return dt;
+	}
+
+	old = *dt;
+	elapsed = seconds - cache->day_start;
+
+	if (elapsed >= SECONDS_PER_DAY) {
+		do {
+			elapsed -= (utime_t )SECONDS_PER_DAY;
+			cache->day_start += (utime_t )SECONDS_PER_DAY;
+
+			++dt->day;
+			if (dt->day > days_per_month[dt->month-1]) {
+				if ((dt->month != 2) || (dt->day > 29) || !IS_LEAP_YEAR(dt->year)) {
+					dt->day = 1;
+					++dt->month;
+					if (dt->month > 12) {
+						dt->month = 1;
+						++dt->year;
+					}
+				}
+			}
+		} while (elapsed >= SECONDS_PER_DAY);
+		cache->day_seconds = 0;
+	}
+	if (elapsed < cache->day_seconds) {
+		cache->day_seconds = 0;
+	}
+	if (cache->day_seconds == 0) {
+		dt->hour = 0;
+		dt->minute = 0;
+		dt->second = 0;
+	}
+
+	//
+	// Less than a day is left, count off the hours so that the rest can be
+	// handled with 16-bit math
+	rest = 0;
+	for (utime_t left = elapsed - cache->day_seconds; ; left -= SECONDS_PER_HOUR) {
+		if (left < SECONDS_PER_HOUR) {
+			rest = (uint_fast16_t )left;
+			break;
+		}
+		++dt->hour;
+	}
+	dt->second += (uint_fast8_t )(rest % SECONDS_PER_MINUTE);
+	dt->minute += (uint_fast8_t )(rest / SECONDS_PER_MINUTE);
+	if (dt->second >= 60U) {
+		dt->second = (uint_fast8_t )(dt->second - 60U);
+		++dt->minute;
+	}
+	if (dt->minute >= 60U) {
+		dt->minute = (uint_fast8_t )(dt->minute - 60U);
+		++dt->hour;
+	}
+	cache->day_seconds = elapsed;
+
+	patch_datetime(cache->str, &old, dt);
+
+	return dt;
+}
+const char* print_seconds_datetime_cached(utime_t seconds, datetime_cache_t *cache) {
+	ulib_assert(cache != NULL);
+
+#if DO_TIME_SAFETY_CHECKS
+	if (cache == NULL) {
+		return "";
+	}
+#endif
+
+	seconds_to_datetime_cached(seconds, cache);
+
+	return cache->str;
+}
+
 
 #else
 	// ISO C forbids empty translation units, this makes it happy.
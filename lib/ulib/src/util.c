@@ -40,6 +40,23 @@ void mem_init(void *mem, uint8_t value, size_t size) {
 	return;
 }
 
+uint16_t crc16_ccitt(uint16_t crc, const uint8_t *data, size_t size) {
+#if DO_UTIL_SAFETY_CHECKS
+	if (data == NULL) {
+		return crc;
+	}
+#endif
+
+	for (size_t i = 0; i < size; ++i) {
+		crc ^= (uint16_t )((uint16_t )data[i] << 8U);
+		for (uint_fast8_t b = 0; b < 8U; ++b) {
+			crc = ((crc & 0x8000U) != 0) ? (uint16_t )((uint16_t )(crc << 1U) ^ 0x1021U) : (uint16_t )(crc << 1U);
+		}
+	}
+
+	return crc;
+}
+
 
 #else
 	// ISO C forbids empty translation units, this makes it happy.
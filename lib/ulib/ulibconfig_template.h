@@ -558,6 +558,13 @@
 # define PRINTF_INT_GROUPING_CHAR ','
 #endif
 //
+// If non-zero, print decimal integers two digits at a time using a 200-byte
+// lookup table
+// This speeds up printing on devices without hardware division.
+#ifndef PRINTF_USE_DIGIT_PAIRS
+# define PRINTF_USE_DIGIT_PAIRS 1
+#endif
+//
 // If non-zero, perform additional checks to handle common problems like being
 // passed NULL inputs.
 #ifndef DO_PRINTF_SAFETY_CHECKS
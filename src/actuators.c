@@ -23,6 +23,7 @@
 //
 #include "common.h"
 #include "actuators.h"
+#include "simulation.h"
 
 #if USE_ACTUATORS
 
@@ -114,6 +115,7 @@ err_t set_actuator(ACTUATOR_CFG_STORAGE actuator_cfg_t *cfg, actuator_status_t *
 #if USE_ACTUATOR_STATUS_CHANGE_TIME
 		const utime_t now = NOW();
 #endif
+		sim_note_actuator_change(status, prev_status);
 
 #if USE_ACTUATOR_STATUS_CHANGE_COUNT
 		++status->status_change_count;
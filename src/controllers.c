@@ -27,6 +27,8 @@
 #include "controllers.h"
 #include "actuators.h"
 #include "sensors.h"
+#include "schedule.h"
+#include "simulation.h"
 
 #include "ulib/include/util.h"
 
@@ -47,6 +49,56 @@ controller_status_t controllers[SIZEOF_ARRAY(CONTROLLERS)];
 #if TRACK_GLOBAL_SCHEDULE
 static utime_t next_scheduled_run = 0;
 #endif
+#if USE_CONTROLLER_SCHEDULE || USE_CONTROLLER_NEXTTIME
+//
+// The next run time of every common controller, kept sorted so that finding
+// the next one due doesn't mean walking the whole list
+static schedule_entry_t schedule_heap[SIZEOF_ARRAY(CONTROLLERS)];
+static uint8_t schedule_positions[SIZEOF_ARRAY(CONTROLLERS)];
+static schedule_t schedule = {
+	.heap = schedule_heap,
+	.position = schedule_positions,
+	.count = 0,
+	.size = SIZEOF_ARRAY(CONTROLLERS),
+};
+
+//
+// The common controllers which have no next run time but could get one, and
+// so need it recalculated by calculate_common_controller_alarms()
+// Controllers which can never be scheduled are left out so that they don't
+// keep the rest from being skipped.
+static uint8_t unscheduled[(SIZEOF_ARRAY(CONTROLLERS) + 7U) / 8U];
+
+static bool can_be_scheduled(CONTROLLER_CFG_STORAGE controller_cfg_t *cfg) {
+# if USE_CONTROLLER_NEXTTIME
+	if (cfg->next_run_time != NULL) {
+		return true;
+	}
+# endif
+# if USE_CONTROLLER_SCHEDULE
+	return ((CONTROLLER_CHECK_MINUTES > 0) || (cfg->schedule_minutes != 0) || BIT_IS_SET(cfg->cfg_flags, CONTROLLER_CFG_FLAG_USE_TIME_OF_DAY));
+# else
+	UNUSED(cfg);
+	return false;
+# endif
+}
+static void sync_schedule(controller_status_t *status) {
+	//
+	// Non-common controllers are managed by whoever owns them
+	if ((status >= controllers) && (status < &controllers[CONTROLLER_COUNT])) {
+		const uint_fast8_t id = CONTROLLER_ID(status);
+
+		schedule_set(&schedule, id, status->next_run_time);
+		if ((status->next_run_time == 0) && can_be_scheduled(&CONTROLLERS[id])) {
+			SET_BIT(unscheduled[id / 8], 1U << (id % 8));
+		} else {
+			CLEAR_BIT(unscheduled[id / 8], 1U << (id % 8));
+		}
+	}
+
+	return;
+}
+#endif
 
 controller_status_t* get_controller_status_by_index(CONTROLLER_INDEX_T i) {
 	assert(i >= 0 && i < CONTROLLER_COUNT);
@@ -79,6 +131,9 @@ err_t init_controller(CONTROLLER_CFG_STORAGE controller_cfg_t *cfg, controller_s
 	assert(status != NULL);
 
 	mem_init(status, 0, sizeof(*status));
+#if USE_CONTROLLER_SCHEDULE || USE_CONTROLLER_NEXTTIME
+	sync_schedule(status);
+#endif
 	return _init_controller(cfg, status);
 }
 void init_common_controllers(void) {
@@ -118,7 +173,13 @@ err_t run_controller(CONTROLLER_CFG_STORAGE controller_cfg_t *cfg, controller_st
 	LOGGER("Running controller %u", CONTROLLER_ID(status));
 #endif
 
+#if DO_SIMULATION
+	const uint_fast64_t sim_start_us = host_get_awake_us();
+#endif
 	err_t res = cfg->run(cfg, status);
+#if DO_SIMULATION
+	sim_note_controller_run(status, (uint_fast32_t )(host_get_awake_us() - sim_start_us));
+#endif
 	if (res != ERR_OK) {
 		SET_BIT(status->status_flags, CONTROLLER_STATUS_FLAG_ERROR);
 		return res;
@@ -134,6 +195,38 @@ void run_common_controllers(bool manual, bool force) {
 	CONTROLLER_CFG_STORAGE controller_cfg_t *cfg;
 	controller_status_t *status;
 
+	//
+	// Scheduled runs only need to look at the controllers which are actually
+	// due; they're collected first and then run in index order so that the
+	// order doesn't depend on when each was scheduled
+	if (!manual && !force) {
+		uint8_t due[(SIZEOF_ARRAY(CONTROLLERS) + 7U) / 8U] = { 0 };
+		const utime_t now = NOW();
+		int_fast16_t id;
+
+		if ((id = schedule_pop_due(&schedule, now)) < 0) {
+			return;
+		}
+		do {
+			SET_BIT(due[id / 8], 1U << (id % 8));
+		} while ((id = schedule_pop_due(&schedule, now)) >= 0);
+
+		for (CONTROLLER_INDEX_T i = 0; i < CONTROLLER_COUNT; ++i) {
+			if (BIT_IS_SET(due[i / 8], 1U << (i % 8))) {
+				cfg = &CONTROLLERS[i];
+				status = &controllers[i];
+
+				run_controller(cfg, status);
+				if (calculate_controller_alarm(cfg, status) != ERR_OK) {
+					// Keep trying the same as before it was due
+					sync_schedule(status);
+				}
+			}
+		}
+
+		return;
+	}
+
 	for (CONTROLLER_INDEX_T i = 0; i < CONTROLLER_COUNT; ++i) {
 		cfg = &CONTROLLERS[i];
 		status = &controllers[i];
@@ -229,7 +322,10 @@ err_t calculate_controller_alarm(CONTROLLER_CFG_STORAGE controller_cfg_t *cfg, c
 		//
 		// If the scheduled time would be earlier than now and we're outside
 		// the clock scew window, wait until tomorrow
-		if ((next + (CONTROLLER_SCHEDULE_SKEW_WINDOW_MINUTES * SECONDS_PER_MINUTE)) < now) {
+		// If it's the time we were already scheduled for, the controller has
+		// just been run for it and also needs to wait until tomorrow
+		if (((next + (CONTROLLER_SCHEDULE_SKEW_WINDOW_MINUTES * SECONDS_PER_MINUTE)) < now) ||
+		    ((next <= now) && (next == status->next_run_time))) {
 			next += SECONDS_PER_DAY;
 		}
 	//
@@ -246,19 +342,20 @@ err_t calculate_controller_alarm(CONTROLLER_CFG_STORAGE controller_cfg_t *cfg, c
 END:
 # if USE_CONTROLLER_NAME
 	if (next != 0) {
-		LOGGER("Next alarm for controller %s at %lu", FROM_FSTR(cfg->name), next);
+		LOGGER("Next alarm for controller %s at %lu", FROM_FSTR(cfg->name), (long unsigned int )next);
 	} else {
 		LOGGER("No alarm scheduled for controller %s", FROM_FSTR(cfg->name));
 	}
 # else
 	if (next != 0) {
-		LOGGER("Next alarm for controller %u at %lu", CONTROLLER_ID(status), next);
+		LOGGER("Next alarm for controller %u at %lu", CONTROLLER_ID(status), (long unsigned int )next);
 	} else {
 		LOGGER("No alarm scheduled for controller %u", CONTROLLER_ID(status));
 	}
 # endif
 
 	status->next_run_time = next;
+	sync_schedule(status);
 #endif // USE_CONTROLLER_SCHEDULE || USE_CONTROLLER_NEXTTIME
 
 	return ERR_OK;
@@ -271,11 +368,24 @@ void calculate_common_controller_alarms(bool force) {
 	CONTROLLER_CFG_STORAGE controller_cfg_t *cfg;
 	controller_status_t *status;
 
+	//
+	// Only the controllers without a next run time need looking at, and
+	// most of the time there aren't any
+	if (!force) {
+		uiter_t i = 0;
+
+		while ((i < SIZEOF_ARRAY(unscheduled)) && (unscheduled[i] == 0)) {
+			++i;
+		}
+		if (i == SIZEOF_ARRAY(unscheduled)) {
+			return;
+		}
+	}
 	for (CONTROLLER_INDEX_T i = 0; i < CONTROLLER_COUNT; ++i) {
 		cfg = &CONTROLLERS[i];
 		status = &controllers[i];
 
-		if (force || (status->next_run_time == 0)) {
+		if (force || BIT_IS_SET(unscheduled[i / 8], 1U << (i % 8))) {
 			calculate_controller_alarm(cfg, status);
 		}
 	}
@@ -295,15 +405,7 @@ utime_t find_next_common_controller_alarm(void) {
 	utime_t next = 0;
 
 #if USE_CONTROLLER_SCHEDULE || USE_CONTROLLER_NEXTTIME
-	controller_status_t *status;
-
-	for (CONTROLLER_INDEX_T i = 0; i < CONTROLLER_COUNT; ++i) {
-		status = &controllers[i];
-
-		if (next == 0 || (status->next_run_time != 0 && status->next_run_time < next)) {
-			next = status->next_run_time;
-		}
-	}
+	next = schedule_peek(&schedule, NULL);
 #else
 	if (TRACK_GLOBAL_SCHEDULE) {
 		next = next_scheduled_run;
@@ -92,6 +92,12 @@ static bool button_pin_is_on(gpio_pin_t pin) {
 // Write '1' to the flag to clear it
 # define CLEAR_CTRL_BUTTON_ISR() do { BUTTON_PORT.INTFLAGS = GPIO_GET_PINMASK(CTRL_BUTTON_PIN); } while (0)
 
+#elif HAVE_HOST
+// Called from host_gpio_set_input() when the simulated button is pressed
+# define CTRL_BUTTON_ISR host_gpio_IRQHandler
+# define ISR(_f_) void _f_(void)
+# define CLEAR_CTRL_BUTTON_ISR() (void )0U
+
 #else
 # error "Unhandled device"
 #endif
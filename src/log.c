@@ -30,12 +30,17 @@
 #include "actuators.h"
 #include "sensors.h"
 #include "controllers.h"
+#include "profile.h"
+#include "retain.h"
 
 #include "ulib/include/cstrings.h"
 #include "ulib/include/fmem.h"
 #include "ulib/include/halloc.h"
 #include "ulib/include/printf.h"
 
+// For memcpy() and memcmp()
+#include <string.h>
+
 #if LOG_PRINT_BUFFER_SIZE > 0xFFFFFFFF
  typedef uint64_t print_buffer_size_t;
 #elif LOG_PRINT_BUFFER_SIZE > 0xFFFF
@@ -56,6 +61,15 @@
  typedef uint8_t log_line_buffer_size_t;
 #endif
 
+#ifndef LOG_COMPRESSED_BUFFER_SIZE
+# define LOG_COMPRESSED_BUFFER_SIZE 0
+#endif
+#define DO_LOG_COMPRESSION (LOG_COMPRESSED_BUFFER_SIZE > 0 && LOG_LINE_BUFFER_COUNT > 0)
+#define DO_LOG_RETENTION (USE_RETAINED_MEMORY && LOG_LINE_BUFFER_COUNT > 0)
+#if LOG_COMPRESSED_BUFFER_SIZE > 0xFFFF
+# error "LOG_COMPRESSED_BUFFER_SIZE must be <= 0xFFFF"
+#endif
+
 #include GHMON_INCLUDE_CONFIG_HEADER(log/logfile.h)
 
 typedef enum {
@@ -74,6 +88,43 @@ typedef enum {
 #ifndef USE_LOG_FILE_NAME
 # define USE_LOG_FILE_NAME 0
 #endif
+#ifndef LOG_FORMAT_BINARY
+# define LOG_FORMAT_BINARY 0
+#endif
+#ifndef LOG_PRINT_BUFFER_ALIGNMENT
+# define LOG_PRINT_BUFFER_ALIGNMENT 0
+#endif
+#ifndef LOG_PREALLOCATE_LINE_SIZE
+# define LOG_PREALLOCATE_LINE_SIZE 0
+#endif
+#define DO_LOG_PREALLOCATION (LOG_PREALLOCATE_LINE_SIZE > 0 && LOG_LINES_PER_FILE > 0)
+#ifndef LOG_RESUME_LAST_FILE
+# define LOG_RESUME_LAST_FILE 0
+#endif
+// Binary logs would need every record parsed to count the lines
+#define DO_LOG_RESUME (LOG_RESUME_LAST_FILE && USE_LOG_FILE_NAME && LOG_LINES_PER_FILE > 0 && !LOG_FORMAT_BINARY)
+#if LOG_PRINT_BUFFER_SIZE > 0 && LOG_PRINT_BUFFER_ALIGNMENT > 0 && (LOG_PRINT_BUFFER_SIZE % LOG_PRINT_BUFFER_ALIGNMENT) != 0
+# error "LOG_PRINT_BUFFER_SIZE must be a multiple of LOG_PRINT_BUFFER_ALIGNMENT"
+#endif
+
+//
+// The columns making up a log line, in the order they're printed
+// These values are part of the binary log format and must not be renumbered;
+// tools/decode_binary_log.py needs to be updated if any are added.
+typedef enum {
+	LOG_COLUMN_END = 0, // Marks the end of the column list in binary headers
+	LOG_COLUMN_TIME,
+	LOG_COLUMN_WARNINGS,
+	LOG_COLUMN_SENSOR_STATUS,
+	LOG_COLUMN_SENSOR_READING,
+	LOG_COLUMN_CONTROLLER_STATUS,
+	LOG_COLUMN_ACTUATOR_STATUS,
+	LOG_COLUMN_ACTUATOR_STATUS_CHANGE_TIME,
+	LOG_COLUMN_ACTUATOR_ON_TIME,
+	LOG_COLUMN_ACTUATOR_STATUS_CHANGE_COUNT,
+	LOG_COLUMN_EXTRA
+} log_column_t;
+typedef void (*log_column_cb_t)(void (*pf)(const char *format, ...), log_column_t column, const char *name, uint_fast8_t index);
 
 #if USE_LOG_FILE_NAME
  static char logfile_name[] = LOG_FILE_NAME_PATTERN;
@@ -88,6 +139,18 @@ static const char line_end[] = LOG_LINE_END;
 
 static bool have_log_header = false;
 static uint32_t lines_logged_this_file = 0;
+#if USE_LOG_FILE_NAME && LOG_LINES_PER_FILE > 0
+//
+// The number of the next log file to use, or -1 if the storage hasn't been
+// searched for existing files yet
+static int_fast8_t next_logfile_index = -1;
+#endif
+#if DO_LOG_PREALLOCATION
+//
+// The estimated size of a log line, replaced by the measured average each time
+// a full log file is rotated out
+static uint32_t log_line_size = LOG_PREALLOCATE_LINE_SIZE;
+#endif
 
 #if LOG_SENSORS_BY_DEFAULT
 # define DO_SENSOR(_i_) (!BIT_IS_SET(SENSORS[_i_].cfg_flags, SENSOR_CFG_FLAG_NOLOG))
@@ -108,7 +171,6 @@ static uint32_t lines_logged_this_file = 0;
 // These only need to save information which changes and is actually recorded
 #if USE_SENSORS
 typedef struct {
-	sensor_reading_t *reading;
 #if USE_SENSOR_STATUS
 	SENSOR_STATUS_T status;
 #endif
@@ -141,21 +203,52 @@ typedef struct {
 	uint8_t status_flags;
 } actuator_log_buffer_t;
 
+//
+// Each log line is stored as a single fixed-size record made up of a
+// log_line_buffer_t followed by the status of every logged sensor, all of their
+// readings in order, the controllers, and then the actuators
+// The offset of each part is worked out once by log_init() and kept in
+// log_line_layout so that the records can be packed together in one block and
+// found by index alone.
 typedef struct {
 	utime_t  system_time;
+	uint8_t ghmon_warnings;
+} log_line_buffer_t;
+//
+// This is only used to find the alignment needed by the records
+typedef union {
+	log_line_buffer_t line;
+#if USE_SENSORS
+	sensor_log_buffer_t sensor;
+	sensor_reading_t reading;
+#endif
+#if USE_CONTROLLERS
+	controller_log_buffer_t controller;
+#endif
+#if USE_ACTUATORS
+	actuator_log_buffer_t actuator;
+#endif
+} log_line_align_t;
 
+static struct log_line_layout {
 #if USE_SENSORS
-	sensor_log_buffer_t *sensors;
+	uint_fast16_t sensors;
+	uint_fast16_t readings;
 #endif
 #if USE_CONTROLLERS
-	controller_log_buffer_t *controllers;
+	uint_fast16_t controllers;
 #endif
 #if USE_ACTUATORS
-	actuator_log_buffer_t *actuators;
+	uint_fast16_t actuators;
 #endif
+	uint_fast16_t size;
+} log_line_layout;
 
-	uint8_t ghmon_warnings;
-} log_line_buffer_t;
+#define LOG_LINE_PART(_line_, _part_, _type_) ((_type_ *)((uint8_t *)(_line_) + log_line_layout._part_))
+#define LOG_LINE_SENSORS(_line_)     LOG_LINE_PART(_line_, sensors, sensor_log_buffer_t)
+#define LOG_LINE_READINGS(_line_)    LOG_LINE_PART(_line_, readings, sensor_reading_t)
+#define LOG_LINE_CONTROLLERS(_line_) LOG_LINE_PART(_line_, controllers, controller_log_buffer_t)
+#define LOG_LINE_ACTUATORS(_line_)   LOG_LINE_PART(_line_, actuators, actuator_log_buffer_t)
 
 #if USE_SENSORS
  static SENSOR_INDEX_T sensor_count;
@@ -169,18 +262,76 @@ typedef struct {
  static ACTUATOR_INDEX_T actuator_count;
 #endif
 
+//
+// Declare a properly-aligned log line record on the stack
+#define DECLARE_LOG_LINE(_name_) \
+	log_line_align_t _name_##_m[(log_line_layout.size + (sizeof(log_line_align_t) - 1)) / sizeof(log_line_align_t)]; \
+	log_line_buffer_t *_name_ = (log_line_buffer_t *)_name_##_m
+
 #if LOG_LINE_BUFFER_COUNT > 0
 // Use a ring buffer so that if there's a problem preventing us from writing
 // out the log it's the oldest data that gets overwritten.
+// 'tail' is the slot the next line goes in and 'size' the number of lines that
+// haven't been written out yet; slots are used to index the line extras even
+// when the lines themselves are compressed.
 static struct {
-	log_line_buffer_t lines[LOG_LINE_BUFFER_COUNT];
+#if DO_LOG_COMPRESSION
+	//
+	// Each line is stored as the difference from the one before it, see
+	// encode_log_line()
+	// 'base' is the line before the oldest one stored and 'newest' the most
+	// recent one.
+	log_line_buffer_t *base;
+	log_line_buffer_t *newest;
+	uint_fast16_t start;
+	uint_fast16_t used;
+	log_line_buffer_size_t count;
+	uint8_t *data;
+#else
+	uint8_t *lines;
+#endif
 	log_line_buffer_size_t tail;
 	log_line_buffer_size_t size;
 } log_buffer = { 0 };
+# define LOG_BUFFER_LINE(_i_) ((log_line_buffer_t *)&log_buffer.lines[(uint_fast32_t )(_i_) * log_line_layout.size])
+
+#if DO_LOG_RETENTION
+//
+// The part of the log buffer state that's kept across resets, which is
+// followed in retained memory by the buffer itself
+// The layout is kept to make sure the lines are still readable.
+typedef struct {
+	struct log_line_layout layout;
+	log_line_buffer_size_t tail;
+	log_line_buffer_size_t size;
+#if DO_LOG_COMPRESSION
+	uint_fast16_t start;
+	uint_fast16_t used;
+	log_line_buffer_size_t count;
+#endif
+} log_buffer_state_t;
+static log_buffer_state_t *log_buffer_state = NULL;
+#endif
+
+//
+// Used to walk through the buffered lines from oldest to newest
+typedef struct {
+	log_line_buffer_size_t index;
+#if DO_LOG_COMPRESSION
+	log_line_buffer_size_t left;
+	uint_fast16_t pos;
+	log_line_buffer_t *line;
+#endif
+} log_buffer_iter_t;
 #endif
 
 #if LOG_PRINT_BUFFER_SIZE > 0
+// When LOG_PRINT_BUFFER_ALIGNMENT is set, the position of each byte in the
+// buffer mirrors its offset in the output file modulo the alignment so that
+// every write except the first and last of a session covers whole blocks.
+// 'start' is the first byte that hasn't been written out yet.
 static struct {
+	print_buffer_size_t start;
 	print_buffer_size_t size;
 	uint8_t buffer[LOG_PRINT_BUFFER_SIZE];
 } print_buffer = { 0 };
@@ -190,19 +341,73 @@ static err_t _write_log_to_storage(uint_fast8_t flags);
 static err_t write_log_line_to_storage(log_line_buffer_t *line, const char *extra, uint_fast8_t flags);
 static void print_log_line(void (*pf)(const char *format, ...), log_line_buffer_t *line, const char *extra);
 static bool buffer_is_full(void);
-static void buffer_status_line(void);
-static void lprintf_putc(uint_fast8_t c);
+static err_t buffer_status_line(void);
+#if LOG_LINE_BUFFER_COUNT > 0
+static void alloc_log_buffer(void);
+static void save_log_buffer_state(void);
+static void save_log_buffer_range(const void *start, size_t size);
+#endif
+#if LOG_LINE_BUFFER_COUNT > 0
+static log_line_buffer_size_t log_buffer_count(void);
+static log_line_buffer_t* log_buffer_first(log_buffer_iter_t *iter, log_line_buffer_t *scratch, log_line_buffer_size_t skip);
+static log_line_buffer_t* log_buffer_next(log_buffer_iter_t *iter);
+#endif
+#if DO_LOG_COMPRESSION
+static void init_log_compression(void);
+static void drop_oldest_log_line(void);
+#endif
+static void lprint_bytes(const uint8_t *data, size_t size);
+#if ! LOG_FORMAT_BINARY
 static void lprintf(const char *format, ...)
 	__attribute__ ((format(printf, 1, 2)));
-static const char* format_print_time(char *timestr, utime_t uptime, time_format_t format);
+#endif
+static void store_log_line(log_line_buffer_t *line, const char *extra);
+static const char* format_print_time(char *timestr, uint_fast8_t timestr_size, utime_t uptime, time_format_t format, datetime_cache_t *cache);
 static const char* format_warnings(uint8_t warnings);
 static err_t open_log_storage(void);
 static err_t open_log_file(void);
 static void close_log_storage(void);
 static err_t rotate_log_file(void);
+static err_t find_log_file_name(bool *resume);
+static int_fast32_t count_log_file_lines(uint32_t *end, bool *has_tail);
+static void measure_log_line_size(void);
+static void reserve_log_file(void);
 static void reset_print_buffer(void);
+static void align_print_buffer(void);
 static void write_log_header(void);
 
+//
+// Work out where each part of a log line record goes
+static uint_fast16_t align_log_line_part(uint_fast16_t offset, uint_fast16_t align) {
+	return (offset + (align - 1)) & ~(align - 1);
+}
+static void layout_log_line(void) {
+	uint_fast16_t offset = sizeof(log_line_buffer_t);
+
+#if USE_SENSORS
+	offset = align_log_line_part(offset, __alignof__(sensor_log_buffer_t));
+	log_line_layout.sensors = offset;
+	offset += sensor_count * sizeof(sensor_log_buffer_t);
+
+	offset = align_log_line_part(offset, __alignof__(sensor_reading_t));
+	log_line_layout.readings = offset;
+	offset += sensor_reading_total_count * sizeof(sensor_reading_t);
+#endif
+#if USE_CONTROLLERS
+	offset = align_log_line_part(offset, __alignof__(controller_log_buffer_t));
+	log_line_layout.controllers = offset;
+	offset += controller_count * sizeof(controller_log_buffer_t);
+#endif
+#if USE_ACTUATORS
+	offset = align_log_line_part(offset, __alignof__(actuator_log_buffer_t));
+	log_line_layout.actuators = offset;
+	offset += actuator_count * sizeof(actuator_log_buffer_t);
+#endif
+
+	log_line_layout.size = align_log_line_part(offset, __alignof__(log_line_align_t));
+	return;
+}
+
 void log_init(void) {
 	SENSOR_INDEX_T sn = 0;
 	CONTROLLER_INDEX_T cn = 0;
@@ -215,6 +420,21 @@ void log_init(void) {
 		}
 	}
 	sensor_count = sn;
+
+	if (sn > 0) {
+		sensor_reading_count = halloc(sn * sizeof(sensor_reading_count[0]));
+
+		for (SENSOR_INDEX_T i = 0, si = 0; i < SENSOR_COUNT; ++i) {
+			if (!DO_SENSOR(i)) {
+				continue;
+			}
+			uint_fast8_t cnt = (SENSORS[i].value_count > 0) ? SENSORS[i].value_count : 1;
+
+			sensor_reading_total_count += cnt;
+			sensor_reading_count[si] = cnt;
+			++si;
+		}
+	}
 #endif
 
 #if USE_CONTROLLERS
@@ -235,39 +455,13 @@ void log_init(void) {
 	actuator_count = an;
 #endif
 
+	layout_log_line();
+#if DO_LOG_COMPRESSION
+	init_log_compression();
+#endif
 #if LOG_LINE_BUFFER_COUNT > 0
-	for (log_line_buffer_size_t i = 0; i < LOG_LINE_BUFFER_COUNT; ++i) {
-
-#if USE_SENSORS
-		if (sn > 0) {
-			log_buffer.lines[i].sensors = halloc(sn * sizeof(log_buffer.lines[0].sensors[0]));
-			sensor_reading_count = halloc(sn * sizeof(sensor_reading_count[0]));
-
-			for (SENSOR_INDEX_T ii = 0, si = 0; ii < SENSOR_COUNT; ++ii) {
-				if (!DO_SENSOR(ii)) {
-					continue;
-				}
-				uint_fast8_t cnt = (SENSORS[ii].value_count > 0) ? SENSORS[ii].value_count : 1;
-
-				sensor_reading_total_count += cnt;
-				sensor_reading_count[si] = cnt;
-				log_buffer.lines[i].sensors[si].reading = halloc(cnt * sizeof(log_buffer.lines[0].sensors[0].reading[0]));
-				++si;
-			}
-		}
+	alloc_log_buffer();
 #endif
-# if USE_CONTROLLERS
-		if (cn > 0) {
-			log_buffer.lines[i].controllers = halloc(cn * sizeof(log_buffer.lines[0].controllers[0]));
-		}
-# endif
-# if USE_ACTUATORS
-		if (an > 0) {
-			log_buffer.lines[i].actuators = halloc(an * sizeof(log_buffer.lines[0].actuators[0]));
-		}
-# endif // USE_ACTUATORS
-	}
-#endif // LOG_LINE_BUFFER_COUNT > 0
 
 	init_output_device();
 
@@ -276,6 +470,12 @@ void log_init(void) {
 	return;
 }
 
+#if USE_SENSOR_ADC_BATCH
+static bool sample_sensor_for_log(SENSOR_INDEX_T i) {
+	return DO_SENSOR(i);
+}
+#endif
+
 static void log_status_line(log_line_buffer_t *line) {
 	assert(line != NULL);
 
@@ -286,6 +486,15 @@ static void log_status_line(log_line_buffer_t *line) {
 	line->ghmon_warnings = ghmon_warnings;
 	line->system_time = NOW();
 #if USE_SENSORS
+# if USE_SENSOR_ADC_BATCH
+	// Take all the analog readings in one go rather than powering the ADC up
+	// and down again for each sensor
+	if (LOG_UPDATES_SENSORS) {
+		sample_common_adc_sensors(sample_sensor_for_log);
+	}
+# endif
+	sensor_log_buffer_t *line_sensors = LOG_LINE_SENSORS(line);
+	sensor_reading_t *line_readings = LOG_LINE_READINGS(line);
 	for (SENSOR_INDEX_T i = 0, si = 0; i < SENSOR_COUNT; ++i) {
 		if (!DO_SENSOR(i)) {
 			continue;
@@ -301,50 +510,53 @@ static void log_status_line(log_line_buffer_t *line) {
 		// I doubt it saves many (if any) cycles in this case.
 		if (sensors[i].reading != NULL) {
 			for (uint_fast8_t vi = 0; vi < cnt; ++vi) {
-				line->sensors[si].reading[vi] = sensors[i].reading[vi];
+				line_readings[vi] = sensors[i].reading[vi];
 			}
 		} else {
 			for (uint_fast8_t vi = 0; vi < cnt; ++vi) {
-				line->sensors[si].reading[vi] = default_reading_value;
+				line_readings[vi] = default_reading_value;
 			}
 		}
+		line_readings += cnt;
 
 # if USE_SENSOR_STATUS
-		line->sensors[si].status = sensors[i].status;
+		line_sensors[si].status = sensors[i].status;
 # endif
-		line->sensors[si].status_flags = sensors[i].status_flags;
+		line_sensors[si].status_flags = sensors[i].status_flags;
 		++si;
 	}
 #endif
 
 #if USE_CONTROLLERS
+	controller_log_buffer_t *line_controllers = LOG_LINE_CONTROLLERS(line);
 	for (CONTROLLER_INDEX_T i = 0, si = 0; i < CONTROLLER_COUNT; ++i) {
 		if (!DO_CONTROLLER(i)) {
 			continue;
 		}
 # if USE_CONTROLLER_STATUS
-		line->controllers[si].status = controllers[i].status;
+		line_controllers[si].status = controllers[i].status;
 # endif
-		line->controllers[si].status_flags = controllers[i].status_flags;
+		line_controllers[si].status_flags = controllers[i].status_flags;
 		++si;
 	}
 #endif
 
 #if USE_ACTUATORS
+	actuator_log_buffer_t *line_actuators = LOG_LINE_ACTUATORS(line);
 	for (ACTUATOR_INDEX_T i = 0, si = 0; i < ACTUATOR_COUNT; ++i) {
 		if (!DO_ACTUATOR(i)) {
 			continue;
 		}
-		line->actuators[si].status = actuators[i].status;
-		line->actuators[si].status_flags = actuators[i].status_flags;
+		line_actuators[si].status = actuators[i].status;
+		line_actuators[si].status_flags = actuators[i].status_flags;
 # if USE_ACTUATOR_STATUS_CHANGE_TIME
-		line->actuators[si].status_change_time = actuators[i].status_change_time;
+		line_actuators[si].status_change_time = actuators[i].status_change_time;
 # endif
 # if USE_ACTUATOR_ON_TIME_COUNT
-		line->actuators[si].on_time_seconds = actuators[i].on_time_seconds;
+		line_actuators[si].on_time_seconds = actuators[i].on_time_seconds;
 # endif
 # if USE_ACTUATOR_STATUS_CHANGE_COUNT
-		line->actuators[si].status_change_count = actuators[i].status_change_count;
+		line_actuators[si].status_change_count = actuators[i].status_change_count;
 # endif
 		++si;
 	}
@@ -353,78 +565,83 @@ static void log_status_line(log_line_buffer_t *line) {
 	return;
 }
 
+//
+// Open the log storage and write out the buffered lines so that the current
+// line can follow them
+// Returns true if the storage was left open for the current line.
+static bool write_log_buffer_ahead(void) {
+	if (open_log_storage() == ERR_OK) {
+		if (_write_log_to_storage(0) == ERR_OK) {
+			return true;
+		}
+		close_log_storage();
+	}
+
+	return false;
+}
 void log_status(void) {
-	bool buffer_line = true;
+	bool buffer_line = true, tried_storage = false;
 
 	if (buffer_is_full()) {
 		if (skip_log_writes()) {
 			SET_BIT(ghmon_warnings, WARN_LOG_SKIPPED);
-		} else if (open_log_storage() == ERR_OK) {
-			if (_write_log_to_storage(0) == ERR_OK) {
-				buffer_line = false;
-			} else {
-				close_log_storage();
-			}
+		} else {
+			tried_storage = true;
+			buffer_line = !write_log_buffer_ahead();
 		}
 	}
 
-	if (!buffer_line) {
-		log_line_buffer_t current_status = { 0 };
-#if USE_SENSORS
-		sensor_log_buffer_t sensors_m[sensor_count];
-		sensor_reading_t readings_m[sensor_reading_total_count];
-		for (SENSOR_INDEX_T si = 0, ri = 0; si < sensor_count; ++si) {
-			sensors_m[si].reading = &readings_m[ri];
-			ri += sensor_reading_count[si];
+	if (buffer_line) {
+		if (buffer_status_line() == ERR_OK) {
+			return;
+		}
+		//
+		// A line that can't be buffered at all has to be written out right
+		// away or not at all
+		if (skip_log_writes()) {
+			SET_BIT(ghmon_warnings, WARN_LOG_SKIPPED);
+			return;
+		}
+		if (tried_storage || !write_log_buffer_ahead()) {
+			return;
 		}
-		current_status.sensors = sensors_m;
-#endif
-#if USE_CONTROLLERS
-		controller_log_buffer_t controllers_m[controller_count];
-		current_status.controllers = controllers_m;
-#endif
-#if USE_ACTUATORS
-		actuator_log_buffer_t actuators_m[actuator_count];
-		current_status.actuators = actuators_m;
-#endif
-
-		log_status_line(&current_status);
-		buffer_line_extra(LOG_LINE_BUFFER_COUNT);
-		write_log_line_to_storage(&current_status, print_line_extra(LOG_LINE_BUFFER_COUNT), 0);
-		close_log_storage();
-	} else {
-		buffer_status_line();
 	}
+
+	DECLARE_LOG_LINE(current_status);
+
+	log_status_line(current_status);
+	buffer_line_extra(LOG_LINE_BUFFER_COUNT);
+	write_log_line_to_storage(current_status, print_line_extra(LOG_LINE_BUFFER_COUNT), 0);
+	close_log_storage();
+
 	return;
 }
 
 static err_t _write_log_to_storage(uint_fast8_t flags) {
 #if LOG_LINE_BUFFER_COUNT > 0
-	err_t res;
-	log_line_buffer_size_t head, size;
+	err_t res = ERR_OK;
+	log_line_buffer_size_t count, size;
+	log_buffer_iter_t iter;
+	log_line_buffer_t *line;
+	DECLARE_LOG_LINE(scratch);
 
-	size = (BIT_IS_SET(flags, LOG_WRITE_REWRITE_ALL)) ? LOG_LINE_BUFFER_COUNT : log_buffer.size;
+	count = log_buffer_count();
+	size = (BIT_IS_SET(flags, LOG_WRITE_REWRITE_ALL)) ? count : log_buffer.size;
 
-	if (size > log_buffer.tail) {
-		head = LOG_LINE_BUFFER_COUNT - (size - log_buffer.tail);
-	} else {
-		head = log_buffer.tail - size;
-	}
+	line = log_buffer_first(&iter, scratch, count - size);
 	while (size > 0) {
-		if ((res = write_log_line_to_storage(&log_buffer.lines[head], print_line_extra(head), flags)) != ERR_OK) {
+		if ((res = write_log_line_to_storage(line, print_line_extra(iter.index), flags)) != ERR_OK) {
 			goto END;
 		}
 
-		++head;
-		if (head == LOG_LINE_BUFFER_COUNT) {
-			head = 0;
-		}
 		--size;
+		line = log_buffer_next(&iter);
 	}
 
 END:
 	if (!BIT_IS_SET(flags, LOG_WRITE_PRESERVE_STATE) && (size < log_buffer.size)) {
 		log_buffer.size = size;
+		save_log_buffer_state();
 	}
 	return res;
 
@@ -433,80 +650,98 @@ END:
 }
 void print_log(void (*pf)(const char *format, ...)) {
 #if LOG_LINE_BUFFER_COUNT > 0
-	log_line_buffer_size_t head, size;
+	log_line_buffer_size_t size;
+	log_buffer_iter_t iter;
+	log_line_buffer_t *line;
+	DECLARE_LOG_LINE(scratch);
 
 	// Replay the whole buffer, even if it's been written out and even if
 	// there was never an entry
-	size = LOG_LINE_BUFFER_COUNT;
-	head = log_buffer.tail;
+	size = log_buffer_count();
+	line = log_buffer_first(&iter, scratch, 0);
 
 	for (; size > 0; --size) {
-		print_log_line(pf, &log_buffer.lines[head], print_line_extra(head));
-
-		++head;
-		if (head == LOG_LINE_BUFFER_COUNT) {
-			head = 0;
-		}
+		print_log_line(pf, line, print_line_extra(iter.index));
+		line = log_buffer_next(&iter);
 	}
 #endif // LOG_LINE_BUFFER_COUNT > 0
 
 	return;
 }
+err_t print_log_storage(void (*pf)(const char *format, ...)) {
+	err_t res;
+
+	uint_fast32_t profile_start = profile_begin();
+	res = print_output_storage(pf);
+	profile_end(PROFILE_STORAGE, profile_start);
+
+	return res;
+}
 
 static void print_log_line(void (*pf)(const char *format, ...), log_line_buffer_t *line, const char *extra) {
 	// 20 is enough to hold '2021.02.15 12:00:00' with a trailing NUL
 	char timestr[20];
+	// Consecutive lines are usually only a few minutes apart so most of the
+	// date can be reused from the last one
+	static datetime_cache_t line_time_cache;
+#if USE_ACTUATORS && USE_ACTUATOR_STATUS_CHANGE_TIME
+	static datetime_cache_t status_time_cache;
+#endif
 
-	pf("%s\t%s", format_print_time(timestr, line->system_time, LOG_TIME_FORMAT), format_warnings(line->ghmon_warnings));
+	pf("%s\t%s", format_print_time(timestr, SIZEOF_ARRAY(timestr), line->system_time, LOG_TIME_FORMAT, &line_time_cache), format_warnings(line->ghmon_warnings));
 
 #if USE_SENSORS
+	const sensor_log_buffer_t *line_sensors = LOG_LINE_SENSORS(line);
+	const sensor_reading_t *line_readings = LOG_LINE_READINGS(line);
 	for (SENSOR_INDEX_T i = 0, si = 0; i < SENSOR_COUNT; ++i) {
 		if (!DO_SENSOR(i)) {
 			continue;
 		}
 
 		const char *es;
-		es = BIT_IS_SET(line->sensors[si].status_flags, SENSOR_STATUS_FLAG_ERROR) ? "\t!" : "\t";
+		es = BIT_IS_SET(line_sensors[si].status_flags, SENSOR_STATUS_FLAG_ERROR) ? "\t!" : "\t";
 
-		if (!BIT_IS_SET(line->sensors[si].status_flags, SENSOR_STATUS_FLAG_INITIALIZED)) {
+		if (!BIT_IS_SET(line_sensors[si].status_flags, SENSOR_STATUS_FLAG_INITIALIZED)) {
 			pf("%s%s", es, invalid_value);
 			for (uint_fast8_t ri = 0; ri < sensor_reading_count[si]; ++ri) {
 				pf("\t%s", invalid_value);
 			}
 		} else {
 # if USE_SENSOR_STATUS
-			pf("%s%d", es, (int )line->sensors[si].status);
+			pf("%s%d", es, (int )line_sensors[si].status);
 # else
 			pf("%s%s", es, no_value);
 # endif
 			for (uint_fast8_t ri = 0; ri < sensor_reading_count[si]; ++ri) {
 				const char *tn;
 
-				if (LOG_PRINT_SENSOR_TYPE && (tn = sensor_type_to_name(line->sensors[si].reading[ri].type)) != NULL) {
-					pf("\t%d %s", (int )line->sensors[si].reading[ri].value, tn);
+				if (LOG_PRINT_SENSOR_TYPE && (tn = sensor_type_to_name(line_readings[ri].type)) != NULL) {
+					pf("\t%d %s", (int )line_readings[ri].value, tn);
 				} else {
-					pf("\t%d", (int )line->sensors[si].reading[ri].value);
+					pf("\t%d", (int )line_readings[ri].value);
 				}
 			}
 		}
+		line_readings += sensor_reading_count[si];
 		++si;
 	}
 #endif
 
 #if USE_CONTROLLERS
+	const controller_log_buffer_t *line_controllers = LOG_LINE_CONTROLLERS(line);
 	for (CONTROLLER_INDEX_T i = 0, si = 0; i < CONTROLLER_COUNT; ++i) {
 		if (!DO_CONTROLLER(i)) {
 			continue;
 		}
 
 		const char *es;
-		es = BIT_IS_SET(line->controllers[si].status_flags, CONTROLLER_STATUS_FLAG_ERROR) ? "\t!" : "\t";
+		es = BIT_IS_SET(line_controllers[si].status_flags, CONTROLLER_STATUS_FLAG_ERROR) ? "\t!" : "\t";
 
-		if (!BIT_IS_SET(line->controllers[si].status_flags, CONTROLLER_STATUS_FLAG_INITIALIZED)) {
+		if (!BIT_IS_SET(line_controllers[si].status_flags, CONTROLLER_STATUS_FLAG_INITIALIZED)) {
 			pf("%s%s", es, invalid_value);
 		} else {
 # if USE_CONTROLLER_STATUS
-			pf("%s%d", es, (int )line->controllers[si].status);
+			pf("%s%d", es, (int )line_controllers[si].status);
 # else
 			pf("%s%s", es, no_value);
 # endif
@@ -516,17 +751,18 @@ static void print_log_line(void (*pf)(const char *format, ...), log_line_buffer_
 #endif
 
 #if USE_ACTUATORS
+	const actuator_log_buffer_t *line_actuators = LOG_LINE_ACTUATORS(line);
 	for (ACTUATOR_INDEX_T i = 0, si = 0; i < ACTUATOR_COUNT; ++i) {
 		if (!DO_ACTUATOR(i)) {
 			continue;
 		}
 
-		if (BIT_IS_SET(line->actuators[si].status_flags, ACTUATOR_STATUS_FLAG_ERROR)) {
+		if (BIT_IS_SET(line_actuators[si].status_flags, ACTUATOR_STATUS_FLAG_ERROR)) {
 			pf("\t!");
 		} else {
 			pf("\t");
 		}
-		if (!BIT_IS_SET(line->actuators[si].status_flags, ACTUATOR_STATUS_FLAG_INITIALIZED)) {
+		if (!BIT_IS_SET(line_actuators[si].status_flags, ACTUATOR_STATUS_FLAG_INITIALIZED)) {
 			pf("%s", invalid_value);
 			if (USE_ACTUATOR_STATUS_CHANGE_TIME) {
 				pf("\t%s", invalid_value);
@@ -538,15 +774,15 @@ static void print_log_line(void (*pf)(const char *format, ...), log_line_buffer_
 				pf("\t%s", invalid_value);
 			}
 		} else {
-			pf("%d", (int )line->actuators[si].status);
+			pf("%d", (int )line_actuators[si].status);
 # if USE_ACTUATOR_STATUS_CHANGE_TIME
-			pf("\t%s", format_print_time(timestr, line->actuators[si].status_change_time, LOG_TIME_FORMAT));
+			pf("\t%s", format_print_time(timestr, SIZEOF_ARRAY(timestr), line_actuators[si].status_change_time, LOG_TIME_FORMAT, &status_time_cache));
 # endif
 # if USE_ACTUATOR_ON_TIME_COUNT
-			pf("\t%s", format_print_time(timestr, line->actuators[si].on_time_seconds, TIME_FORMAT_DURATION));
+			pf("\t%s", format_print_time(timestr, SIZEOF_ARRAY(timestr), line_actuators[si].on_time_seconds, TIME_FORMAT_DURATION, NULL));
 # endif
 # if USE_ACTUATOR_STATUS_CHANGE_COUNT
-			pf("\t%u", (unsigned )line->actuators[si].status_change_count);
+			pf("\t%u", (unsigned )line_actuators[si].status_change_count);
 # endif
 		}
 		++si;
@@ -563,7 +799,7 @@ static void print_log_line(void (*pf)(const char *format, ...), log_line_buffer_
 }
 static err_t write_log_line_to_storage(log_line_buffer_t *line, const char *extra, uint_fast8_t flags) {
 	if (BIT_IS_SET(flags, LOG_WRITE_PRESERVE_STATE)) {
-		print_log_line(lprintf, line, extra);
+		store_log_line(line, extra);
 		return ERR_OK;
 	}
 
@@ -575,7 +811,7 @@ static err_t write_log_line_to_storage(log_line_buffer_t *line, const char *extr
 		}
 	}
 
-	print_log_line(lprintf, line, extra);
+	store_log_line(line, extra);
 	++lines_logged_this_file;
 
 	return ERR_OK;
@@ -589,7 +825,10 @@ void write_log_to_storage(uint_fast8_t flags) {
 	return;
 }
 
-static const char* format_print_time(char *timestr, utime_t uptime, time_format_t format) {
+//
+// If cache is non-NULL, dates are worked out from the last one printed with it
+// rather than from scratch
+static const char* format_print_time(char *timestr, uint_fast8_t timestr_size, utime_t uptime, time_format_t format, datetime_cache_t *cache) {
 	const char *ret = timestr;
 
 	assert(timestr != NULL);
@@ -606,17 +845,20 @@ static const char* format_print_time(char *timestr, utime_t uptime, time_format_
 	}
 
 	if (format == TIME_FORMAT_SECONDS) {
-		cstring_from_uint(timestr, SIZEOF_ARRAY(timestr), uptime, 10);
+		cstring_from_uint(timestr, timestr_size, uptime, 10);
 
 	} else if (format == TIME_FORMAT_DURATION) {
 		// FIXME: Buffer overflow with days > 999999 (~2740 years)
-		ret = print_duration(timestr, SIZEOF_ARRAY(timestr), uptime);
+		ret = print_duration(timestr, timestr_size, uptime);
+
+	} else if (cache != NULL) {
+		ret = print_seconds_datetime_cached(uptime, cache);
 
 	} else {
 		datetime_t dt;
 
 		seconds_to_datetime(uptime, &dt);
-		ret = print_datetime(timestr, SIZEOF_ARRAY(timestr), &dt);
+		ret = print_datetime(timestr, timestr_size, &dt);
 	}
 
 	return ret;
@@ -648,165 +890,790 @@ static const char* format_warnings(uint8_t warnings) {
 	return wstr;
 }
 
-#if LOG_LINE_BUFFER_COUNT > 0
-static bool buffer_is_full(void) {
-	return (log_buffer.size == LOG_LINE_BUFFER_COUNT);
-}
-static void buffer_status_line(void) {
-	uint lineno;
+#if DO_LOG_COMPRESSION
+//
+// Compressed log buffer
+//
+// Each record starts with a bitmask with one bit for every field of the line
+// (in the order given by walk_log_line_fields()) which is set if the field
+// changed since the line before it. That's followed by the difference for each
+// field that changed as a zigzag-encoded varint. Fields wider than 32 bits are
+// handled as several 32-bit fields.
+//
+// There are no keyframes, instead the line before the oldest record is kept in
+// full as 'base' and dropping the oldest record just applies it to 'base'.
+typedef void (*log_field_cb_t)(void *ctx, uint_fast16_t offset, uint_fast8_t size);
 
-	assert(log_buffer.tail <  LOG_LINE_BUFFER_COUNT);
-	assert(log_buffer.size <= LOG_LINE_BUFFER_COUNT);
+static uint_fast16_t log_field_count;
+static uint_fast16_t log_record_max_size;
 
-	// This check makes sure we don't print e.g. '5 of 4' if there was a problem
-	// writing the log out and we're overwriting old entries.
-	lineno = log_buffer.size+1;
-	if (lineno > LOG_LINE_BUFFER_COUNT) {
-		lineno = LOG_LINE_BUFFER_COUNT;
+#define LOG_RECORD_MASK_SIZE() ((log_field_count + 7U) / 8U)
+#define LOG_FIELD_SIZE(_type_, _member_) (sizeof(((_type_ *)0)->_member_))
+
+static void walk_log_field(log_field_cb_t cb, void *ctx, uint_fast16_t offset, uint_fast8_t size) {
+	for (; size > 4; size -= 4, offset += 4) {
+		cb(ctx, offset, 4);
 	}
-	LOGGER("Buffering log line %u of %u", (uint )lineno, (uint )LOG_LINE_BUFFER_COUNT);
+	cb(ctx, offset, size);
 
-	log_status_line(&log_buffer.lines[log_buffer.tail]);
-	buffer_line_extra(log_buffer.tail);
+	return;
+}
+static void walk_log_line_fields(log_field_cb_t cb, void *ctx) {
+	walk_log_field(cb, ctx, offsetof(log_line_buffer_t, system_time), LOG_FIELD_SIZE(log_line_buffer_t, system_time));
+	walk_log_field(cb, ctx, offsetof(log_line_buffer_t, ghmon_warnings), LOG_FIELD_SIZE(log_line_buffer_t, ghmon_warnings));
 
-#if DEBUG && uHAL_USE_UART_COMM
-	print_log_line(serial_printf, &log_buffer.lines[log_buffer.tail], print_line_extra(log_buffer.tail));
+#if USE_SENSORS
+	for (uint_fast16_t i = 0, o = log_line_layout.sensors; i < (uint_fast16_t )sensor_count; ++i, o += sizeof(sensor_log_buffer_t)) {
+# if USE_SENSOR_STATUS
+		walk_log_field(cb, ctx, o + offsetof(sensor_log_buffer_t, status), LOG_FIELD_SIZE(sensor_log_buffer_t, status));
+# endif
+		walk_log_field(cb, ctx, o + offsetof(sensor_log_buffer_t, status_flags), LOG_FIELD_SIZE(sensor_log_buffer_t, status_flags));
+	}
+	for (uint_fast16_t i = 0, o = log_line_layout.readings; i < sensor_reading_total_count; ++i, o += sizeof(sensor_reading_t)) {
+		walk_log_field(cb, ctx, o + offsetof(sensor_reading_t, value), LOG_FIELD_SIZE(sensor_reading_t, value));
+		walk_log_field(cb, ctx, o + offsetof(sensor_reading_t, type), LOG_FIELD_SIZE(sensor_reading_t, type));
+	}
 #endif
 
-	++log_buffer.tail;
-	if (log_buffer.tail == LOG_LINE_BUFFER_COUNT) {
-		log_buffer.tail = 0;
+#if USE_CONTROLLERS
+	for (uint_fast16_t i = 0, o = log_line_layout.controllers; i < (uint_fast16_t )controller_count; ++i, o += sizeof(controller_log_buffer_t)) {
+# if USE_CONTROLLER_STATUS
+		walk_log_field(cb, ctx, o + offsetof(controller_log_buffer_t, status), LOG_FIELD_SIZE(controller_log_buffer_t, status));
+# endif
+		walk_log_field(cb, ctx, o + offsetof(controller_log_buffer_t, status_flags), LOG_FIELD_SIZE(controller_log_buffer_t, status_flags));
 	}
-	if (log_buffer.size != LOG_LINE_BUFFER_COUNT) {
-		++log_buffer.size;
+#endif
+
+#if USE_ACTUATORS
+	for (uint_fast16_t i = 0, o = log_line_layout.actuators; i < (uint_fast16_t )actuator_count; ++i, o += sizeof(actuator_log_buffer_t)) {
+# if USE_ACTUATOR_STATUS_CHANGE_TIME
+		walk_log_field(cb, ctx, o + offsetof(actuator_log_buffer_t, status_change_time), LOG_FIELD_SIZE(actuator_log_buffer_t, status_change_time));
+# endif
+# if USE_ACTUATOR_ON_TIME_COUNT
+		walk_log_field(cb, ctx, o + offsetof(actuator_log_buffer_t, on_time_seconds), LOG_FIELD_SIZE(actuator_log_buffer_t, on_time_seconds));
+# endif
+# if USE_ACTUATOR_STATUS_CHANGE_COUNT
+		walk_log_field(cb, ctx, o + offsetof(actuator_log_buffer_t, status_change_count), LOG_FIELD_SIZE(actuator_log_buffer_t, status_change_count));
+# endif
+		walk_log_field(cb, ctx, o + offsetof(actuator_log_buffer_t, status), LOG_FIELD_SIZE(actuator_log_buffer_t, status));
+		walk_log_field(cb, ctx, o + offsetof(actuator_log_buffer_t, status_flags), LOG_FIELD_SIZE(actuator_log_buffer_t, status_flags));
 	}
+#endif
 
 	return;
 }
 
-#else // !LOG_LINE_BUFFER_COUNT != 0
-static bool buffer_is_full(void) {
-	return true;
+static uint32_t get_log_field(const uint8_t *p, uint_fast8_t size) {
+	switch (size) {
+	case 1:
+		return *p;
+	case 2:
+		return *(const uint16_t *)p;
+	default:
+		return *(const uint32_t *)p;
+	}
 }
-static void buffer_status_line(void) {
+static void set_log_field(uint8_t *p, uint_fast8_t size, uint32_t value) {
+	switch (size) {
+	case 1:
+		*p = (uint8_t )value;
+		break;
+	case 2:
+		*(uint16_t *)p = (uint16_t )value;
+		break;
+	default:
+		*(uint32_t *)p = value;
+		break;
+	}
+
 	return;
 }
-#endif
-
-__attribute__ ((format(printf, 1, 2)))
-static void lprintf(const char *format, ...) {
-	va_list arp;
 
-	va_start(arp, format);
-	ulib_vprintf(lprintf_putc, format, arp);
-	va_end(arp);
+static uint_fast16_t log_ring_next(uint_fast16_t pos) {
+	return (pos + 1U == LOG_COMPRESSED_BUFFER_SIZE) ? 0 : pos + 1U;
+}
+static uint_fast16_t log_ring_advance(uint_fast16_t pos, uint_fast16_t n) {
+	pos += n;
+	return (pos >= LOG_COMPRESSED_BUFFER_SIZE) ? pos - LOG_COMPRESSED_BUFFER_SIZE : pos;
+}
 
+typedef struct {
+	const uint8_t *prev;
+	uint8_t *line;
+	uint_fast16_t mask_pos;
+	uint_fast16_t pos;
+	uint_fast16_t size;
+	uint_fast16_t field;
+	bool write;
+} log_delta_ctx_t;
+
+static void count_log_field(void *ctx, uint_fast16_t offset, uint_fast8_t size) {
+	UNUSED(offset);
+	UNUSED(size);
+	++*(uint_fast16_t *)ctx;
 	return;
 }
+static void encode_log_field(void *vctx, uint_fast16_t offset, uint_fast8_t size) {
+	log_delta_ctx_t *ctx = vctx;
+	uint32_t delta = get_log_field(&ctx->line[offset], size) - get_log_field(&ctx->prev[offset], size);
+	uint_fast16_t field = ctx->field++;
+
+	if (size < 4) {
+		// Sign-extend the difference so that small negative changes to narrow
+		// fields stay small
+		const uint_fast8_t shift = 32U - (size * 8U);
+		delta = (uint32_t )((int32_t )(delta << shift) >> shift);
+	}
+	if (delta == 0) {
+		return;
+	}
+	delta = (delta << 1U) ^ (uint32_t )((int32_t )delta >> 31U);
 
-#if LOG_PRINT_BUFFER_SIZE > 0
-static void lprintf_putc(uint_fast8_t c) {
-	assert(print_buffer.size < LOG_PRINT_BUFFER_SIZE);
+	if (ctx->write) {
+		uint_fast16_t mpos = log_ring_advance(ctx->mask_pos, field / 8U);
 
-	print_buffer.buffer[print_buffer.size] = c;
-	++print_buffer.size;
+		log_buffer.data[mpos] |= (uint8_t )(1U << (field % 8U));
+	}
+	do {
+		uint8_t c = delta & 0x7FU;
 
-	if (print_buffer.size == LOG_PRINT_BUFFER_SIZE) {
-		if (write_buffer_to_storage(print_buffer.buffer, print_buffer.size) != ERR_OK) {
-			SET_BIT(ghmon_warnings, WARN_LOG_ERROR);
+		delta >>= 7U;
+		if (delta != 0) {
+			c |= 0x80U;
 		}
-		print_buffer.size = 0;
-	}
+		if (ctx->write) {
+			log_buffer.data[ctx->pos] = c;
+			ctx->pos = log_ring_next(ctx->pos);
+		}
+		++ctx->size;
+	} while (delta != 0);
 
 	return;
 }
-static void reset_print_buffer(void) {
-	print_buffer.size = 0;
-	return;
-}
-#else // LOG_PRINT_BUFFER_SIZE > 0
-static void lprintf_putc(uint_fast8_t c) {
-	if (write_byte_to_storage(c) != ERR_OK) {
-		SET_BIT(ghmon_warnings, WARN_LOG_ERROR);
+static void decode_log_field(void *vctx, uint_fast16_t offset, uint_fast8_t size) {
+	log_delta_ctx_t *ctx = vctx;
+	uint_fast16_t field = ctx->field++;
+	uint32_t delta = 0;
+	uint8_t c;
+
+	if (!BIT_IS_SET(log_buffer.data[log_ring_advance(ctx->mask_pos, field / 8U)], 1U << (field % 8U))) {
+		return;
 	}
+	for (uint_fast8_t shift = 0; ; shift += 7U) {
+		c = log_buffer.data[ctx->pos];
+		ctx->pos = log_ring_next(ctx->pos);
+		delta |= (uint32_t )(c & 0x7FU) << shift;
+		if (!BIT_IS_SET(c, 0x80U)) {
+			break;
+		}
+	}
+	delta = (delta >> 1U) ^ (uint32_t )(-(int32_t )(delta & 1U));
+
+	set_log_field(&ctx->line[offset], size, get_log_field(&ctx->line[offset], size) + delta);
 	return;
 }
-static void reset_print_buffer(void) {
-	return;
-}
-#endif // LOG_PRINT_BUFFER_SIZE > 0
-
-static err_t open_log_storage(void) {
-	err_t res;
-
-	LOGGER("Writing log data");
-	CLEAR_BIT(ghmon_warnings, WARN_LOG_ERROR);
-	CLEAR_BIT(ghmon_warnings, WARN_LOG_SKIPPED);
-	reset_print_buffer();
 
-	if ((res = open_output_device()) == ERR_OK && (res = open_log_file()) != ERR_OK) {
-		close_output_device();
+//
+// Store 'line' as the difference from the newest line, dropping old lines as
+// needed to make room
+// Returns ERR_NOMEM without changing the buffer if the record is too large
+// for it even when empty.
+static err_t encode_log_line(log_line_buffer_t *line) {
+	log_delta_ctx_t ctx = {
+		.prev = (const uint8_t *)log_buffer.newest,
+		.line = (uint8_t *)line,
+		.size = LOG_RECORD_MASK_SIZE(),
+	};
+
+	uint_fast16_t size;
+
+	walk_log_line_fields(encode_log_field, &ctx);
+	size = ctx.size;
+	if (size > LOG_COMPRESSED_BUFFER_SIZE) {
+		LOGGER("Log line too large for LOG_COMPRESSED_BUFFER_SIZE");
+		return ERR_NOMEM;
 	}
-	if (res != ERR_OK) {
-		SET_BIT(ghmon_warnings, WARN_LOG_ERROR);
+	while (log_buffer.count == LOG_LINE_BUFFER_COUNT || (LOG_COMPRESSED_BUFFER_SIZE - log_buffer.used) < size) {
+		drop_oldest_log_line();
 	}
 
-	return res;
-}
-static err_t open_log_file(void) {
-	if (!have_log_header) {
-		return rotate_log_file();
+	ctx.mask_pos = log_ring_advance(log_buffer.start, log_buffer.used);
+	ctx.pos = log_ring_advance(ctx.mask_pos, LOG_RECORD_MASK_SIZE());
+	ctx.field = 0;
+	ctx.write = true;
+	for (uint_fast16_t i = 0, p = ctx.mask_pos; i < LOG_RECORD_MASK_SIZE(); ++i, p = log_ring_next(p)) {
+		log_buffer.data[p] = 0;
+	}
+	walk_log_line_fields(encode_log_field, &ctx);
+
+	log_buffer.used += size;
+	++log_buffer.count;
+	memcpy(log_buffer.newest, line, log_line_layout.size);
+
+	// The record may wrap around to the start of the ring
+	if (size > (LOG_COMPRESSED_BUFFER_SIZE - ctx.mask_pos)) {
+		save_log_buffer_range(&log_buffer.data[ctx.mask_pos], LOG_COMPRESSED_BUFFER_SIZE - ctx.mask_pos);
+		save_log_buffer_range(log_buffer.data, size - (LOG_COMPRESSED_BUFFER_SIZE - ctx.mask_pos));
+	} else {
+		save_log_buffer_range(&log_buffer.data[ctx.mask_pos], size);
 	}
+	save_log_buffer_range(log_buffer.newest, log_line_layout.size);
 
-	return open_output_file(logfile_name);
+	return ERR_OK;
+}
+//
+// Apply the record at 'pos' to 'line' and return the position of the next one
+static uint_fast16_t decode_log_line(log_line_buffer_t *line, uint_fast16_t pos) {
+	log_delta_ctx_t ctx = {
+		.line = (uint8_t *)line,
+		.mask_pos = pos,
+		.pos = log_ring_advance(pos, LOG_RECORD_MASK_SIZE()),
+	};
+
+	walk_log_line_fields(decode_log_field, &ctx);
+	return ctx.pos;
 }
+//
+// Return the size of the record at 'pos' without decoding it
+static uint_fast16_t log_record_size(uint_fast16_t pos) {
+	uint_fast16_t fields = 0, size = LOG_RECORD_MASK_SIZE();
 
-static err_t flush_print_buffer(void) {
-	err_t res = ERR_OK;
+	for (uint_fast16_t i = 0; i < LOG_RECORD_MASK_SIZE(); ++i, pos = log_ring_next(pos)) {
+		for (uint8_t m = log_buffer.data[pos]; m != 0; m &= (uint8_t )(m - 1U)) {
+			++fields;
+		}
+	}
+	for (; fields > 0; ++size, pos = log_ring_next(pos)) {
+		if (!BIT_IS_SET(log_buffer.data[pos], 0x80U)) {
+			--fields;
+		}
+	}
 
-#if LOG_PRINT_BUFFER_SIZE > 0
-	if (print_buffer.size > 0) {
-		res = write_buffer_to_storage(print_buffer.buffer, print_buffer.size);
-		reset_print_buffer();
+	return size;
+}
+static void drop_oldest_log_line(void) {
+	uint_fast16_t next;
+
+	assert(log_buffer.count > 0);
+
+	next = decode_log_line(log_buffer.base, log_buffer.start);
+	save_log_buffer_range(log_buffer.base, log_line_layout.size);
+	log_buffer.used -= (next >= log_buffer.start) ? (next - log_buffer.start) : (next + LOG_COMPRESSED_BUFFER_SIZE - log_buffer.start);
+	log_buffer.start = next;
+	--log_buffer.count;
+	if (log_buffer.size > log_buffer.count) {
+		log_buffer.size = log_buffer.count;
 	}
-#endif
 
-	return res;
+	return;
 }
-static void close_log_storage(void) {
-	flush_print_buffer();
-	close_output_device();
+static void init_log_compression(void) {
+	log_field_count = 0;
+	walk_log_line_fields(count_log_field, &log_field_count);
+	// A 32-bit varint takes up to 5 bytes
+	log_record_max_size = LOG_RECORD_MASK_SIZE() + (log_field_count * 5U);
 
 	return;
 }
 
-static err_t find_log_file_name(void) {
-#if USE_LOG_FILE_NAME && LOG_LINES_PER_FILE > 0
+static log_line_buffer_size_t log_buffer_count(void) {
+	return log_buffer.count;
+}
+//
+// Decode the lines up to the one 'skip' lines after the oldest into 'scratch'
+// and return it
+static log_line_buffer_t* log_buffer_first(log_buffer_iter_t *iter, log_line_buffer_t *scratch, log_line_buffer_size_t skip) {
+	iter->line = scratch;
+	iter->left = log_buffer.count;
+	iter->pos = log_buffer.start;
+	iter->index = (log_buffer.tail >= log_buffer.count) ? log_buffer.tail - log_buffer.count : (LOG_LINE_BUFFER_COUNT - (log_buffer.count - log_buffer.tail));
+	memcpy(scratch, log_buffer.base, log_line_layout.size);
+
+	if (iter->left > 0) {
+		iter->pos = decode_log_line(scratch, iter->pos);
+		--iter->left;
+	}
+	for (; skip > 0; --skip) {
+		log_buffer_next(iter);
+	}
+
+	return scratch;
+}
+static log_line_buffer_t* log_buffer_next(log_buffer_iter_t *iter) {
+	++iter->index;
+	if (iter->index == LOG_LINE_BUFFER_COUNT) {
+		iter->index = 0;
+	}
+	if (iter->left > 0) {
+		iter->pos = decode_log_line(iter->line, iter->pos);
+		--iter->left;
+	}
+
+	return iter->line;
+}
+
+static bool buffer_is_full(void) {
+	uint_fast16_t pending, pos;
+
+	if (log_buffer.size == LOG_LINE_BUFFER_COUNT) {
+		return true;
+	}
+	//
+	// Lines which have already been written out can be dropped to make room,
+	// the rest can't
+	pos = log_buffer.start;
+	pending = log_buffer.used;
+	for (log_line_buffer_size_t i = log_buffer.count - log_buffer.size; i > 0; --i) {
+		uint_fast16_t size = log_record_size(pos);
+
+		pending -= size;
+		pos = log_ring_advance(pos, size);
+	}
+
+	return ((LOG_COMPRESSED_BUFFER_SIZE - pending) < log_record_max_size);
+}
+
+#elif LOG_LINE_BUFFER_COUNT > 0
+static log_line_buffer_size_t log_buffer_count(void) {
+	return LOG_LINE_BUFFER_COUNT;
+}
+static log_line_buffer_t* log_buffer_first(log_buffer_iter_t *iter, log_line_buffer_t *scratch, log_line_buffer_size_t skip) {
+	UNUSED(scratch);
+
+	iter->index = log_buffer.tail + skip;
+	if (iter->index >= LOG_LINE_BUFFER_COUNT) {
+		iter->index -= LOG_LINE_BUFFER_COUNT;
+	}
+
+	return LOG_BUFFER_LINE(iter->index);
+}
+static log_line_buffer_t* log_buffer_next(log_buffer_iter_t *iter) {
+	++iter->index;
+	if (iter->index == LOG_LINE_BUFFER_COUNT) {
+		iter->index = 0;
+	}
+
+	return LOG_BUFFER_LINE(iter->index);
+}
+
+static bool buffer_is_full(void) {
+	return (log_buffer.size == LOG_LINE_BUFFER_COUNT);
+}
+#endif // DO_LOG_COMPRESSION
+
+#if LOG_LINE_BUFFER_COUNT > 0
+#if DO_LOG_RETENTION
+static bool restore_log_buffer_state(void) {
+	const log_buffer_state_t *state = log_buffer_state;
+
+	if (memcmp(&state->layout, &log_line_layout, sizeof(log_line_layout)) != 0) {
+		return false;
+	}
+	if ((state->tail >= LOG_LINE_BUFFER_COUNT) || (state->size > LOG_LINE_BUFFER_COUNT)) {
+		return false;
+	}
+#if DO_LOG_COMPRESSION
+	if ((state->count > LOG_LINE_BUFFER_COUNT) || (state->size > state->count) || (state->start >= LOG_COMPRESSED_BUFFER_SIZE) || (state->used > LOG_COMPRESSED_BUFFER_SIZE)) {
+		return false;
+	}
+	log_buffer.start = state->start;
+	log_buffer.used  = state->used;
+	log_buffer.count = state->count;
+#endif
+	log_buffer.tail = state->tail;
+	log_buffer.size = state->size;
+
+	return true;
+}
+#endif // DO_LOG_RETENTION
+//
+// Allocate the log buffer, preferably in retained memory in which case the
+// unwritten lines from before a reset are picked back up
+static void alloc_log_buffer(void) {
+	//
+	// halloc() only guarantees pointer alignment and retained memory only
+	// guarantees 8 bytes
+	const uintptr_t align = __alignof__(log_line_align_t);
+	uint8_t *mem = NULL;
+	size_t size;
+
+#if DO_LOG_COMPRESSION
+	size = (2U * (size_t )log_line_layout.size) + LOG_COMPRESSED_BUFFER_SIZE;
+#else
+	size = (size_t )LOG_LINE_BUFFER_COUNT * log_line_layout.size;
+#endif
+
+#if DO_LOG_RETENTION
+	const size_t state_size = (sizeof(log_buffer_state_t) + (align - 1)) & ~(align - 1);
+	bool restored = false;
+
+	if ((align <= 8U) && ((state_size + size) <= 0xFFFFU)) {
+		log_buffer_state = retain_region(RETAIN_LOG, (uint_fast16_t )(state_size + size), &restored);
+	}
+	if (log_buffer_state != NULL) {
+		mem = (uint8_t *)log_buffer_state + state_size;
+		if (restored && restore_log_buffer_state()) {
+			LOGGER("Recovered %u unwritten log lines", (uint )log_buffer.size);
+		} else {
+			mem_init(log_buffer_state, 0, state_size + size);
+			retain_sync(log_buffer_state);
+		}
+	}
+#endif
+
+	if (mem == NULL) {
+		uintptr_t addr = (uintptr_t )halloc(size + (align - 1));
+
+		mem = (uint8_t *)((addr + (align - 1)) & ~(align - 1));
+		mem_init(mem, 0, size);
+	}
+
+#if DO_LOG_COMPRESSION
+	log_buffer.base = (log_line_buffer_t *)mem;
+	log_buffer.newest = (log_line_buffer_t *)&mem[log_line_layout.size];
+	log_buffer.data = &mem[2U * log_line_layout.size];
+#else
+	log_buffer.lines = mem;
+#endif
+	save_log_buffer_state();
+
+	return;
+}
+//
+// Update the copy of the buffer state in retained memory
+static void save_log_buffer_state(void) {
+#if DO_LOG_RETENTION
+	log_buffer_state_t *state = log_buffer_state;
+
+	if (state == NULL) {
+		return;
+	}
+	state->layout = log_line_layout;
+	state->tail = log_buffer.tail;
+	state->size = log_buffer.size;
+#if DO_LOG_COMPRESSION
+	state->start = log_buffer.start;
+	state->used  = log_buffer.used;
+	state->count = log_buffer.count;
+#endif
+	retain_sync_range(state, state, sizeof(*state));
+#endif // DO_LOG_RETENTION
+
+	return;
+}
+//
+// Update the copy of part of the buffer in retained memory
+static void save_log_buffer_range(const void *start, size_t size) {
+#if DO_LOG_RETENTION
+	if (log_buffer_state == NULL) {
+		return;
+	}
+	retain_sync_range(log_buffer_state, start, (uint_fast16_t )size);
+#else
+	UNUSED(start);
+	UNUSED(size);
+#endif // DO_LOG_RETENTION
+
+	return;
+}
+
+//
+// Add the current status to the log buffer
+// Returns an error if the line couldn't be buffered; nothing is changed in
+// that case.
+static err_t buffer_status_line(void) {
+	uint lineno;
+	log_line_buffer_t *line;
+#if DO_LOG_COMPRESSION
+	DECLARE_LOG_LINE(scratch);
+
+	line = scratch;
+#else
+	line = LOG_BUFFER_LINE(log_buffer.tail);
+#endif
+
+	assert(log_buffer.tail <  LOG_LINE_BUFFER_COUNT);
+	assert(log_buffer.size <= LOG_LINE_BUFFER_COUNT);
+
+	log_status_line(line);
+#if DO_LOG_COMPRESSION
+	if (encode_log_line(line) != ERR_OK) {
+		return ERR_NOMEM;
+	}
+#else
+	save_log_buffer_range(line, log_line_layout.size);
+#endif
+
+	// This check makes sure we don't print e.g. '5 of 4' if there was a problem
+	// writing the log out and we're overwriting old entries.
+	lineno = log_buffer.size+1;
+	if (lineno > LOG_LINE_BUFFER_COUNT) {
+		lineno = LOG_LINE_BUFFER_COUNT;
+	}
+	LOGGER("Buffering log line %u of %u", (uint )lineno, (uint )LOG_LINE_BUFFER_COUNT);
+
+	buffer_line_extra(log_buffer.tail);
+
+#if DEBUG && uHAL_USE_UART_COMM
+	print_log_line(serial_printf, line, print_line_extra(log_buffer.tail));
+#endif
+
+	++log_buffer.tail;
+	if (log_buffer.tail == LOG_LINE_BUFFER_COUNT) {
+		log_buffer.tail = 0;
+	}
+	if (log_buffer.size != LOG_LINE_BUFFER_COUNT) {
+		++log_buffer.size;
+	}
+	save_log_buffer_state();
+
+	return ERR_OK;
+}
+
+#else // !LOG_LINE_BUFFER_COUNT != 0
+static bool buffer_is_full(void) {
+	return true;
+}
+//
+// The buffer is always full so we only get here when the line is being
+// skipped or the storage is unavailable
+static err_t buffer_status_line(void) {
+	return ERR_OK;
+}
+#endif
+
+#if ! LOG_FORMAT_BINARY
+//
+// printf() output goes straight into the unused part of the print buffer and
+// lprintf_write() is only called when that fills up
+static void lprintf_write(printf_sink_t *sink, const uint8_t *data, size_t len);
+
+static void open_lprintf_sink(printf_sink_t *sink) {
+# if LOG_PRINT_BUFFER_SIZE > 0
+	sink->buf = &print_buffer.buffer[print_buffer.size];
+	sink->size = LOG_PRINT_BUFFER_SIZE - print_buffer.size;
+# else
+	sink->buf = NULL;
+	sink->size = 0;
+# endif
+	sink->write = lprintf_write;
+
+	return;
+}
+static void close_lprintf_sink(printf_sink_t *sink) {
+# if LOG_PRINT_BUFFER_SIZE > 0
+	print_buffer.size = (print_buffer_size_t )(sink->buf - print_buffer.buffer);
+# else
+	UNUSED(sink);
+# endif
+
+	return;
+}
+static void lprintf_write(printf_sink_t *sink, const uint8_t *data, size_t len) {
+	close_lprintf_sink(sink);
+	lprint_bytes(data, len);
+	open_lprintf_sink(sink);
+
+	return;
+}
+__attribute__ ((format(printf, 1, 2)))
+static void lprintf(const char *format, ...) {
+	va_list arp;
+	printf_sink_t sink;
+
+	open_lprintf_sink(&sink);
+	va_start(arp, format);
+	ulib_vprintf_sink(&sink, format, arp);
+	va_end(arp);
+	close_lprintf_sink(&sink);
+
+	return;
+}
+#endif
+
+#if LOG_PRINT_BUFFER_SIZE > 0
+static void lprint_bytes(const uint8_t *data, size_t size) {
+	while (size > 0) {
+		print_buffer_size_t n;
+
+		if (print_buffer.size == LOG_PRINT_BUFFER_SIZE) {
+			if ((print_buffer.size > print_buffer.start) && (write_buffer_to_storage(&print_buffer.buffer[print_buffer.start], print_buffer.size - print_buffer.start) != ERR_OK)) {
+				SET_BIT(ghmon_warnings, WARN_LOG_ERROR);
+			}
+			// The buffer size is a multiple of the alignment so the next byte
+			// starts a new block
+			print_buffer.start = 0;
+			print_buffer.size = 0;
+		}
+
+		n = (print_buffer_size_t )MIN(size, (size_t )(LOG_PRINT_BUFFER_SIZE - print_buffer.size));
+		memcpy(&print_buffer.buffer[print_buffer.size], data, n);
+		print_buffer.size += n;
+		data += n;
+		size -= n;
+	}
+
+	return;
+}
+static void reset_print_buffer(void) {
+	print_buffer.start = 0;
+	print_buffer.size = 0;
+	return;
+}
+//
+// Start the (empty) buffer at the same offset within a block as the output
+// file
+static void align_print_buffer(void) {
+	assert(print_buffer.start == print_buffer.size);
+
+#if LOG_PRINT_BUFFER_ALIGNMENT > 0
+	print_buffer.start = (print_buffer_size_t )(output_file_position() % LOG_PRINT_BUFFER_ALIGNMENT);
+#else
+	print_buffer.start = 0;
+#endif
+	print_buffer.size = print_buffer.start;
+
+	return;
+}
+#else // LOG_PRINT_BUFFER_SIZE > 0
+static void lprint_bytes(const uint8_t *data, size_t size) {
+	//
+	// print_buffer_size_t is only a byte wide here, so very long writes
+	// have to be split up
+	while (size > 0) {
+		print_buffer_size_t n = (print_buffer_size_t )MIN(size, (size_t )((print_buffer_size_t )-1));
+
+		if (write_buffer_to_storage(data, n) != ERR_OK) {
+			SET_BIT(ghmon_warnings, WARN_LOG_ERROR);
+		}
+		data += n;
+		size -= n;
+	}
+	return;
+}
+static void reset_print_buffer(void) {
+	return;
+}
+static void align_print_buffer(void) {
+	return;
+}
+#endif // LOG_PRINT_BUFFER_SIZE > 0
+
+static err_t open_log_storage(void) {
+	err_t res;
+
+	LOGGER("Writing log data");
+	CLEAR_BIT(ghmon_warnings, WARN_LOG_ERROR);
+	CLEAR_BIT(ghmon_warnings, WARN_LOG_SKIPPED);
+	reset_print_buffer();
+
+	uint_fast32_t profile_start = profile_begin();
+	if ((res = open_output_device()) == ERR_OK && (res = open_log_file()) != ERR_OK) {
+		close_output_device();
+	}
+	profile_end(PROFILE_STORAGE, profile_start);
+	if (res != ERR_OK) {
+		SET_BIT(ghmon_warnings, WARN_LOG_ERROR);
+	}
+
+	return res;
+}
+static err_t open_log_file(void) {
+	if (!have_log_header) {
+		return rotate_log_file();
+	}
+
+	err_t res = open_output_file(logfile_name);
+	if (res == ERR_OK) {
+		align_print_buffer();
+	}
+
+	return res;
+}
+
+static err_t flush_print_buffer(void) {
+	err_t res = ERR_OK;
+
+#if LOG_PRINT_BUFFER_SIZE > 0
+	if (print_buffer.size > print_buffer.start) {
+		res = write_buffer_to_storage(&print_buffer.buffer[print_buffer.start], print_buffer.size - print_buffer.start);
+		// Anything added after this continues in the same block, so the
+		// alignment is unchanged
+		print_buffer.start = print_buffer.size;
+	}
+#endif
+
+	return res;
+}
+static void close_log_storage(void) {
+	flush_print_buffer();
+
+	uint_fast32_t profile_start = profile_begin();
+	close_output_device();
+	profile_end(PROFILE_STORAGE, profile_start);
+
+	return;
+}
+
+#if USE_LOG_FILE_NAME && LOG_LINES_PER_FILE > 0
+static void set_log_file_index(uint_fast8_t mod_p, int_fast8_t index) {
+	logfile_name[mod_p] = (char )('0' + (index / 10));
+	logfile_name[mod_p+1] = (char )('0' + (index % 10));
+	return;
+}
+#endif
+//
+// Pick the name of the next log file
+// 'resume' is set if the name belongs to an existing file which may be picked
+// back up where it left off.
+static err_t find_log_file_name(bool *resume) {
+	*resume = false;
+
+#if USE_LOG_FILE_NAME && LOG_LINES_PER_FILE > 0
 	// This gets us two positions before the file extension
 	const uint_fast8_t mod_p = SIZEOF_ARRAY(logfile_name) - 7;
+	int_fast8_t last;
 
-	if (logfile_name[mod_p] == 'X') {
-		logfile_name[mod_p] = '0';
-		logfile_name[mod_p+1] = '0';
-	}
-
-	// 'A' > '9' so the loop is skipped completely if we've already exhausted the
-	// options
-	// TODO: If the most recent existing log file has fewer than LOG_LINES_PER_FILE lines,
-	// reopen that and set the current line number.
-	for (; logfile_name[mod_p] <= '9'; ++logfile_name[mod_p]) {
-		for (; logfile_name[mod_p+1] <= '9'; ++logfile_name[mod_p+1]) {
-			switch (output_file_is_available(logfile_name)) {
-			case ERR_OK:
-				return ERR_OK;
-			case ERR_RETRY:
-				return ERR_RETRY;
-			default:
-				break;
-			}
+	//
+	// Once the storage has been searched each rotation just moves on to the
+	// next number, as long as nothing else has taken it in the meantime
+	if (next_logfile_index > 99) {
+		goto EXHAUSTED;
+	}
+	if (next_logfile_index >= 0) {
+		set_log_file_index(mod_p, next_logfile_index);
+		switch (output_file_is_available(logfile_name)) {
+		case ERR_OK:
+			++next_logfile_index;
+			return ERR_OK;
+		case ERR_RETRY:
+			return ERR_RETRY;
+		default:
+			break;
 		}
-		logfile_name[mod_p+1] = '0';
 	}
+
+	logfile_name[mod_p] = '?';
+	logfile_name[mod_p+1] = '?';
+	if (find_last_output_file(logfile_name, mod_p, &last) != ERR_OK) {
+		return ERR_RETRY;
+	}
+	//
+	// The most recent file is only picked back up right after boot, any other
+	// time we get here something else has been writing to the storage
+	if (DO_LOG_RESUME && next_logfile_index < 0 && last >= 0) {
+		*resume = true;
+		next_logfile_index = last;
+	} else {
+		next_logfile_index = last + 1;
+	}
+	if (next_logfile_index <= 99) {
+		set_log_file_index(mod_p, next_logfile_index);
+		++next_logfile_index;
+		return ERR_OK;
+	}
+
+EXHAUSTED:
 	// TODO: Start using letter suffixes when numbers run out
 	logfile_name[mod_p] = 'A';
 	logfile_name[mod_p+1] = '0';
@@ -816,22 +1683,67 @@ static err_t find_log_file_name(void) {
 }
 static err_t rotate_log_file(void) {
 	err_t res;
+	bool resume;
 
 	have_log_header = false;
 	if ((res = flush_print_buffer()) != ERR_OK) {
 		goto END;
 	}
+	measure_log_line_size();
 	if ((res = close_output_file()) != ERR_OK) {
 		goto END;
 	}
 	//
 	// Don't return an error when we couldn't find the name, that just means the
 	// device is temporarily unvavailable and we'll try again later.
-	//if ((res = find_log_file_name()) != ERR_OK) {
-	if ((find_log_file_name()) != ERR_OK) {
+	//if ((res = find_log_file_name(&resume)) != ERR_OK) {
+	if ((find_log_file_name(&resume)) != ERR_OK) {
 		goto END;
 	}
 
+	if (resume) {
+		int_fast32_t lines;
+		uint32_t end;
+		bool has_tail;
+
+		//
+		// Only check the file over with it opened read-only so that a file
+		// which turns out not to be ours can't be changed
+		if ((res = open_output_file_readonly(logfile_name)) != ERR_OK) {
+			goto END;
+		}
+		lines = count_log_file_lines(&end, &has_tail);
+		if ((res = close_output_file()) != ERR_OK) {
+			goto END;
+		}
+		//
+		// If the file is still holding space reserved for it then it has to
+		// be opened for writing, whether it's being resumed or not, so that
+		// the space can be released
+		if (lines >= 0 && (lines < LOG_LINES_PER_FILE || has_tail)) {
+			if ((res = open_output_file(logfile_name)) != ERR_OK) {
+				goto END;
+			}
+			if ((res = seek_output_file(end)) != ERR_OK) {
+				close_output_file();
+				goto END;
+			}
+			if (lines < LOG_LINES_PER_FILE) {
+				LOGGER("Resuming log file %s at line %u", logfile_name, (uint )lines);
+				lines_logged_this_file = (uint32_t )lines;
+				align_print_buffer();
+				have_log_header = true;
+				goto END;
+			}
+			if ((res = close_output_file()) != ERR_OK) {
+				goto END;
+			}
+		}
+		if ((find_log_file_name(&resume)) != ERR_OK) {
+			goto END;
+		}
+	}
+
 	lines_logged_this_file = 0;
 	if (USE_LOG_FILE_NAME) {
 		LOGGER("Using log file %s", logfile_name);
@@ -839,6 +1751,8 @@ static err_t rotate_log_file(void) {
 	if ((res = open_output_file(logfile_name)) != ERR_OK) {
 		goto END;
 	}
+	reserve_log_file();
+	align_print_buffer();
 
 	write_log_header();
 	have_log_header = true;
@@ -847,8 +1761,143 @@ END:
 	return res;
 }
 
-void print_log_header(void (*pf)(const char *format, ...)) {
-	pf(F("# Time\tWarnings"));
+#if DO_LOG_RESUME
+//
+// Sequential reader used to check over an existing log file
+typedef struct {
+	uint32_t offset;
+	uint_fast16_t size;
+	uint_fast16_t pos;
+	bool error;
+	bool mismatch;
+	uint8_t buf[64];
+} log_reader_t;
+static log_reader_t *log_reader;
+
+//
+// Return the next byte of the file or -1 at the end of the file
+static int_fast16_t log_reader_getc(void) {
+	log_reader_t *r = log_reader;
+
+	if (r->pos == r->size) {
+		r->pos = 0;
+		r->size = sizeof(r->buf);
+		if (read_output_file(r->offset, r->buf, &r->size) != ERR_OK) {
+			r->error = true;
+			r->size = 0;
+		}
+		if (r->size == 0) {
+			return -1;
+		}
+		r->offset += r->size;
+	}
+
+	return r->buf[r->pos++];
+}
+static void log_reader_compare_putc(uint_fast8_t c) {
+	if (log_reader_getc() != (int_fast16_t )c) {
+		log_reader->mismatch = true;
+	}
+	return;
+}
+__attribute__ ((format(printf, 1, 2)))
+static void log_reader_compare_printf(const char *format, ...) {
+	va_list arp;
+
+	va_start(arp, format);
+	ulib_vprintf(log_reader_compare_putc, format, arp);
+	va_end(arp);
+
+	return;
+}
+//
+// Check whether the log file that was just opened can be picked back up and
+// count the lines in it
+// The file has to begin with the same header we'd write now and its contents
+// have to end with a complete line. The contents end at the end of the file
+// or at the first byte that can't be part of a text line, which is where
+// space reserved for the file begins if it wasn't released before a reset;
+// '*end' is set to the offset of the end of the contents and '*has_tail' is
+// set if anything follows it.
+// Returns the number of lines following the header or -1 if the file can't
+// be used.
+static int_fast32_t count_log_file_lines(uint32_t *end, bool *has_tail) {
+	const uint8_t eol = (uint8_t )line_end[SIZEOF_ARRAY(line_end) - 2];
+	log_reader_t reader = { 0 };
+	int_fast32_t lines = 0;
+	int_fast16_t c, last = eol;
+	uint32_t pos = 0;
+
+	*end = 0;
+	*has_tail = false;
+
+	log_reader = &reader;
+	print_log_header(log_reader_compare_printf);
+	if (reader.mismatch || reader.error) {
+		return -1;
+	}
+	pos = reader.offset - (reader.size - reader.pos);
+
+	while ((c = log_reader_getc()) >= 0) {
+		if ((c < ' ' && c != '\t' && c != '\r' && c != '\n') || c == 0x7F || c == 0xFF) {
+			*has_tail = true;
+			break;
+		}
+		if (c == eol) {
+			++lines;
+		}
+		last = c;
+		++pos;
+	}
+	if (reader.error || last != eol) {
+		return -1;
+	}
+	*end = pos;
+
+	return lines;
+}
+#else // DO_LOG_RESUME
+static int_fast32_t count_log_file_lines(uint32_t *end, bool *has_tail) {
+	*end = 0;
+	*has_tail = false;
+	return -1;
+}
+#endif // DO_LOG_RESUME
+
+//
+// Update the log line size estimate from the file about to be rotated out
+// Only full files are counted so that the header doesn't skew the average much.
+static void measure_log_line_size(void) {
+#if DO_LOG_PREALLOCATION
+	uint32_t size;
+
+	if (lines_logged_this_file == LOG_LINES_PER_FILE && (size = output_file_position()) != 0) {
+		log_line_size = (size + (LOG_LINES_PER_FILE - 1)) / LOG_LINES_PER_FILE;
+	}
+#endif
+	return;
+}
+//
+// Set aside enough space for a full log file so that it can be written
+// sequentially
+// Failure isn't an error, the file just grows as needed the same as it would
+// without this.
+static void reserve_log_file(void) {
+#if DO_LOG_PREALLOCATION
+	// The extra line is room for the header
+	if (reserve_output_file(log_line_size * (LOG_LINES_PER_FILE + 1)) != ERR_OK) {
+		LOGGER("Failed to reserve space for log file");
+	}
+#endif
+	return;
+}
+
+//
+// Call cb() once for each column of a log line, in order
+// 'index' is the reading number for sensor readings and 0 otherwise
+static void describe_log_columns(void (*pf)(const char *format, ...), log_column_cb_t cb) {
+	cb(pf, LOG_COLUMN_TIME, "Time", 0);
+	cb(pf, LOG_COLUMN_WARNINGS, "Warnings", 0);
 
 #if USE_SENSORS
 	for (SENSOR_INDEX_T i = 0, si = 0; i < SENSOR_COUNT; ++i) {
@@ -863,9 +1912,9 @@ void print_log_header(void (*pf)(const char *format, ...)) {
 		name[6] = '0' + i%10;
 #endif
 
-		pf("\t%s_status", name);
+		cb(pf, LOG_COLUMN_SENSOR_STATUS, name, 0);
 		for (uint8_t ri = 0; ri < sensor_reading_count[si]; ++ri) {
-			pf("\t%s_reading_%u", name, (uint )ri);
+			cb(pf, LOG_COLUMN_SENSOR_READING, name, ri);
 		}
 		++si;
 	}
@@ -883,7 +1932,7 @@ void print_log_header(void (*pf)(const char *format, ...)) {
 		name[5] = '0' + i/10;
 		name[6] = '0' + i%10;
 # endif
-		pf("\t%s_status", name);
+		cb(pf, LOG_COLUMN_CONTROLLER_STATUS, name, 0);
 	}
 #endif
 
@@ -899,24 +1948,58 @@ void print_log_header(void (*pf)(const char *format, ...)) {
 		name[5] = '0' + i/10;
 		name[6] = '0' + i%10;
 # endif
-		pf("\t%s_status", name);
+		cb(pf, LOG_COLUMN_ACTUATOR_STATUS, name, 0);
 # if USE_ACTUATOR_STATUS_CHANGE_TIME
-		pf("\t%s_last_status_change", name);
+		cb(pf, LOG_COLUMN_ACTUATOR_STATUS_CHANGE_TIME, name, 0);
 # endif
 # if USE_ACTUATOR_ON_TIME_COUNT
-		pf("\t%s_on_time", name);
+		cb(pf, LOG_COLUMN_ACTUATOR_ON_TIME, name, 0);
 # endif
 # if USE_ACTUATOR_STATUS_CHANGE_COUNT
-		pf("\t%s_status_change_count", name);
+		cb(pf, LOG_COLUMN_ACTUATOR_STATUS_CHANGE_COUNT, name, 0);
 # endif
 	}
 #endif
 
 	const char *extra = print_header_extra();
 	if (extra != NULL) {
-		pf("\t%s", extra);
+		cb(pf, LOG_COLUMN_EXTRA, extra, 0);
+	}
+
+	return;
+}
+static void print_header_column(void (*pf)(const char *format, ...), log_column_t column, const char *name, uint_fast8_t index) {
+	switch (column) {
+	case LOG_COLUMN_TIME:
+		pf("# %s", name);
+		break;
+	case LOG_COLUMN_SENSOR_STATUS:
+	case LOG_COLUMN_CONTROLLER_STATUS:
+	case LOG_COLUMN_ACTUATOR_STATUS:
+		pf("\t%s_status", name);
+		break;
+	case LOG_COLUMN_SENSOR_READING:
+		pf("\t%s_reading_%u", name, (uint )index);
+		break;
+	case LOG_COLUMN_ACTUATOR_STATUS_CHANGE_TIME:
+		pf("\t%s_last_status_change", name);
+		break;
+	case LOG_COLUMN_ACTUATOR_ON_TIME:
+		pf("\t%s_on_time", name);
+		break;
+	case LOG_COLUMN_ACTUATOR_STATUS_CHANGE_COUNT:
+		pf("\t%s_status_change_count", name);
+		break;
+	default:
+		pf("\t%s", name);
+		break;
 	}
 
+	return;
+}
+void print_log_header(void (*pf)(const char *format, ...)) {
+	describe_log_columns(pf, print_header_column);
+
 	pf("%s", line_end);
 	// This needs to be split to fit in the buffer for F()
 	pf(F("# Warnings: B=battery low, V=Vcc low, S=sensor warning, C=controller warning, "));
@@ -924,9 +2007,250 @@ void print_log_header(void (*pf)(const char *format, ...)) {
 
 	return;
 }
+
+#if LOG_FORMAT_BINARY
+//
+// Binary log format
+//
+// The file is a sequence of records, each starting with a one-byte type and
+// ending with a CRC-16/CCITT-FALSE of every preceding byte in the record.
+// Multi-byte values are stored in the byte order of the logging device, which
+// the header records so that the decoder can tell.
+//
+// Header record:
+//    'H' "GHM" version:u8 byte_order:u16 (always 0x0102) time_format:u8
+//    year_0:u16 flags:u8 invalid_value:str no_value:str line_end:str
+//    warning_flags:str
+//    Then one entry per column: type:u8 size:u8 index:u8 name:str
+//    Then LOG_COLUMN_END:u8 crc:u16
+// Line record:
+//    'L' Then each column from the header in order, each 'size' bytes
+//    Then extra_size:u8 (LOG_BINARY_NO_EXTRA if there's no extra) extra
+//    Then crc:u16
+//
+// Strings are NUL-terminated. Status columns begin with a byte of
+// LOG_BINARY_FLAG_* flags followed by the status value, if there is one.
+// Sensor reading columns are the value followed by a byte with the reading type.
+#define LOG_BINARY_VERSION 1U
+#define LOG_BINARY_RECORD_HEADER 'H'
+#define LOG_BINARY_RECORD_LINE   'L'
+#define LOG_BINARY_NO_EXTRA 0xFFU
+
+#define LOG_BINARY_FLAG_INITIALIZED 0x01U
+#define LOG_BINARY_FLAG_ERROR       0x02U
+
+#define LOG_BINARY_HEADER_FLAG_SENSOR_TYPE 0x01U
+
+static uint16_t binary_crc;
+
+static void lwrite(const void *data, uint_fast8_t size) {
+	const uint8_t *d = data;
+
+	binary_crc = crc16_ccitt(binary_crc, d, size);
+	lprint_bytes(d, size);
+
+	return;
+}
+static void lwrite_u8(uint8_t c) {
+	lwrite(&c, 1);
+	return;
+}
+static void lwrite_str(const char *s) {
+	do {
+		lwrite_u8((uint8_t )*s);
+	} while (*s++ != 0);
+
+	return;
+}
+static void lwrite_begin(uint8_t record_type) {
+	binary_crc = 0xFFFFU;
+	lwrite_u8(record_type);
+	return;
+}
+static void lwrite_end(void) {
+	// The CRC of the CRC isn't needed, so copy it before it changes
+	const uint16_t crc = binary_crc;
+
+	lwrite(&crc, sizeof(crc));
+	return;
+}
+static uint8_t binary_status_flags(uint8_t status_flags, uint8_t initialized, uint8_t error) {
+	uint8_t flags = 0;
+
+	if (BIT_IS_SET(status_flags, initialized)) {
+		flags |= LOG_BINARY_FLAG_INITIALIZED;
+	}
+	if (BIT_IS_SET(status_flags, error)) {
+		flags |= LOG_BINARY_FLAG_ERROR;
+	}
+
+	return flags;
+}
+
+static void write_binary_header_column(void (*pf)(const char *format, ...), log_column_t column, const char *name, uint_fast8_t index) {
+	uint8_t size;
+
+	UNUSED(pf);
+
+	switch (column) {
+	case LOG_COLUMN_TIME:
+	case LOG_COLUMN_ACTUATOR_STATUS_CHANGE_TIME:
+	case LOG_COLUMN_ACTUATOR_ON_TIME:
+		size = sizeof(utime_t);
+		break;
+	case LOG_COLUMN_WARNINGS:
+		size = sizeof(uint8_t);
+		break;
+#if USE_SENSORS
+	case LOG_COLUMN_SENSOR_STATUS:
+# if USE_SENSOR_STATUS
+		size = 1 + sizeof(SENSOR_STATUS_T);
+# else
+		size = 1;
+# endif
+		break;
+	case LOG_COLUMN_SENSOR_READING:
+		size = sizeof(SENSOR_READING_T) + 1;
+		break;
+#endif
+#if USE_CONTROLLERS
+	case LOG_COLUMN_CONTROLLER_STATUS:
+# if USE_CONTROLLER_STATUS
+		size = 1 + sizeof(CONTROLLER_STATUS_T);
+# else
+		size = 1;
+# endif
+		break;
+#endif
+#if USE_ACTUATORS
+	case LOG_COLUMN_ACTUATOR_STATUS:
+		size = 1 + sizeof(ACTUATOR_STATUS_T);
+		break;
+# if USE_ACTUATOR_STATUS_CHANGE_COUNT
+	case LOG_COLUMN_ACTUATOR_STATUS_CHANGE_COUNT:
+		size = sizeof(uint_t);
+		break;
+# endif
+#endif
+	default:
+		// The extra field is stored separately at the end of the line
+		size = 0;
+		break;
+	}
+
+	lwrite_u8((uint8_t )column);
+	lwrite_u8(size);
+	lwrite_u8((uint8_t )index);
+	lwrite_str(name);
+
+	return;
+}
+static void write_binary_log_header(void) {
+	static FMEM_STORAGE const char magic[] = "GHM";
+	static FMEM_STORAGE const char warning_flags[] = GHMON_WARNING_FLAGS;
+	const uint16_t byte_order = 0x0102U;
+	const uint16_t year_0 = TIME_YEAR_0;
+
+	lwrite_begin(LOG_BINARY_RECORD_HEADER);
+	lwrite(FROM_FSTR(magic), SIZEOF_ARRAY(magic) - 1);
+	lwrite_u8(LOG_BINARY_VERSION);
+	lwrite(&byte_order, sizeof(byte_order));
+	lwrite_u8(LOG_TIME_FORMAT);
+	lwrite(&year_0, sizeof(year_0));
+	lwrite_u8((LOG_PRINT_SENSOR_TYPE) ? LOG_BINARY_HEADER_FLAG_SENSOR_TYPE : 0);
+	lwrite_str(invalid_value);
+	lwrite_str(no_value);
+	lwrite_str(line_end);
+	lwrite_str(FROM_FSTR(warning_flags));
+
+	describe_log_columns(NULL, write_binary_header_column);
+	lwrite_u8(LOG_COLUMN_END);
+	lwrite_end();
+
+	return;
+}
+static void write_binary_log_line(log_line_buffer_t *line, const char *extra) {
+	lwrite_begin(LOG_BINARY_RECORD_LINE);
+	lwrite(&line->system_time, sizeof(line->system_time));
+	lwrite_u8(line->ghmon_warnings);
+
+#if USE_SENSORS
+	const sensor_reading_t *r = LOG_LINE_READINGS(line);
+	for (SENSOR_INDEX_T si = 0; si < sensor_count; ++si) {
+		const sensor_log_buffer_t *s = &LOG_LINE_SENSORS(line)[si];
+
+		lwrite_u8(binary_status_flags(s->status_flags, SENSOR_STATUS_FLAG_INITIALIZED, SENSOR_STATUS_FLAG_ERROR));
+# if USE_SENSOR_STATUS
+		lwrite(&s->status, sizeof(s->status));
+# endif
+		for (uint_fast8_t ri = 0; ri < sensor_reading_count[si]; ++ri, ++r) {
+			lwrite(&r->value, sizeof(r->value));
+			lwrite_u8(r->type);
+		}
+	}
+#endif
+
+#if USE_CONTROLLERS
+	for (CONTROLLER_INDEX_T si = 0; si < controller_count; ++si) {
+		const controller_log_buffer_t *c = &LOG_LINE_CONTROLLERS(line)[si];
+
+		lwrite_u8(binary_status_flags(c->status_flags, CONTROLLER_STATUS_FLAG_INITIALIZED, CONTROLLER_STATUS_FLAG_ERROR));
+# if USE_CONTROLLER_STATUS
+		lwrite(&c->status, sizeof(c->status));
+# endif
+	}
+#endif
+
+#if USE_ACTUATORS
+	for (ACTUATOR_INDEX_T si = 0; si < actuator_count; ++si) {
+		const actuator_log_buffer_t *a = &LOG_LINE_ACTUATORS(line)[si];
+
+		lwrite_u8(binary_status_flags(a->status_flags, ACTUATOR_STATUS_FLAG_INITIALIZED, ACTUATOR_STATUS_FLAG_ERROR));
+		lwrite(&a->status, sizeof(a->status));
+# if USE_ACTUATOR_STATUS_CHANGE_TIME
+		lwrite(&a->status_change_time, sizeof(a->status_change_time));
+# endif
+# if USE_ACTUATOR_ON_TIME_COUNT
+		lwrite(&a->on_time_seconds, sizeof(a->on_time_seconds));
+# endif
+# if USE_ACTUATOR_STATUS_CHANGE_COUNT
+		lwrite(&a->status_change_count, sizeof(a->status_change_count));
+# endif
+	}
+#endif
+
+	if (extra != NULL) {
+		uint_fast8_t len = 0;
+
+		while (extra[len] != 0 && len < (LOG_BINARY_NO_EXTRA - 1)) {
+			++len;
+		}
+		lwrite_u8((uint8_t )len);
+		lwrite(extra, len);
+	} else {
+		lwrite_u8(LOG_BINARY_NO_EXTRA);
+	}
+	lwrite_end();
+
+	return;
+}
+#endif // LOG_FORMAT_BINARY
+
+static void store_log_line(log_line_buffer_t *line, const char *extra) {
+#if LOG_FORMAT_BINARY
+	write_binary_log_line(line, extra);
+#else
+	print_log_line(lprintf, line, extra);
+#endif
+	return;
+}
 static void write_log_header(void) {
 	LOGGER("Writing log header");
+#if LOG_FORMAT_BINARY
+	write_binary_log_header();
+#else
 	print_log_header(lprintf);
+#endif
 	return;
 }
 
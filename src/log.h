@@ -52,6 +52,10 @@ void print_log_header(void (*pf)(const char *format, ...));
 // Print the buffered log using pf()
 // This includes previously-written entries
 void print_log(void (*pf)(const char *format, ...));
+//
+// Print whatever log the output device keeps in internal storage using pf()
+// Returns ERR_NOTSUP if there's no such storage.
+err_t print_log_storage(void (*pf)(const char *format, ...));
 
 #else // !USE_LOGGING
 # define log_init()   ((void )0U)
@@ -59,6 +63,7 @@ void print_log(void (*pf)(const char *format, ...));
 # define write_log_to_storage(_f_) ((void )0U)
 # define print_log_header(...) ((void )0U)
 # define print_log(...) ((void )0U)
+# define print_log_storage(...) (ERR_NOTSUP)
 #endif // USE_LOGGING
 
 #endif // _LOG_H
@@ -27,6 +27,10 @@
 #include "sensors.h"
 #include "controllers.h"
 #include "log.h"
+#include "schedule.h"
+#include "simulation.h"
+#include "profile.h"
+#include "retain.h"
 
 #if RTC_CORRECTION_PERIOD_MINUTES < 0
 # error "RTC_CORRECTION_PERIOD_MINUTES must be >= 0"
@@ -55,18 +59,53 @@ typedef enum {
 static volatile uint_fast8_t ghmon_IRQs = 0;
 uint_fast8_t ghmon_warnings = 0;
 
-static utime_t log_alarm = 0;
-static utime_t status_alarm = 0;
-static utime_t deskew_alarm = 0;
-static utime_t fine_deskew_alarm = 0;
+//
+// Alarms due at the same time are handled in this order
+typedef enum {
+	ALARM_LOG = 0,
+	ALARM_STATUS,
+	ALARM_DESKEW,
+	ALARM_FINE_DESKEW,
+	ALARM_COUNT
+} ghmon_alarm_t;
+static const char *alarm_reasons[ALARM_COUNT] = {
+	"Write log",
+	"Update status",
+	"Deskew clock (coarse)",
+	"Deskew clock (fine)",
+};
+static const uint8_t alarm_wake_reasons[ALARM_COUNT] = {
+	PROFILE_WAKE_LOG,
+	PROFILE_WAKE_STATUS,
+	PROFILE_WAKE_DESKEW,
+	PROFILE_WAKE_FINE_DESKEW,
+};
+
+static schedule_entry_t alarm_heap[ALARM_COUNT];
+static uint8_t alarm_positions[ALARM_COUNT];
+static schedule_t alarms = {
+	.heap = alarm_heap,
+	.position = alarm_positions,
+	.count = 0,
+	.size = ALARM_COUNT,
+};
 static utime_t next_wakeup;
+static profile_wake_reason_t next_wakeup_reason;
+#if USE_RETAINED_MEMORY
+//
+// The alarm times are kept across resets so that the schedule isn't started
+// over from scratch
+static utime_t *retained_alarms = NULL;
+#endif
 
 static utime_t set_alarms(bool force);
+static void restore_alarms(void);
+static void save_alarms(void);
 static void check_warnings(void);
 static void update_warnings(void);
 static void deskew_clock(int_fast16_t correction);
 static inline utime_t calculate_alarm(const utime_t now, const utime_t period);
-static inline utime_t correct_deskew_alarm(const utime_t now, const utime_t alarm, const utime_t period, const int_fast16_t correction);
+static inline utime_t calculate_deskew_alarm(const utime_t now, const utime_t period, const int_fast16_t correction);
 
 #if USE_CTRL_BUTTON
 # include "ctrl_button.h"
@@ -83,6 +122,8 @@ static inline utime_t correct_deskew_alarm(const utime_t now, const utime_t alar
 int main(void) {
 	platform_init();
 	early_init_hook();
+	sim_init();
+	profile_init();
 
 #if USE_STATUS_LED
 # if uHAL_USE_HIGH_LEVEL_GPIO
@@ -106,6 +147,7 @@ int main(void) {
 #if USE_LOGGING
 	log_init();
 #endif
+	restore_alarms();
 	next_wakeup = set_alarms(false);
 
 	late_init_hook();
@@ -127,8 +169,11 @@ int main(void) {
 			// a very short period to compensate. It's not a big problem, but just the
 			// same deliberately setting the wake alarm for 1 second later will mostly
 			// fix that at the cost of a few (~10?) bytes of program memory.
+			profile_sleep();
 			hibernate_s((next_wakeup - now), HIBERNATE_DEEP, uHAL_CFG_ALLOW_INTERRUPTS);
 			//hibernate_s((next_wakeup - now)+1, HIBERNATE_DEEP, uHAL_CFG_ALLOW_INTERRUPTS);
+			profile_wake((ghmon_IRQs != 0) ? PROFILE_WAKE_IRQ : next_wakeup_reason);
+			sim_wakeup();
 
 			// Clear the status *after* hibernation so that we wake instantly if we
 			// recieved an interrupt while something besides sleep was happening
@@ -183,31 +228,33 @@ int main(void) {
 		early_loop_hook();
 
 		now = NOW();
-		if (DO_CLOCK_DESKEW && (deskew_alarm > 0) && (now >= deskew_alarm)) {
+		if (DO_CLOCK_DESKEW && schedule_is_due(&alarms, ALARM_DESKEW, now)) {
 			deskew_clock(RTC_CORRECTION_SECONDS);
 			now = NOW();
-			deskew_alarm = calculate_alarm(now, RTC_CORRECTION_PERIOD_MINUTES * SECONDS_PER_MINUTE);
-			deskew_alarm = correct_deskew_alarm(now, deskew_alarm, RTC_CORRECTION_PERIOD_MINUTES * SECONDS_PER_MINUTE, RTC_CORRECTION_SECONDS);
+			schedule_set(&alarms, ALARM_DESKEW, calculate_deskew_alarm(now, RTC_CORRECTION_PERIOD_MINUTES * SECONDS_PER_MINUTE, RTC_CORRECTION_SECONDS));
 		}
-		if (DO_FINE_CLOCK_DESKEW && (fine_deskew_alarm > 0) && (now >= fine_deskew_alarm)) {
+		if (DO_FINE_CLOCK_DESKEW && schedule_is_due(&alarms, ALARM_FINE_DESKEW, now)) {
 			deskew_clock(RTC_FINE_CORRECTION_SECONDS);
 			now = NOW();
-			fine_deskew_alarm = calculate_alarm(now, RTC_FINE_CORRECTION_PERIOD_MINUTES * SECONDS_PER_MINUTE);
-			fine_deskew_alarm = correct_deskew_alarm(now, fine_deskew_alarm, RTC_FINE_CORRECTION_PERIOD_MINUTES * SECONDS_PER_MINUTE, RTC_FINE_CORRECTION_SECONDS);
+			schedule_set(&alarms, ALARM_FINE_DESKEW, calculate_deskew_alarm(now, RTC_FINE_CORRECTION_PERIOD_MINUTES * SECONDS_PER_MINUTE, RTC_FINE_CORRECTION_SECONDS));
 		}
 
+		uint_fast32_t profile_start = profile_begin();
 		run_common_controllers(do_controllers, force_controllers);
+		profile_end(PROFILE_CONTROLLERS, profile_start);
 
-		if (do_status || ((status_alarm > 0) && (now >= status_alarm))) {
+		if (do_status || schedule_is_due(&alarms, ALARM_STATUS, now)) {
 			check_warnings();
 
-			status_alarm = calculate_alarm(now+1, STATUS_CHECK_MINUTES * SECONDS_PER_MINUTE);
+			schedule_set(&alarms, ALARM_STATUS, calculate_alarm(now+1, STATUS_CHECK_MINUTES * SECONDS_PER_MINUTE));
 		}
 
 		if (USE_LOGGING) {
-			if (do_log || ((log_alarm > 0) && (now >= log_alarm))) {
+			if (do_log || schedule_is_due(&alarms, ALARM_LOG, now)) {
+				profile_start = profile_begin();
 				log_status();
-				log_alarm = calculate_alarm(now+1, LOG_APPEND_MINUTES * SECONDS_PER_MINUTE);
+				profile_end(PROFILE_LOG, profile_start);
+				schedule_set(&alarms, ALARM_LOG, calculate_alarm(now+1, LOG_APPEND_MINUTES * SECONDS_PER_MINUTE));
 			}
 
 			if (force_sync) {
@@ -240,7 +287,9 @@ static inline utime_t calculate_alarm(const utime_t now, const utime_t period) {
 	next = SNAP_TO_FACTOR(next, period);
 	return next;
 }
-static inline utime_t correct_deskew_alarm(const utime_t now, const utime_t alarm, const utime_t period, const int_fast16_t correction) {
+static inline utime_t calculate_deskew_alarm(const utime_t now, const utime_t period, const int_fast16_t correction) {
+	utime_t alarm = calculate_alarm(now, period);
+
 	//
 	// Without this check, a negative correction may be applied repeatedly.
 	if ((correction < 0) && (alarm <= (now + -correction))) {
@@ -250,23 +299,29 @@ static inline utime_t correct_deskew_alarm(const utime_t now, const utime_t alar
 }
 static utime_t set_alarms(bool force) {
 	utime_t now, next, test;
-	char *reason = "Unknown";
+	uint_fast8_t id;
+	const char *reason = "Unknown";
+	profile_wake_reason_t wake_reason = PROFILE_WAKE_TIMEOUT;
 
 	now = NOW();
-	if (USE_LOGGING && (LOG_APPEND_MINUTES > 0) && ((log_alarm == 0) || force)) {
-		log_alarm = calculate_alarm(now, LOG_APPEND_MINUTES * SECONDS_PER_MINUTE);
+	//
+	// Forcing a reschedule drops every pending alarm so that none of them
+	// are left pointing at a time that's no longer meaningful
+	if (force) {
+		schedule_clear(&alarms);
 	}
-	if ((STATUS_CHECK_MINUTES > 0) && ((status_alarm == 0) || force)) {
-		status_alarm = calculate_alarm(now, STATUS_CHECK_MINUTES * SECONDS_PER_MINUTE);
+	if (USE_LOGGING && (LOG_APPEND_MINUTES > 0) && (schedule_get(&alarms, ALARM_LOG) == 0)) {
+		schedule_set(&alarms, ALARM_LOG, calculate_alarm(now, LOG_APPEND_MINUTES * SECONDS_PER_MINUTE));
+	}
+	if ((STATUS_CHECK_MINUTES > 0) && (schedule_get(&alarms, ALARM_STATUS) == 0)) {
+		schedule_set(&alarms, ALARM_STATUS, calculate_alarm(now, STATUS_CHECK_MINUTES * SECONDS_PER_MINUTE));
 	}
 
-	if (DO_CLOCK_DESKEW && ((deskew_alarm == 0) || force)) {
-		deskew_alarm = calculate_alarm(now, RTC_CORRECTION_PERIOD_MINUTES * SECONDS_PER_MINUTE);
-		deskew_alarm = correct_deskew_alarm(now, deskew_alarm, RTC_CORRECTION_PERIOD_MINUTES * SECONDS_PER_MINUTE, RTC_CORRECTION_SECONDS);
+	if (DO_CLOCK_DESKEW && (schedule_get(&alarms, ALARM_DESKEW) == 0)) {
+		schedule_set(&alarms, ALARM_DESKEW, calculate_deskew_alarm(now, RTC_CORRECTION_PERIOD_MINUTES * SECONDS_PER_MINUTE, RTC_CORRECTION_SECONDS));
 	}
-	if (DO_FINE_CLOCK_DESKEW && ((fine_deskew_alarm == 0) || force)) {
-		fine_deskew_alarm = calculate_alarm(now, RTC_FINE_CORRECTION_PERIOD_MINUTES * SECONDS_PER_MINUTE);
-		fine_deskew_alarm = correct_deskew_alarm(now, fine_deskew_alarm, RTC_FINE_CORRECTION_PERIOD_MINUTES * SECONDS_PER_MINUTE, RTC_FINE_CORRECTION_SECONDS);
+	if (DO_FINE_CLOCK_DESKEW && (schedule_get(&alarms, ALARM_FINE_DESKEW) == 0)) {
+		schedule_set(&alarms, ALARM_FINE_DESKEW, calculate_deskew_alarm(now, RTC_FINE_CORRECTION_PERIOD_MINUTES * SECONDS_PER_MINUTE, RTC_FINE_CORRECTION_SECONDS));
 	}
 	calculate_common_controller_alarms(force);
 
@@ -275,28 +330,22 @@ static utime_t set_alarms(bool force) {
 	if (wake_alarm != 0 && next > wake_alarm) {
 		next = wake_alarm;
 		reason = "General wake alarm";
+		wake_reason = PROFILE_WAKE_ALARM;
 	}
-	if ((log_alarm != 0) && (next > log_alarm)) {
-		next = log_alarm;
-		reason = "Write log";
-	}
-	if ((status_alarm != 0) && (next > status_alarm)) {
-		next = status_alarm;
-		reason = "Update status";
-	}
-	if (DO_CLOCK_DESKEW && (deskew_alarm != 0) && (next > deskew_alarm)) {
-		next = deskew_alarm;
-		reason = "Deskew clock (coarse)";
-	}
-	if (DO_FINE_CLOCK_DESKEW && (fine_deskew_alarm != 0) && (next > fine_deskew_alarm)) {
-		next = fine_deskew_alarm;
-		reason = "Deskew clock (fine)";
+	test = schedule_peek(&alarms, &id);
+	if ((test != 0) && (next > test)) {
+		next = test;
+		reason = alarm_reasons[id];
+		wake_reason = alarm_wake_reasons[id];
 	}
 	test = find_next_common_controller_alarm();
 	if (test > 0 && test < next) {
 		next = test;
 		reason = "Run controllers";
+		wake_reason = PROFILE_WAKE_CONTROLLERS;
 	}
+	next_wakeup_reason = wake_reason;
+	save_alarms();
 
 	long diff = (next > now) ? (long )(next - now) : -((long )(now - next));
 	LOGGER("Next alarm in %ld seconds: %s", diff, reason);
@@ -307,6 +356,64 @@ static utime_t set_alarms(bool force) {
 	return next;
 }
 
+#if USE_RETAINED_MEMORY
+static utime_t alarm_period(uint_fast8_t id) {
+	switch (id) {
+	case ALARM_LOG:
+		return LOG_APPEND_MINUTES * SECONDS_PER_MINUTE;
+	case ALARM_STATUS:
+		return STATUS_CHECK_MINUTES * SECONDS_PER_MINUTE;
+	case ALARM_DESKEW:
+		return RTC_CORRECTION_PERIOD_MINUTES * SECONDS_PER_MINUTE;
+	case ALARM_FINE_DESKEW:
+		return RTC_FINE_CORRECTION_PERIOD_MINUTES * SECONDS_PER_MINUTE;
+	}
+
+	return 0;
+}
+#endif
+static void restore_alarms(void) {
+#if USE_RETAINED_MEMORY
+	utime_t now;
+	bool restored;
+
+	retained_alarms = retain_region(RETAIN_ALARMS, sizeof(*retained_alarms) * ALARM_COUNT, &restored);
+	if ((retained_alarms == NULL) || !restored) {
+		return;
+	}
+
+	now = NOW();
+	for (uint_fast8_t id = 0; id < ALARM_COUNT; ++id) {
+		utime_t alarm = retained_alarms[id];
+
+		//
+		// An alarm more than a period away means the clock went backwards
+		// during the reset, so leave that one for set_alarms() to work out
+		// Alarms that came due during the reset are handled right away.
+		if ((alarm != 0) && (alarm <= (now + alarm_period(id)))) {
+			schedule_set(&alarms, id, alarm);
+		}
+	}
+	LOGGER("Restored %u alarms", (uint )alarms.count);
+#endif // USE_RETAINED_MEMORY
+
+	return;
+}
+static void save_alarms(void) {
+#if USE_RETAINED_MEMORY
+	if (retained_alarms == NULL) {
+		return;
+	}
+
+	for (uint_fast8_t id = 0; id < ALARM_COUNT; ++id) {
+		retained_alarms[id] = schedule_get(&alarms, id);
+	}
+	retain_sync(retained_alarms);
+#endif // USE_RETAINED_MEMORY
+
+	return;
+}
+
 static void deskew_clock(int_fast16_t correction) {
 	err_t res = ERR_OK;
 	utime_t now;
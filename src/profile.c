@@ -0,0 +1,322 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// profile.c
+// Keep track of where the time spent awake goes
+// NOTES:
+//   Awake periods are timed with the microsecond counter, which is restarted
+//   on every wakeup and turned off before sleeping because some platforms
+//   share its timer with the sleep alarm. Where the counter can't track its
+//   own overflows a single period longer than the counter's range will be
+//   under-counted.
+//
+//   Time asleep is measured in whole seconds with the uptime counter, or the
+//   system clock if that's unavailable.
+//
+//   The per-sensor totals and the strings which depend on the number of
+//   sensors are allocated once by profile_init().
+//
+#include "profile.h"
+
+#if USE_PROFILING
+
+#include "sensors.h"
+
+#include "ulib/include/halloc.h"
+
+#if ! uHAL_USE_USCOUNTER
+# error "USE_PROFILING requires uHAL_USE_USCOUNTER"
+#endif
+
+#if uHAL_USE_UPTIME
+# define PROFILE_NOW() (get_uptime())
+#else
+# define PROFILE_NOW() (NOW())
+#endif
+
+static FMEM_STORAGE const char phase_names[PROFILE_PHASE_COUNT][12] = {
+	"awake",
+	"controllers",
+	"sensors",
+	"log",
+	"storage",
+};
+static FMEM_STORAGE const char wake_reason_names[PROFILE_WAKE_REASON_COUNT][12] = {
+	"timeout",
+	"wake_alarm",
+	"log",
+	"status",
+	"deskew",
+	"fine_deskew",
+	"controllers",
+	"interrupt",
+};
+
+#if USE_SENSOR_NAME
+# define SENSOR_COLUMN_NAME_LEN DEVICE_NAME_LEN
+#else
+# define SENSOR_COLUMN_NAME_LEN 7U // "sens_XX"
+#endif
+// Each number is at most 10 digits plus a separator
+#define SUMMARY_COLUMN_LEN 11U
+
+static profile_totals_t totals;
+static bool counting = false;
+static utime_t sleep_begin = 0;
+// Indexed like SENSORS[]
+static profile_time_t *sensor_times = NULL;
+static char *summary_buf = NULL;
+static char *log_columns = NULL;
+
+
+static void start_counter(void) {
+	counting = ((uscounter_on() == ERR_OK) && (uscounter_start() == ERR_OK));
+
+	return;
+}
+static void add_time(profile_time_t *t, uint_fast32_t us) {
+	uint_fast32_t total_us = t->us + us;
+
+	t->ms += total_us / 1000U;
+	t->us = total_us % 1000U;
+	if (us > t->max_us) {
+		t->max_us = us;
+	}
+	++t->count;
+
+	return;
+}
+
+//
+// Copy a string without the trailing NUL, returning the next position
+static char* append_str(char *s, const char *src) {
+	while (*src != 0) {
+		*s++ = *src++;
+	}
+
+	return s;
+}
+static void init_log_columns(void) {
+	char *s;
+
+	log_columns = halloc(sizeof(PROFILE_LOG_COLUMNS) + ((size_t )SENSOR_COUNT * (SENSOR_COLUMN_NAME_LEN + 4U)));
+	s = append_str(log_columns, PROFILE_LOG_COLUMNS);
+#if USE_SENSORS
+	for (SENSOR_INDEX_T i = 0; i < SENSOR_COUNT; ++i) {
+# if USE_SENSOR_NAME
+		const char *name = FROM_FSTR(SENSORS[i].name);
+# else
+		char name[] = "sens_XX";
+		name[5] = '0' + i/10;
+		name[6] = '0' + i%10;
+# endif
+		*s++ = '\t';
+		s = append_str(s, name);
+		s = append_str(s, "_ms");
+	}
+#endif
+	*s = 0;
+
+	return;
+}
+
+void profile_init(void) {
+	if (SENSOR_COUNT > 0) {
+		sensor_times = halloc((size_t )SENSOR_COUNT * sizeof(*sensor_times));
+	}
+	summary_buf = halloc((PROFILE_PHASE_COUNT + 2U + (size_t )SENSOR_COUNT) * SUMMARY_COLUMN_LEN);
+	init_log_columns();
+
+	profile_reset();
+	start_counter();
+
+	return;
+}
+void profile_reset(void) {
+	mem_init(&totals, 0, sizeof(totals));
+	if (sensor_times != NULL) {
+		mem_init(sensor_times, 0, (size_t )SENSOR_COUNT * sizeof(*sensor_times));
+	}
+	totals.start_time = PROFILE_NOW();
+
+	return;
+}
+uint_fast32_t profile_begin(void) {
+	return (counting) ? uscounter_read() : 0;
+}
+void profile_end(profile_phase_t phase, uint_fast32_t begin) {
+	assert(phase < PROFILE_PHASE_COUNT);
+
+	if (counting) {
+		add_time(&totals.phases[phase], uscounter_read() - begin);
+	}
+
+	return;
+}
+void profile_end_sensor(SENSOR_INDEX_T i, uint_fast32_t begin) {
+	assert(i < SENSOR_COUNT);
+
+	if (counting) {
+		uint_fast32_t us = uscounter_read() - begin;
+
+		add_time(&totals.phases[PROFILE_SENSORS], us);
+		add_time(&sensor_times[i], us);
+	}
+
+	return;
+}
+void profile_sleep(void) {
+	if (counting) {
+		// The counter was started when we woke up
+		add_time(&totals.phases[PROFILE_AWAKE], uscounter_stop());
+		uscounter_off();
+		counting = false;
+	}
+	sleep_begin = PROFILE_NOW();
+
+	return;
+}
+void profile_wake(profile_wake_reason_t reason) {
+	assert(reason < PROFILE_WAKE_REASON_COUNT);
+
+	utime_t now = PROFILE_NOW();
+	if (now > sleep_begin) {
+		totals.sleep_seconds += now - sleep_begin;
+	}
+	++totals.wakeups[reason];
+	start_counter();
+
+	return;
+}
+
+const profile_totals_t* profile_get_totals(void) {
+	return &totals;
+}
+const profile_time_t* profile_get_sensor_time(SENSOR_INDEX_T i) {
+	assert(i < SENSOR_COUNT);
+
+	return &sensor_times[i];
+}
+void profile_get_summary(profile_summary_t *summary) {
+	assert(summary != NULL);
+
+	for (uiter_t i = 0; i < PROFILE_PHASE_COUNT; ++i) {
+		summary->ms[i] = totals.phases[i].ms;
+	}
+	summary->sleep_seconds = totals.sleep_seconds;
+	summary->wakeups = 0;
+	for (uiter_t i = 0; i < PROFILE_WAKE_REASON_COUNT; ++i) {
+		summary->wakeups += totals.wakeups[i];
+	}
+	if (SENSOR_COUNT > 0) {
+		if (summary->sensor_ms == NULL) {
+			summary->sensor_ms = halloc((size_t )SENSOR_COUNT * sizeof(*summary->sensor_ms));
+		}
+		for (SENSOR_INDEX_T i = 0; i < SENSOR_COUNT; ++i) {
+			summary->sensor_ms[i] = sensor_times[i].ms;
+		}
+	}
+
+	return;
+}
+
+//
+// Print a number followed by a separator, returning the next position
+static char* append_uint32(char *s, uint32_t n, char sep) {
+	char digits[10];
+	uint_fast8_t i = 0;
+
+	do {
+		digits[i++] = (char )('0' + (n % 10U));
+		n /= 10U;
+	} while (n != 0);
+	while (i > 0) {
+		*s++ = digits[--i];
+	}
+	*s++ = sep;
+
+	return s;
+}
+const char* profile_summary_to_cstring(const profile_summary_t *summary) {
+	char *s = summary_buf;
+
+	assert(summary != NULL);
+
+	for (uiter_t i = 0; i < PROFILE_PHASE_COUNT; ++i) {
+		s = append_uint32(s, summary->ms[i], '\t');
+	}
+	s = append_uint32(s, summary->sleep_seconds, '\t');
+	s = append_uint32(s, summary->wakeups, (SENSOR_COUNT > 0) ? '\t' : 0);
+	for (SENSOR_INDEX_T i = 0; i < SENSOR_COUNT; ++i) {
+		s = append_uint32(s, summary->sensor_ms[i], (i < (SENSOR_COUNT - 1)) ? '\t' : 0);
+	}
+
+	return summary_buf;
+}
+const char* profile_log_columns(void) {
+	return log_columns;
+}
+
+//
+// Print the totals of a single phase or sensor
+static void print_time(void (*pf)(const char *format, ...), const char *name, const profile_time_t *t) {
+	uint32_t avg_us = 0;
+
+	if (t->count > 0) {
+		// Good enough for an average, which is all this is
+		avg_us = ((t->ms / t->count) * 1000U) + ((((t->ms % t->count) * 1000U) + t->us) / t->count);
+	}
+	pf("   %s: %lu.%03u ms in %lu periods, average %lu us, longest %lu us\r\n",
+		name, (long unsigned )t->ms, (uint )t->us, (long unsigned )t->count,
+		(long unsigned )avg_us, (long unsigned )t->max_us);
+
+	return;
+}
+
+void profile_print(void (*pf)(const char *format, ...)) {
+	assert(pf != NULL);
+
+	pf("Profile over %lu seconds, %lu asleep\r\n", (long unsigned )(PROFILE_NOW() - totals.start_time), (long unsigned )totals.sleep_seconds);
+	for (uiter_t i = 0; i < PROFILE_PHASE_COUNT; ++i) {
+		print_time(pf, FROM_FSTR(phase_names[i]), &totals.phases[i]);
+	}
+#if USE_SENSORS
+	if (SENSOR_COUNT > 0) {
+		pf("Sensors:\r\n");
+	}
+	for (SENSOR_INDEX_T i = 0; i < SENSOR_COUNT; ++i) {
+# if USE_SENSOR_NAME
+		print_time(pf, FROM_FSTR(SENSORS[i].name), &sensor_times[i]);
+# else
+		char name[] = "sens_XX";
+		name[5] = '0' + i/10;
+		name[6] = '0' + i%10;
+		print_time(pf, name, &sensor_times[i]);
+# endif
+	}
+#endif
+	pf("Wakeups:\r\n");
+	for (uiter_t i = 0; i < PROFILE_WAKE_REASON_COUNT; ++i) {
+		pf("   %s: %lu\r\n", FROM_FSTR(wake_reason_names[i]), (long unsigned )totals.wakeups[i]);
+	}
+
+	return;
+}
+
+#endif // USE_PROFILING
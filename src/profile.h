@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// profile.h
+// Keep track of where the time spent awake goes
+// NOTES:
+//   Phases can overlap; sensors read by controllers are counted both as
+//   sensor time and controller time, and storage time is included in the log
+//   time when the log is written by log_status().
+//
+//   Each sensor's read() is also timed on its own; batched ADC sampling is
+//   shared by several sensors, so it's only counted in the sensor total.
+//
+//   Profiling takes over the microsecond counter, so nothing else should use
+//   it while USE_PROFILING is set.
+//
+
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include "common.h"
+
+//
+// Phases of a loop iteration which are timed
+typedef enum {
+	PROFILE_AWAKE = 0,   // Everything between waking up and going back to sleep
+	PROFILE_CONTROLLERS, // run_common_controllers()
+	PROFILE_SENSORS,     // Sensor read() functions and batched ADC sampling
+	PROFILE_LOG,         // log_status()
+	PROFILE_STORAGE,     // Opening and closing log storage
+	PROFILE_PHASE_COUNT
+} profile_phase_t;
+//
+// Reasons for waking up, as chosen when the alarm was set
+typedef enum {
+	PROFILE_WAKE_TIMEOUT = 0,  // Nothing was due within the default sleep period
+	PROFILE_WAKE_ALARM,        // The general wake alarm
+	PROFILE_WAKE_LOG,          // Write the log
+	PROFILE_WAKE_STATUS,       // Update the status
+	PROFILE_WAKE_DESKEW,       // Coarse clock deskew
+	PROFILE_WAKE_FINE_DESKEW,  // Fine clock deskew
+	PROFILE_WAKE_CONTROLLERS,  // Run controllers
+	PROFILE_WAKE_IRQ,          // Woken early by an interrupt
+	PROFILE_WAKE_REASON_COUNT
+} profile_wake_reason_t;
+
+//
+// The columns printed by profile_summary_to_cstring() ahead of the per-sensor
+// columns, which are added by profile_log_columns()
+#define PROFILE_LOG_COLUMNS "awake_ms\tcontrollers_ms\tsensors_ms\tlog_ms\tstorage_ms\tsleep_s\twakeups"
+
+#if USE_PROFILING
+
+//
+// Accumulated time for a single phase
+typedef struct {
+	uint32_t ms;     // Whole milliseconds
+	uint16_t us;     // Microseconds left over from ms
+	uint32_t max_us; // The longest single period
+	uint32_t count;  // The number of periods
+} profile_time_t;
+//
+// Everything tracked since the last reset
+typedef struct {
+	profile_time_t phases[PROFILE_PHASE_COUNT];
+	uint32_t wakeups[PROFILE_WAKE_REASON_COUNT];
+	utime_t sleep_seconds;
+	utime_t start_time;
+} profile_totals_t;
+//
+// The cumulative totals in a form small enough to keep for each log line
+typedef struct {
+	uint32_t ms[PROFILE_PHASE_COUNT];
+	uint32_t sleep_seconds;
+	uint32_t wakeups;
+	// The time spent in each sensor's read(), indexed like SENSORS[]
+	// This is allocated by the first call to profile_get_summary().
+	uint32_t *sensor_ms;
+} profile_summary_t;
+
+//
+// Reset the totals and start timing the current awake period
+void profile_init(void);
+//
+// Reset the totals
+void profile_reset(void);
+//
+// Get the start time of a phase, to be passed to profile_end()
+uint_fast32_t profile_begin(void);
+//
+// Add the time since profile_begin() to a phase
+void profile_end(profile_phase_t phase, uint_fast32_t begin);
+//
+// Add the time since profile_begin() to a sensor and to PROFILE_SENSORS
+void profile_end_sensor(SENSOR_INDEX_T i, uint_fast32_t begin);
+//
+// Note that the device is about to sleep
+void profile_sleep(void);
+//
+// Note that the device has woken up
+void profile_wake(profile_wake_reason_t reason);
+//
+// Get the current totals
+const profile_totals_t* profile_get_totals(void);
+//
+// Get the accumulated time of a sensor
+const profile_time_t* profile_get_sensor_time(SENSOR_INDEX_T i);
+//
+// Get a summary of the current totals
+void profile_get_summary(profile_summary_t *summary);
+//
+// Print a summary as tab-separated columns matching PROFILE_LOG_COLUMNS
+// The returned string is overwritten by the next call.
+const char* profile_summary_to_cstring(const profile_summary_t *summary);
+//
+// Get the names of the columns printed by profile_summary_to_cstring()
+// This is PROFILE_LOG_COLUMNS followed by '<sensor>_ms' for each sensor.
+const char* profile_log_columns(void);
+//
+// Print the totals using pf()
+void profile_print(void (*pf)(const char *format, ...));
+
+#else // !USE_PROFILING
+INLINE void profile_init(void) {
+	return;
+}
+INLINE void profile_reset(void) {
+	return;
+}
+INLINE uint_fast32_t profile_begin(void) {
+	return 0;
+}
+INLINE void profile_end(profile_phase_t phase, uint_fast32_t begin) {
+	UNUSED(phase);
+	UNUSED(begin);
+	return;
+}
+INLINE void profile_end_sensor(SENSOR_INDEX_T i, uint_fast32_t begin) {
+	UNUSED(i);
+	UNUSED(begin);
+	return;
+}
+INLINE void profile_sleep(void) {
+	return;
+}
+INLINE void profile_wake(profile_wake_reason_t reason) {
+	UNUSED(reason);
+	return;
+}
+#endif // USE_PROFILING
+
+#endif // _PROFILE_H
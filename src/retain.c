@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// retain.c
+// Keep state in RAM across resets
+// NOTES:
+//
+#include "retain.h"
+
+#if USE_RETAINED_MEMORY
+
+#include "ulib/include/util.h"
+
+#define RETAIN_MAGIC 0x4847U // 'GH'
+//
+// Regions are aligned to this many bytes, which get_retained_memory() also
+// guarantees for the block
+#define RETAIN_ALIGN 8U
+#define RETAIN_ROUND_UP(_n_) (((_n_) + (RETAIN_ALIGN - 1U)) & ~(RETAIN_ALIGN - 1U))
+//
+// Each region is checked in blocks of this many bytes so that a change only
+// costs the CRC of the blocks it touches
+#define RETAIN_BLOCK_BYTES 64U
+#define RETAIN_BLOCKS(_size_) (((_size_) + (RETAIN_BLOCK_BYTES - 1U)) / RETAIN_BLOCK_BYTES)
+
+//
+// The region follows the header and the CRCs of its blocks follow the region
+// The header's CRC covers the block CRCs.
+typedef struct {
+	uint16_t magic;
+	uint16_t size;
+	uint16_t crc;
+	uint8_t  id;
+	uint8_t  reserved;
+} retain_header_t;
+
+static uint_fast16_t retain_used = 0;
+
+static uint16_t* block_crcs(retain_header_t *header) {
+	return (uint16_t *)((uint8_t *)&header[1] + RETAIN_ROUND_UP(header->size));
+}
+static uint16_t calculate_block_crc(const retain_header_t *header, uint_fast16_t block) {
+	const uint8_t *region = (const uint8_t *)&header[1];
+	uint_fast16_t offset = block * RETAIN_BLOCK_BYTES;
+
+	return crc16_ccitt(0xFFFFU, &region[offset], MIN(RETAIN_BLOCK_BYTES, header->size - offset));
+}
+static uint16_t calculate_header_crc(retain_header_t *header) {
+	return crc16_ccitt(0xFFFFU, (const uint8_t *)block_crcs(header), RETAIN_BLOCKS(header->size) * sizeof(uint16_t));
+}
+static bool region_is_intact(retain_header_t *header) {
+	const uint16_t *crcs = block_crcs(header);
+
+	if (header->crc != calculate_header_crc(header)) {
+		return false;
+	}
+	for (uint_fast16_t i = 0; i < RETAIN_BLOCKS(header->size); ++i) {
+		if (crcs[i] != calculate_block_crc(header, i)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+static void sync_blocks(retain_header_t *header, uint_fast16_t first, uint_fast16_t last) {
+	uint16_t *crcs = block_crcs(header);
+
+	for (uint_fast16_t i = first; i <= last; ++i) {
+		crcs[i] = calculate_block_crc(header, i);
+	}
+	header->crc = calculate_header_crc(header);
+
+	return;
+}
+
+void* retain_region(retain_id_t id, uint_fast16_t size, bool *restored) {
+	uint8_t *block = get_retained_memory();
+	uint_fast16_t need;
+	retain_header_t *header;
+	uint8_t *region;
+
+	assert(restored != NULL);
+	assert(size > 0);
+
+	*restored = false;
+	need = sizeof(*header) + RETAIN_ROUND_UP(size) + RETAIN_ROUND_UP(RETAIN_BLOCKS(size) * sizeof(uint16_t));
+	if ((RETAINED_MEMORY_BYTES - retain_used) < need) {
+		LOGGER("Not enough retained memory for region %u (%u bytes)", (uint )id, (uint )size);
+		return NULL;
+	}
+
+	header = (retain_header_t *)&block[retain_used];
+	region = (uint8_t *)&header[1];
+	retain_used += need;
+
+	if ((header->magic == RETAIN_MAGIC) && (header->id == id) && (header->size == size) && region_is_intact(header)) {
+		*restored = true;
+	} else {
+		header->magic = RETAIN_MAGIC;
+		header->id = id;
+		header->size = (uint16_t )size;
+		mem_init(region, 0, size);
+		sync_blocks(header, 0, (uint_fast16_t )(RETAIN_BLOCKS(size) - 1U));
+	}
+
+	return region;
+}
+
+void retain_sync(void *region) {
+	retain_header_t *header = (retain_header_t *)region - 1;
+
+	assert(region != NULL);
+
+	sync_blocks(header, 0, (uint_fast16_t )(RETAIN_BLOCKS(header->size) - 1U));
+
+	return;
+}
+void retain_sync_range(void *region, const void *start, uint_fast16_t size) {
+	retain_header_t *header = (retain_header_t *)region - 1;
+	uint_fast16_t offset;
+
+	assert(region != NULL);
+	assert((const uint8_t *)start >= (const uint8_t *)region);
+
+	if (size == 0) {
+		return;
+	}
+	offset = (uint_fast16_t )((const uint8_t *)start - (const uint8_t *)region);
+	assert((offset + size) <= header->size);
+
+	sync_blocks(header, offset / RETAIN_BLOCK_BYTES, (uint_fast16_t )((offset + size - 1U) / RETAIN_BLOCK_BYTES));
+
+	return;
+}
+
+#endif // USE_RETAINED_MEMORY
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// retain.h
+// Keep state in RAM across resets
+// NOTES:
+//   The retained memory block is handed out in regions in the order they're
+//   asked for. Each region has a small header with its id, size, and a CRC of
+//   its contents, and is only considered to have survived the reset if all of
+//   those match; otherwise it's zeroed. Since the layout depends on the order
+//   of the requests, they have to be made the same way on every boot.
+//
+//   The CRC has to be updated with retain_sync() after the region is changed.
+//   A reset between changing a region and syncing it discards the region.
+//   The CRC is kept for every 64 bytes of the region, so when only part of a
+//   large region changes retain_sync_range() can update just that part.
+//
+#ifndef _RETAIN_H
+#define _RETAIN_H
+
+#include "common.h"
+
+#define USE_RETAINED_MEMORY (RETAINED_MEMORY_BYTES > 0)
+
+//
+// Identifiers for the users of the retained memory
+typedef enum {
+	RETAIN_LOG = 1,    // The log buffer
+	RETAIN_ALARMS,     // The main loop alarms
+	RETAIN_LOG_CURSOR, // Where the log file on the SD card ends
+} retain_id_t;
+
+#if USE_RETAINED_MEMORY
+//
+// Reserve the next 'size' bytes of retained memory for 'id'
+// Returns NULL if there's not enough room left. 'restored' is set to true if
+// the region is intact from before the reset, otherwise the region is zeroed.
+void* retain_region(retain_id_t id, uint_fast16_t size, bool *restored);
+//
+// Update the CRC of a region returned by retain_region() after changing it
+void retain_sync(void *region);
+//
+// Update the CRC of the 'size' bytes at 'start' in a region returned by
+// retain_region() after changing them
+// The rest of the region has to be unchanged since the last sync.
+void retain_sync_range(void *region, const void *start, uint_fast16_t size);
+
+#else // !USE_RETAINED_MEMORY
+INLINE void* retain_region(retain_id_t id, uint_fast16_t size, bool *restored) {
+	UNUSED(id);
+	UNUSED(size);
+	*restored = false;
+	return NULL;
+}
+INLINE void retain_sync(void *region) {
+	UNUSED(region);
+	return;
+}
+INLINE void retain_sync_range(void *region, const void *start, uint_fast16_t size) {
+	UNUSED(region);
+	UNUSED(start);
+	UNUSED(size);
+	return;
+}
+#endif // USE_RETAINED_MEMORY
+
+#endif // _RETAIN_H
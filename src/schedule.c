@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// schedule.c
+// Keep track of upcoming alarms
+// NOTES:
+//
+#include "schedule.h"
+
+#include "ulib/include/util.h"
+
+
+#define ENTRY_BEFORE(_a_, _b_) (((_a_).time < (_b_).time) || (((_a_).time == (_b_).time) && ((_a_).id < (_b_).id)))
+
+static void place_entry(schedule_t *sched, uint_fast8_t i, schedule_entry_t entry) {
+	sched->heap[i] = entry;
+	sched->position[entry.id] = i + 1U;
+
+	return;
+}
+static void sift_up(schedule_t *sched, uint_fast8_t i) {
+	schedule_entry_t entry = sched->heap[i];
+
+	while (i > 0) {
+		uint_fast8_t parent = (i - 1U) / 2U;
+
+		if (!ENTRY_BEFORE(entry, sched->heap[parent])) {
+			break;
+		}
+		place_entry(sched, i, sched->heap[parent]);
+		i = parent;
+	}
+	place_entry(sched, i, entry);
+
+	return;
+}
+static void sift_down(schedule_t *sched, uint_fast8_t i) {
+	schedule_entry_t entry = sched->heap[i];
+	uint_fast8_t count = sched->count;
+
+	while (true) {
+		uint_fast8_t child = (i * 2U) + 1U;
+
+		if (child >= count) {
+			break;
+		}
+		if (((child + 1U) < count) && ENTRY_BEFORE(sched->heap[child + 1U], sched->heap[child])) {
+			++child;
+		}
+		if (!ENTRY_BEFORE(sched->heap[child], entry)) {
+			break;
+		}
+		place_entry(sched, i, sched->heap[child]);
+		i = child;
+	}
+	place_entry(sched, i, entry);
+
+	return;
+}
+static void remove_at(schedule_t *sched, uint_fast8_t i) {
+	sched->position[sched->heap[i].id] = 0;
+	--sched->count;
+	if (i == sched->count) {
+		return;
+	}
+
+	//
+	// Fill the hole with the last entry and let it find its place, which may
+	// be in either direction
+	place_entry(sched, i, sched->heap[sched->count]);
+	if ((i > 0) && ENTRY_BEFORE(sched->heap[i], sched->heap[(i - 1U) / 2U])) {
+		sift_up(sched, i);
+	} else {
+		sift_down(sched, i);
+	}
+
+	return;
+}
+
+void schedule_set(schedule_t *sched, uint_fast8_t id, utime_t time) {
+	assert(sched != NULL);
+	assert(id < sched->size);
+
+	if (!SKIP_SAFETY_CHECKS && (id >= sched->size)) {
+		return;
+	}
+	if (time == 0) {
+		schedule_cancel(sched, id);
+		return;
+	}
+
+	uint_fast8_t pos = sched->position[id];
+	if (pos == 0) {
+		pos = sched->count;
+		++sched->count;
+		sched->heap[pos] = (schedule_entry_t ){ .time = time, .id = id };
+		sift_up(sched, pos);
+	} else {
+		utime_t old_time = sched->heap[pos - 1U].time;
+
+		sched->heap[pos - 1U].time = time;
+		if (time < old_time) {
+			sift_up(sched, pos - 1U);
+		} else {
+			sift_down(sched, pos - 1U);
+		}
+	}
+
+	return;
+}
+void schedule_cancel(schedule_t *sched, uint_fast8_t id) {
+	assert(sched != NULL);
+	assert(id < sched->size);
+
+	if (!SKIP_SAFETY_CHECKS && (id >= sched->size)) {
+		return;
+	}
+
+	uint_fast8_t pos = sched->position[id];
+	if (pos != 0) {
+		remove_at(sched, pos - 1U);
+	}
+
+	return;
+}
+void schedule_clear(schedule_t *sched) {
+	assert(sched != NULL);
+
+	for (uiter_t i = 0; i < sched->count; ++i) {
+		sched->position[sched->heap[i].id] = 0;
+	}
+	sched->count = 0;
+
+	return;
+}
+utime_t schedule_get(const schedule_t *sched, uint_fast8_t id) {
+	assert(sched != NULL);
+	assert(id < sched->size);
+
+	if (!SKIP_SAFETY_CHECKS && (id >= sched->size)) {
+		return 0;
+	}
+
+	uint_fast8_t pos = sched->position[id];
+	return (pos != 0) ? sched->heap[pos - 1U].time : 0;
+}
+utime_t schedule_peek(const schedule_t *sched, uint_fast8_t *id) {
+	assert(sched != NULL);
+
+	if (sched->count == 0) {
+		return 0;
+	}
+	if (id != NULL) {
+		*id = sched->heap[0].id;
+	}
+	return sched->heap[0].time;
+}
+int_fast16_t schedule_pop_due(schedule_t *sched, utime_t now) {
+	assert(sched != NULL);
+
+	if ((sched->count == 0) || (sched->heap[0].time > now)) {
+		return -1;
+	}
+
+	uint_fast8_t id = sched->heap[0].id;
+	remove_at(sched, 0);
+
+	return id;
+}
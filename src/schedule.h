@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// schedule.h
+// Keep track of upcoming alarms
+// NOTES:
+//   A schedule is a binary min-heap of (time, id) pairs plus a table mapping
+//   each id to its place in the heap, so that the earliest alarm can be found
+//   in constant time and any alarm can be set, moved, or cancelled in
+//   O(log n) time without searching for it.
+//
+//   Alarms due at the same time are ordered by id.
+//
+//   The storage belongs to the user of the schedule; the position table must
+//   be zeroed before use, which static storage already is.
+//
+#ifndef _SCHEDULE_H
+#define _SCHEDULE_H
+
+#include "common.h"
+
+//
+// A single scheduled alarm
+typedef struct {
+	utime_t time;
+	uint8_t id;
+} schedule_entry_t;
+//
+// A set of alarms
+typedef struct {
+	//
+	// The heap itself, with room for at least 'size' entries
+	schedule_entry_t *heap;
+	//
+	// The position of each id in the heap, plus one; 0 means the id isn't
+	// scheduled
+	// Must have room for 'size' entries.
+	uint8_t *position;
+	//
+	// The number of alarms currently scheduled
+	uint8_t count;
+	//
+	// The number of ids managed by the schedule
+	// Ids range from 0 to (size-1) and can't be more than 255.
+	uint8_t size;
+} schedule_t;
+
+//
+// Set the alarm for an id, replacing any existing one
+// If time is 0, the alarm is cancelled.
+void schedule_set(schedule_t *sched, uint_fast8_t id, utime_t time);
+//
+// Cancel the alarm for an id
+void schedule_cancel(schedule_t *sched, uint_fast8_t id);
+//
+// Cancel all alarms
+void schedule_clear(schedule_t *sched);
+//
+// Get the alarm time for an id, or 0 if it's not scheduled
+utime_t schedule_get(const schedule_t *sched, uint_fast8_t id);
+//
+// Get the time of the earliest alarm, or 0 if nothing is scheduled
+// If id isn't NULL, it's set to the id of that alarm.
+utime_t schedule_peek(const schedule_t *sched, uint_fast8_t *id);
+//
+// Remove the earliest alarm if it's due at or before 'now'
+// Returns the id of the alarm or -1 if nothing is due.
+int_fast16_t schedule_pop_due(schedule_t *sched, utime_t now);
+
+//
+// Check if an alarm is due at or before 'now'
+INLINE bool schedule_is_due(const schedule_t *sched, uint_fast8_t id, utime_t now) {
+	utime_t time = schedule_get(sched, id);
+	return ((time != 0) && (time <= now));
+}
+
+
+#endif // _SCHEDULE_H
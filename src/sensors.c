@@ -25,6 +25,7 @@
 #if USE_SENSORS
 
 #include "sensors.h"
+#include "profile.h"
 
 #include "ulib/include/math.h"
 #include "ulib/include/util.h"
@@ -108,7 +109,19 @@ SENSOR_READING_T find_sensor_value_by_type(SENSOR_CFG_STORAGE sensor_cfg_t *cfg,
 	return SENSOR_BAD_VALUE;
 }
 
-SENSOR_READING_T read_sensor(SENSOR_CFG_STORAGE sensor_cfg_t *cfg, sensor_status_t *status, bool force_update, uint_fast8_t type) {
+static bool sensor_is_cooling_down(SENSOR_CFG_STORAGE sensor_cfg_t *cfg, sensor_status_t *status) {
+#if USE_SENSOR_COOLDOWN
+	utime_t now = NOW(), prev = status->previous_reading_time;
+
+	return ((prev != 0) && (prev <= now) && (prev + cfg->cooldown_seconds) > now);
+#else
+	UNUSED(cfg);
+	UNUSED(status);
+	return false;
+#endif
+}
+
+static SENSOR_READING_T _read_sensor(SENSOR_CFG_STORAGE sensor_cfg_t *cfg, sensor_status_t *status, bool force_update, uint_fast8_t type) {
 	sensor_reading_t *reading;
 
 	assert(cfg != NULL);
@@ -123,9 +136,7 @@ SENSOR_READING_T read_sensor(SENSOR_CFG_STORAGE sensor_cfg_t *cfg, sensor_status
 	}
 
 #if USE_SENSOR_COOLDOWN
-	utime_t now = NOW(), prev = status->previous_reading_time;
-
-	if (!force_update && (prev != 0) && (prev <= now) && (prev + cfg->cooldown_seconds) > now) {
+	if (!force_update && sensor_is_cooling_down(cfg, status)) {
 # if USE_SENSOR_NAME
 		LOGGER("Using previous reading of sensor %s", FROM_FSTR(cfg->name));
 # else
@@ -146,7 +157,9 @@ SENSOR_READING_T read_sensor(SENSOR_CFG_STORAGE sensor_cfg_t *cfg, sensor_status
 		return SENSOR_BAD_VALUE;
 	}
 
+	uint_fast32_t profile_start = profile_begin();
 	reading = cfg->read(cfg, status);
+	profile_end_sensor((SENSOR_INDEX_T )SENSOR_ID(status), profile_start);
 	if (reading == NULL) {
 		SET_BIT(status->status_flags, SENSOR_STATUS_FLAG_ERROR);
 		return SENSOR_BAD_VALUE;
@@ -161,6 +174,90 @@ SENSOR_READING_T read_sensor(SENSOR_CFG_STORAGE sensor_cfg_t *cfg, sensor_status
 END:
 	return find_sensor_value_by_type(cfg, status, type);
 }
+SENSOR_READING_T read_sensor(SENSOR_CFG_STORAGE sensor_cfg_t *cfg, sensor_status_t *status, bool force_update, uint_fast8_t type) {
+	SENSOR_READING_T value = _read_sensor(cfg, status, force_update, type);
+
+	// A sample is only good for the read it was taken for, if it wasn't used
+	// then it's stale now
+	CLEAR_BIT(status->status_flags, SENSOR_STATUS_FLAG_ADC_SAMPLED);
+
+	return value;
+}
+
+#if USE_SENSOR_ADC_BATCH
+void sample_common_adc_sensors(bool (*filter)(SENSOR_INDEX_T i)) {
+	gpio_pin_t pins[SIZEOF_ARRAY(SENSORS)];
+	adc_t values[SIZEOF_ARRAY(SENSORS)];
+	SENSOR_INDEX_T index[SIZEOF_ARRAY(SENSORS)];
+	uint_fast8_t n = 0;
+
+	for (SENSOR_INDEX_T i = 0; i < SENSOR_COUNT; ++i) {
+		SENSOR_CFG_STORAGE sensor_cfg_t *cfg = &SENSORS[i];
+		sensor_status_t *status = &sensors[i];
+
+		CLEAR_BIT(status->status_flags, SENSOR_STATUS_FLAG_ADC_SAMPLED);
+		//
+		// Uninitialized sensors may not have set their pin up yet and sensors
+		// which are cooling down aren't going to use the sample
+		if (!BIT_IS_SET(cfg->cfg_flags, SENSOR_CFG_FLAG_ADC) ||
+		    !BIT_IS_SET(status->status_flags, SENSOR_STATUS_FLAG_INITIALIZED) ||
+		    sensor_is_cooling_down(cfg, status) ||
+		    (filter != NULL && !filter(i))) {
+			continue;
+		}
+		pins[n] = cfg->pin;
+		index[n] = i;
+		++n;
+	}
+	if (n == 0) {
+		return;
+	}
+
+	uint_fast32_t profile_start = profile_begin();
+	power_acquire(POWER_DOMAIN_ADC);
+
+	// Any pin that couldn't be read is left for read() to try again on its own
+	adc_read_pins(pins, values, n);
+
+	power_release(POWER_DOMAIN_ADC);
+	profile_end(PROFILE_SENSORS, profile_start);
+
+	for (uiter_t i = 0; i < n; ++i) {
+		if (values[i] != ERR_ADC) {
+			sensor_status_t *status = &sensors[index[i]];
+
+			status->adc_value = values[i];
+			SET_BIT(status->status_flags, SENSOR_STATUS_FLAG_ADC_SAMPLED);
+		}
+	}
+
+	return;
+}
+#endif // USE_SENSOR_ADC_BATCH
+
+#if USE_SENSOR_CFG_PIN && uHAL_USE_ADC
+adc_t read_sensor_adc(SENSOR_CFG_STORAGE sensor_cfg_t *cfg, sensor_status_t *status) {
+	assert(cfg != NULL);
+	assert(status != NULL);
+
+#if USE_SENSOR_ADC_BATCH
+	if (BIT_IS_SET(status->status_flags, SENSOR_STATUS_FLAG_ADC_SAMPLED)) {
+		CLEAR_BIT(status->status_flags, SENSOR_STATUS_FLAG_ADC_SAMPLED);
+		return status->adc_value;
+	}
+#else
+	UNUSED(status);
+#endif
+
+	power_acquire(POWER_DOMAIN_ADC);
+
+	adc_t adc_value = adc_read_pin(cfg->pin);
+
+	power_release(POWER_DOMAIN_ADC);
+
+	return adc_value;
+}
+#endif // USE_SENSOR_CFG_PIN && uHAL_USE_ADC
 
 #if USE_SENSOR_NAME
 SENSOR_INDEX_T find_sensor_index_by_name(const char *name) {
@@ -43,6 +43,7 @@ typedef struct {
 typedef enum {
 	SENSOR_STATUS_FLAG_INITIALIZED = 0x01U, // Sensor successfully initialized
 	SENSOR_STATUS_FLAG_ERROR       = 0x02U, // Sensor in error state
+	SENSOR_STATUS_FLAG_ADC_SAMPLED = 0x04U, // .adc_value holds a sample not yet used by read()
 } sensor_status_flag_t;
 //
 // Status of a sensor
@@ -66,6 +67,12 @@ typedef struct {
 	// This is set and maintained by the sensor and only used externally for
 	// logging
 	SENSOR_STATUS_T status;
+#endif
+#if USE_SENSOR_ADC_BATCH
+	//
+	// The value of cfg->pin sampled by sample_common_adc_sensors()
+	// This is only valid while SENSOR_STATUS_FLAG_ADC_SAMPLED is set
+	adc_t adc_value;
 #endif
 	//
 	// Status flags
@@ -75,6 +82,7 @@ typedef struct {
 //
 // Configuration flags for sensor_cfg_t structs
 typedef enum {
+	SENSOR_CFG_FLAG_ADC   = 0x20U, // The reading is taken from cfg->pin with the ADC
 	SENSOR_CFG_FLAG_LOG   = 0x40U, // Log this sensor
 	SENSOR_CFG_FLAG_NOLOG = 0x80U, // Don't log this sensor
 } sensor_cfg_flag_t;
@@ -149,6 +157,20 @@ SENSOR_READING_T read_sensor_by_index(SENSOR_INDEX_T i, bool force_update, uint_
 // Initialization of the common sensors can be skipped if there's nothing in the
 // sensor initializers that needs to be run on startup
 void init_common_sensors(void);
+#if USE_SENSOR_ADC_BATCH
+//
+// Sample the pins of all the sensors with SENSOR_CFG_FLAG_ADC set in a single
+// pass of the ADC so that their next read() doesn't need to power it up
+// again
+// If filter isn't NULL, only sensors for which it returns true are sampled
+void sample_common_adc_sensors(bool (*filter)(SENSOR_INDEX_T i));
+#endif
+#if USE_SENSOR_CFG_PIN && uHAL_USE_ADC
+//
+// Get the ADC reading for cfg->pin, using the value taken by
+// sample_common_adc_sensors() if there is one
+adc_t read_sensor_adc(SENSOR_CFG_STORAGE sensor_cfg_t *cfg, sensor_status_t *status);
+#endif
 SENSOR_READING_T find_sensor_value_by_type(SENSOR_CFG_STORAGE sensor_cfg_t *cfg, sensor_status_t *status, uint_fast8_t type);
 SENSOR_INDEX_T find_sensor_index_by_name(const char *name);
 void check_common_sensor_warnings(void);
@@ -0,0 +1,462 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// simulation.c
+// Drive a host build with recorded data and report on the run
+// NOTES:
+//   The trace is read from the file named by the GHMON_SIM_TRACE environment
+//   variable. It's laid out like the text log: tab-separated columns, one
+//   line per point in time, and lines starting with '#' are comments except
+//   for the first one with a tab in it, which names the columns.
+//
+//   The first column is the time in any of the formats the log uses. Only
+//   the difference from the first line matters, so a trace can start at any
+//   time of day without the clock needing to be set to match.
+//
+//   A column named <sensor name>_adc holds raw ADC readings for the pin of
+//   that sensor; the reading is returned by adc_read_pin() from the time of
+//   its line until the next line. Every other column, and any value that
+//   isn't a number, is ignored so an edited log file can be used as a trace.
+//
+//   The converted readings in the log's '<sensor name>_reading_N' columns
+//   can't be replayed. Turning them back into ADC readings would need an
+//   inverse for each sensor's read function, which is arbitrary code in the
+//   instance configuration and often depends on other readings such as Vcc,
+//   so a log only becomes a usable trace once raw readings are added to it.
+//
+//   The run ends at the first wakeup after the time of the last line. The
+//   summary is printed to stderr when the program exits for any reason, so it
+//   also works with HOST_RUN_LIMIT_S and without a trace.
+//
+//   This is only ever built for the host, so it uses the C library freely.
+//
+#include "simulation.h"
+
+#if DO_SIMULATION
+
+#include "sensors.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define TRACE_ENV_VAR "GHMON_SIM_TRACE"
+#define TRACE_COLUMN_SUFFIX "_adc"
+#define TRACE_LINE_MAX 1024U
+#define MS_PER_DAY (SECONDS_PER_DAY * 1000.0)
+
+typedef struct {
+	uint32_t runs;
+	uint_fast64_t total_us;
+	uint_fast32_t max_us;
+} sim_controller_stats_t;
+
+typedef struct {
+	uint32_t switches;
+	uint_fast64_t on_ms;
+	uint_fast64_t on_since_ms;
+} sim_actuator_stats_t;
+
+static FILE *trace = NULL;
+static unsigned long trace_lineno = 0;
+static uint32_t trace_lines_applied = 0;
+// The pin driven by each column, or 0 if the column is ignored
+static gpio_pin_t *column_pins = NULL;
+static uint_fast16_t column_count = 0;
+// The next line to apply, which is due 'pending_s' seconds after the start
+static long *pending_values = NULL;
+static int_fast64_t pending_s = -1;
+static int_fast64_t first_s = -1;
+static int_fast64_t last_s = 0;
+
+static uint32_t wakeups = 0;
+#if USE_CONTROLLERS
+static sim_controller_stats_t *controller_stats = NULL;
+#endif
+#if USE_ACTUATORS
+static sim_actuator_stats_t *actuator_stats = NULL;
+#endif
+
+
+static int_fast64_t days_from_civil(int_fast64_t y, uint_fast8_t m, uint_fast8_t d) {
+	y -= (m <= 2);
+	const int_fast64_t era = ((y >= 0) ? y : y - 399) / 400;
+	const int_fast64_t yoe = y - (era * 400);
+	const int_fast64_t doy = ((153 * (m + ((m > 2) ? -3 : 9))) + 2) / 5 + d - 1;
+	const int_fast64_t doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;
+
+	return (era * 146097) + doe;
+}
+//
+// Convert any of the log's time formats to seconds
+// Returns -1 if the string can't be parsed.
+static int_fast64_t parse_time(const char *s) {
+	unsigned y, mo, d, h, mi, sec;
+	int n = 0;
+
+	if ((sscanf(s, "%u.%u.%u%*1[_ ]%u:%u:%u%n", &y, &mo, &d, &h, &mi, &sec, &n) == 6) && (s[n] == 0)) {
+		if ((mo < 1) || (mo > 12) || (d < 1) || (d > 31)) {
+			return -1;
+		}
+		return (days_from_civil(y, mo, d) * SECONDS_PER_DAY) + (h * SECONDS_PER_HOUR) + (mi * SECONDS_PER_MINUTE) + sec;
+	}
+
+	int_fast64_t total = 0;
+	bool have_digits = false;
+	uint_fast64_t value = 0;
+	for (; *s != 0; ++s) {
+		if ((*s >= '0') && (*s <= '9')) {
+			value = (value * 10U) + (uint_fast64_t )(*s - '0');
+			have_digits = true;
+			continue;
+		}
+		if (!have_digits) {
+			return -1;
+		}
+		switch (*s) {
+		case 'd':
+			value *= SECONDS_PER_DAY;
+			break;
+		case 'h':
+			value *= SECONDS_PER_HOUR;
+			break;
+		case 'm':
+			value *= SECONDS_PER_MINUTE;
+			break;
+		case 's':
+			break;
+		default:
+			return -1;
+		}
+		total += value;
+		value = 0;
+		have_digits = false;
+	}
+	// A bare number is just seconds; a trailing number after units isn't
+	// anything
+	if (have_digits) {
+		if (total != 0) {
+			return -1;
+		}
+		total = value;
+	}
+
+	return total;
+}
+//
+// Split a line at tabs in place and strip the line ending
+// Returns the number of fields found, up to max_fields.
+static uint_fast16_t split_line(char *line, char **fields, uint_fast16_t max_fields) {
+	uint_fast16_t count = 0;
+
+	line[strcspn(line, "\r\n")] = 0;
+	while ((count < max_fields) && (line != NULL)) {
+		fields[count++] = line;
+		if ((line = strchr(line, '\t')) != NULL) {
+			*line = 0;
+			++line;
+		}
+	}
+
+	return count;
+}
+//
+// Read the next non-comment line into the pending slot
+static void read_trace_line(void) {
+	char line[TRACE_LINE_MAX];
+	char *fields[TRACE_LINE_MAX / 2U];
+	uint_fast16_t count;
+
+	pending_s = -1;
+	while (fgets(line, sizeof(line), trace) != NULL) {
+		++trace_lineno;
+		if ((line[0] == '#') || (line[strspn(line, " \t\r\n")] == 0)) {
+			continue;
+		}
+
+		count = split_line(line, fields, SIZEOF_ARRAY(fields));
+		int_fast64_t t = parse_time(fields[0]);
+		if (t < 0) {
+			fprintf(stderr, "%s:%lu: can't parse time '%s', skipping line\n", TRACE_ENV_VAR, trace_lineno, fields[0]);
+			continue;
+		}
+		if (first_s < 0) {
+			first_s = t;
+		}
+		if (t < first_s) {
+			fprintf(stderr, "%s:%lu: time goes backwards, skipping line\n", TRACE_ENV_VAR, trace_lineno);
+			continue;
+		}
+
+		for (uiter_t i = 1; i < column_count; ++i) {
+			char *end;
+
+			pending_values[i] = -1;
+			if ((i >= count) || (column_pins[i] == 0)) {
+				continue;
+			}
+			long v = strtol(fields[i], &end, 10);
+			if ((end != fields[i]) && (*end == 0)) {
+				if (v < 0 || v > (long )ADC_MAX) {
+					fprintf(stderr, "%s:%lu: ADC value %ld out of range, clamping\n", TRACE_ENV_VAR, trace_lineno, v);
+					v = (v < 0) ? 0 : (long )ADC_MAX;
+				}
+				pending_values[i] = v;
+			}
+		}
+		pending_s = t - first_s;
+		last_s = pending_s;
+		return;
+	}
+
+	return;
+}
+//
+// Map the trace columns to sensor pins
+static void read_trace_header(void) {
+	char line[TRACE_LINE_MAX];
+	char *fields[TRACE_LINE_MAX / 2U];
+	bool found = false;
+
+	while (fgets(line, sizeof(line), trace) != NULL) {
+		++trace_lineno;
+		if ((line[0] == '#') && (strchr(line, '\t') != NULL)) {
+			found = true;
+			break;
+		}
+		if (line[0] != '#') {
+			break;
+		}
+	}
+	if (!found) {
+		fprintf(stderr, "%s: no column names found before line %lu\n", TRACE_ENV_VAR, trace_lineno);
+		exit(EXIT_FAILURE);
+	}
+
+	column_count = split_line(line, fields, SIZEOF_ARRAY(fields));
+	column_pins = calloc(column_count, sizeof(*column_pins));
+	pending_values = calloc(column_count, sizeof(*pending_values));
+	if ((column_pins == NULL) || (pending_values == NULL)) {
+		fprintf(stderr, "%s: out of memory\n", TRACE_ENV_VAR);
+		exit(EXIT_FAILURE);
+	}
+
+	uint_fast16_t used = 0;
+	for (uiter_t i = 1; i < column_count; ++i) {
+		char *name = fields[i];
+		size_t len = strlen(name);
+		const size_t suffix_len = sizeof(TRACE_COLUMN_SUFFIX) - 1U;
+
+		if ((len <= suffix_len) || (strcmp(&name[len - suffix_len], TRACE_COLUMN_SUFFIX) != 0)) {
+			continue;
+		}
+		name[len - suffix_len] = 0;
+
+#if USE_SENSOR_NAME && USE_SENSOR_CFG_PIN
+		SENSOR_INDEX_T si = find_sensor_index_by_name(name);
+		if (si < 0) {
+			fprintf(stderr, "%s: no sensor named '%s', ignoring column %u\n", TRACE_ENV_VAR, name, (uint )i + 1U);
+			continue;
+		}
+		if (!GPIO_PIN_IS_VALID(SENSORS[si].pin)) {
+			fprintf(stderr, "%s: sensor '%s' has no pin, ignoring column %u\n", TRACE_ENV_VAR, name, (uint )i + 1U);
+			continue;
+		}
+		column_pins[i] = SENSORS[si].pin;
+		++used;
+#else
+		fprintf(stderr, "%s: sensors can't be found by name in this build, ignoring column %u\n", TRACE_ENV_VAR, (uint )i + 1U);
+#endif
+	}
+	if (used == 0) {
+		fprintf(stderr, "%s: no usable columns, nothing will be replayed\n", TRACE_ENV_VAR);
+	}
+
+	return;
+}
+static void apply_due_lines(void) {
+	const int_fast64_t now_s = (int_fast64_t )(host_get_elapsed_ms() / 1000U);
+
+	if (trace == NULL) {
+		return;
+	}
+
+	while ((pending_s >= 0) && (pending_s <= now_s)) {
+		for (uiter_t i = 1; i < column_count; ++i) {
+			if (pending_values[i] >= 0) {
+				host_adc_set_pin(column_pins[i], (adc_t )pending_values[i]);
+			}
+		}
+		++trace_lines_applied;
+		read_trace_line();
+	}
+	if ((pending_s < 0) && (now_s > last_s)) {
+		fprintf(stderr, "Reached the end of the trace at %lus\n", (unsigned long )now_s);
+		exit(EXIT_SUCCESS);
+	}
+
+	return;
+}
+
+static void print_report(void) {
+	const uint_fast64_t elapsed_ms = host_get_elapsed_ms();
+	const uint_fast64_t awake_us = host_get_awake_us();
+	const double days = (elapsed_ms > 0) ? ((double )elapsed_ms / MS_PER_DAY) : 1.0;
+
+	fprintf(stderr, "Simulation summary\n");
+	fprintf(stderr, "  Simulated time:  %.2f days (%lus)\n", (double )elapsed_ms / MS_PER_DAY, (unsigned long )(elapsed_ms / 1000U));
+	if (trace != NULL) {
+		fprintf(stderr, "  Trace lines:     %lu\n", (unsigned long )trace_lines_applied);
+	}
+	fprintf(stderr, "  Wakeups:         %lu (%.1f per day)\n", (unsigned long )wakeups, (double )wakeups / days);
+	fprintf(stderr, "  Awake time:      %.3fs (%.3fs per day)\n", (double )awake_us / 1000000.0, ((double )awake_us / 1000000.0) / days);
+#if uHAL_USE_ADC
+	host_adc_stats_t adc;
+	host_adc_get_stats(&adc);
+	fprintf(stderr, "  ADC power-ups:   %lu (%.1f per day)\n", (unsigned long )adc.power_ups, (double )adc.power_ups / days);
+	fprintf(stderr, "  ADC conversions: %lu (%.1f per day)\n", (unsigned long )adc.conversions, (double )adc.conversions / days);
+#endif
+#if uHAL_USE_POWER_MANAGER
+	power_domain_stats_t pwr;
+# if uHAL_USE_ADC
+	power_get_stats(POWER_DOMAIN_ADC, &pwr);
+	fprintf(stderr, "  ADC power cycles saved: %lu (%.1f per day)\n", (unsigned long )pwr.cycles_saved, (double )pwr.cycles_saved / days);
+# endif
+# if uHAL_USE_SPI
+	power_get_stats(POWER_DOMAIN_SPI, &pwr);
+	fprintf(stderr, "  SPI power cycles saved: %lu (%.1f per day)\n", (unsigned long )pwr.cycles_saved, (double )pwr.cycles_saved / days);
+# endif
+#endif
+
+#if USE_CONTROLLERS
+	if (controller_stats != NULL) {
+		fprintf(stderr, "Controllers:   %12s %12s %12s\n", "runs", "total ms", "max ms");
+		for (CONTROLLER_INDEX_T i = 0; i < CONTROLLER_COUNT; ++i) {
+			sim_controller_stats_t *cs = &controller_stats[i];
+# if USE_CONTROLLER_NAME
+			fprintf(stderr, "  %-12s", FROM_FSTR(CONTROLLERS[i].name));
+# else
+			fprintf(stderr, "  %-12u", (uint )i);
+# endif
+			fprintf(stderr, "%12lu %12.3f %12.3f\n", (unsigned long )cs->runs, (double )cs->total_us / 1000.0, (double )cs->max_us / 1000.0);
+		}
+	}
+#endif
+#if USE_ACTUATORS
+	if (actuator_stats != NULL) {
+		fprintf(stderr, "Actuators:     %12s %12s %12s\n", "switches", "per day", "on time s");
+		for (ACTUATOR_INDEX_T i = 0; i < ACTUATOR_COUNT; ++i) {
+			sim_actuator_stats_t *as = &actuator_stats[i];
+			uint_fast64_t on_ms = as->on_ms;
+
+			if (actuators[i].status != 0) {
+				on_ms += elapsed_ms - as->on_since_ms;
+			}
+# if USE_ACTUATOR_NAME
+			fprintf(stderr, "  %-12s", FROM_FSTR(ACTUATORS[i].name));
+# else
+			fprintf(stderr, "  %-12u", (uint )i);
+# endif
+			fprintf(stderr, "%12lu %12.1f %12lu\n", (unsigned long )as->switches, (double )as->switches / days, (unsigned long )(on_ms / 1000U));
+		}
+	}
+#endif
+
+	return;
+}
+
+void sim_init(void) {
+	const char *path;
+
+#if USE_CONTROLLERS
+	controller_stats = calloc(CONTROLLER_COUNT, sizeof(*controller_stats));
+#endif
+#if USE_ACTUATORS
+	actuator_stats = calloc(ACTUATOR_COUNT, sizeof(*actuator_stats));
+#endif
+	atexit(print_report);
+
+	if ((path = getenv(TRACE_ENV_VAR)) == NULL) {
+		return;
+	}
+	if ((trace = fopen(path, "r")) == NULL) {
+		fprintf(stderr, "%s: can't open '%s'\n", TRACE_ENV_VAR, path);
+		exit(EXIT_FAILURE);
+	}
+	read_trace_header();
+	read_trace_line();
+	if (pending_s < 0) {
+		fprintf(stderr, "%s: '%s' has no data\n", TRACE_ENV_VAR, path);
+		exit(EXIT_FAILURE);
+	}
+	apply_due_lines();
+
+	return;
+}
+void sim_wakeup(void) {
+	++wakeups;
+	apply_due_lines();
+
+	return;
+}
+
+#if USE_CONTROLLERS
+void sim_note_controller_run(const controller_status_t *status, uint_fast32_t us) {
+	ptrdiff_t i = status - controllers;
+
+	// Non-common controllers aren't tracked
+	if ((controller_stats == NULL) || (i < 0) || (i >= CONTROLLER_COUNT)) {
+		return;
+	}
+
+	sim_controller_stats_t *cs = &controller_stats[i];
+	++cs->runs;
+	cs->total_us += us;
+	if (us > cs->max_us) {
+		cs->max_us = us;
+	}
+
+	return;
+}
+#endif
+
+#if USE_ACTUATORS
+void sim_note_actuator_change(const actuator_status_t *status, ACTUATOR_STATUS_T prev) {
+	ptrdiff_t i = status - actuators;
+	const uint_fast64_t now_ms = host_get_elapsed_ms();
+
+	// Non-common actuators aren't tracked
+	if ((actuator_stats == NULL) || (i < 0) || (i >= ACTUATOR_COUNT)) {
+		return;
+	}
+
+	sim_actuator_stats_t *as = &actuator_stats[i];
+	++as->switches;
+	if ((prev == 0) && (status->status != 0)) {
+		as->on_since_ms = now_ms;
+	} else if ((prev != 0) && (status->status == 0)) {
+		as->on_ms += now_ms - as->on_since_ms;
+	}
+
+	return;
+}
+#endif
+
+#endif // DO_SIMULATION
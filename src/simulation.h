@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPL-3.0-only
+/***********************************************************************
+*                                                                      *
+*                                                                      *
+* Copyright 2024 svijsv                                                *
+* This program is free software: you can redistribute it and/or modify *
+* it under the terms of the GNU General Public License as published by *
+* the Free Software Foundation, version 3.                             *
+*                                                                      *
+* This program is distributed in the hope that it will be useful, but  *
+* WITHOUT ANY WARRANTY; without even the implied warranty of           *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU    *
+* General Public License for more details.                             *
+*                                                                      *
+* You should have received a copy of the GNU General Public License    *
+* along with this program.  If not, see <http:// www.gnu.org/licenses/>.*
+*                                                                      *
+*                                                                      *
+***********************************************************************/
+// simulation.h
+// Drive a host build with recorded data and report on the run
+// NOTES:
+//   See simulation.c for the trace file format.
+//
+
+#ifndef _SIMULATION_H
+#define _SIMULATION_H
+
+#include "common.h"
+#include "actuators.h"
+#include "controllers.h"
+
+#if defined(HAVE_HOST) && HAVE_HOST && USE_SIMULATION
+# define DO_SIMULATION 1
+#else
+# define DO_SIMULATION 0
+#endif
+
+#if DO_SIMULATION
+
+//
+// Open the trace file and apply its first line
+// This should be called before sensors are initialized.
+void sim_init(void);
+//
+// Apply every line of the trace which has become due
+// This should be called each time the device wakes up.
+void sim_wakeup(void);
+# if USE_CONTROLLERS
+//
+// Note that a controller has been run for the given number of microseconds
+void sim_note_controller_run(const controller_status_t *status, uint_fast32_t us);
+# else
+#  define sim_note_controller_run(...)  ((void )0U)
+# endif
+# if USE_ACTUATORS
+//
+// Note that an actuator's status has changed
+void sim_note_actuator_change(const actuator_status_t *status, ACTUATOR_STATUS_T prev);
+# else
+#  define sim_note_actuator_change(...) ((void )0U)
+# endif
+
+#else // !DO_SIMULATION
+# define sim_init()   ((void )0U)
+# define sim_wakeup() ((void )0U)
+# define sim_note_controller_run(...)  ((void )0U)
+# define sim_note_actuator_change(...) ((void )0U)
+#endif // DO_SIMULATION
+
+#endif // _SIMULATION_H
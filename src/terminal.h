@@ -90,6 +90,29 @@ static int terminalcmd_write_log(const char *line_in) {
 }
 #endif
 
+#if USE_LOGGING
+static int terminalcmd_dump_log(const char *line_in) {
+	UNUSED(line_in);
+
+	if (print_log_storage(serial_printf) == ERR_NOTSUP) {
+		PUTS("No log storage to print\r\n", 0);
+	}
+	return 0;
+}
+#endif
+
+#if USE_PROFILING
+static int terminalcmd_profile(const char *line_in) {
+	if (cstring_eqz("reset", NEXT_TOK(line_in, ' '))) {
+		profile_reset();
+		PUTS("Profile reset\r\n", 0);
+	} else {
+		profile_print(serial_printf);
+	}
+	return 0;
+}
+#endif
+
 static int terminalcmd_reset(const char *line_in) {
 	UNUSED(line_in);
 
@@ -109,6 +132,12 @@ FMEM_STORAGE const terminal_cmd_t terminal_extra_cmds[] = {
 #if USE_LOGGING && LOG_LINE_BUFFER_COUNT > 0
 	{ terminalcmd_play_log,    "play_log",    8 },
 	{ terminalcmd_write_log,   "write_log",   9 },
+#endif
+#if USE_LOGGING
+	{ terminalcmd_dump_log,    "dump_log",    8 },
+#endif
+#if USE_PROFILING
+	{ terminalcmd_profile,     "profile",     7 },
 #endif
 	{ terminalcmd_reset,       "reset",       5 },
 	{ NULL, {0}, 0 },
@@ -124,6 +153,12 @@ FMEM_STORAGE const char terminal_extra_help[] =
 "   play_log          - Print the log buffer\r\n"
 "   write_log [force] - Write the log buffer to storage\r\n"
 #endif
+#if USE_LOGGING
+"   dump_log          - Print the log kept in internal storage\r\n"
+#endif
+#if USE_PROFILING
+"   profile [reset]   - Print or reset the wake time profile\r\n"
+#endif
 "   reset             - Reset the device\r\n"
 ;
 
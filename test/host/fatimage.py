@@ -0,0 +1,155 @@
+#!/usr/bin/python3
+#
+# Create and inspect the FAT16 images used by the host tests
+# Only what the tests need is supported: a single volume without a partition
+# table, 8.3 names in the root directory, and 512-byte sectors.
+#
+import struct
+import sys
+import argparse
+
+SECTOR_BYTES = 512
+ROOT_ENTRIES = 512
+RESERVED_SECTORS = 1
+FAT_COUNT = 2
+
+FAT_FREE = 0x0000
+FAT_EOC  = 0xFFF8
+
+class ImageError(Exception):
+	pass
+
+def create(path, mib=32, cluster_sectors=4):
+	total = (mib * 1024 * 1024) // SECTOR_BYTES
+	root_sectors = (ROOT_ENTRIES * 32) // SECTOR_BYTES
+	# Over-estimate the FAT size by ignoring the sectors it takes itself
+	clusters = (total - RESERVED_SECTORS - root_sectors) // cluster_sectors
+	fat_sectors = ((clusters + 2) * 2 + SECTOR_BYTES - 1) // SECTOR_BYTES
+	clusters = (total - RESERVED_SECTORS - root_sectors - (fat_sectors * FAT_COUNT)) // cluster_sectors
+	if not (4085 <= clusters < 65525):
+		raise ImageError("%u clusters is out of range for FAT16" % clusters)
+
+	boot = bytearray(SECTOR_BYTES)
+	boot[0:3] = b"\xEB\x3C\x90"
+	boot[3:11] = b"GHMONTST"
+	struct.pack_into("<HBHBHHBHHHII", boot, 11,
+		SECTOR_BYTES, cluster_sectors, RESERVED_SECTORS, FAT_COUNT, ROOT_ENTRIES,
+		total if total < 0x10000 else 0, 0xF8, fat_sectors, 63, 255, 0,
+		total if total >= 0x10000 else 0)
+	struct.pack_into("<BBBI11s8s", boot, 36,
+		0x80, 0, 0x29, 0x12345678, b"NO NAME    ", b"FAT16   ")
+	boot[510:512] = b"\x55\xAA"
+
+	fat = bytearray(fat_sectors * SECTOR_BYTES)
+	struct.pack_into("<HH", fat, 0, 0xFFF8, 0xFFFF)
+
+	with open(path, "wb") as f:
+		f.write(boot)
+		for _ in range(FAT_COUNT):
+			f.write(fat)
+		f.truncate(total * SECTOR_BYTES)
+
+	return Image(path)
+
+class Image:
+	def __init__(self, path):
+		with open(path, "rb") as f:
+			self.data = f.read()
+
+		(ssize, self.cluster_sectors, reserved, fats, root_entries, total16, _,
+			fat_sectors, _, _, _, total32) = struct.unpack_from("<HBHBHHBHHHII", self.data, 11)
+		if ssize != SECTOR_BYTES or self.data[510:512] != b"\x55\xAA":
+			raise ImageError("%s isn't a FAT16 image" % path)
+
+		total = total16 if total16 != 0 else total32
+		self.fat_start = reserved * SECTOR_BYTES
+		self.root_start = self.fat_start + (fats * fat_sectors * SECTOR_BYTES)
+		self.root_entries = root_entries
+		self.data_start = self.root_start + (root_entries * 32)
+		self.cluster_bytes = self.cluster_sectors * SECTOR_BYTES
+		self.cluster_count = (total * SECTOR_BYTES - self.data_start) // self.cluster_bytes
+
+	def fat(self, cluster):
+		return struct.unpack_from("<H", self.data, self.fat_start + (cluster * 2))[0]
+
+	def chain(self, cluster):
+		clusters = []
+		while 2 <= cluster < FAT_EOC:
+			if cluster in clusters or len(clusters) > self.cluster_count:
+				raise ImageError("loop in cluster chain")
+			clusters.append(cluster)
+			cluster = self.fat(cluster)
+		return clusters
+
+	def free_clusters(self):
+		return sum(1 for c in range(2, self.cluster_count + 2) if self.fat(c) == FAT_FREE)
+
+	# Return a dict of {name: (size, first_cluster)} for the files in the root
+	# directory
+	def files(self):
+		files = {}
+		for i in range(self.root_entries):
+			e = self.data[self.root_start + (i * 32):self.root_start + ((i + 1) * 32)]
+			if e[0] == 0x00:
+				break
+			if e[0] == 0xE5 or (e[11] & 0x08) or e[11] == 0x0F:
+				continue
+			name = e[0:8].decode("ascii").rstrip()
+			ext = e[8:11].decode("ascii").rstrip()
+			if ext:
+				name += "." + ext
+			cluster, size = struct.unpack_from("<HI", e, 26)
+			files[name] = (size, cluster)
+		return files
+
+	def read(self, name):
+		size, cluster = self.files()[name]
+		out = bytearray()
+		for c in self.chain(cluster):
+			off = self.data_start + ((c - 2) * self.cluster_bytes)
+			out += self.data[off:off + self.cluster_bytes]
+		if len(out) < size:
+			raise ImageError("%s is shorter than its directory entry" % name)
+		return bytes(out[:size])
+
+	# Overwrite part of a file in place; it can't be made any larger
+	def patch(self, name, offset, data):
+		size, cluster = self.files()[name]
+		if offset + len(data) > size:
+			raise ImageError("patch goes past the end of %s" % name)
+		chain = self.chain(cluster)
+		buf = bytearray(self.data)
+		for i, b in enumerate(data, offset):
+			c = chain[i // self.cluster_bytes]
+			buf[self.data_start + ((c - 2) * self.cluster_bytes) + (i % self.cluster_bytes)] = b
+		self.data = bytes(buf)
+
+	def save(self, path):
+		with open(path, "r+b") as f:
+			f.write(self.data)
+
+	# Return the number of clusters allocated to a file beyond what its size
+	# needs
+	def slack_clusters(self, name):
+		size, cluster = self.files()[name]
+		used = (size + self.cluster_bytes - 1) // self.cluster_bytes
+		return len(self.chain(cluster)) - used
+
+def main():
+	parser = argparse.ArgumentParser(description="Create or list a FAT16 test image")
+	parser.add_argument("image")
+	parser.add_argument("--create", action="store_true", help="create an empty image")
+	parser.add_argument("--mib", type=int, default=32, help="size of a new image")
+	args = parser.parse_args()
+
+	if args.create:
+		create(args.image, args.mib)
+	img = Image(args.image)
+	for name, (size, cluster) in sorted(img.files().items()):
+		print("%-12s %10u bytes, %u clusters" % (name, size, len(img.chain(cluster))))
+	print("%u of %u clusters free" % (img.free_clusters(), img.cluster_count))
+
+	return 0
+
+if __name__ == "__main__":
+	sys.exit(main())
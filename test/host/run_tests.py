@@ -0,0 +1,531 @@
+#!/usr/bin/python3
+#
+# Build GHMon for the host and check the logs it writes in a few scenarios
+#
+# Each scenario builds a copy of config/examples/basic with some settings
+# changed, runs it against a fresh FAT image for a stretch of virtual time,
+# and checks the image afterwards. Builds go through PlatformIO, so this has
+# to be able to find 'pio'.
+#
+# A few checks of library code which can't run as part of the host build,
+# like the STM32 SPI driver against its register-level mock and the SSD1306
+# driver against a recorder on the I2C bus, are compiled straight from the
+# sources with the host C compiler instead. Those in test/host/ulib can also
+# be run by hand with '--bench' to time the code they check; use '--keep' to
+# hang on to the programs.
+#
+#    test/host/run_tests.py [-k scenario] [--keep] [--pio PIO] [--cc CC]
+#
+import os
+import re
+import sys
+import shutil
+import argparse
+import tempfile
+import subprocess
+
+import fatimage
+
+PROJECT_DIR = os.path.realpath(os.path.join(os.path.dirname(__file__), "..", ".."))
+BASE_INSTANCE = os.path.join(PROJECT_DIR, "config", "examples", "basic")
+LOG_NAME = "STATUS00.LOG"
+
+# Lines are logged every LOG_APPEND_MINUTES and written out when the
+# LOG_LINE_BUFFER_COUNT lines in the buffer plus the current one are ready
+LOG_INTERVAL_S = 15 * 60
+LINES_PER_WRITE = 16
+WRITE_INTERVAL_S = LINES_PER_WRITE * LOG_INTERVAL_S
+
+# The CMSIS_STM32 SPI driver built for an STM32F401 against the register-level
+# mock in test/host/stm32_mock; the mock needs static buffers to have 32-bit
+# addresses so it can't be position-independent
+STM32_MOCK_DIR = os.path.join(PROJECT_DIR, "test", "host", "stm32_mock")
+STM32_MOCK_FLAGS = [
+	"-no-pie", "-Wno-pointer-to-int-cast",
+	"-DSTM32F401xC", "-DF_CPU=84000000UL",
+	"-DuHAL_PLATFORM=CMSIS_STM32",
+	"-DuHAL_CONFIG=test/host/stm32_mock/config_uHAL.h",
+	"-DuHAL_PLATFORM_CONFIG=lib/uHAL/config/config_CMSIS_STM32.h",
+	"-DULIB_CONFIG_HEADER=\"ulibconfig_template.h\"",
+	"-I" + STM32_MOCK_DIR,
+]
+ULIB_TEST_FLAGS = [
+	"-iquote", "lib/ulib/include",
+	"-DULIB_CONFIG_HEADER=\"ulibconfig_template.h\"",
+]
+SSD1306_TEST_FLAGS = ULIB_TEST_FLAGS + [
+	"-DHAVE_HOST=1", "-DuHAL_PLATFORM=HOST",
+	"-DuHAL_CONFIG=test/host/ssd1306/config_uHAL.h",
+	"-DuHAL_PLATFORM_CONFIG=lib/uHAL/config/config_HOST.h",
+	"-Wl,--wrap=i2c_transmit_block_begin,--wrap=i2c_transmit_block_end",
+]
+
+class TestFailure(Exception):
+	pass
+
+def check(cond, msg):
+	if not cond:
+		raise TestFailure(msg)
+
+class Build:
+	def __init__(self, work, name, env, flags, settings):
+		self.dir = os.path.join(work, "build-" + name)
+		instance = os.path.join(self.dir, "instance")
+		shutil.copytree(BASE_INSTANCE, instance)
+		for setting, value in settings.items():
+			set_define(instance, setting, value)
+
+		penv = dict(os.environ)
+		penv["INSTANCE_DIR"] = os.path.relpath(instance, os.path.join(PROJECT_DIR, "config"))
+		penv["PLATFORMIO_BUILD_DIR"] = os.path.join(self.dir, "pio")
+		if flags:
+			penv["PLATFORMIO_BUILD_FLAGS"] = " ".join(flags)
+		r = subprocess.run([ARGS.pio, "run", "-e", env], cwd=PROJECT_DIR, env=penv, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+		if r.returncode != 0:
+			sys.stderr.write(r.stdout)
+			raise TestFailure("build %s failed" % name)
+		self.program = os.path.join(self.dir, "pio", env, "program")
+
+	# Run for 'seconds' of virtual time and return everything printed
+	def run(self, image, seconds, retained=None, flash=None, extra_env={}):
+		penv = dict(os.environ)
+		penv.update(extra_env)
+		penv["FATFS_IMAGE"] = image
+		penv["HOST_RUN_LIMIT_S"] = str(seconds)
+		penv["HOST_RETAINED_MEMORY_FILE"] = retained if retained is not None else os.path.join(self.dir, "retained.bin")
+		penv["HOST_FLASH_FILE"] = flash if flash is not None else os.path.join(self.dir, "flash.bin")
+		r = subprocess.run([self.program], cwd=self.dir, env=penv, stdin=subprocess.DEVNULL, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True, errors="replace")
+		check(r.returncode == 0, "%s exited with status %d" % (self.program, r.returncode))
+		return r.stdout
+
+# Change the value of a #define in any of an instance's headers
+def set_define(instance, name, value):
+	found = False
+	pattern = re.compile(r"^(#\s*define\s+%s)\b.*$" % re.escape(name), re.M)
+	for root, _, files in os.walk(instance):
+		for f in files:
+			path = os.path.join(root, f)
+			with open(path) as fh:
+				text = fh.read()
+			text, n = pattern.subn(lambda m: "%s %s" % (m.group(1), value), text)
+			if n > 0:
+				with open(path, "w") as fh:
+					fh.write(text)
+				found = True
+	if not found:
+		raise TestFailure("%s isn't defined in the instance configuration" % name)
+
+class Context:
+	def __init__(self, work):
+		self.work = work
+		self.builds = {}
+		self.images = 0
+
+	# Build the instance with 'settings' changed and any extra compiler 'flags',
+	# re-using an earlier build with the same ones
+	def build(self, env="host_debug", flags=(), **settings):
+		key = (env, tuple(flags), tuple(sorted(settings.items())))
+		if key not in self.builds:
+			name = "%s-%u" % (env, len(self.builds))
+			self.builds[key] = Build(self.work, name, env, flags, settings)
+		return self.builds[key]
+
+	# Build a program straight from 'sources' with the host C compiler
+	def compile(self, name, sources, flags=()):
+		out = os.path.join(self.work, name)
+		cmd = [ARGS.cc, "-std=c99", "-Wall", "-Wextra", "-g", "-O1", "-DDEBUG=1",
+			"-I.", "-Ilib", "-Ilib/uHAL", "-Ilib/uHAL/include", "-Ilib/uHAL/src", "-Ilib/ulib",
+			*flags, *sources, "-o", out]
+		r = subprocess.run(cmd, cwd=PROJECT_DIR, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+		if r.returncode != 0:
+			sys.stderr.write(r.stdout)
+			raise TestFailure("building %s failed" % name)
+		return out
+
+	# Run a program built by compile() and fail with the last thing it
+	# printed if it does
+	def run_compiled(self, program, args=()):
+		r = subprocess.run([program, *args], stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+		check(r.returncode == 0, r.stdout.strip().splitlines()[-1] if r.stdout.strip() else "exited with status %d" % r.returncode)
+		return r.stdout
+
+	def new_image(self):
+		self.images += 1
+		path = os.path.join(self.work, "image%u.img" % self.images)
+		fatimage.create(path)
+		return path
+
+# Return the contents of a log file without the zeroes filling any space
+# still reserved for it
+def log_text(image, name=LOG_NAME):
+	return fatimage.Image(image).read(name).rstrip(b"\0")
+
+# Return the lines of a text log which aren't part of the header
+def log_lines(image, name=LOG_NAME):
+	return [l for l in log_text(image, name).decode("ascii").split("\r\n") if l and not l.startswith("#")]
+
+def test_log_to_image(t):
+	b = t.build()
+	img = t.new_image()
+	b.run(img, 3 * WRITE_INTERVAL_S + 60)
+
+	check(list(fatimage.Image(img).files()) == [LOG_NAME], "unexpected files %s" % list(fatimage.Image(img).files()))
+	header = log_text(img).decode("ascii").split("\r\n")[0]
+	lines = log_lines(img)
+	check(len(lines) == 3 * LINES_PER_WRITE, "expected %u lines, found %u" % (3 * LINES_PER_WRITE, len(lines)))
+	for l in lines:
+		check(len(l.split("\t")) == len(header.split("\t")), "line doesn't match the header: %s" % l)
+	check(lines[0].startswith("15m00s\t") and lines[-1].startswith("12h00m"), "unexpected timestamps %s ... %s" % (lines[0], lines[-1]))
+
+	return
+
+#
+# A binary log has to decode to exactly what the text log holds
+def test_binary_log_decodes_to_text(t):
+	text_img = t.new_image()
+	t.build().run(text_img, 3 * WRITE_INTERVAL_S + 60)
+	bin_img = t.new_image()
+	t.build(LOG_FORMAT_BINARY=1).run(bin_img, 3 * WRITE_INTERVAL_S + 60)
+
+	binlog = os.path.join(t.work, "binary.log")
+	decoded = os.path.join(t.work, "decoded.log")
+	with open(binlog, "wb") as f:
+		f.write(fatimage.Image(bin_img).read(LOG_NAME))
+	r = subprocess.run([sys.executable, os.path.join(PROJECT_DIR, "tools", "decode_binary_log.py"), "-o", decoded, binlog], stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+	check(r.returncode == 0, "decoder failed: %s" % r.stdout.strip())
+	with open(decoded, "rb") as f:
+		check(f.read() == log_text(text_img), "decoded binary log doesn't match the text log")
+
+	return
+
+#
+# Going through the SD card driver and the emulated card has to write the
+# same log as going to the image directly, and the flushes should be streamed
+def test_sd_card_writes_same_log(t):
+	img = t.new_image()
+	t.build().run(img, 3 * WRITE_INTERVAL_S + 60)
+	sd_img = t.new_image()
+	out = t.build(env="host_sd_debug").run(sd_img, 3 * WRITE_INTERVAL_S + 60)
+
+	check(log_text(sd_img) == log_text(img), "log written through the SD card driver differs")
+	streamed = sum(int(n) for n in re.findall(r"(\d+) CMD25", out))
+	check(streamed > 0, "no multiple block writes were used")
+
+	return
+
+#
+# Each new log file is reserved in one contiguous run of clusters, and the
+# files that have been rotated out are trimmed back to what was written
+def test_rotated_files_are_trimmed(t):
+	img = t.new_image()
+	t.build(LOG_LINES_PER_FILE=20).run(img, 3 * WRITE_INTERVAL_S + 60)
+
+	image = fatimage.Image(img)
+	names = sorted(image.files())
+	check(names == ["STATUS00.LOG", "STATUS01.LOG", "STATUS02.LOG"], "unexpected files %s" % names)
+	for name in names:
+		size, cluster = image.files()[name]
+		chain = image.chain(cluster)
+		check(chain == list(range(chain[0], chain[0] + len(chain))), "%s isn't contiguous" % name)
+	for name in names[:-1]:
+		check(len(log_lines(img, name)) == 20, "%s doesn't hold 20 lines" % name)
+		check(image.files()[name][0] == len(log_text(img, name)), "%s wasn't trimmed" % name)
+		check(image.slack_clusters(name) == 0, "%s still holds clusters past its end" % name)
+
+	return
+
+#
+# After a restart the last log file is picked back up where it ended as long
+# as it has the same header and room for more lines
+#
+# With retained memory the SD cursor from before the restart is used too
+def test_log_file_resumed_after_restart(t):
+	for retained in (0, 4096):
+		b = t.build(RETAINED_MEMORY_BYTES=retained)
+		img = t.new_image()
+		b.run(img, WRITE_INTERVAL_S + 60)
+		out = b.run(img, WRITE_INTERVAL_S + 60)
+
+		names = sorted(fatimage.Image(img).files())
+		check(names == [LOG_NAME], "unexpected files %s" % names)
+		check(("Resuming log file %s at line %u" % (LOG_NAME, LINES_PER_WRITE)) in out, "log file wasn't resumed")
+		check(("Restored log SD cursor" in out) == (retained > 0), "SD cursor %s restored" % ("wasn't" if retained > 0 else "was"))
+		lines = log_lines(img)
+		check(len(lines) == 2 * LINES_PER_WRITE, "expected %u lines, found %u" % (2 * LINES_PER_WRITE, len(lines)))
+		check(log_text(img).count(b"# Time") == 1, "header was written again")
+
+	return
+def test_log_file_not_resumed_with_other_header(t):
+	b = t.build()
+	img = t.new_image()
+	b.run(img, WRITE_INTERVAL_S + 60)
+	image = fatimage.Image(img)
+	image.patch(LOG_NAME, 2, b"Tyme")
+	image.save(img)
+	before = log_text(img)
+	out = b.run(img, WRITE_INTERVAL_S + 60)
+
+	names = sorted(fatimage.Image(img).files())
+	check(names == ["STATUS00.LOG", "STATUS01.LOG"], "unexpected files %s" % names)
+	check("Resuming" not in out, "log file with a different header was resumed")
+	check(log_text(img) == before, "log file with a different header was changed")
+	check(len(log_lines(img, "STATUS01.LOG")) == LINES_PER_WRITE, "new log file is missing lines")
+
+	return
+def test_full_log_file_not_resumed(t):
+	b = t.build(LOG_LINES_PER_FILE=LINES_PER_WRITE)
+	img = t.new_image()
+	b.run(img, WRITE_INTERVAL_S + 60)
+	b.run(img, WRITE_INTERVAL_S + 60)
+
+	image = fatimage.Image(img)
+	names = sorted(image.files())
+	check(names == ["STATUS00.LOG", "STATUS01.LOG"], "unexpected files %s" % names)
+	check(image.slack_clusters("STATUS00.LOG") == 0, "full log file wasn't trimmed")
+
+	return
+
+#
+# Delta-encoding the buffered lines mustn't change what's written, and a
+# buffer too small for even one line has to write every line right away
+def test_compressed_buffer_writes_same_log(t):
+	img = t.new_image()
+	t.build().run(img, 3 * WRITE_INTERVAL_S + 60)
+	comp_img = t.new_image()
+	t.build(LOG_COMPRESSED_BUFFER_SIZE=512).run(comp_img, 3 * WRITE_INTERVAL_S + 60)
+
+	check(log_text(comp_img) == log_text(img), "log written from the compressed buffer differs")
+
+	return
+def test_compressed_buffer_too_small(t):
+	img = t.new_image()
+	out = t.build(LOG_COMPRESSED_BUFFER_SIZE=8).run(img, 3 * WRITE_INTERVAL_S + 60)
+
+	lines = log_lines(img)
+	expect = (3 * WRITE_INTERVAL_S) // LOG_INTERVAL_S
+	check(len(lines) == expect, "expected %u lines, found %u" % (expect, len(lines)))
+	check(all(l.endswith("(unbuffered)") for l in lines), "a line was buffered")
+	check(out.count("Writing log data") == expect, "the storage was opened more than once for some lines")
+
+	return
+
+#
+# Without a print buffer the log is written straight from the formatter, which
+# mustn't change the contents in either format
+def test_unbuffered_output_writes_same_log(t):
+	for binary in (0, 1):
+		img = t.new_image()
+		t.build(LOG_FORMAT_BINARY=binary).run(img, 3 * WRITE_INTERVAL_S + 60)
+		nobuf_img = t.new_image()
+		t.build(LOG_FORMAT_BINARY=binary, LOG_PRINT_BUFFER_SIZE=0).run(nobuf_img, 3 * WRITE_INTERVAL_S + 60)
+
+		check(log_text(nobuf_img) == log_text(img), "unbuffered %s log differs" % ("binary" if binary else "text"))
+
+	return
+
+#
+# Lines still in the buffer when the device resets are written out after it
+# comes back up, unless the retained memory was damaged in the meantime
+def test_buffered_lines_survive_reset(t):
+	for compressed in (0, 512):
+		b = t.build(RETAINED_MEMORY_BYTES=4096, LOG_COMPRESSED_BUFFER_SIZE=compressed)
+		img = t.new_image()
+		retained = os.path.join(t.work, "retained.bin")
+		if os.path.exists(retained):
+			os.remove(retained)
+		b.run(img, WRITE_INTERVAL_S + (5 * LOG_INTERVAL_S) + 60, retained=retained)
+		out = b.run(img, WRITE_INTERVAL_S + 60, retained=retained)
+
+		check("Recovered 5 unwritten log lines" in out, "buffered lines weren't recovered")
+		lines = log_lines(img)
+		# The recovered lines take up part of the buffer so the first write
+		# after the reset comes early
+		check(len(lines) == 2 * LINES_PER_WRITE, "expected %u lines, found %u" % (2 * LINES_PER_WRITE, len(lines)))
+		recovered = [l.split("\t")[0] for l in lines[LINES_PER_WRITE:LINES_PER_WRITE + 5]]
+		check(recovered == ["04h15m00s", "04h30m01s", "04h45m00s", "05h00m01s", "05h15m00s"], "unexpected recovered lines %s" % recovered)
+
+	return
+def test_damaged_retained_memory_discarded(t):
+	b = t.build(RETAINED_MEMORY_BYTES=4096)
+	img = t.new_image()
+	retained = os.path.join(t.work, "damaged.bin")
+	b.run(img, WRITE_INTERVAL_S + (5 * LOG_INTERVAL_S) + 60, retained=retained)
+	with open(retained, "r+b") as f:
+		f.seek(200)
+		c = f.read(1)
+		f.seek(200)
+		f.write(bytes([c[0] ^ 0x01]))
+	out = b.run(img, WRITE_INTERVAL_S + 60, retained=retained)
+
+	check("Recovered" not in out, "damaged retained memory was used")
+	lines = log_lines(img)
+	check(len(lines) == 2 * LINES_PER_WRITE, "expected %u lines, found %u" % (2 * LINES_PER_WRITE, len(lines)))
+	check(lines[LINES_PER_WRITE].startswith("15m00s\t"), "unexpected line after the reset: %s" % lines[LINES_PER_WRITE])
+
+	return
+
+#
+# Lines journaled to flash have to reach the SD card unchanged
+def test_flash_journal_drains_same_log(t):
+	img = t.new_image()
+	t.build().run(img, 3 * WRITE_INTERVAL_S + 60)
+	flash_img = t.new_image()
+	flash = os.path.join(t.work, "flash.bin")
+	out = t.build(WRITE_LOG_TO_FLASH=1).run(flash_img, 3 * WRITE_INTERVAL_S + 60, flash=flash)
+
+	names = sorted(fatimage.Image(flash_img).files())
+	check(names == ["JOURNAL.LOG"], "unexpected files %s" % names)
+	check(log_text(flash_img, "JOURNAL.LOG") == log_text(img), "drained journal differs from the log")
+	dropped = [int(n) for n in re.findall(r"\((\d+) damaged records dropped\)", out)]
+	check(len(dropped) > 0 and not any(dropped), "journal records were damaged")
+
+	return
+
+#
+# Decoding the output of a tokenized build has to give the same messages as
+# an ordinary build prints
+def test_tokenized_logger_decodes_to_text(t):
+	logger_re = re.compile(r"^\d+:  ", re.M)
+	out = t.build().run(t.new_image(), WRITE_INTERVAL_S + 60)
+	tokens = t.build(flags=["-DLOGGER_TOKENIZED=1"]).run(t.new_image(), WRITE_INTERVAL_S + 60)
+	check(not logger_re.search(tokens), "tokenized build printed plain messages")
+
+	capture = os.path.join(t.work, "tokens.txt")
+	with open(capture, "w") as f:
+		f.write(tokens)
+	r = subprocess.run([sys.executable, os.path.join(PROJECT_DIR, "tools", "decode_logger.py"), capture], cwd=PROJECT_DIR, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+	check(r.returncode == 0, "decoder failed: %s" % r.stderr.strip())
+	expect = [l for l in out.splitlines() if logger_re.match(l)]
+	decoded = [l for l in r.stdout.splitlines() if logger_re.match(l)]
+	check(len(expect) > 0 and decoded == expect, "decoded messages differ")
+
+	return
+
+#
+# A trace of raw ADC readings drives the sensor it names from the time of
+# each line, and the run stops when the trace does
+def test_simulation_replays_trace(t):
+	trace = os.path.join(t.work, "trace.tsv")
+	with open(trace, "w") as f:
+		f.write("# Time\tGND_MOIST1_adc\n00h00m00s\t1000\n02h00m00s\t3000\n05h00m00s\t3000\n")
+	img = t.new_image()
+	out = t.build().run(img, 24 * 60 * 60, extra_env={"GHMON_SIM_TRACE": trace})
+
+	check("Reached the end of the trace" in out, "run didn't stop at the end of the trace")
+	column = log_text(img).decode("ascii").split("\r\n")[0].split("\t").index("GND_MOIST1_reading_0")
+	readings = [l.split("\t")[column] for l in log_lines(img)]
+	# The trace changes after the 7th line, logged at 01h45m
+	before = set(readings[:7])
+	after = set(readings[7:])
+	check(len(before) == 1 and len(after) == 1 and before != after, "readings didn't follow the trace: %s" % readings)
+
+	return
+
+#
+# The STM32 SPI driver's DMA transfers move the right data, time out, and
+# can be abandoned, checked against a mock of the F401's SPI1 and DMA2
+def test_stm32_spi_dma_transfers(t):
+	program = t.compile("spi_dma_test", [
+		"test/host/stm32_mock/spi_dma_test.c",
+		"test/host/stm32_mock/mock.c",
+		"lib/uHAL/src/platform/CMSIS_STM32/spi.c",
+	], STM32_MOCK_FLAGS)
+	t.run_compiled(program)
+
+	return
+
+def test_ssd1306_framebuffer_matches_direct(t):
+	panels = []
+	for fb_bytes in (0, 1024):
+		name = "ssd1306_test_fb%u" % fb_bytes
+		program = t.compile(name, [
+			"test/host/ssd1306/ssd1306_test.c",
+			"lib/uHAL/src/platform/HOST/i2c.c",
+			"lib/uHAL/src/drivers/display/ssd1306/ssd1306.c",
+			"lib/ulib/src/util.c",
+		], SSD1306_TEST_FLAGS + ["-DSSD1306_FRAMEBUFFER_BYTES=%uU" % fb_bytes])
+		out = os.path.join(t.work, name + ".panel")
+		t.run_compiled(program, [out])
+		with open(out) as f:
+			panels.append(f.read())
+	check(panels[0] == panels[1], "panel contents differ with and without the framebuffer")
+
+	return
+
+def test_time_cache_matches_full_conversion(t):
+	program = t.compile("time_cache_test", [
+		"test/host/ulib/time_cache_test.c",
+		"lib/ulib/src/time.c",
+		"lib/ulib/src/util.c",
+	], ULIB_TEST_FLAGS)
+	t.run_compiled(program)
+
+	return
+
+def test_printf_matches_snprintf(t):
+	for pairs in (0, 1):
+		for int_bytes in (4, 8):
+			program = t.compile("printf_test_pairs%u_int%u" % (pairs, int_bytes), [
+				"test/host/ulib/printf_test.c",
+				"lib/ulib/src/printf.c",
+				"lib/ulib/src/util.c",
+			], ULIB_TEST_FLAGS + ["-DPRINTF_USE_DIGIT_PAIRS=%u" % pairs, "-DPRINTF_MAX_INT_BYTES=%u" % int_bytes])
+			t.run_compiled(program)
+
+	return
+
+TESTS = [
+	test_log_to_image,
+	test_binary_log_decodes_to_text,
+	test_sd_card_writes_same_log,
+	test_rotated_files_are_trimmed,
+	test_log_file_resumed_after_restart,
+	test_log_file_not_resumed_with_other_header,
+	test_full_log_file_not_resumed,
+	test_compressed_buffer_writes_same_log,
+	test_compressed_buffer_too_small,
+	test_unbuffered_output_writes_same_log,
+	test_buffered_lines_survive_reset,
+	test_damaged_retained_memory_discarded,
+	test_flash_journal_drains_same_log,
+	test_tokenized_logger_decodes_to_text,
+	test_simulation_replays_trace,
+	test_stm32_spi_dma_transfers,
+	test_ssd1306_framebuffer_matches_direct,
+	test_time_cache_matches_full_conversion,
+	test_printf_matches_snprintf,
+]
+
+def main():
+	global ARGS
+
+	parser = argparse.ArgumentParser(description="Run the host scenario tests")
+	parser.add_argument("-k", dest="select", action="append", help="only run scenarios with this in their name")
+	parser.add_argument("--keep", action="store_true", help="keep the builds and images")
+	parser.add_argument("--pio", default="pio", help="PlatformIO command (default is 'pio')")
+	parser.add_argument("--cc", default="cc", help="C compiler for the tests that don't use PlatformIO (default is 'cc')")
+	ARGS = parser.parse_args()
+
+	work = tempfile.mkdtemp(prefix="ghmon-host-tests-")
+	t = Context(work)
+	failed = 0
+	for test in TESTS:
+		name = test.__name__[len("test_"):]
+		if ARGS.select and not any(s in name for s in ARGS.select):
+			continue
+		try:
+			test(t)
+			print("PASS  %s" % name)
+		except (TestFailure, fatimage.ImageError) as e:
+			print("FAIL  %s: %s" % (name, e))
+			failed += 1
+
+	if ARGS.keep:
+		print("Builds and images kept in %s" % work)
+	else:
+		shutil.rmtree(work)
+
+	return 1 if failed else 0
+
+if __name__ == "__main__":
+	sys.exit(main())
@@ -0,0 +1,7 @@
+//
+// uHAL configuration for building the SSD1306 driver against the I2C recorder
+//
+#define uHAL_USE_I2C 1
+#define uHAL_USE_DISPLAY_SSD1306 1
+
+#include "lib/uHAL/config/config_uHAL.h"
@@ -0,0 +1,353 @@
+//
+// Check the SSD1306 driver against a recorder on the host I2C bus
+//
+// The recorder overrides the host platform's weak host_i2c_transmit() and
+// models the controller's RAM in horizontal addressing mode, which is the
+// only mode the driver uses. A transaction started with
+// i2c_transmit_block_begin() is passed to the hook a piece at a time, so the
+// begin and end functions are wrapped by the linker ('--wrap') to mark where
+// each one starts and stops.
+//
+// Built and run by test/host/run_tests.py with and without a framebuffer;
+// each build writes the panel contents after every step of the same drawing
+// script to the file named on the command line so the two can be compared.
+// It prints what it checked and exits non-zero on the first failure.
+//
+#include "include/interface.h"
+#include "include/drivers/display/ssd1306/ssd1306.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define CHECK(_cond_) \
+	do { \
+		if (!(_cond_)) { \
+			fail(__FILE__, __LINE__, #_cond_); \
+		} \
+	} while (0)
+
+#define DISPLAY_ADDR 0x3CU
+#define PANEL_WIDTH 128U
+#define PANEL_PAGES 8U
+// The panel RAM holds garbage at power-on
+#define PANEL_GARBAGE 0x5AU
+
+#define MAX_TRANSACTIONS 64U
+#define TRANSACTION_HEAD_BYTES 8U
+
+typedef struct {
+	uint8_t head[TRANSACTION_HEAD_BYTES]; // The first bytes sent
+	uint_fast16_t size; // The number of bytes sent
+} transaction_t;
+
+static uint8_t panel[PANEL_PAGES][PANEL_WIDTH];
+static struct {
+	uint8_t col_first, col_last, col;
+	uint8_t page_first, page_last, page;
+} ram;
+
+static transaction_t transactions[MAX_TRANSACTIONS];
+static uint_fast16_t transaction_count;
+static bool in_block;
+static bool have_control;
+static bool is_data;
+static uint8_t cmd[3];
+static uint_fast8_t cmd_bytes, cmd_need;
+
+static const ssd1306_cfg_t cfg = {
+	.access.address = DISPLAY_ADDR,
+	.height = 64U,
+	.width = PANEL_WIDTH,
+	.flags = SSD1306_CFG_FLAG_I2C,
+};
+static ssd1306_handle_t display;
+static FILE *panel_file;
+
+err_t __real_i2c_transmit_block_begin(uint8_t addr, utime_t timeout);
+err_t __real_i2c_transmit_block_end(void);
+
+
+static void fail(const char *file, int line, const char *msg) {
+	fflush(stdout);
+	fprintf(stderr, "%s:%d: check failed: %s\n", file, line, msg);
+	exit(1);
+}
+
+//
+// Recorder
+//
+static void start_transaction(uint8_t addr) {
+	CHECK(addr == DISPLAY_ADDR);
+	CHECK(transaction_count < MAX_TRANSACTIONS);
+
+	memset(&transactions[transaction_count], 0, sizeof(transactions[0]));
+	++transaction_count;
+	have_control = false;
+	cmd_bytes = 0;
+
+	return;
+}
+static void end_transaction(void) {
+	CHECK(have_control);
+	CHECK(cmd_bytes == 0);
+
+	return;
+}
+static void write_ram(uint8_t b) {
+	panel[ram.page][ram.col] = b;
+	if (ram.col < ram.col_last) {
+		++ram.col;
+	} else {
+		ram.col = ram.col_first;
+		ram.page = (ram.page < ram.page_last) ? ram.page + 1U : ram.page_first;
+	}
+
+	return;
+}
+static uint_fast8_t command_args(uint8_t c) {
+	switch (c) {
+	case 0x21U: // Column range
+	case 0x22U: // Page range
+		return 2;
+	case 0x20U: // Addressing mode
+	case 0x81U: // Contrast
+	case 0x8DU: // Charge pump
+	case 0xA8U: // MUX ratio
+	case 0xD3U: // Display offset
+	case 0xD5U: // Clock
+	case 0xD9U: // Pre-charge
+	case 0xDAU: // COM pins
+	case 0xDBU: // Deselect level
+		return 1;
+	default:
+		return 0;
+	}
+}
+static void run_command(void) {
+	switch (cmd[0]) {
+	case 0x20U:
+		CHECK(cmd[1] == 0x00U);
+		break;
+	case 0x21U:
+		CHECK(cmd[1] <= cmd[2] && cmd[2] < PANEL_WIDTH);
+		ram.col_first = ram.col = cmd[1];
+		ram.col_last = cmd[2];
+		break;
+	case 0x22U:
+		CHECK(cmd[1] <= cmd[2] && cmd[2] < PANEL_PAGES);
+		ram.page_first = ram.page = cmd[1];
+		ram.page_last = cmd[2];
+		break;
+	default:
+		break;
+	}
+	cmd_bytes = 0;
+
+	return;
+}
+static void receive_byte(uint8_t b) {
+	transaction_t *txn = &transactions[transaction_count - 1U];
+
+	if (txn->size < TRANSACTION_HEAD_BYTES) {
+		txn->head[txn->size] = b;
+	}
+	++txn->size;
+
+	if (!have_control) {
+		// Only the streaming form, with the continuation bit clear, is used
+		CHECK((b & 0x80U) == 0);
+		have_control = true;
+		is_data = ((b & 0x40U) != 0);
+	} else if (is_data) {
+		write_ram(b);
+	} else {
+		if (cmd_bytes == 0) {
+			cmd_need = command_args(b) + 1U;
+		}
+		cmd[cmd_bytes++] = b;
+		if (cmd_bytes == cmd_need) {
+			run_command();
+		}
+	}
+
+	return;
+}
+err_t host_i2c_transmit(uint8_t addr, const uint8_t *tx_buffer, txsize_t tx_size) {
+	if (!in_block) {
+		start_transaction(addr);
+	}
+	for (txsize_t i = 0; i < tx_size; ++i) {
+		receive_byte(tx_buffer[i]);
+	}
+	if (!in_block) {
+		end_transaction();
+	}
+
+	return ERR_OK;
+}
+err_t __wrap_i2c_transmit_block_begin(uint8_t addr, utime_t timeout) {
+	err_t res = __real_i2c_transmit_block_begin(addr, timeout);
+
+	if (res == ERR_OK) {
+		start_transaction(addr);
+		in_block = true;
+	}
+	return res;
+}
+err_t __wrap_i2c_transmit_block_end(void) {
+	if (in_block) {
+		in_block = false;
+		end_transaction();
+	}
+	return __real_i2c_transmit_block_end();
+}
+// The driver waits for the panel to power up
+void delay_ms(utime_t ms) {
+	UNUSED(ms);
+	return;
+}
+
+//
+// Write the panel contents to the output file
+static void dump_panel(const char *step) {
+	fprintf(panel_file, "%s:\n", step);
+	for (uint_fast8_t page = 0; page < PANEL_PAGES; ++page) {
+		for (uint_fast8_t col = 0; col < PANEL_WIDTH; ++col) {
+			fprintf(panel_file, "%02X", panel[page][col]);
+		}
+		fputc('\n', panel_file);
+	}
+
+	return;
+}
+static bool panel_is_blank(void) {
+	for (uint_fast8_t page = 0; page < PANEL_PAGES; ++page) {
+		for (uint_fast8_t col = 0; col < PANEL_WIDTH; ++col) {
+			if (panel[page][col] != 0) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+//
+// The same drawing script is run with and without the framebuffer
+static void run_script(void) {
+	CHECK(ssd1306_init(&display, &cfg) == ERR_OK);
+	CHECK(panel_is_blank());
+	dump_panel("init");
+
+	CHECK(ssd1306_draw_text(&display, NULL, 0, 0, "Temp 21.5C") == ERR_OK);
+	CHECK(ssd1306_draw_text(&display, NULL, 0, 1, "Hum  48%") == ERR_OK);
+	CHECK(ssd1306_draw_text_scaled(&display, NULL, 2, 2, 1, 3, "42") == ERR_OK);
+	// Partial-width fills spanning more than one page
+	CHECK(ssd1306_fill_section(&display, 0xAAU, 10, 20, 40, 16) == ERR_OK);
+	CHECK(ssd1306_fill_section(&display, 0xFFU, 100, 28, 48, 16) == ERR_OK);
+	CHECK(ssd1306_flush(&display) == ERR_OK);
+	dump_panel("draw");
+
+	// Redraw the values and overwrite part of a fill
+	CHECK(ssd1306_draw_text(&display, NULL, 5, 0, "22.0") == ERR_OK);
+	CHECK(ssd1306_draw_text(&display, NULL, 5, 1, "51") == ERR_OK);
+	CHECK(ssd1306_fill_section(&display, 0x00U, 104, 8, 56, 8) == ERR_OK);
+	CHECK(ssd1306_flush(&display) == ERR_OK);
+	dump_panel("update");
+
+	// Text running off the right edge is cut off
+	CHECK(ssd1306_draw_text(&display, NULL, 12, 7, "overflowing") == ERR_OK);
+	CHECK(ssd1306_draw_text_scaled(&display, NULL, 3, 1, 10, 2, "xyz") == ERR_OK);
+	CHECK(ssd1306_flush(&display) == ERR_OK);
+	dump_panel("edge");
+
+	CHECK(ssd1306_clear_display(&display) == ERR_OK);
+	CHECK(ssd1306_flush(&display) == ERR_OK);
+	CHECK(panel_is_blank());
+	dump_panel("clear");
+
+	puts("ok: drawing script");
+
+	return;
+}
+
+#if SSD1306_FRAMEBUFFER_BYTES > 0
+//
+// Check that a transaction only sets the write window
+static bool window_is(const transaction_t *txn, uint8_t x_first, uint8_t x_last, uint8_t y_first, uint8_t y_last) {
+	const uint8_t expect[] = { 0x00U, 0x21U, x_first, x_last, 0x22U, y_first, y_last };
+
+	return ((txn->size == sizeof(expect)) && (memcmp(txn->head, expect, sizeof(expect)) == 0));
+}
+//
+// A flush with nothing changed sends nothing
+static void test_flush_unchanged(void) {
+	transaction_count = 0;
+	CHECK(ssd1306_flush(&display) == ERR_OK);
+	CHECK(transaction_count == 0);
+	puts("ok: unchanged framebuffer isn't sent");
+
+	return;
+}
+//
+// Neighboring pages changed over the same columns are sent as one window
+static void test_merged_flush(void) {
+	CHECK(ssd1306_draw_text(&display, NULL, 2, 2, "ab") == ERR_OK);
+	CHECK(ssd1306_draw_text(&display, NULL, 2, 3, "cd") == ERR_OK);
+
+	transaction_count = 0;
+	CHECK(ssd1306_flush(&display) == ERR_OK);
+	CHECK(transaction_count == 2U);
+	CHECK(window_is(&transactions[0], 16, 31, 2, 3));
+	CHECK(transactions[1].size == 1U + (16U * 2U));
+	CHECK(memcmp(&panel[2][16], &display.framebuffer[(2U * PANEL_WIDTH) + 16U], 16) == 0);
+	CHECK(memcmp(&panel[3][16], &display.framebuffer[(3U * PANEL_WIDTH) + 16U], 16) == 0);
+	puts("ok: neighboring changed pages are merged");
+
+	return;
+}
+//
+// Neighboring pages changed over distant columns are sent separately
+static void test_separate_flush(void) {
+	CHECK(ssd1306_draw_text(&display, NULL, 0, 4, "a") == ERR_OK);
+	CHECK(ssd1306_draw_text(&display, NULL, 15, 5, "b") == ERR_OK);
+
+	transaction_count = 0;
+	CHECK(ssd1306_flush(&display) == ERR_OK);
+	CHECK(transaction_count == 4U);
+	CHECK(window_is(&transactions[0], 0, 7, 4, 4));
+	CHECK(transactions[1].size == 1U + 8U);
+	CHECK(window_is(&transactions[2], 120, 127, 5, 5));
+	CHECK(transactions[3].size == 1U + 8U);
+	CHECK(memcmp(panel[4], &display.framebuffer[4U * PANEL_WIDTH], PANEL_WIDTH) == 0);
+	CHECK(memcmp(panel[5], &display.framebuffer[5U * PANEL_WIDTH], PANEL_WIDTH) == 0);
+	puts("ok: distant changes on neighboring pages are sent separately");
+
+	return;
+}
+#endif // SSD1306_FRAMEBUFFER_BYTES > 0
+
+int main(int argc, char **argv) {
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s PANEL_FILE\n", argv[0]);
+		return 2;
+	}
+	if ((panel_file = fopen(argv[1], "w")) == NULL) {
+		perror(argv[1]);
+		return 2;
+	}
+
+	memset(panel, PANEL_GARBAGE, sizeof(panel));
+	CHECK(i2c_on() == ERR_OK);
+
+	run_script();
+#if SSD1306_FRAMEBUFFER_BYTES > 0
+	test_flush_unchanged();
+	test_merged_flush();
+	test_separate_flush();
+#endif
+
+	fclose(panel_file);
+
+	return 0;
+}
@@ -0,0 +1,15 @@
+//
+// uHAL configuration for building the CMSIS_STM32 SPI driver against the mock
+//
+#define uHAL_USE_SPI 1
+#define uHAL_SPI_USE_DMA 1
+
+#define HAVE_GPIO_PORT_DEFAULT 0
+#define HAVE_GPIO_PORTA 1
+#define HAVE_GPIO_PORTB 1
+
+#define SPI_SCK_PIN  PINID_SPI1_SCK
+#define SPI_MISO_PIN PINID_SPI1_MISO
+#define SPI_MOSI_PIN PINID_SPI1_MOSI
+
+#include "lib/uHAL/config/config_uHAL.h"
@@ -0,0 +1,314 @@
+//
+// Register-level mock of an STM32F401's SPI1 and the DMA2 streams serving it
+//
+// The peripherals are plain variables, so the mock only sees what the driver
+// did to them when it gets control back, which is whenever the driver calls
+// one of the core or system functions implemented here. __WFI() is where
+// time passes: the systick advances by 1ms and any transfer set up on the
+// DMA streams runs to completion, after which the stream's interrupt is
+// pended and handled as soon as interrupts are unmasked.
+//
+// The SPI data register loops back when it's used without DMA, and the
+// status register always shows TXE and RXNE while the peripheral's clock
+// is on; delay_ms() clears RXNE because it's only used by spi_off() to let
+// the bus drain. DMA transfers go through mock_spi_device(), which sees every
+// byte sent and supplies the byte received in its place.
+//
+#include "mock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+GPIO_TypeDef mock_GPIOA, mock_GPIOB, mock_GPIOC;
+SPI_TypeDef mock_SPI1;
+DMA_TypeDef mock_DMA2;
+DMA_Stream_TypeDef mock_DMA2_Stream[8];
+
+volatile utime_t G_sys_msticks;
+
+mock_spi_device_t mock_spi_device = NULL;
+bool mock_spi_stalled = false;
+uint8_t mock_spi_wire[MOCK_SPI_WIRE_BYTES];
+uint_fast16_t mock_spi_wire_bytes;
+uint_fast16_t mock_dma_transfers;
+
+// SPI1 requests are on channel 3 of DMA2 stream 0 (RX) and stream 3 (TX)
+// (RM0368 table 28)
+#define SPI1_DMA_CHSEL 3U
+#define RX_STREAM 0U
+#define TX_STREAM 3U
+// Transfer-complete and transfer-error flags in LISR for streams 0-3
+#define FLAG_POS(_s_) ((((_s_) & 0x03U) * 6U) + ((((_s_) & 0x03U) > 1U) ? 4U : 0U))
+#define TCIF(_s_) (DMA_LISR_TCIF0 << FLAG_POS(_s_))
+#define TEIF(_s_) (DMA_LISR_TEIF0 << FLAG_POS(_s_))
+
+#define MAX_CLOCKS 8U
+static rcc_periph_t clocks_on[MAX_CLOCKS];
+static uint_fast8_t dma_clock_users;
+
+static bool irq_masked;
+static bool irq_enabled[MOCK_IRQn_COUNT];
+static bool irq_pending[MOCK_IRQn_COUNT];
+
+// The stream registers only hold the start of the transfer, the position
+// is internal to the controller
+static uint32_t stream_start_ndtr[8];
+static bool stream_was_enabled[8];
+
+void DMA2_Stream0_IRQHandler(void);
+
+
+void mock_fail(const char *file, int line, const char *msg) {
+	fflush(stdout);
+	fprintf(stderr, "%s:%d: mock check failed: %s\n", file, line, msg);
+	exit(1);
+}
+
+//
+// Clocks
+//
+static bool clock_on(rcc_periph_t periph_clock) {
+	for (uint_fast8_t i = 0; i < MAX_CLOCKS; ++i) {
+		if (clocks_on[i] == periph_clock) {
+			return true;
+		}
+	}
+	return false;
+}
+void clock_init(rcc_periph_t periph_clock) {
+	clock_enable(periph_clock);
+	if (periph_clock == RCC_PERIPH_SPI1) {
+		memset(&mock_SPI1, 0, sizeof(mock_SPI1));
+		mock_SPI1.SR = SPI_SR_TXE;
+	}
+	return;
+}
+void clock_enable(rcc_periph_t periph_clock) {
+	if (!clock_on(periph_clock)) {
+		for (uint_fast8_t i = 0; i < MAX_CLOCKS; ++i) {
+			if (clocks_on[i] == 0) {
+				clocks_on[i] = periph_clock;
+				break;
+			}
+		}
+	}
+	if (periph_clock == RCC_PERIPH_SPI1) {
+		mock_SPI1.SR = SPI_SR_TXE|SPI_SR_RXNE;
+	}
+	return;
+}
+void clock_disable(rcc_periph_t periph_clock) {
+	for (uint_fast8_t i = 0; i < MAX_CLOCKS; ++i) {
+		if (clocks_on[i] == periph_clock) {
+			clocks_on[i] = 0;
+		}
+	}
+	return;
+}
+bool clock_is_enabled(rcc_periph_t periph_clock) {
+	return clock_on(periph_clock);
+}
+void dma_clock_acquire(rcc_periph_t dma_clock) {
+	MOCK_CHECK(dma_clock == RCC_PERIPH_DMA2, "SPI1 is served by DMA2");
+	if (dma_clock_users++ == 0) {
+		clock_enable(dma_clock);
+	}
+	return;
+}
+void dma_clock_release(rcc_periph_t dma_clock) {
+	MOCK_CHECK(dma_clock_users > 0, "DMA clock released more often than acquired");
+	if (--dma_clock_users == 0) {
+		clock_disable(dma_clock);
+	}
+	return;
+}
+uint_fast8_t mock_dma_clock_users(void) {
+	return dma_clock_users;
+}
+
+//
+// GPIO
+//
+void gpio_set_AF(gpio_pin_t pin, gpio_af_t af) {
+	UNUSED(pin);
+	UNUSED(af);
+	return;
+}
+err_t gpio_set_mode(gpio_pin_t pin, gpio_mode_t mode, gpio_state_t istate) {
+	UNUSED(pin);
+	UNUSED(mode);
+	UNUSED(istate);
+	return ERR_OK;
+}
+
+//
+// Time
+//
+void delay_ms(utime_t ms) {
+	G_sys_msticks += ms;
+	CLEAR_BIT(mock_SPI1.SR, SPI_SR_RXNE);
+	return;
+}
+
+//
+// DMA
+//
+static void sync_dma_flags(void) {
+	mock_DMA2.LISR &= ~mock_DMA2.LIFCR;
+	mock_DMA2.HISR &= ~mock_DMA2.HIFCR;
+	mock_DMA2.LIFCR = 0;
+	mock_DMA2.HIFCR = 0;
+
+	for (uint_fast8_t s = 0; s < 8U; ++s) {
+		bool en = BIT_IS_SET(mock_DMA2_Stream[s].CR, DMA_SxCR_EN);
+
+		if (en && !stream_was_enabled[s]) {
+			stream_start_ndtr[s] = mock_DMA2_Stream[s].NDTR;
+		}
+		stream_was_enabled[s] = en;
+	}
+
+	return;
+}
+static void stream_error(uint_fast8_t s) {
+	CLEAR_BIT(mock_DMA2_Stream[s].CR, DMA_SxCR_EN);
+	stream_was_enabled[s] = false;
+	SET_BIT(mock_DMA2.LISR, TEIF(s));
+	if (BIT_IS_SET(mock_DMA2_Stream[s].CR, DMA_SxCR_TEIE) && s == RX_STREAM) {
+		irq_pending[DMA2_Stream0_IRQn] = true;
+	}
+	return;
+}
+//
+// Check that a stream is set up the way SPI1 needs it; a stream moving data
+// to or from the wrong place is a transfer error on the real thing
+static bool stream_is_valid(uint_fast8_t s, uint32_t dir) {
+	const DMA_Stream_TypeDef *st = &mock_DMA2_Stream[s];
+
+	return (
+		SELECT_BITS(st->CR, DMA_SxCR_CHSEL) == (SPI1_DMA_CHSEL << DMA_SxCR_CHSEL_Pos) &&
+		SELECT_BITS(st->CR, DMA_SxCR_DIR) == (dir << DMA_SxCR_DIR_Pos) &&
+		SELECT_BITS(st->CR, DMA_SxCR_PINC|DMA_SxCR_PSIZE|DMA_SxCR_MSIZE) == 0 &&
+		st->PAR == (uint32_t )(uintptr_t )&mock_SPI1.DR &&
+		st->M0AR != 0 &&
+		st->FCR == 0
+	);
+}
+static volatile uint8_t* stream_mem(uint_fast8_t s) {
+	const DMA_Stream_TypeDef *st = &mock_DMA2_Stream[s];
+	uintptr_t addr = st->M0AR;
+
+	if (BIT_IS_SET(st->CR, DMA_SxCR_MINC)) {
+		addr += stream_start_ndtr[s] - st->NDTR;
+	}
+	return (volatile uint8_t *)addr;
+}
+static void run_dma(void) {
+	DMA_Stream_TypeDef *rx = &mock_DMA2_Stream[RX_STREAM], *tx = &mock_DMA2_Stream[TX_STREAM];
+
+	sync_dma_flags();
+
+	if (!clock_on(RCC_PERIPH_DMA2) || !clock_on(RCC_PERIPH_SPI1) || !BIT_IS_SET(mock_SPI1.CR1, SPI_CR1_SPE)) {
+		return;
+	}
+	if (!BIT_IS_SET(rx->CR, DMA_SxCR_EN) || !BIT_IS_SET(tx->CR, DMA_SxCR_EN)) {
+		return;
+	}
+	if (!BIT_IS_SET(mock_SPI1.CR2, SPI_CR2_RXDMAEN) || !BIT_IS_SET(mock_SPI1.CR2, SPI_CR2_TXDMAEN)) {
+		return;
+	}
+	if (!stream_is_valid(RX_STREAM, 0b00U)) {
+		stream_error(RX_STREAM);
+		return;
+	}
+	if (!stream_is_valid(TX_STREAM, 0b01U)) {
+		stream_error(TX_STREAM);
+		return;
+	}
+	if (mock_spi_stalled) {
+		return;
+	}
+
+	++mock_dma_transfers;
+	while (rx->NDTR > 0 && tx->NDTR > 0) {
+		uint8_t out = *stream_mem(TX_STREAM), in;
+
+		--tx->NDTR;
+		if (mock_spi_wire_bytes < MOCK_SPI_WIRE_BYTES) {
+			mock_spi_wire[mock_spi_wire_bytes++] = out;
+		}
+		in = (mock_spi_device != NULL) ? mock_spi_device(out) : out;
+		*stream_mem(RX_STREAM) = in;
+		--rx->NDTR;
+	}
+	MOCK_CHECK(rx->NDTR == 0 && tx->NDTR == 0, "RX and TX streams were given different sizes");
+
+	// Streams disable themselves when they finish
+	CLEAR_BIT(tx->CR, DMA_SxCR_EN);
+	CLEAR_BIT(rx->CR, DMA_SxCR_EN);
+	stream_was_enabled[TX_STREAM] = stream_was_enabled[RX_STREAM] = false;
+	SET_BIT(mock_DMA2.LISR, TCIF(TX_STREAM)|TCIF(RX_STREAM));
+	if (BIT_IS_SET(rx->CR, DMA_SxCR_TCIE)) {
+		irq_pending[DMA2_Stream0_IRQn] = true;
+	}
+
+	return;
+}
+static void run_irqs(void) {
+	if (!irq_masked && irq_enabled[DMA2_Stream0_IRQn] && irq_pending[DMA2_Stream0_IRQn]) {
+		irq_pending[DMA2_Stream0_IRQn] = false;
+		DMA2_Stream0_IRQHandler();
+		sync_dma_flags();
+	}
+	return;
+}
+void mock_run(void) {
+	run_dma();
+	run_irqs();
+	return;
+}
+void mock_spi_wire_clear(void) {
+	mock_spi_wire_bytes = 0;
+	return;
+}
+
+//
+// Core
+//
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority) {
+	UNUSED(IRQn);
+	UNUSED(priority);
+	return;
+}
+void NVIC_EnableIRQ(IRQn_Type IRQn) {
+	irq_enabled[IRQn] = true;
+	run_irqs();
+	return;
+}
+void NVIC_DisableIRQ(IRQn_Type IRQn) {
+	irq_enabled[IRQn] = false;
+	return;
+}
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn) {
+	irq_pending[IRQn] = false;
+	return;
+}
+bool mock_irq_is_enabled(IRQn_Type IRQn) {
+	return irq_enabled[IRQn];
+}
+void __disable_irq(void) {
+	irq_masked = true;
+	return;
+}
+void __enable_irq(void) {
+	irq_masked = false;
+	run_irqs();
+	return;
+}
+void __WFI(void) {
+	++G_sys_msticks;
+	run_dma();
+	return;
+}
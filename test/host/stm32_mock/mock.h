@@ -0,0 +1,47 @@
+//
+// Register-level mock of an STM32F401's SPI1 and the DMA2 streams serving it
+//
+#ifndef _STM32_MOCK_MOCK_H
+#define _STM32_MOCK_MOCK_H
+
+#include "include/interface.h"
+#include "platform/CMSIS_STM32/system.h"
+#include "platform/CMSIS_STM32/gpio.h"
+
+
+#define MOCK_CHECK(_cond_, _msg_) \
+	do { \
+		if (!(_cond_)) { \
+			mock_fail(__FILE__, __LINE__, (_msg_)); \
+		} \
+	} while (0)
+void mock_fail(const char *file, int line, const char *msg);
+
+//
+// Called with each byte sent over a DMA transfer to get the byte received
+// in its place; if NULL, the sent byte is received
+typedef uint8_t (*mock_spi_device_t)(uint8_t tx);
+extern mock_spi_device_t mock_spi_device;
+//
+// While set, DMA requests are never served and transfers don't progress
+extern bool mock_spi_stalled;
+//
+// Every byte sent over DMA since the last mock_spi_wire_clear()
+#define MOCK_SPI_WIRE_BYTES 2048U
+extern uint8_t mock_spi_wire[MOCK_SPI_WIRE_BYTES];
+extern uint_fast16_t mock_spi_wire_bytes;
+void mock_spi_wire_clear(void);
+//
+// The number of DMA transfers run so far
+extern uint_fast16_t mock_dma_transfers;
+
+//
+// Let a transfer in progress run, the same as happens while sleeping but
+// without the time passing
+void mock_run(void);
+
+uint_fast8_t mock_dma_clock_users(void);
+bool mock_irq_is_enabled(IRQn_Type IRQn);
+
+
+#endif // _STM32_MOCK_MOCK_H
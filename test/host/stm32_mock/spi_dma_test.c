@@ -0,0 +1,217 @@
+//
+// Check the CMSIS_STM32 SPI driver's DMA and polled transfers against the
+// register-level mock
+//
+// Built and run by test/host/run_tests.py; it prints what it checked and
+// exits non-zero on the first failure.
+//
+#include "mock.h"
+#include "platform/CMSIS_STM32/spi.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define CHECK(_cond_) MOCK_CHECK((_cond_), #_cond_)
+
+#define BLOCK_BYTES 512U
+#define TIMEOUT_MS 100U
+
+// DMA only ever gets static addresses, see stm32f4xx.h
+static uint8_t tx_buf[BLOCK_BYTES];
+static uint8_t rx_buf[BLOCK_BYTES];
+static uint8_t device_out[BLOCK_BYTES];
+static uint_fast16_t device_pos;
+
+static uint_fast8_t callbacks;
+static err_t callback_res;
+static void *callback_data;
+
+//
+// The device answers with device_out[], in order
+static uint8_t device(uint8_t tx) {
+	UNUSED(tx);
+	return device_out[device_pos++ % BLOCK_BYTES];
+}
+static void callback(err_t res, void *cb_data) {
+	++callbacks;
+	callback_res = res;
+	callback_data = cb_data;
+	return;
+}
+static void reset(void) {
+	for (uint_fast16_t i = 0; i < BLOCK_BYTES; ++i) {
+		tx_buf[i] = (uint8_t )(i * 3U);
+		device_out[i] = (uint8_t )((i * 7U) + 1U);
+	}
+	memset(rx_buf, 0, sizeof(rx_buf));
+	device_pos = 0;
+	callbacks = 0;
+	callback_res = ERR_UNKNOWN;
+	callback_data = NULL;
+	mock_spi_stalled = false;
+	mock_spi_wire_clear();
+
+	return;
+}
+static bool dma_is_idle(void) {
+	return (
+		!spi_transfer_is_busy() &&
+		!BIT_IS_SET(DMA2_Stream0->CR, DMA_SxCR_EN) &&
+		!BIT_IS_SET(DMA2_Stream3->CR, DMA_SxCR_EN) &&
+		!BIT_IS_SET(SPI1->CR2, SPI_CR2_RXDMAEN|SPI_CR2_TXDMAEN)
+	);
+}
+
+//
+// A receive-only block goes through DMA with the fill byte sent throughout
+static void test_receive_block(void) {
+	uint_fast16_t transfers = mock_dma_transfers;
+
+	reset();
+	CHECK(spi_receive_block(rx_buf, BLOCK_BYTES, 0xFFU, TIMEOUT_MS) == ERR_OK);
+	CHECK(mock_dma_transfers == transfers + 1U);
+	CHECK(memcmp(rx_buf, device_out, BLOCK_BYTES) == 0);
+	CHECK(mock_spi_wire_bytes == BLOCK_BYTES);
+	for (uint_fast16_t i = 0; i < BLOCK_BYTES; ++i) {
+		CHECK(mock_spi_wire[i] == 0xFFU);
+	}
+	CHECK(dma_is_idle());
+	puts("ok: 512-byte receive uses DMA");
+
+	return;
+}
+//
+// A transmit-only block goes through DMA with the received bytes dropped
+static void test_transmit_block(void) {
+	uint_fast16_t transfers = mock_dma_transfers;
+
+	reset();
+	CHECK(spi_transmit_block(tx_buf, BLOCK_BYTES, TIMEOUT_MS) == ERR_OK);
+	CHECK(mock_dma_transfers == transfers + 1U);
+	CHECK(mock_spi_wire_bytes == BLOCK_BYTES);
+	CHECK(memcmp(mock_spi_wire, tx_buf, BLOCK_BYTES) == 0);
+	CHECK(dma_is_idle());
+	puts("ok: 512-byte transmit uses DMA");
+
+	return;
+}
+//
+// An asynchronous transfer runs both ways, turns away anything else until
+// it's done, and calls back once
+static void test_async_transfer(void) {
+	uint8_t b;
+
+	reset();
+	CHECK(spi_transfer_async(tx_buf, rx_buf, 64U, 0, callback, &callbacks) == ERR_OK);
+	CHECK(spi_transfer_is_busy());
+	CHECK(spi_transfer_async(tx_buf, rx_buf, 64U, 0, callback, &callbacks) == ERR_RETRY);
+	CHECK(spi_receive_block(rx_buf, 4U, 0xFFU, TIMEOUT_MS) == ERR_RETRY);
+	CHECK(spi_transmit_block(tx_buf, BLOCK_BYTES, TIMEOUT_MS) == ERR_RETRY);
+	CHECK(spi_exchange_byte(0xFFU, &b, TIMEOUT_MS) == ERR_RETRY);
+	CHECK(callbacks == 0);
+
+	CHECK(spi_transfer_wait(TIMEOUT_MS) == ERR_OK);
+	CHECK(callbacks == 1U && callback_res == ERR_OK && callback_data == &callbacks);
+	CHECK(memcmp(rx_buf, device_out, 64U) == 0);
+	CHECK(mock_spi_wire_bytes == 64U && memcmp(mock_spi_wire, tx_buf, 64U) == 0);
+	CHECK(dma_is_idle());
+
+	// The interrupt finishes a transfer whether or not anyone's waiting
+	reset();
+	CHECK(spi_transfer_async(NULL, rx_buf, 32U, 0x5AU, callback, NULL) == ERR_OK);
+	mock_run();
+	CHECK(callbacks == 1U && callback_res == ERR_OK);
+	CHECK(memcmp(rx_buf, device_out, 32U) == 0);
+	CHECK(dma_is_idle());
+	CHECK(spi_transfer_wait(TIMEOUT_MS) == ERR_OK);
+	puts("ok: asynchronous transfers");
+
+	return;
+}
+//
+// Transfers shorter than SPI_DMA_MIN_BYTES are polled; the mock's data
+// register loops back when it's used directly
+static void test_polled(void) {
+	uint_fast16_t transfers = mock_dma_transfers;
+	uint8_t b = 0;
+
+	reset();
+	CHECK(spi_receive_block(rx_buf, SPI_DMA_MIN_BYTES - 1U, 0xA5U, TIMEOUT_MS) == ERR_OK);
+	for (uint_fast16_t i = 0; i < SPI_DMA_MIN_BYTES - 1U; ++i) {
+		CHECK(rx_buf[i] == 0xA5U);
+	}
+	CHECK(rx_buf[SPI_DMA_MIN_BYTES - 1U] == 0);
+	CHECK(spi_transmit_block(tx_buf, SPI_DMA_MIN_BYTES - 1U, TIMEOUT_MS) == ERR_OK);
+	CHECK(spi_exchange_byte(0x3CU, &b, TIMEOUT_MS) == ERR_OK && b == 0x3CU);
+	CHECK(mock_dma_transfers == transfers && mock_spi_wire_bytes == 0);
+	puts("ok: short transfers are polled");
+
+	return;
+}
+//
+// A transfer which never finishes is abandoned after the timeout and leaves
+// the controller ready for the next one
+static void test_timeout(void) {
+	utime_t start;
+
+	reset();
+	mock_spi_stalled = true;
+	start = G_sys_msticks;
+	CHECK(spi_receive_block(rx_buf, BLOCK_BYTES, 0xFFU, 10U) == ERR_TIMEOUT);
+	CHECK(G_sys_msticks - start >= 10U && G_sys_msticks - start < TIMEOUT_MS);
+	CHECK(dma_is_idle());
+	CHECK(mock_irq_is_enabled(DMA2_Stream0_IRQn));
+
+	mock_spi_stalled = false;
+	CHECK(spi_receive_block(rx_buf, BLOCK_BYTES, 0xFFU, TIMEOUT_MS) == ERR_OK);
+	CHECK(memcmp(rx_buf, device_out, BLOCK_BYTES) == 0);
+	puts("ok: stalled transfer times out");
+
+	return;
+}
+//
+// Turning the peripheral off abandons a transfer in progress and gives the
+// DMA controller's clock back
+static void test_off_aborts(void) {
+	reset();
+	mock_spi_stalled = true;
+	CHECK(spi_transfer_async(tx_buf, NULL, BLOCK_BYTES, 0, callback, NULL) == ERR_OK);
+	__WFI();
+	CHECK(spi_off() == ERR_OK);
+	CHECK(callbacks == 1U && callback_res == ERR_INTERRUPT);
+	CHECK(spi_transfer_wait(TIMEOUT_MS) == ERR_INTERRUPT);
+	CHECK(dma_is_idle());
+	CHECK(mock_dma_clock_users() == 0);
+	CHECK(!mock_irq_is_enabled(DMA2_Stream0_IRQn));
+	CHECK(!spi_is_on());
+
+	reset();
+	CHECK(spi_on() == ERR_OK);
+	CHECK(mock_dma_clock_users() == 1U);
+	CHECK(spi_transmit_block(tx_buf, BLOCK_BYTES, TIMEOUT_MS) == ERR_OK);
+	CHECK(memcmp(mock_spi_wire, tx_buf, BLOCK_BYTES) == 0);
+	puts("ok: spi_off() aborts a transfer");
+
+	return;
+}
+
+int main(void) {
+	mock_spi_device = device;
+
+	spi_init();
+	CHECK(spi_on() == ERR_OK);
+
+	test_receive_block();
+	test_transmit_block();
+	test_async_transfer();
+	test_polled();
+	test_timeout();
+	test_off_aborts();
+
+	CHECK(spi_off() == ERR_OK);
+	CHECK(mock_dma_clock_users() == 0);
+
+	return 0;
+}
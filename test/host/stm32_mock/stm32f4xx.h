@@ -0,0 +1,227 @@
+//
+// Register-level stand-in for the CMSIS STM32F4xx device header
+//
+// Only what the CMSIS_STM32 platform headers and spi.c need to build for an
+// STM32F401 is here. Register and bit definitions follow stm32f401xc.h, but
+// the peripherals are ordinary variables in host memory and the core
+// functions are implemented by mock.c, which also moves the data for the DMA
+// streams serving SPI1.
+//
+// DMA address registers hold 32-bit addresses, so anything they point to has
+// to be in the low 4GB of the address space; test programs are linked with
+// '-no-pie' and only use static buffers.
+//
+#ifndef _STM32_MOCK_STM32F4XX_H
+#define _STM32_MOCK_STM32F4XX_H
+
+#include <stdint.h>
+
+#define __STM32F4xx_CMSIS_VERSION_MAIN (0x02U)
+#define __STM32F4xx_CMSIS_VERSION_SUB1 (0x06U)
+#define __STM32F4xx_CMSIS_VERSION_SUB2 (0x08U)
+#define __STM32F4xx_CMSIS_VERSION_RC   (0x00U)
+#define __STM32F4xx_CMSIS_VERSION ((__STM32F4xx_CMSIS_VERSION_MAIN << 24U)\
+                                  |(__STM32F4xx_CMSIS_VERSION_SUB1 << 16U)\
+                                  |(__STM32F4xx_CMSIS_VERSION_SUB2 << 8U )\
+                                  |(__STM32F4xx_CMSIS_VERSION_RC))
+
+#define __I  volatile const
+#define __O  volatile
+#define __IO volatile
+
+#define SRAM_BASE 0x20000000UL
+
+typedef enum {
+	SysTick_IRQn       = -1,
+	DMA1_Stream0_IRQn  = 11,
+	DMA1_Stream3_IRQn  = 14,
+	DMA2_Stream0_IRQn  = 56,
+	MOCK_IRQn_COUNT    = 86
+} IRQn_Type;
+
+typedef struct {
+	__IO uint32_t MODER;
+	__IO uint32_t OTYPER;
+	__IO uint32_t OSPEEDR;
+	__IO uint32_t PUPDR;
+	__IO uint32_t IDR;
+	__IO uint32_t ODR;
+	__IO uint32_t BSRR;
+	__IO uint32_t LCKR;
+	__IO uint32_t AFR[2];
+} GPIO_TypeDef;
+
+typedef struct {
+	__IO uint32_t SR;
+	__IO uint32_t DR;
+	__IO uint32_t BRR;
+	__IO uint32_t CR1;
+	__IO uint32_t CR2;
+	__IO uint32_t CR3;
+	__IO uint32_t GTPR;
+} USART_TypeDef;
+
+typedef struct {
+	__IO uint32_t CR1;
+	__IO uint32_t CR2;
+	__IO uint32_t SMCR;
+	__IO uint32_t DIER;
+	__IO uint32_t SR;
+	__IO uint32_t EGR;
+	__IO uint32_t CCMR1;
+	__IO uint32_t CCMR2;
+	__IO uint32_t CCER;
+	__IO uint32_t CNT;
+	__IO uint32_t PSC;
+	__IO uint32_t ARR;
+	__IO uint32_t RCR;
+	__IO uint32_t CCR1;
+	__IO uint32_t CCR2;
+	__IO uint32_t CCR3;
+	__IO uint32_t CCR4;
+	__IO uint32_t BDTR;
+	__IO uint32_t DCR;
+	__IO uint32_t DMAR;
+	__IO uint32_t OR;
+} TIM_TypeDef;
+
+typedef struct {
+	__IO uint32_t CR1;
+	__IO uint32_t CR2;
+	__IO uint32_t SR;
+	__IO uint32_t DR;
+	__IO uint32_t CRCPR;
+	__IO uint32_t RXCRCR;
+	__IO uint32_t TXCRCR;
+	__IO uint32_t I2SCFGR;
+	__IO uint32_t I2SPR;
+} SPI_TypeDef;
+
+typedef struct {
+	__IO uint32_t CR;
+	__IO uint32_t NDTR;
+	__IO uint32_t PAR;
+	__IO uint32_t M0AR;
+	__IO uint32_t M1AR;
+	__IO uint32_t FCR;
+} DMA_Stream_TypeDef;
+
+typedef struct {
+	__IO uint32_t LISR;
+	__IO uint32_t HISR;
+	__IO uint32_t LIFCR;
+	__IO uint32_t HIFCR;
+} DMA_TypeDef;
+
+extern GPIO_TypeDef mock_GPIOA, mock_GPIOB, mock_GPIOC;
+extern SPI_TypeDef mock_SPI1;
+extern DMA_TypeDef mock_DMA2;
+extern DMA_Stream_TypeDef mock_DMA2_Stream[8];
+
+#define GPIOA (&mock_GPIOA)
+#define GPIOB (&mock_GPIOB)
+#define GPIOC (&mock_GPIOC)
+#define SPI1  (&mock_SPI1)
+#define DMA2  (&mock_DMA2)
+#define DMA2_Stream0 (&mock_DMA2_Stream[0])
+#define DMA2_Stream1 (&mock_DMA2_Stream[1])
+#define DMA2_Stream2 (&mock_DMA2_Stream[2])
+#define DMA2_Stream3 (&mock_DMA2_Stream[3])
+#define DMA2_Stream4 (&mock_DMA2_Stream[4])
+#define DMA2_Stream5 (&mock_DMA2_Stream[5])
+#define DMA2_Stream6 (&mock_DMA2_Stream[6])
+#define DMA2_Stream7 (&mock_DMA2_Stream[7])
+
+//
+// RCC
+//
+#define RCC_AHB1ENR_GPIOAEN (0x1UL << 0U)
+#define RCC_AHB1ENR_GPIOBEN (0x1UL << 1U)
+#define RCC_AHB1ENR_GPIOCEN (0x1UL << 2U)
+#define RCC_AHB1ENR_DMA1EN  (0x1UL << 21U)
+#define RCC_AHB1ENR_DMA2EN  (0x1UL << 22U)
+#define RCC_APB2ENR_SPI1EN  (0x1UL << 12U)
+
+//
+// SPI
+//
+#define SPI_CR1_CPHA_Pos     (0U)
+#define SPI_CR1_CPHA         (0x1UL << SPI_CR1_CPHA_Pos)
+#define SPI_CR1_CPOL_Pos     (1U)
+#define SPI_CR1_CPOL         (0x1UL << SPI_CR1_CPOL_Pos)
+#define SPI_CR1_MSTR_Pos     (2U)
+#define SPI_CR1_MSTR         (0x1UL << SPI_CR1_MSTR_Pos)
+#define SPI_CR1_BR_Pos       (3U)
+#define SPI_CR1_BR           (0x7UL << SPI_CR1_BR_Pos)
+#define SPI_CR1_SPE_Pos      (6U)
+#define SPI_CR1_SPE          (0x1UL << SPI_CR1_SPE_Pos)
+#define SPI_CR1_LSBFIRST_Pos (7U)
+#define SPI_CR1_LSBFIRST     (0x1UL << SPI_CR1_LSBFIRST_Pos)
+#define SPI_CR1_SSI_Pos      (8U)
+#define SPI_CR1_SSI          (0x1UL << SPI_CR1_SSI_Pos)
+#define SPI_CR1_SSM_Pos      (9U)
+#define SPI_CR1_SSM          (0x1UL << SPI_CR1_SSM_Pos)
+#define SPI_CR1_DFF_Pos      (11U)
+#define SPI_CR1_DFF          (0x1UL << SPI_CR1_DFF_Pos)
+
+#define SPI_CR2_RXDMAEN_Pos  (0U)
+#define SPI_CR2_RXDMAEN      (0x1UL << SPI_CR2_RXDMAEN_Pos)
+#define SPI_CR2_TXDMAEN_Pos  (1U)
+#define SPI_CR2_TXDMAEN      (0x1UL << SPI_CR2_TXDMAEN_Pos)
+
+#define SPI_SR_RXNE_Pos      (0U)
+#define SPI_SR_RXNE          (0x1UL << SPI_SR_RXNE_Pos)
+#define SPI_SR_TXE_Pos       (1U)
+#define SPI_SR_TXE           (0x1UL << SPI_SR_TXE_Pos)
+#define SPI_SR_OVR_Pos       (6U)
+#define SPI_SR_OVR           (0x1UL << SPI_SR_OVR_Pos)
+#define SPI_SR_BSY_Pos       (7U)
+#define SPI_SR_BSY           (0x1UL << SPI_SR_BSY_Pos)
+
+//
+// DMA
+//
+#define DMA_SxCR_EN_Pos      (0U)
+#define DMA_SxCR_EN          (0x1UL << DMA_SxCR_EN_Pos)
+#define DMA_SxCR_TEIE_Pos    (2U)
+#define DMA_SxCR_TEIE        (0x1UL << DMA_SxCR_TEIE_Pos)
+#define DMA_SxCR_TCIE_Pos    (4U)
+#define DMA_SxCR_TCIE        (0x1UL << DMA_SxCR_TCIE_Pos)
+#define DMA_SxCR_DIR_Pos     (6U)
+#define DMA_SxCR_DIR         (0x3UL << DMA_SxCR_DIR_Pos)
+#define DMA_SxCR_PINC_Pos    (9U)
+#define DMA_SxCR_PINC        (0x1UL << DMA_SxCR_PINC_Pos)
+#define DMA_SxCR_MINC_Pos    (10U)
+#define DMA_SxCR_MINC        (0x1UL << DMA_SxCR_MINC_Pos)
+#define DMA_SxCR_PSIZE_Pos   (11U)
+#define DMA_SxCR_PSIZE       (0x3UL << DMA_SxCR_PSIZE_Pos)
+#define DMA_SxCR_MSIZE_Pos   (13U)
+#define DMA_SxCR_MSIZE       (0x3UL << DMA_SxCR_MSIZE_Pos)
+#define DMA_SxCR_PL_Pos      (16U)
+#define DMA_SxCR_PL          (0x3UL << DMA_SxCR_PL_Pos)
+#define DMA_SxCR_CHSEL_Pos   (25U)
+#define DMA_SxCR_CHSEL       (0x7UL << DMA_SxCR_CHSEL_Pos)
+
+#define DMA_LISR_FEIF0_Pos   (0U)
+#define DMA_LISR_FEIF0       (0x1UL << DMA_LISR_FEIF0_Pos)
+#define DMA_LISR_DMEIF0_Pos  (2U)
+#define DMA_LISR_DMEIF0      (0x1UL << DMA_LISR_DMEIF0_Pos)
+#define DMA_LISR_TEIF0_Pos   (3U)
+#define DMA_LISR_TEIF0       (0x1UL << DMA_LISR_TEIF0_Pos)
+#define DMA_LISR_HTIF0_Pos   (4U)
+#define DMA_LISR_HTIF0       (0x1UL << DMA_LISR_HTIF0_Pos)
+#define DMA_LISR_TCIF0_Pos   (5U)
+#define DMA_LISR_TCIF0       (0x1UL << DMA_LISR_TCIF0_Pos)
+
+//
+// Core functions, normally from core_cm4.h
+//
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn);
+void __disable_irq(void);
+void __enable_irq(void);
+void __WFI(void);
+
+#endif // _STM32_MOCK_STM32F4XX_H
@@ -0,0 +1,272 @@
+//
+// Compare ulib_printf_sink() with snprintf() and time print_decimal()
+//
+// Built and run by test/host/run_tests.py with PRINTF_USE_DIGIT_PAIRS on and
+// off and PRINTF_MAX_INT_BYTES at 4 and 8, which checks that random values
+// of every size print the same as with snprintf() in a range of integer
+// formats.
+//
+// With '--bench' it instead times printing a small %d, a 10-digit %lu and a
+// negative %d, reporting TSC cycles per conversion where the host has a TSC
+// and nanoseconds otherwise, next to snprintf() doing the same.
+//
+// It prints what it checked and exits non-zero on the first failure.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include "ulib/include/printf.h"
+#include "ulib/include/util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+# define HAVE_TSC 1
+#else
+# define HAVE_TSC 0
+#endif
+
+
+#define VALUES_PER_FORMAT 200000UL
+#define BENCH_CALLS 5000000UL
+#define OUT_BYTES 64U
+
+typedef enum {
+	ARG_INT,
+	ARG_UINT,
+	ARG_LONG,
+	ARG_ULONG,
+	ARG_LLONG,
+	ARG_ULLONG,
+} arg_t;
+
+static const struct {
+	const char *fmt;
+	arg_t arg;
+} formats[] = {
+	{ "%d",       ARG_INT },
+	{ "%i",       ARG_INT },
+	{ "%u",       ARG_UINT },
+	{ "[%6d]",    ARG_INT },
+	{ "[%-7d]",   ARG_INT },
+	{ "%+d",      ARG_INT },
+	{ "% d",      ARG_INT },
+	{ "%08u",     ARG_UINT },
+	{ "%.5d",     ARG_INT },
+	{ "[%12.7d]", ARG_INT },
+	{ "%X",       ARG_UINT },
+	{ "%x",       ARG_UINT },
+	{ "%o",       ARG_UINT },
+	{ "%ld",      ARG_LONG },
+	{ "%lu",      ARG_ULONG },
+	{ "t=%d,h=%lu;", ARG_INT },
+#if PRINTF_MAX_INT_BYTES >= 8
+	{ "%lld",     ARG_LLONG },
+	{ "%llu",     ARG_ULLONG },
+	{ "%020llu",  ARG_ULLONG },
+#endif
+};
+
+static const char *current = "";
+static uint64_t rand_state = 0x9E3779B97F4A7C15ULL;
+
+
+static void fail(const char *file, int line, const char *msg) {
+	fflush(stdout);
+	fprintf(stderr, "%s:%d: check failed for '%s': %s\n", file, line, current, msg);
+	exit(1);
+}
+static uint64_t next_rand(void) {
+	// xorshift64
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+
+	return rand_state;
+}
+//
+// A random value with a random number of significant bits, so that short
+// numbers are as well covered as long ones
+static uint64_t random_value(uint_fast8_t max_bits) {
+	uint_fast8_t bits = (uint_fast8_t )(next_rand() % (max_bits + 1U));
+
+	return (bits == 0) ? 0 : (next_rand() >> (64U - bits));
+}
+static int64_t random_signed(uint_fast8_t max_bits) {
+	int64_t v = (int64_t )random_value(max_bits - 1U);
+
+	return ((next_rand() & 1U) != 0) ? -v - 1 : v;
+}
+
+//
+// Output overflowing the buffer is a failure
+static void overflow(printf_sink_t *sink, const uint8_t *data, size_t len) {
+	UNUSED(sink);
+	UNUSED(data);
+	UNUSED(len);
+	fail(__FILE__, __LINE__, "output overflowed the buffer");
+}
+static void ulib_print(char *buf, const char *fmt, ...) {
+	printf_sink_t sink = { .buf = (uint8_t *)buf, .size = OUT_BYTES - 1U, .write = overflow };
+	va_list arp;
+
+	va_start(arp, fmt);
+	ulib_vprintf_sink(&sink, fmt, arp);
+	va_end(arp);
+	*sink.buf = 0;
+
+	return;
+}
+
+//
+// The longest integer a printf_uint_t can hold, in bits
+#define MAX_BITS ((uint_fast8_t )(PRINTF_MAX_INT_BYTES * 8U))
+
+static void check_format(const char *fmt, arg_t arg) {
+	char got[OUT_BYTES], expect[OUT_BYTES];
+
+	current = fmt;
+	for (uint_fast32_t i = 0; i < VALUES_PER_FORMAT; ++i) {
+		switch (arg) {
+		case ARG_INT: {
+			// The second argument only matters to the mixed format
+			int v = (int )random_signed(32);
+			unsigned long u = (unsigned long )(unsigned )v;
+
+			snprintf(expect, sizeof(expect), fmt, v, u);
+			ulib_print(got, fmt, v, u);
+			break;
+		}
+		case ARG_UINT: {
+			unsigned v = (unsigned )random_value(32);
+
+			snprintf(expect, sizeof(expect), fmt, v);
+			ulib_print(got, fmt, v);
+			break;
+		}
+		case ARG_LONG: {
+			long v = (long )random_signed(MIN(MAX_BITS, sizeof(long) * 8U));
+
+			snprintf(expect, sizeof(expect), fmt, v);
+			ulib_print(got, fmt, v);
+			break;
+		}
+		case ARG_ULONG: {
+			unsigned long v = (unsigned long )random_value(MIN(MAX_BITS, sizeof(long) * 8U));
+
+			snprintf(expect, sizeof(expect), fmt, v);
+			ulib_print(got, fmt, v);
+			break;
+		}
+		case ARG_LLONG: {
+			long long v = (long long )random_signed(MAX_BITS);
+
+			snprintf(expect, sizeof(expect), fmt, v);
+			ulib_print(got, fmt, v);
+			break;
+		}
+		case ARG_ULLONG: {
+			unsigned long long v = (unsigned long long )random_value(MAX_BITS);
+
+			snprintf(expect, sizeof(expect), fmt, v);
+			ulib_print(got, fmt, v);
+			break;
+		}
+		}
+		if (strcmp(got, expect) != 0) {
+			fflush(stdout);
+			fprintf(stderr, "'%s': got '%s', snprintf() gave '%s'\n", fmt, got, expect);
+			exit(1);
+		}
+	}
+
+	return;
+}
+
+//
+// Benchmark
+//
+typedef struct {
+	struct timespec ts;
+#if HAVE_TSC
+	uint64_t tsc;
+#endif
+} stamp_t;
+
+static void stamp(stamp_t *s) {
+	clock_gettime(CLOCK_MONOTONIC, &s->ts);
+#if HAVE_TSC
+	s->tsc = __rdtsc();
+#endif
+	return;
+}
+static double per_call(const stamp_t *start) {
+	stamp_t end;
+
+	stamp(&end);
+#if HAVE_TSC
+	return (double )(end.tsc - start->tsc) / BENCH_CALLS;
+#else
+	return ((((double )(end.ts.tv_sec - start->ts.tv_sec)) * 1e9) + (double )(end.ts.tv_nsec - start->ts.tv_nsec)) / BENCH_CALLS;
+#endif
+}
+//
+// Keep the compiler from dropping the output
+static volatile unsigned sink_sum;
+
+#define BENCH(_name_, _fmt_, _expr_) \
+	do { \
+		char buf[OUT_BYTES]; \
+		stamp_t start; \
+		double ulib_cost, libc_cost; \
+		\
+		stamp(&start); \
+		for (uint_fast32_t i = 0; i < BENCH_CALLS; ++i) { \
+			ulib_print(buf, (_fmt_), (_expr_)); \
+			sink_sum += (unsigned char )buf[0]; \
+		} \
+		ulib_cost = per_call(&start); \
+		stamp(&start); \
+		for (uint_fast32_t i = 0; i < BENCH_CALLS; ++i) { \
+			snprintf(buf, sizeof(buf), (_fmt_), (_expr_)); \
+			sink_sum += (unsigned char )buf[0]; \
+		} \
+		libc_cost = per_call(&start); \
+		printf("   %-14s %8.1f %10.1f\n", (_name_), ulib_cost, libc_cost); \
+	} while (0)
+
+static void bench(void) {
+	printf("PRINTF_USE_DIGIT_PAIRS=%u PRINTF_MAX_INT_BYTES=%u, %s per call:\n",
+		(unsigned )PRINTF_USE_DIGIT_PAIRS, (unsigned )PRINTF_MAX_INT_BYTES, HAVE_TSC ? "TSC cycles" : "ns");
+	printf("   %-14s %8s %10s\n", "", "ulib", "snprintf");
+	// Warm up the caches and the clock so the first result isn't skewed
+	for (uint_fast32_t i = 0; i < BENCH_CALLS; ++i) {
+		char buf[OUT_BYTES];
+
+		ulib_print(buf, "%d", (int )i);
+		snprintf(buf, sizeof(buf), "%d", (int )i);
+		sink_sum += (unsigned char )buf[0];
+	}
+	BENCH("%d 0-9999", "%d", (int )(i % 10000U));
+	BENCH("%d negative", "%d", -(int )(i % 10000U) - 1);
+	BENCH("%lu 10 digits", "%lu", 4000000000UL + (unsigned long )i);
+
+	return;
+}
+
+int main(int argc, char **argv) {
+	if ((argc > 1) && (strcmp(argv[1], "--bench") == 0)) {
+		bench();
+		return 0;
+	}
+
+	for (uint_fast8_t i = 0; i < SIZEOF_ARRAY(formats); ++i) {
+		check_format(formats[i].fmt, formats[i].arg);
+	}
+	printf("ok: %lu values in each of %u formats match snprintf() with PRINTF_USE_DIGIT_PAIRS=%u PRINTF_MAX_INT_BYTES=%u\n",
+		(unsigned long )VALUES_PER_FORMAT, (unsigned )SIZEOF_ARRAY(formats), (unsigned )PRINTF_USE_DIGIT_PAIRS, (unsigned )PRINTF_MAX_INT_BYTES);
+
+	return 0;
+}
@@ -0,0 +1,279 @@
+//
+// Compare seconds_to_datetime_cached() with the full conversion and libc
+//
+// Built and run by test/host/run_tests.py, which checks that every way of
+// converting a time agrees:
+//    Every 12 hours (plus a varying number of seconds) across the whole
+//    range of utime_t, seconds_to_datetime() and print_datetime() match
+//    gmtime(), and the cached conversion stepped forward through the same
+//    times matches both.
+//    The first and last second of the last day of every leap year in range
+//    convert to 31 December; seconds_to_date() used to get these wrong.
+//    Log timestamps a few minutes apart and random jumps forward and back
+//    convert the same cached and uncached.
+//
+// With '--bench' it instead times printing log timestamps 5 minutes apart
+// with the full conversion, the cached conversion and libc.
+//
+// It prints what it checked and exits non-zero on the first failure.
+//
+#define _POSIX_C_SOURCE 200809L
+
+#include "ulib/include/time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define CHECK(_cond_) \
+	do { \
+		if (!(_cond_)) { \
+			fail(__FILE__, __LINE__, #_cond_, current); \
+		} \
+	} while (0)
+
+#define RANDOM_JUMPS 2000000UL
+#define LOG_LINES    2000000UL
+#define BENCH_LINES  10000000UL
+#define LOG_INTERVAL_S (5U * SECONDS_PER_MINUTE)
+
+// The time being checked, reported on failure
+static utime_t current;
+// The host time of the start of TIME_YEAR_0
+static time_t epoch;
+static uint32_t rand_state = 0x2545F491UL;
+
+
+static void fail(const char *file, int line, const char *msg, utime_t seconds) {
+	fflush(stdout);
+	fprintf(stderr, "%s:%d: check failed at %lu: %s\n", file, line, (unsigned long )seconds, msg);
+	exit(1);
+}
+static uint32_t next_rand(void) {
+	// xorshift32
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+
+	return rand_state;
+}
+static bool is_leap_year(long year) {
+	return ((((year % 4) == 0) && ((year % 100) != 0)) || ((year % 400) == 0));
+}
+static time_t find_epoch(void) {
+	time_t t = 0;
+
+	for (long year = 1970; year < (long )TIME_YEAR_0; ++year) {
+		t += (is_leap_year(year) ? 366 : 365) * (time_t )SECONDS_PER_DAY;
+	}
+
+	return t;
+}
+static void libc_datetime(utime_t seconds, struct tm *tm) {
+	time_t t = epoch + (time_t )seconds;
+
+	CHECK(gmtime_r(&t, tm) != NULL);
+
+	return;
+}
+static bool datetime_is_tm(const datetime_t *dt, const struct tm *tm) {
+	return (
+		(dt->year == (time_year_t )(tm->tm_year + 1900)) &&
+		(dt->month == (uint_fast8_t )(tm->tm_mon + 1)) &&
+		(dt->day == (uint_fast8_t )tm->tm_mday) &&
+		(dt->hour == (uint_fast8_t )tm->tm_hour) &&
+		(dt->minute == (uint_fast8_t )tm->tm_min) &&
+		(dt->second == (uint_fast8_t )tm->tm_sec)
+	);
+}
+static bool datetime_is(const datetime_t *a, const datetime_t *b) {
+	return (
+		(a->year == b->year) && (a->month == b->month) && (a->day == b->day) &&
+		(a->hour == b->hour) && (a->minute == b->minute) && (a->second == b->second)
+	);
+}
+//
+// Convert a time both ways and check that they agree, including the string
+// kept in the cache
+static void check_cached(utime_t seconds, datetime_cache_t *cache) {
+	datetime_t full;
+	char buf[20];
+
+	current = seconds;
+	seconds_to_datetime(seconds, &full);
+	CHECK(datetime_is(seconds_to_datetime_cached(seconds, cache), &full));
+	CHECK(strcmp(cache->str, print_datetime(buf, sizeof(buf), &full)) == 0);
+
+	return;
+}
+
+static void check_against_libc(void) {
+	datetime_cache_t cache = { 0 };
+	uint_fast32_t count = 0;
+
+	for (uint_fast32_t step = 0; ; ++step) {
+		uint_fast64_t s = ((uint_fast64_t )step * 12U * SECONDS_PER_HOUR) + ((step * 7919U) % (12U * SECONDS_PER_HOUR));
+		utime_t seconds;
+		datetime_t dt;
+		struct tm tm;
+		char buf[20], expect[32];
+
+		if (s > UTIME_MAX) {
+			break;
+		}
+		seconds = (utime_t )s;
+		current = seconds;
+
+		libc_datetime(seconds, &tm);
+		seconds_to_datetime(seconds, &dt);
+		CHECK(datetime_is_tm(&dt, &tm));
+		CHECK(strftime(expect, sizeof(expect), "%Y.%m.%d_%H:%M:%S", &tm) > 0);
+		CHECK(strcmp(print_datetime(buf, sizeof(buf), &dt), expect) == 0);
+		CHECK(datetime_to_seconds(&dt) == seconds);
+
+		check_cached(seconds, &cache);
+		++count;
+	}
+	printf("ok: %lu times 12 hours apart match libc\n", (unsigned long )count);
+
+	return;
+}
+static void check_leap_year_ends(void) {
+	uint_fast16_t count = 0;
+
+	for (long year = (long )TIME_YEAR_0; ; ++year) {
+		time_t t = 0;
+		datetime_t dt;
+
+		if (!is_leap_year(year)) {
+			continue;
+		}
+		// Find the start of 31 December without timegm(), which isn't standard
+		for (long y = 1970; y < year; ++y) {
+			t += (is_leap_year(y) ? 366 : 365) * (time_t )SECONDS_PER_DAY;
+		}
+		t += 365 * (time_t )SECONDS_PER_DAY;
+		if ((t - epoch) + (time_t )SECONDS_PER_DAY - 1 > (time_t )UTIME_MAX) {
+			break;
+		}
+
+		for (utime_t s = 0; s < SECONDS_PER_DAY; s += SECONDS_PER_DAY - 1U) {
+			current = (utime_t )(t - epoch) + s;
+			seconds_to_date(current, &dt);
+			CHECK(dt.year == (time_year_t )year && dt.month == 12U && dt.day == 31U);
+		}
+		++count;
+	}
+	printf("ok: the last day of %u leap years\n", (unsigned )count);
+
+	return;
+}
+static void check_log_sequence(void) {
+	datetime_cache_t cache = { 0 };
+	utime_t seconds = next_rand() % (UTIME_MAX / 2U);
+
+	for (uint_fast32_t i = 0; i < LOG_LINES; ++i) {
+		check_cached(seconds, &cache);
+		// Mostly a few minutes apart with the occasional gap
+		seconds += ((i % 1000U) == 999U) ? (next_rand() % (40U * SECONDS_PER_DAY)) : (next_rand() % (10U * SECONDS_PER_MINUTE));
+	}
+	printf("ok: %lu log timestamps\n", (unsigned long )LOG_LINES);
+
+	return;
+}
+static void check_random_jumps(void) {
+	datetime_cache_t cache = { 0 };
+	utime_t seconds = next_rand();
+
+	for (uint_fast32_t i = 0; i < RANDOM_JUMPS; ++i) {
+		uint32_t r = next_rand();
+
+		check_cached(seconds, &cache);
+		switch (r % 4U) {
+		case 0:
+			seconds = next_rand();
+			break;
+		case 1:
+			seconds -= MIN(seconds, next_rand() % SECONDS_PER_DAY);
+			break;
+		default:
+			seconds += MIN(UTIME_MAX - seconds, next_rand() % (35U * SECONDS_PER_DAY));
+			break;
+		}
+	}
+	printf("ok: %lu random jumps\n", (unsigned long )RANDOM_JUMPS);
+
+	return;
+}
+
+static double elapsed_ns(const struct timespec *start) {
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (((double )(end.tv_sec - start->tv_sec)) * 1e9) + (double )(end.tv_nsec - start->tv_nsec);
+}
+static void bench(void) {
+	// 2024.01.01_00:00:00
+	const utime_t start = 283996800UL;
+	struct timespec t;
+	unsigned long sum;
+	double full_ns, cached_ns, libc_ns;
+
+	sum = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	for (uint_fast32_t i = 0; i < BENCH_LINES; ++i) {
+		datetime_t dt;
+		char buf[20];
+
+		seconds_to_datetime(start + (i * LOG_INTERVAL_S), &dt);
+		sum += (unsigned char )print_datetime(buf, sizeof(buf), &dt)[18];
+	}
+	full_ns = elapsed_ns(&t) / BENCH_LINES;
+
+	{
+		datetime_cache_t cache = { 0 };
+
+		clock_gettime(CLOCK_MONOTONIC, &t);
+		for (uint_fast32_t i = 0; i < BENCH_LINES; ++i) {
+			sum += (unsigned char )print_seconds_datetime_cached(start + (i * LOG_INTERVAL_S), &cache)[18];
+		}
+		cached_ns = elapsed_ns(&t) / BENCH_LINES;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	for (uint_fast32_t i = 0; i < BENCH_LINES; ++i) {
+		time_t tt = epoch + (time_t )(start + (i * LOG_INTERVAL_S));
+		struct tm tm;
+		char buf[32];
+
+		gmtime_r(&tt, &tm);
+		strftime(buf, sizeof(buf), "%Y.%m.%d_%H:%M:%S", &tm);
+		sum += (unsigned char )buf[18];
+	}
+	libc_ns = elapsed_ns(&t) / BENCH_LINES;
+
+	printf("%lu timestamps %u seconds apart (checksum %lu):\n", (unsigned long )BENCH_LINES, (unsigned )LOG_INTERVAL_S, sum);
+	printf("   full:   %6.1f ns/line\n", full_ns);
+	printf("   cached: %6.1f ns/line\n", cached_ns);
+	printf("   libc:   %6.1f ns/line\n", libc_ns);
+
+	return;
+}
+
+int main(int argc, char **argv) {
+	epoch = find_epoch();
+
+	if ((argc > 1) && (strcmp(argv[1], "--bench") == 0)) {
+		bench();
+		return 0;
+	}
+
+	check_against_libc();
+	check_leap_year_ends();
+	check_log_sequence();
+	check_random_jumps();
+
+	return 0;
+}
@@ -0,0 +1,268 @@
+#!/usr/bin/python3
+#
+# Convert a log file written with LOG_FORMAT_BINARY set back into the
+# tab-separated text format
+# The record layout is described in src/log.c
+#
+import sys
+import argparse
+import datetime
+
+RECORD_HEADER = ord("H")
+RECORD_LINE   = ord("L")
+NO_EXTRA = 0xFF
+
+FLAG_INITIALIZED = 0x01
+FLAG_ERROR       = 0x02
+
+HEADER_FLAG_SENSOR_TYPE = 0x01
+
+COLUMN_END                          = 0
+COLUMN_TIME                         = 1
+COLUMN_WARNINGS                     = 2
+COLUMN_SENSOR_STATUS                = 3
+COLUMN_SENSOR_READING               = 4
+COLUMN_CONTROLLER_STATUS            = 5
+COLUMN_ACTUATOR_STATUS              = 6
+COLUMN_ACTUATOR_STATUS_CHANGE_TIME  = 7
+COLUMN_ACTUATOR_ON_TIME             = 8
+COLUMN_ACTUATOR_STATUS_CHANGE_COUNT = 9
+COLUMN_EXTRA                        = 10
+
+STATUS_COLUMNS = (COLUMN_SENSOR_STATUS, COLUMN_CONTROLLER_STATUS, COLUMN_ACTUATOR_STATUS)
+
+TIME_FORMAT_AUTO     = 0
+TIME_FORMAT_SECONDS  = 1
+TIME_FORMAT_DURATION = 2
+TIME_FORMAT_DATE     = 3
+
+SECONDS_PER_YEAR = 60 * 60 * 24 * 365
+
+WARNINGS_LEGEND = "# Warnings: B=battery low, V=Vcc low, S=sensor warning, C=controller warning, A=Actuator warning, l=log write skipped, L=log write error"
+
+class DecodeError(Exception):
+	pass
+
+def crc16(data):
+	crc = 0xFFFF
+	for c in data:
+		crc ^= c << 8
+		for _ in range(8):
+			if crc & 0x8000:
+				crc = ((crc << 1) ^ 0x1021) & 0xFFFF
+			else:
+				crc = (crc << 1) & 0xFFFF
+	return crc
+
+class Reader:
+	def __init__(self, data, pos):
+		self.data = data
+		self.start = pos
+		self.pos = pos
+
+	def bytes(self, n):
+		if self.pos + n > len(self.data):
+			raise DecodeError("truncated record at offset %d" % (self.start))
+		b = self.data[self.pos:self.pos+n]
+		self.pos += n
+		return b
+
+	def int(self, n, endian, signed=False):
+		if n == 0:
+			return 0
+		return int.from_bytes(self.bytes(n), endian, signed=signed)
+
+	def str(self):
+		end = self.data.find(b"\0", self.pos)
+		if end < 0:
+			raise DecodeError("truncated record at offset %d" % (self.start))
+		s = self.data[self.pos:end].decode("latin-1")
+		self.pos = end + 1
+		return s
+
+	def check_crc(self, endian):
+		expected = crc16(self.data[self.start:self.pos])
+		if self.int(2, endian) != expected:
+			raise DecodeError("bad CRC in record at offset %d" % (self.start))
+
+class Header:
+	def __init__(self, r):
+		if r.bytes(3) != b"GHM":
+			raise DecodeError("bad header magic at offset %d" % (r.start))
+		self.version = r.int(1, "little")
+		if self.version != 1:
+			raise DecodeError("unsupported format version %d" % (self.version))
+		bo = r.bytes(2)
+		if bo == b"\x02\x01":
+			self.endian = "little"
+		elif bo == b"\x01\x02":
+			self.endian = "big"
+		else:
+			raise DecodeError("bad byte order marker at offset %d" % (r.start))
+		self.time_format = r.int(1, self.endian)
+		self.year_0 = r.int(2, self.endian)
+		self.flags = r.int(1, self.endian)
+		self.invalid_value = r.str()
+		self.no_value = r.str()
+		self.line_end = r.str()
+		self.warning_flags = r.str()
+		self.columns = []
+		while True:
+			ctype = r.int(1, self.endian)
+			if ctype == COLUMN_END:
+				break
+			size = r.int(1, self.endian)
+			index = r.int(1, self.endian)
+			name = r.str()
+			self.columns.append((ctype, size, index, name))
+		r.check_crc(self.endian)
+
+	def text(self):
+		out = []
+		for (ctype, size, index, name) in self.columns:
+			if ctype == COLUMN_TIME:
+				out.append("# %s" % (name))
+			elif ctype in STATUS_COLUMNS:
+				out.append("\t%s_status" % (name))
+			elif ctype == COLUMN_SENSOR_READING:
+				out.append("\t%s_reading_%u" % (name, index))
+			elif ctype == COLUMN_ACTUATOR_STATUS_CHANGE_TIME:
+				out.append("\t%s_last_status_change" % (name))
+			elif ctype == COLUMN_ACTUATOR_ON_TIME:
+				out.append("\t%s_on_time" % (name))
+			elif ctype == COLUMN_ACTUATOR_STATUS_CHANGE_COUNT:
+				out.append("\t%s_status_change_count" % (name))
+			else:
+				out.append("\t%s" % (name))
+		out.append(self.line_end)
+		out.append(WARNINGS_LEGEND + self.line_end)
+		return "".join(out)
+
+	def format_time(self, seconds, time_format):
+		if time_format == TIME_FORMAT_AUTO:
+			if seconds < (SECONDS_PER_YEAR * 3):
+				time_format = TIME_FORMAT_DURATION
+			else:
+				time_format = TIME_FORMAT_DATE
+
+		if time_format == TIME_FORMAT_SECONDS:
+			return "%u" % (seconds)
+		elif time_format == TIME_FORMAT_DURATION:
+			s = "%02us" % (seconds % 60)
+			if seconds // 60 > 0:
+				s = "%02um" % ((seconds // 60) % 60) + s
+			if seconds // (60 * 60) > 0:
+				s = "%02uh" % ((seconds // (60 * 60)) % 24) + s
+			if seconds // (60 * 60 * 24) > 0:
+				s = "%ud" % (seconds // (60 * 60 * 24)) + s
+			return s
+		else:
+			dt = datetime.datetime(self.year_0, 1, 1) + datetime.timedelta(seconds=seconds)
+			return dt.strftime("%Y.%m.%d_%H:%M:%S")
+
+	def format_warnings(self, warnings):
+		if warnings == 0:
+			return "OK"
+		s = "!"
+		for i in range(len(self.warning_flags)):
+			if warnings & (1 << i):
+				s += self.warning_flags[i]
+		return s
+
+	def line_text(self, r):
+		out = []
+		flags = 0
+		for (ctype, size, index, name) in self.columns:
+			if ctype == COLUMN_EXTRA:
+				continue
+			elif ctype == COLUMN_TIME:
+				out.append(self.format_time(r.int(size, self.endian), self.time_format))
+			elif ctype == COLUMN_WARNINGS:
+				out.append("\t" + self.format_warnings(r.int(size, self.endian)))
+			elif ctype in STATUS_COLUMNS:
+				flags = r.int(1, self.endian)
+				status = r.int(size - 1, self.endian, signed=True)
+				es = "\t!" if (flags & FLAG_ERROR) else "\t"
+				if not (flags & FLAG_INITIALIZED):
+					out.append(es + self.invalid_value)
+				elif size > 1:
+					out.append(es + "%d" % (status))
+				else:
+					out.append(es + self.no_value)
+			elif not (flags & FLAG_INITIALIZED):
+				# Every other column belongs to the status column before it
+				r.bytes(size)
+				out.append("\t" + self.invalid_value)
+			elif ctype == COLUMN_SENSOR_READING:
+				value = r.int(size - 1, self.endian, signed=True)
+				vtype = r.int(1, self.endian)
+				if (self.flags & HEADER_FLAG_SENSOR_TYPE) and vtype != 0:
+					out.append("\t%d (T:%02u)" % (value, vtype))
+				else:
+					out.append("\t%d" % (value))
+			elif ctype == COLUMN_ACTUATOR_STATUS_CHANGE_TIME:
+				out.append("\t" + self.format_time(r.int(size, self.endian), self.time_format))
+			elif ctype == COLUMN_ACTUATOR_ON_TIME:
+				out.append("\t" + self.format_time(r.int(size, self.endian), TIME_FORMAT_DURATION))
+			elif ctype == COLUMN_ACTUATOR_STATUS_CHANGE_COUNT:
+				out.append("\t%u" % (r.int(size, self.endian)))
+			else:
+				raise DecodeError("unknown column type %d" % (ctype))
+
+		extra_size = r.int(1, self.endian)
+		if extra_size != NO_EXTRA:
+			out.append("\t" + r.bytes(extra_size).decode("latin-1"))
+		out.append(self.line_end)
+		r.check_crc(self.endian)
+		return "".join(out)
+
+def decode(data, outf, errf):
+	header = None
+	pos = 0
+	errors = 0
+	resyncing = False
+
+	while pos < len(data):
+		r = Reader(data, pos)
+		rtype = r.int(1, "little")
+		if rtype == 0 and not any(data[pos:]):
+			# The rest is space reserved for the file that hasn't been written
+			# to yet
+			break
+		try:
+			if rtype == RECORD_HEADER:
+				header = Header(r)
+				outf.write(header.text())
+			elif rtype == RECORD_LINE:
+				if header is None:
+					raise DecodeError("line record before header at offset %d" % (pos))
+				outf.write(header.line_text(r))
+			else:
+				raise DecodeError("unknown record type 0x%02X at offset %d" % (rtype, pos))
+			pos = r.pos
+			resyncing = False
+		except DecodeError as e:
+			# Skip a byte and try to pick up again at the next good record
+			if not resyncing:
+				errf.write("%s\n" % (e))
+				errors += 1
+				resyncing = True
+			pos += 1
+
+	return errors
+
+parser = argparse.ArgumentParser(description="Convert a binary log file to tab-separated text")
+parser.add_argument("--out-file", "-o", help="Output to file (default is stdout)", default="-", metavar="[outfile]");
+parser.add_argument("logfile", help="Binary log file");
+args = parser.parse_args()
+
+with open(args.logfile, "rb") as f:
+	data = f.read()
+
+if args.out_file == "-":
+	errors = decode(data, sys.stdout, sys.stderr)
+else:
+	with open(args.out_file, "w", newline="") as f:
+		errors = decode(data, f, sys.stderr)
+
+sys.exit(1 if errors > 0 else 0)
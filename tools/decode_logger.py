@@ -0,0 +1,260 @@
+#!/usr/bin/python3
+#
+# Convert the output of a build with LOGGER_TOKENIZED set back into text
+# The format strings are found by scanning the source for LOGGER() calls and
+# each one is identified by the same hash that's computed at compile time by
+# lib/uHAL/include/interface/logger_token_hash.h
+# The record layout is described in logger_token() in lib/uHAL/src/serial.c
+# Lines which aren't tokenized records are passed through unchanged
+#
+import os
+import re
+import sys
+import base64
+import argparse
+
+# Must match lib/uHAL/tools/serial/logger_token_hash.sh
+HASH_LENGTH = 128
+HASH_COEF   = 65599
+
+FLAG_TIME = 0x01
+
+DEFAULT_SOURCE_DIRS = ("src", "lib", "config")
+SOURCE_EXTENSIONS   = (".c", ".h", ".cpp", ".hpp", ".ino")
+
+RECORD_RE     = re.compile(r"\$([A-Za-z0-9+/]+)")
+CALL_RE       = re.compile(r"\bLOGGER\s*\(")
+LITERAL_RE    = re.compile(r'\s*"((?:[^"\\\n]|\\.)*)"', re.S)
+CONVERSION_RE = re.compile(r"%([-+ #0']*)(\*|\d+)?(?:\.(\*|\d+))?(hh|h|ll|l|z|j|t)?([diouxXcsb%])")
+ESCAPE_RE     = re.compile(r"\\(x[0-9A-Fa-f]+|[0-7]{1,3}|.)", re.S)
+
+SIMPLE_ESCAPES = {
+	"n": "\n", "r": "\r", "t": "\t", "a": "\a", "b": "\b", "f": "\f", "v": "\v",
+	"\\": "\\", "\"": "\"", "'": "'", "?": "?",
+}
+
+class DecodeError(Exception):
+	pass
+
+def token_hash(s):
+	data = s.encode("latin-1")
+	h = len(data)
+	coef = HASH_COEF
+	for c in data[:HASH_LENGTH]:
+		h = (h + (c * coef)) & 0xFFFFFFFF
+		coef = (coef * HASH_COEF) & 0xFFFFFFFF
+	return h
+
+def c_unescape(s):
+	def sub(m):
+		e = m.group(1)
+		if e[0] == "x":
+			return chr(int(e[1:], 16) & 0xFF)
+		elif e[0] in "01234567":
+			return chr(int(e, 8) & 0xFF)
+		return SIMPLE_ESCAPES.get(e, e)
+	return ESCAPE_RE.sub(sub, s)
+
+def c_escape(s):
+	out = []
+	for c in s:
+		if c == "\\":
+			out.append("\\\\")
+		elif c == "\n":
+			out.append("\\n")
+		elif c == "\r":
+			out.append("\\r")
+		elif c == "\t":
+			out.append("\\t")
+		elif ord(c) < 0x20 or ord(c) > 0x7E:
+			out.append("\\x%02X" % (ord(c)))
+		else:
+			out.append(c)
+	return "".join(out)
+
+class TokenTable:
+	def __init__(self):
+		self.formats = {}
+
+	def add(self, fmt, errf):
+		token = token_hash(fmt)
+		prev = self.formats.get(token)
+		if prev is None:
+			self.formats[token] = fmt
+		elif prev != fmt:
+			errf.write("token 0x%08X collision between \"%s\" and \"%s\"\n" % (token, c_escape(prev), c_escape(fmt)))
+
+	def scan_file(self, path, errf):
+		with open(path, "r", encoding="latin-1") as f:
+			text = f.read()
+		for m in CALL_RE.finditer(text):
+			# Adjacent literals are concatenated; anything else (like the
+			# 'fmt' in the macro's own definition) ends the format string
+			pos = m.end()
+			parts = []
+			while True:
+				lm = LITERAL_RE.match(text, pos)
+				if lm is None:
+					break
+				parts.append(c_unescape(lm.group(1)))
+				pos = lm.end()
+			if len(parts) > 0:
+				self.add("".join(parts), errf)
+
+	def scan_dirs(self, dirs, errf):
+		for d in dirs:
+			for (root, subdirs, files) in os.walk(d):
+				subdirs.sort()
+				for name in sorted(files):
+					if name.endswith(SOURCE_EXTENSIONS):
+						self.scan_file(os.path.join(root, name), errf)
+
+	def read(self, path):
+		with open(path, "r", encoding="latin-1") as f:
+			for line in f:
+				line = line.rstrip("\r\n")
+				if line == "" or line.startswith("#"):
+					continue
+				(token, fmt) = line.split("\t", 1)
+				self.formats[int(token, 16)] = c_unescape(fmt)
+
+	def write(self, path):
+		with open(path, "w", encoding="latin-1") as f:
+			f.write("# LOGGER() format strings by token, generated by %s\n" % (os.path.basename(sys.argv[0])))
+			for token in sorted(self.formats):
+				f.write("%08X\t%s\n" % (token, c_escape(self.formats[token])))
+
+class Reader:
+	def __init__(self, data):
+		self.data = data
+		self.pos = 0
+
+	def left(self):
+		return len(self.data) - self.pos
+
+	def byte(self):
+		if self.pos >= len(self.data):
+			raise DecodeError("truncated record")
+		b = self.data[self.pos]
+		self.pos += 1
+		return b
+
+	def int(self):
+		b = self.byte()
+		negative = (b & 0x01) != 0
+		mag = (b & 0x7E) >> 1
+		shift = 6
+		while b & 0x80:
+			b = self.byte()
+			mag |= (b & 0x7F) << shift
+			shift += 7
+		return -mag if negative else mag
+
+	def str(self):
+		n = self.int()
+		if n < 0 or n > self.left():
+			raise DecodeError("truncated record")
+		s = self.data[self.pos:self.pos+n].decode("latin-1")
+		self.pos += n
+		return s
+
+def format_conversion(m, r):
+	(flags, width, precision, length, conv) = m.groups()
+	if conv == "%":
+		return "%"
+
+	flags = flags.replace("'", "")
+	if width == "*":
+		width = str(r.int())
+	if precision == "*":
+		precision = str(r.int())
+	spec = "%" + flags + (width or "") + (("." + precision) if precision is not None else "")
+
+	if conv == "s":
+		return (spec + "s") % (r.str())
+
+	value = r.int()
+	if conv == "c":
+		return (spec + "c") % (chr(value & 0xFF))
+	if conv in "di":
+		return (spec + "d") % (value)
+	# There's no way to know the size of the original type, so negative values
+	# passed to unsigned conversions are assumed to be 32 bits
+	if value < 0:
+		value += 1 << 32
+	if conv == "u":
+		return (spec + "d") % (value)
+	elif conv == "b":
+		return (spec + "s") % (format(value, "b"))
+	return (spec + conv) % (value)
+
+def format_record(table, data):
+	r = Reader(data)
+	flags = r.byte()
+	token = int.from_bytes(bytes([r.byte() for _ in range(4)]), "little")
+	out = []
+	if flags & FLAG_TIME:
+		out.append("%04u:  " % (r.int()))
+
+	fmt = table.formats.get(token)
+	if fmt is None:
+		out.append("<unknown LOGGER() token 0x%08X: %s>" % (token, data[r.pos:].hex()))
+		return "".join(out)
+
+	pos = 0
+	for m in CONVERSION_RE.finditer(fmt):
+		out.append(fmt[pos:m.start()])
+		try:
+			out.append(format_conversion(m, r))
+		except DecodeError:
+			# Arguments that didn't fit in the record are dropped
+			out.append("...")
+			return "".join(out)
+		pos = m.end()
+	out.append(fmt[pos:])
+	return "".join(out)
+
+def decode_line(table, line):
+	def sub(m):
+		b64 = m.group(1)
+		try:
+			data = base64.b64decode(b64 + ("=" * (-len(b64) % 4)), validate=True)
+			return format_record(table, data)
+		except (ValueError, DecodeError):
+			return m.group(0)
+	return RECORD_RE.sub(sub, line)
+
+def decode(table, inf, outf):
+	for line in inf:
+		outf.write(decode_line(table, line))
+
+parser = argparse.ArgumentParser(description="Convert tokenized LOGGER() output back into text")
+parser.add_argument("--out-file", "-o", help="Output to file (default is stdout)", default="-", metavar="[outfile]");
+parser.add_argument("--source", "-s", help="Scan this directory for LOGGER() calls; may be given more than once (default is %s)" % (", ".join(DEFAULT_SOURCE_DIRS)), action="append", metavar="[dir]");
+parser.add_argument("--table", "-t", help="Read the format strings from a table written by --write-table instead of scanning the source", metavar="[table]");
+parser.add_argument("--write-table", "-w", help="Write the format strings to a table and exit", metavar="[table]");
+parser.add_argument("capture", help="Captured serial output (default is stdin)", nargs="?", default="-");
+args = parser.parse_args()
+
+table = TokenTable()
+if args.table is not None:
+	table.read(args.table)
+else:
+	if args.source is None:
+		top = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+		args.source = [os.path.join(top, d) for d in DEFAULT_SOURCE_DIRS]
+	table.scan_dirs(args.source, sys.stderr)
+
+if args.write_table is not None:
+	table.write(args.write_table)
+	sys.exit(0)
+
+if args.capture == "-":
+	inf = sys.stdin
+else:
+	inf = open(args.capture, "r", encoding="latin-1", newline="")
+if args.out_file == "-":
+	decode(table, inf, sys.stdout)
+else:
+	with open(args.out_file, "w", encoding="latin-1", newline="") as f:
+		decode(table, inf, f)